@@ -0,0 +1,142 @@
+/**************************************************************************************************
+ * Host benchmark: the accumulation policies of Matrix::Multiply() (MatrixAccumulation, matrix.h) on
+ *  the dU(k) = XI_DU * E(k) shape of the update, in the precision of the library it's linked with:
+ *
+ *      bench_accumulation [--trials T] [--iterations N]
+ *
+ *  For every length n (the Hc*Z of a horizon) & policy: T random U x n gains & n x 1 vectors with
+ *  elements of mixed magnitude, the biggest error against a long double reference (relative to
+ *  sum|a*b|, i.e. to the condition of the sum), and the time of one n long dot product: the mean time
+ *  of a (MATRIX_MAXIMUM_SIZE-1) x n gain Multiply() over N calls, minus the one of a 1 long Multiply()
+ *  (mostly the construction of the whole MATRIX_MAXIMUM_SIZE^2 result buffer), per row.
+ *
+ * See https://github.com/pronenewbits for more!
+ *************************************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "konfig.h"
+#include "matrix.h"
+
+#define BENCH_U_LEN     (2)
+
+
+static uint32_t u32Seed = 12345;
+static float_prec fRandom(void)
+{
+    /* Deterministic LCG in [-1, 1] */
+    u32Seed = (1103515245UL * u32Seed) + 12345UL;
+    return float_prec((u32Seed >> 8) & 0xFFFF) / float_prec(32767.5) - float_prec(1.0);
+}
+
+static double f64WallSecond(void)
+{
+    struct timespec _ts;
+    clock_gettime(CLOCK_MONOTONIC, &_ts);
+    return double(_ts.tv_sec) + (double(_ts.tv_nsec) * 1e-9);
+}
+
+/* Keep the result alive so the compiler can't throw the multiplication away */
+volatile float_prec fSink;
+
+int main(int argc, char ** argv)
+{
+    int32_t _trials = 1000;
+    int32_t _iterations = 2000;
+    for (int _i = 1; _i < argc; _i++) {
+        if ((strcmp(argv[_i], "--trials") == 0) && (_i+1 < argc)) {
+            _trials = int32_t(atoi(argv[++_i]));
+        } else if ((strcmp(argv[_i], "--iterations") == 0) && (_i+1 < argc)) {
+            _iterations = int32_t(atoi(argv[++_i]));
+        } else {
+            fprintf(stderr, "usage: %s [--trials T] [--iterations N]\n", argv[0]);
+            return 2;
+        }
+    }
+    if ((_trials < 1) || (_iterations < 1)) {
+        fprintf(stderr, "Need trials >= 1 and iterations >= 1\n");
+        return 2;
+    }
+
+    const int32_t _len[] = {14, 40, 80, MATRIX_MAXIMUM_SIZE-1};
+    const MatrixAccumulation _acc[] = {MATRIX_ACC_NAIVE, MATRIX_ACC_PAIRWISE, MATRIX_ACC_KAHAN, MATRIX_ACC_DOUBLE};
+    const char * const _accName[] = {"naive", "pairwise", "kahan", "double"};
+
+    printf("precision : %s, MATRIX_PAIRWISE_BLOCK %d\n", (FPU_PRECISION == PRECISION_SINGLE) ? "float" : "double",
+           int(MATRIX_PAIRWISE_BLOCK));
+    printf("%6s %10s %14s %12s\n", "n", "policy", "max rel. err", "ns/dot");
+    static Matrix XI(BENCH_U_LEN, 1);
+    static Matrix Err(1, 1);
+    static Matrix XI_WIDE(MATRIX_MAXIMUM_SIZE-1, 1);
+
+    /* The baseline: a 1 long dot product */
+    static Matrix XI_1(MATRIX_MAXIMUM_SIZE-1, 1);
+    static Matrix Err_1(1, 1);
+    double _tConstruct = f64WallSecond();
+    for (int32_t _k = 0; _k < _iterations; _k++) {
+        Err_1[0][0] = float_prec(_k & 0xFF);
+        Matrix _out = XI_1.Multiply(Err_1, MATRIX_ACC_NAIVE);
+        fSink = _out[0][0];
+    }
+    _tConstruct = (f64WallSecond() - _tConstruct) / double(_iterations);
+    for (size_t _l = 0; _l < (sizeof(_len)/sizeof(_len[0])); _l++) {
+        const int32_t _n = _len[_l];
+        if (_n >= MATRIX_MAXIMUM_SIZE) {
+            continue;
+        }
+        XI = Matrix(BENCH_U_LEN, _n);
+        Err = Matrix(_n, 1);
+
+        double _errMax[4] = {0, 0, 0, 0};
+        for (int32_t _t = 0; _t < _trials; _t++) {
+            /* Mixed magnitudes, like E(k) of a coincidence point far & near the set-point */
+            for (int32_t _j = 0; _j < _n; _j++) {
+                for (int32_t _i = 0; _i < BENCH_U_LEN; _i++) {
+                    XI[_i][_j] = fRandom();
+                }
+                Err[_j][0] = fRandom() * float_prec(pow(10.0, 3.0 * double(fRandom())));
+            }
+            for (int32_t _a = 0; _a < 4; _a++) {
+                Matrix _out = XI.Multiply(Err, _acc[_a]);
+                for (int32_t _i = 0; _i < BENCH_U_LEN; _i++) {
+                    long double _ref = 0;
+                    long double _abs = 0;
+                    for (int32_t _j = 0; _j < _n; _j++) {
+                        const long double _p = (long double)(XI[_i][_j]) * (long double)(Err[_j][0]);
+                        _ref += _p;
+                        _abs += (_p < 0) ? -_p : _p;
+                    }
+                    const double _err = double(((long double)(_out[_i][0]) - _ref) / ((_abs > 0) ? _abs : 1));
+                    _errMax[_a] = (fabs(_err) > _errMax[_a]) ? fabs(_err) : _errMax[_a];
+                }
+            }
+        }
+
+        XI_WIDE = Matrix(MATRIX_MAXIMUM_SIZE-1, _n);
+        for (int32_t _i = 0; _i < (MATRIX_MAXIMUM_SIZE-1); _i++) {
+            for (int32_t _j = 0; _j < _n; _j++) {
+                XI_WIDE[_i][_j] = fRandom();
+            }
+        }
+        for (int32_t _a = 0; _a < 4; _a++) {
+            const double _t = f64WallSecond();
+            for (int32_t _k = 0; _k < _iterations; _k++) {
+                Err[0][0] = float_prec(_k & 0xFF);
+                Matrix _out = XI_WIDE.Multiply(Err, _acc[_a]);
+                fSink = _out[0][0];
+            }
+            const double _ns = (((f64WallSecond() - _t) / double(_iterations)) - _tConstruct) * 1e9 /
+                               double(MATRIX_MAXIMUM_SIZE-1);
+            printf("%6d %10s %14.3e %12.1f\n", int(_n), _accName[_a], _errMax[_a], _ns);
+        }
+    }
+    return 0;
+}
+
+
+void SPEW_THE_ERROR(char const * str)
+{
+    fprintf(stderr, "%s\n", str);
+    exit(1);
+}
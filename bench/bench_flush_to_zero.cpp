@@ -0,0 +1,185 @@
+/**************************************************************************************************
+ * Host benchmark: the flush-to-zero numerics (MATRIX_USE_FLUSH_TO_ZERO, see the konfig.h of mpc_engl,
+ *  mpc_opt_engl & mpc_least_square_engl), on the jet example of the sketch:
+ *
+ *      bench_flush_to_zero_mpc_opt_engl [--q q] [--r r] [--reinit N] [--iterations N] [--samples S]
+ *                                       [--write file] [--compare file] [--tolerance t]
+ *
+ *  It prints the mean vReInit() & bUpdate() time (the naive version inverts H in bUpdate()), then
+ *  calculates du(k) for S random (SP, x, u(k-1)) in [-1, 1]. du(k) is linear in the gains, so
+ *  comparing it is comparing the gains: --write saves them (one per line), --compare prints the
+ *  biggest difference to the saved ones relative to their biggest |du(k)|, and returns 1 if it's
+ *  bigger than the tolerance (default 1e-4). See bench_flush_to_zero.sh.
+ *
+ * See https://github.com/pronenewbits for more!
+ *************************************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include "konfig.h"
+#include "matrix.h"
+#include "mpc.h"
+#include "closed_loop.h"
+
+#ifndef BENCH_VARIANT_NAME
+    #define BENCH_VARIANT_NAME  "mpc"
+#endif
+
+
+static uint32_t u32Seed = 12345;
+static double f64Random(void)
+{
+    /* Deterministic LCG in [-1, 1] */
+    u32Seed = (1103515245UL * u32Seed) + 12345UL;
+    return double((u32Seed >> 8) & 0xFFFF) / 32767.5 - 1.0;
+}
+
+/* Keep the result alive so the compiler can't throw the update away */
+volatile float_prec fSink;
+
+int main(int argc, char ** argv)
+{
+    double _q = 10.0;
+    double _r = 0.03;
+    int32_t _reinit = 200;
+    int32_t _iterations = 2000;
+    int32_t _samples = 1000;
+    double _tolerance = 1e-4;
+    const char * _write = NULL;
+    const char * _compare = NULL;
+    for (int _i = 1; _i < argc; _i++) {
+        if ((strcmp(argv[_i], "--q") == 0) && (_i+1 < argc)) {
+            _q = atof(argv[++_i]);
+        } else if ((strcmp(argv[_i], "--r") == 0) && (_i+1 < argc)) {
+            _r = atof(argv[++_i]);
+        } else if ((strcmp(argv[_i], "--reinit") == 0) && (_i+1 < argc)) {
+            _reinit = int32_t(atoi(argv[++_i]));
+        } else if ((strcmp(argv[_i], "--iterations") == 0) && (_i+1 < argc)) {
+            _iterations = int32_t(atoi(argv[++_i]));
+        } else if ((strcmp(argv[_i], "--samples") == 0) && (_i+1 < argc)) {
+            _samples = int32_t(atoi(argv[++_i]));
+        } else if ((strcmp(argv[_i], "--tolerance") == 0) && (_i+1 < argc)) {
+            _tolerance = atof(argv[++_i]);
+        } else if ((strcmp(argv[_i], "--write") == 0) && (_i+1 < argc)) {
+            _write = argv[++_i];
+        } else if ((strcmp(argv[_i], "--compare") == 0) && (_i+1 < argc)) {
+            _compare = argv[++_i];
+        } else {
+            fprintf(stderr, "usage: %s [--q q] [--r r] [--reinit N] [--iterations N] [--samples S] "
+                            "[--write file] [--compare file] [--tolerance t]\n", argv[0]);
+            return 2;
+        }
+    }
+    if ((_reinit < 1) || (_iterations < 1) || (_samples < 1) || (_q <= 0) || (_r <= 0)) {
+        fprintf(stderr, "Need q > 0, r > 0, reinit >= 1, iterations >= 1 and samples >= 1\n");
+        return 2;
+    }
+
+    static Matrix A(SS_X_LEN, SS_X_LEN);
+    static Matrix B(SS_X_LEN, SS_U_LEN);
+    static Matrix C(SS_Z_LEN, SS_X_LEN);
+    if (!bSimJetPlant(A, B, C)) {
+        fprintf(stderr, "The jet example needs X = 4, U = 2, Z = 2\n");
+        return 2;
+    }
+    static MPC MPC_HIL(A, B, C, float_prec(_q), float_prec(_r));
+
+    printf("variant          : %s, %s, Hp %d, Hu %d, q %g, r %g%s\n", BENCH_VARIANT_NAME,
+           (FPU_PRECISION == PRECISION_SINGLE) ? "float" : "double", MPC_HP_LEN, MPC_HU_LEN, _q, _r,
+    #if defined(MATRIX_USE_FLUSH_TO_ZERO)
+           ", flush-to-zero");
+    #else
+           "");
+    #endif
+
+    double _t = f64SimWallSecond();
+    for (int32_t _k = 0; _k < _reinit; _k++) {
+        MPC_HIL.vReInit(A, B, C, float_prec(_q), float_prec(_r));
+    }
+    printf("vReInit (us)     : %.2f\n", (f64SimWallSecond() - _t) * 1e6 / double(_reinit));
+
+    static Matrix SP((MPC_HC_LEN*SS_Z_LEN), 1);
+    static Matrix x(SS_X_LEN, 1);
+    static Matrix u(SS_U_LEN, 1);
+    SP.vSetHomogen(float_prec(0.5));
+    x.vSetHomogen(float_prec(0.1));
+    _t = f64SimWallSecond();
+    for (int32_t _k = 0; _k < _iterations; _k++) {
+        x[0][0] = float_prec(_k & 0xFF) * float_prec(0.001);
+        MPC_HIL.bUpdate(SP, x, u);
+        fSink = u[0][0];
+    }
+    printf("bUpdate (us)     : %.2f\n", (f64SimWallSecond() - _t) * 1e6 / double(_iterations));
+
+    std::vector<double> _du(size_t(_samples) * SS_U_LEN);
+    for (int32_t _n = 0; _n < _samples; _n++) {
+        for (int32_t _i = 0; _i < (MPC_HC_LEN*SS_Z_LEN); _i++) {
+            SP[_i][0] = float_prec(f64Random());
+        }
+        for (int32_t _i = 0; _i < SS_X_LEN; _i++) {
+            x[_i][0] = float_prec(f64Random());
+        }
+        float_prec _uLast[SS_U_LEN];
+        for (int32_t _i = 0; _i < SS_U_LEN; _i++) {
+            _uLast[_i] = float_prec(f64Random());
+            u[_i][0] = _uLast[_i];
+        }
+        if (!MPC_HIL.bUpdate(SP, x, u)) {
+            fprintf(stderr, "bUpdate() failed at sample %d\n", int(_n));
+            return 1;
+        }
+        for (int32_t _i = 0; _i < SS_U_LEN; _i++) {
+            _du[(size_t(_n) * SS_U_LEN) + _i] = double(u[_i][0]) - double(_uLast[_i]);
+        }
+    }
+
+    if (_write != NULL) {
+        FILE * _file = fopen(_write, "w");
+        if (_file == NULL) {
+            fprintf(stderr, "Can't write %s\n", _write);
+            return 1;
+        }
+        for (size_t _i = 0; _i < _du.size(); _i++) {
+            fprintf(_file, "%.17g\n", _du[_i]);
+        }
+        fclose(_file);
+    }
+    if (_compare != NULL) {
+        FILE * _file = fopen(_compare, "r");
+        if (_file == NULL) {
+            fprintf(stderr, "Can't read %s\n", _compare);
+            return 1;
+        }
+        double _duMax = 0;
+        double _errMax = 0;
+        for (size_t _i = 0; _i < _du.size(); _i++) {
+            double _ref;
+            if (!bSimReadNumber(_file, _ref)) {
+                fprintf(stderr, "%s has less than %d samples\n", _compare, int(_samples));
+                fclose(_file);
+                return 1;
+            }
+            _duMax = (fabs(_ref) > _duMax) ? fabs(_ref) : _duMax;
+            _errMax = (fabs(_du[_i] - _ref) > _errMax) ? fabs(_du[_i] - _ref) : _errMax;
+        }
+        fclose(_file);
+        if (_duMax <= 0) {
+            _duMax = 1;
+        }
+        const bool _same = ((_errMax / _duMax) <= _tolerance);
+        printf("du difference    : max %.3e (rel.), %s the tolerance %g\n", _errMax / _duMax,
+               _same ? "within" : "OUTSIDE", _tolerance);
+        if (!_same) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+
+void SPEW_THE_ERROR(char const * str)
+{
+    fprintf(stderr, "%s\n", str);
+    exit(1);
+}
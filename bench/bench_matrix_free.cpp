@@ -0,0 +1,100 @@
+/**************************************************************************************************
+ * Host benchmark: stored prediction matrices vs MPC_USE_MATRIX_FREE_PREDICTION (mpc_opt_engl).
+ *
+ *  Compiled once per configuration (the dimensions come from the -D overrides of konfig.h), it
+ *  prints one CSV line:
+ *      mode,x,u,z,hp,hc,hu,ns_per_update,sizeof_mpc,prediction_bytes
+ *
+ *  where prediction_bytes is the exact size of what the update path needs for the prediction:
+ *  CPSI & COMEGA, or the discretized grid segments (A^m, S(m)) in the matrix-free mode.
+ *
+ *  See bench_matrix_free.sh to sweep the configurations and find the break-even point.
+ *
+ * See https://github.com/pronenewbits for more!
+ *************************************************************************************************/
+#include <stdio.h>
+#include <time.h>
+#include "konfig.h"
+#include "matrix.h"
+#include "mpc.h"
+
+
+#ifndef BENCH_UPDATE_LEN
+    #define BENCH_UPDATE_LEN    (20000)
+#endif
+
+
+static uint32_t u32Seed = 12345;
+static float_prec fRandom(void)
+{
+    /* Deterministic LCG in [-1, 1] */
+    u32Seed = (1103515245UL * u32Seed) + 12345UL;
+    return float_prec((u32Seed >> 8) & 0xFFFF) / float_prec(32767.5) - float_prec(1.0);
+}
+
+static double dNow(void)
+{
+    struct timespec _ts;
+    clock_gettime(CLOCK_MONOTONIC, &_ts);
+    return (double(_ts.tv_sec) * 1e9) + double(_ts.tv_nsec);
+}
+
+/* Keep the result alive so the compiler can't throw the update away */
+volatile float_prec fSink;
+
+int main(void)
+{
+    static Matrix A(SS_X_LEN, SS_X_LEN);
+    static Matrix B(SS_X_LEN, SS_U_LEN);
+    static Matrix C(SS_Z_LEN, SS_X_LEN);
+    static Matrix SP((MPC_HC_LEN*SS_Z_LEN), 1);
+    static Matrix x(SS_X_LEN, 1);
+    static Matrix u(SS_U_LEN, 1);
+    
+    /* A stable, random plant */
+    for (int32_t _i = 0; _i < SS_X_LEN; _i++) {
+        for (int32_t _j = 0; _j < SS_X_LEN; _j++) {
+            A[_i][_j] = (_i == _j) ? float_prec(0.95) : (float_prec(0.04) * fRandom() / float_prec(SS_X_LEN));
+        }
+        for (int32_t _j = 0; _j < SS_U_LEN; _j++) {
+            B[_i][_j] = fRandom();
+        }
+    }
+    for (int32_t _i = 0; _i < SS_Z_LEN; _i++) {
+        for (int32_t _j = 0; _j < SS_X_LEN; _j++) {
+            C[_i][_j] = fRandom();
+        }
+    }
+    for (int32_t _i = 0; _i < (MPC_HC_LEN*SS_Z_LEN); _i++) {
+        SP[_i][0] = fRandom();
+    }
+    
+    static MPC MPC_BENCH(A, B, C, 1.0, 0.1);
+    
+    double _tStart = dNow();
+    for (int32_t _k = 0; _k < BENCH_UPDATE_LEN; _k++) {
+        x[0][0] = float_prec(_k & 0xFF) * float_prec(0.001);
+        MPC_BENCH.bUpdate(SP, x, u);
+        u.vSetToZero();
+    }
+    double _tUpdate = (dNow() - _tStart) / BENCH_UPDATE_LEN;
+    fSink = u[0][0];
+    
+    #if defined(MPC_USE_MATRIX_FREE_PREDICTION)
+        const char * _mode = "matrix_free";
+        const int32_t _predictionBytes = MPC_GRID_SEGMENT_LEN * SS_X_LEN * (SS_X_LEN + SS_U_LEN) * int32_t(sizeof(float_prec));
+    #else
+        const char * _mode = "stored";
+        const int32_t _predictionBytes = MPC_HC_LEN * SS_Z_LEN * (SS_X_LEN + SS_U_LEN) * int32_t(sizeof(float_prec));
+    #endif
+    printf("%s,%d,%d,%d,%d,%d,%d,%.1f,%d,%d\n", _mode, SS_X_LEN, SS_U_LEN, SS_Z_LEN, MPC_HP_LEN, MPC_HC_LEN, MPC_HU_LEN,
+           _tUpdate, int32_t(sizeof(MPC)), _predictionBytes);
+    return 0;
+}
+
+
+void SPEW_THE_ERROR(char const * str)
+{
+    printf("%s\n", str);
+    exit(1);
+}
@@ -0,0 +1,65 @@
+#!/bin/sh
+# Sweep the state dimension and compare the stored CPSI/COMEGA update path of mpc_opt_engl with
+# MPC_USE_MATRIX_FREE_PREDICTION, then report the break-even points: the first X where the
+# matrix-free update gets slower than the stored one, and the first X where it doesn't save
+# memory anymore.
+#
+#   usage: bench/bench_matrix_free.sh [CXX flags...]
+#   env  : SWEEP_X ("2 4 6 8 12 16 20 24"), BENCH_U (2), BENCH_Z (2), BENCH_HP (8), BENCH_HU (3)
+set -e
+
+ROOT=$(cd "$(dirname "$0")/.." && pwd)
+CXX=${CXX:-g++}
+SWEEP_X=${SWEEP_X:-"2 4 6 8 12 16 20 24"}
+BENCH_U=${BENCH_U:-2}
+BENCH_Z=${BENCH_Z:-2}
+BENCH_HP=${BENCH_HP:-8}
+BENCH_HU=${BENCH_HU:-3}
+OUT=$(mktemp -d)
+trap 'rm -rf "$OUT"' EXIT
+
+# Uniform grid, every prediction step is a coincidence point
+POINTS=$(seq -s, 1 "$BENCH_HP")
+
+echo "mode,x,u,z,hp,hc,hu,ns_per_update,sizeof_mpc,prediction_bytes" > "$OUT/result.csv"
+for X in $SWEEP_X; do
+    for MODE in stored matrix_free; do
+        FLAGS=""
+        [ "$MODE" = "matrix_free" ] && FLAGS="-DMPC_USE_MATRIX_FREE_PREDICTION"
+        "$CXX" -O2 -std=c++11 -w "$@" $FLAGS -I"$ROOT/mpc_opt_engl" \
+            -DSYSTEM_IMPLEMENTATION=SYSTEM_IMPLEMENTATION_PC \
+            -DSS_X_LEN="$X" -DSS_U_LEN="$BENCH_U" -DSS_Z_LEN="$BENCH_Z" \
+            -DMPC_HP_LEN="$BENCH_HP" -DMPC_HU_LEN="$BENCH_HU" -DMPC_HC_LEN="$BENCH_HP" \
+            -DMPC_COINCIDENCE_POINTS="{$POINTS}" -DMPC_GRID_SEGMENT_LEN=1 -DMPC_GRID_SEGMENTS="{{$BENCH_HP,1}}" \
+            "$ROOT/mpc_opt_engl/matrix.cpp" "$ROOT/mpc_opt_engl/mpc.cpp" "$ROOT/bench/bench_matrix_free.cpp" \
+            -o "$OUT/bench_$MODE"
+        "$OUT/bench_$MODE" >> "$OUT/result.csv"
+    done
+done
+
+cat "$OUT/result.csv"
+echo
+awk -F, 'NR > 1 {
+    key = $2; t[key, $1] = $8; b[key, $1] = $10;
+    if (!(key in seen)) { seen[key] = 1; order[n++] = key; }
+} END {
+    printf("%6s %14s %14s %8s %16s %16s\n", "x", "stored(ns)", "free(ns)", "ratio", "stored(bytes)", "free(bytes)");
+    even = ""; evenMem = "";
+    for (i = 0; i < n; i++) {
+        k = order[i];
+        r = t[k, "matrix_free"] / t[k, "stored"];
+        printf("%6s %14.1f %14.1f %8.2f %16d %16d\n", k, t[k, "stored"], t[k, "matrix_free"], r, b[k, "stored"], b[k, "matrix_free"]);
+        if ((even == "") && (r > 1.0)) { even = k; }
+        if ((evenMem == "") && (b[k, "matrix_free"] >= b[k, "stored"])) { evenMem = k; }
+    }
+    if (even == "") {
+        print "break-even: the matrix-free update is not slower in the whole sweep";
+    } else {
+        print "break-even: the matrix-free update is slower from x = " even;
+    }
+    if (evenMem == "") {
+        print "break-even: the matrix-free mode saves memory in the whole sweep";
+    } else {
+        print "break-even: the matrix-free mode doesn'"'"'t save memory from x = " evenMem;
+    }
+}' "$OUT/result.csv"
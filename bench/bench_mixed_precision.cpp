@@ -0,0 +1,192 @@
+/**************************************************************************************************
+ * Host benchmark: the mixed precision of the templated implementation (mpc_template_engl), on the
+ *  jet example of its sketch with a long horizon (Hp = BENCH_HP_LEN, Hu = BENCH_HU_LEN):
+ *
+ *      bench_mixed_precision [--q q] [--r r] [--samples S] [--iterations N]
+ *
+ *  Three controllers from the same plant & weights:
+ *      float/float     : MPC<.., float, float>     (vReInit() & bUpdate() in float)
+ *      float/double    : MPC<.., float, double>    (vReInit() in double, bUpdate() in float)
+ *      double/double   : MPC<.., double, double>   (the reference)
+ *
+ *  For S random (SP, x, u(k-1)) in [-1, 1] it prints the biggest & the RMS error of the float
+ *  controllers' du(k) relative to the biggest |du(k)| of the reference, then the mean bUpdate() time
+ *  over N calls. A small r makes H ill-conditioned, that's where the float inverse loses accuracy.
+ *  The _compensated build has MPC_USE_COMPENSATED_UPDATE.
+ *
+ * See https://github.com/pronenewbits for more!
+ *************************************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "konfig.h"
+#include "matrix.h"
+#include "mpc.h"
+
+#ifndef BENCH_HP_LEN
+    #define BENCH_HP_LEN    (40)
+#endif
+#ifndef BENCH_HU_LEN
+    #define BENCH_HU_LEN    (10)
+#endif
+
+typedef MPC<4, 2, 2, BENCH_HP_LEN, BENCH_HU_LEN, float, float>   MPC_F32;
+typedef MPC<4, 2, 2, BENCH_HP_LEN, BENCH_HU_LEN, float, double>  MPC_MIXED;
+typedef MPC<4, 2, 2, BENCH_HP_LEN, BENCH_HU_LEN, double, double> MPC_F64;
+
+
+static uint32_t u32Seed = 12345;
+static double f64Random(void)
+{
+    /* Deterministic LCG in [-1, 1] */
+    u32Seed = (1103515245UL * u32Seed) + 12345UL;
+    return double((u32Seed >> 8) & 0xFFFF) / 32767.5 - 1.0;
+}
+
+static double f64WallSecond(void)
+{
+    struct timespec _ts;
+    clock_gettime(CLOCK_MONOTONIC, &_ts);
+    return double(_ts.tv_sec) + (double(_ts.tv_nsec) * 1e-9);
+}
+
+/* The jet transport aircraft of the sketch */
+static void vJetPlant(Matrix<4, 4, double> &A, Matrix<4, 2, double> &B, Matrix<2, 4, double> &C)
+{
+    A[0][0] = -0.0558;      A[0][1] = -0.9968;      A[0][2] =  0.0802;      A[0][3] = 0.0415;
+    A[1][0] =  0.5980;      A[1][1] = -0.1150;      A[1][2] = -0.0318;      A[1][3] = 0.0000;
+    A[2][0] = -3.0500;      A[2][1] =  0.3880;      A[2][2] = -0.4650;      A[2][3] = 0.0000;
+    A[3][0] =  0.0000;      A[3][1] =  0.0805;      A[3][2] =  1.0000;      A[3][3] = 0.0000;
+
+    B[0][0] =  0.0073;      B[0][1] =  0.0000;
+    B[1][0] = -0.4750;      B[1][1] =  0.0077;
+    B[2][0] =  0.1530;      B[2][1] =  0.1430;
+    B[3][0] =  0.0000;      B[3][1] =  0.0000;
+
+    C[0][0] =  0.0000;      C[0][1] =  1.0000;      C[0][2] =  0.0000;      C[0][3] =  0.0000;
+    C[1][0] =  0.0000;      C[1][1] =  0.0000;      C[1][2] =  0.0000;      C[1][3] =  1.0000;
+}
+
+/* Keep the result alive so the compiler can't throw the update away */
+volatile double fSink;
+
+/* The mean bUpdate() time (ns) of _mpc over _iterations calls */
+template <typename T, typename TMPC>
+static double f64UpdateTime(TMPC &_mpc, const int32_t _iterations)
+{
+    Matrix<(BENCH_HP_LEN*2), 1, T> SP;
+    Matrix<4, 1, T> x;
+    Matrix<2, 1, T> u;
+    SP.vSetHomogen(T(0.5));
+    x.vSetHomogen(T(0.1));
+    const double _t = f64WallSecond();
+    for (int32_t _k = 0; _k < _iterations; _k++) {
+        x[0][0] = T(_k & 0xFF) * T(0.001);
+        _mpc.bUpdate(SP, x, u);
+        fSink = double(u[0][0]);
+    }
+    return (f64WallSecond() - _t) * 1e9 / double(_iterations);
+}
+
+int main(int argc, char ** argv)
+{
+    double _q = 10.0;
+    double _r = 1e-4;
+    int32_t _samples = 10000;
+    int32_t _iterations = 100000;
+    for (int _i = 1; _i < argc; _i++) {
+        if ((strcmp(argv[_i], "--q") == 0) && (_i+1 < argc)) {
+            _q = atof(argv[++_i]);
+        } else if ((strcmp(argv[_i], "--r") == 0) && (_i+1 < argc)) {
+            _r = atof(argv[++_i]);
+        } else if ((strcmp(argv[_i], "--samples") == 0) && (_i+1 < argc)) {
+            _samples = int32_t(atoi(argv[++_i]));
+        } else if ((strcmp(argv[_i], "--iterations") == 0) && (_i+1 < argc)) {
+            _iterations = int32_t(atoi(argv[++_i]));
+        } else {
+            fprintf(stderr, "usage: %s [--q q] [--r r] [--samples S] [--iterations N]\n", argv[0]);
+            return 2;
+        }
+    }
+    if ((_samples < 1) || (_iterations < 1) || (_q <= 0) || (_r <= 0)) {
+        fprintf(stderr, "Need q > 0, r > 0, samples >= 1 and iterations >= 1\n");
+        return 2;
+    }
+
+    static Matrix<4, 4, double> A;
+    static Matrix<4, 2, double> B;
+    static Matrix<2, 4, double> C;
+    vJetPlant(A, B, C);
+    static Matrix<4, 4, float> A_f(A);
+    static Matrix<4, 2, float> B_f(B);
+    static Matrix<2, 4, float> C_f(C);
+
+    /* The float/float controller gets the float plant, like a float-only build would */
+    static MPC_F32   MPC_SINGLE(A_f, B_f, C_f, float(_q), float(_r));
+    static MPC_MIXED MPC_MIX(A, B, C, _q, _r);
+    static MPC_F64   MPC_DOUBLE(A, B, C, _q, _r);
+
+    static Matrix<(BENCH_HP_LEN*2), 1, double> SP;
+    static Matrix<4, 1, double> x;
+    static Matrix<2, 1, double> u;
+    double _duMax = 0;
+    double _errMax[2] = {0, 0};
+    double _errSquare[2] = {0, 0};
+    for (int32_t _n = 0; _n < _samples; _n++) {
+        for (int32_t _i = 0; _i < (BENCH_HP_LEN*2); _i++) {
+            SP[_i][0] = double(float(f64Random()));
+        }
+        for (int32_t _i = 0; _i < 4; _i++) {
+            x[_i][0] = double(float(f64Random()));
+        }
+        for (int32_t _i = 0; _i < 2; _i++) {
+            u[_i][0] = double(float(f64Random()));
+        }
+        /* The same (float representable) inputs for every controller */
+        Matrix<(BENCH_HP_LEN*2), 1, float> SP_f(SP);
+        Matrix<4, 1, float> x_f(x);
+        Matrix<2, 1, float> u_single(u);
+        Matrix<2, 1, float> u_mix(u);
+        Matrix<2, 1, double> u_ref(u);
+        MPC_SINGLE.bUpdate(SP_f, x_f, u_single);
+        MPC_MIX.bUpdate(SP_f, x_f, u_mix);
+        MPC_DOUBLE.bUpdate(SP, x, u_ref);
+
+        for (int32_t _i = 0; _i < 2; _i++) {
+            const double _du = u_ref[_i][0] - u[_i][0];
+            _duMax = (fabs(_du) > _duMax) ? fabs(_du) : _duMax;
+            const double _err[2] = {double(u_single[_i][0]) - u_ref[_i][0], double(u_mix[_i][0]) - u_ref[_i][0]};
+            for (int32_t _c = 0; _c < 2; _c++) {
+                _errMax[_c] = (fabs(_err[_c]) > _errMax[_c]) ? fabs(_err[_c]) : _errMax[_c];
+                _errSquare[_c] += _err[_c] * _err[_c];
+            }
+        }
+    }
+    if (_duMax <= 0) {
+        _duMax = 1;
+    }
+
+    printf("horizon          : Hp %d, Hu %d, q %g, r %g%s\n", BENCH_HP_LEN, BENCH_HU_LEN, _q, _r,
+    #if defined(MPC_USE_COMPENSATED_UPDATE)
+           ", compensated update");
+    #else
+           "");
+    #endif
+    printf("gain valid       : float/float %d, float/double %d, double/double %d\n",
+           int(MPC_SINGLE.bGainIsValid()), int(MPC_MIX.bGainIsValid()), int(MPC_DOUBLE.bGainIsValid()));
+    printf("du error (rel.)  : float/float max %.3e rms %.3e, float/double max %.3e rms %.3e\n",
+           _errMax[0] / _duMax, sqrt(_errSquare[0] / double(2 * _samples)) / _duMax,
+           _errMax[1] / _duMax, sqrt(_errSquare[1] / double(2 * _samples)) / _duMax);
+    printf("bUpdate (ns)     : float/float %.1f, float/double %.1f, double/double %.1f\n",
+           f64UpdateTime<float>(MPC_SINGLE, _iterations), f64UpdateTime<float>(MPC_MIX, _iterations),
+           f64UpdateTime<double>(MPC_DOUBLE, _iterations));
+    return 0;
+}
+
+
+void SPEW_THE_ERROR(char const * str)
+{
+    fprintf(stderr, "%s\n", str);
+    exit(1);
+}
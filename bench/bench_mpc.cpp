@@ -0,0 +1,263 @@
+/**************************************************************************************************
+ * Host benchmark: one point of the MPC benchmark sweep (see the root CMakeLists.txt).
+ *
+ *  Compiled once per (implementation, precision, X, U, Z, Hp, Hu) point; the dimensions come from
+ *  the -D overrides of konfig.h and the implementation from BENCH_VARIANT. It prints one CSV line
+ *  (or the CSV header with --header):
+ *
+ *      variant,precision,x,u,z,hp,hu,ns_per_update,ns_per_reinit,cycles_per_update,
+ *      flops_per_update,flops_per_cycle,bytes_per_update,sizeof_matrix,cycle_source
+ *
+ *  - ns_per_update/ns_per_reinit   : CLOCK_MONOTONIC, averaged over at least BENCH_MIN_NS.
+ *  - cycles_per_update             : the time stamp counter on x86 (cycle_source = tsc), it counts
+ *                                    at the nominal clock. Elsewhere there's no portable cycle
+ *                                    counter, it's 0 (cycle_source = none).
+ *  - flops_per_update              : the floating point operations of MPC::bUpdate() as coded
+ *                                    (dense matrix kernels, zeros included).
+ *  - bytes_per_update              : the matrix elements the bUpdate() kernels read & write, on
+ *                                    top of that every by-value Matrix temporary copies
+ *                                    sizeof_matrix bytes.
+ *
+ *  bench_mpc_sweep runs every point and merges the lines into one CSV.
+ *
+ * See https://github.com/pronenewbits for more!
+ *************************************************************************************************/
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "konfig.h"
+#include "matrix.h"
+#include "mpc.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+    #include <x86intrin.h>
+    #define BENCH_HAS_TSC
+#endif
+
+
+#define BENCH_VARIANT_NAIVE         1       /* mpc_engl                 */
+#define BENCH_VARIANT_OPTIMIZED     2       /* mpc_opt_engl             */
+#define BENCH_VARIANT_LEAST_SQUARE  3       /* mpc_least_square_engl    */
+
+#ifndef BENCH_VARIANT
+    #error("BENCH_VARIANT has not been defined!");
+#endif
+
+#ifndef BENCH_MIN_NS
+    #define BENCH_MIN_NS    (2e8)           /* Measure each phase for at least 200 ms */
+#endif
+
+
+static uint32_t u32Seed = 12345;
+static float_prec fRandom(void)
+{
+    /* Deterministic LCG in [-1, 1] */
+    u32Seed = (1103515245UL * u32Seed) + 12345UL;
+    return float_prec((u32Seed >> 8) & 0xFFFF) / float_prec(32767.5) - float_prec(1.0);
+}
+
+static double dNow(void)
+{
+    struct timespec _ts;
+    clock_gettime(CLOCK_MONOTONIC, &_ts);
+    return (double(_ts.tv_sec) * 1e9) + double(_ts.tv_nsec);
+}
+
+static uint64_t u64Cycles(void)
+{
+    #if defined(BENCH_HAS_TSC)
+        return __rdtsc();
+    #else
+        return 0;
+    #endif
+}
+
+
+/* The cost model of the library kernels, as coded ---------------------------------------------- */
+static double dFlops = 0;
+static double dElements = 0;
+
+static void vCostMul(const double _row, const double _inner, const double _col)
+{
+    dFlops    += 2.0 * _row * _inner * _col;
+    dElements += (_row * _inner) + (_inner * _col) + (_row * _col);
+}
+
+static void vCostElementWise(const double _row, const double _col, const double _operand)
+{
+    dFlops    += _row * _col;
+    dElements += (_operand + 1.0) * _row * _col;
+}
+
+#if (BENCH_VARIANT == BENCH_VARIANT_NAIVE)
+static void vCostInvers(const double _n)
+{
+    /* Gauss-Jordan: elimination, Jordan, and normalization passes of Matrix::Invers() */
+    double _pairs = _n * (_n - 1.0) / 2.0;
+    dFlops    += (_pairs * (1.0 + (4.0 * _n))) + (_pairs * (3.0 + (2.0 * _n))) + (_n * _n);
+    dElements += (_pairs * (2.0 + (6.0 * _n))) + (_pairs * (4.0 + (3.0 * _n))) + (2.0 * _n * _n) + _n;
+}
+#elif (BENCH_VARIANT == BENCH_VARIANT_LEAST_SQUARE)
+static void vCostCopy(const double _row, const double _col)
+{
+    dElements += 2.0 * _row * _col;
+}
+
+static void vCostBackSubtitution(const double _n)
+{
+    dFlops    += (_n * (_n - 1.0)) + _n;
+    dElements += (_n * (_n + 1.0) / 2.0) + (2.0 * _n);
+}
+#endif
+
+static void vCostUpdate(void)
+{
+    const double _N = SS_X_LEN;
+    const double _M = SS_U_LEN;
+    const double _P = MPC_HC_LEN * SS_Z_LEN;
+#if (BENCH_VARIANT != BENCH_VARIANT_OPTIMIZED)
+    const double _H = MPC_HU_LEN * SS_U_LEN;
+#endif
+
+    /* E(k) = SP(k) - CPSI*x(k) - COMEGA*u(k-1) */
+    vCostMul(_P, _N, 1);
+    vCostMul(_P, _M, 1);
+    vCostElementWise(_P, 1, 2);
+    vCostElementWise(_P, 1, 2);
+
+#if (BENCH_VARIANT == BENCH_VARIANT_NAIVE)
+    /* G = 2*(CTHETA'*Q)*E(k), CTHETA' is read in place (Matrix::TransposedView) */
+    vCostMul(_H, _P, _P);
+    vCostElementWise(_H, _P, 1);
+    vCostMul(_H, _P, 1);
+    /* H = CTHETA'*Q*CTHETA + R */
+    vCostMul(_H, _P, _P);
+    vCostMul(_H, _P, _H);
+    vCostElementWise(_H, _H, 2);
+    /* dU(k) = 1/2 * H^-1 * G */
+    vCostInvers(_H);
+    vCostMul(_H, _H, 1);
+    vCostElementWise(_H, 1, 1);
+#elif (BENCH_VARIANT == BENCH_VARIANT_OPTIMIZED)
+    /* dU(k) = XI_DU * E(k) */
+    vCostMul(_M, _P, 1);
+#elif (BENCH_VARIANT == BENCH_VARIANT_LEAST_SQUARE)
+    /* Qt_LSQE = Q1*SQ*E(k), then R_L * dU(k) = Qt_LSQE(1:Hu*M) */
+    vCostCopy((_P + _H), _P);
+    vCostMul((_P + _H), _P, _P);
+    vCostMul((_P + _H), _P, 1);
+    vCostCopy(_H, 1);
+    vCostCopy(_H, _H);
+    vCostBackSubtitution(_H);
+#endif
+
+    /* u(k) = u(k-1) + du(k) */
+    vCostElementWise(_M, 1, 2);
+}
+/* ---------------------------------------------------------------------------------------------- */
+
+
+/* Keep the result alive so the compiler can't throw the update away */
+volatile float_prec fSink;
+
+int main(int argc, char ** argv)
+{
+    if ((argc > 1) && (strcmp(argv[1], "--header") == 0)) {
+        printf("variant,precision,x,u,z,hp,hu,ns_per_update,ns_per_reinit,cycles_per_update,"
+               "flops_per_update,flops_per_cycle,bytes_per_update,sizeof_matrix,cycle_source\n");
+        return 0;
+    }
+
+    static Matrix A(SS_X_LEN, SS_X_LEN);
+    static Matrix B(SS_X_LEN, SS_U_LEN);
+    static Matrix C(SS_Z_LEN, SS_X_LEN);
+    static Matrix SP((MPC_HC_LEN*SS_Z_LEN), 1);
+    static Matrix x(SS_X_LEN, 1);
+    static Matrix u(SS_U_LEN, 1);
+
+    /* A stable, random plant */
+    for (int32_t _i = 0; _i < SS_X_LEN; _i++) {
+        for (int32_t _j = 0; _j < SS_X_LEN; _j++) {
+            A[_i][_j] = (_i == _j) ? float_prec(0.95) : (float_prec(0.04) * fRandom() / float_prec(SS_X_LEN));
+        }
+        for (int32_t _j = 0; _j < SS_U_LEN; _j++) {
+            B[_i][_j] = fRandom();
+        }
+    }
+    for (int32_t _i = 0; _i < SS_Z_LEN; _i++) {
+        for (int32_t _j = 0; _j < SS_X_LEN; _j++) {
+            C[_i][_j] = fRandom();
+        }
+    }
+    for (int32_t _i = 0; _i < (MPC_HC_LEN*SS_Z_LEN); _i++) {
+        SP[_i][0] = fRandom();
+    }
+
+    static MPC MPC_BENCH(A, B, C, 1.0, 0.1);
+    if (!MPC_BENCH.bUpdate(SP, x, u)) {
+        SPEW_THE_ERROR("The MPC initialization has failed, the benchmark point is not valid!");
+    }
+    u.vSetToZero();
+
+
+    /* vReInit --------------------------------------------------------------------------------- */
+    int32_t _nReInit = 0;
+    double _tStart = dNow();
+    double _tReInit;
+    do {
+        MPC_BENCH.vReInit(A, B, C, 1.0, 0.1);
+        _nReInit++;
+        _tReInit = dNow() - _tStart;
+    } while ((_tReInit < BENCH_MIN_NS) || (_nReInit < 3));
+    _tReInit /= _nReInit;
+
+
+    /* bUpdate --------------------------------------------------------------------------------- */
+    int32_t _nUpdate = 0;
+    double _tUpdate;
+    _tStart = dNow();
+    uint64_t _cStart = u64Cycles();
+    do {
+        /* Batches of 16, so the clock isn't read at every update */
+        for (int32_t _k = 0; _k < 16; _k++) {
+            x[0][0] = float_prec((_nUpdate + _k) & 0xFF) * float_prec(0.001);
+            MPC_BENCH.bUpdate(SP, x, u);
+            u.vSetToZero();
+        }
+        _nUpdate += 16;
+        _tUpdate = dNow() - _tStart;
+    } while (_tUpdate < BENCH_MIN_NS);
+    double _cUpdate = double(u64Cycles() - _cStart) / _nUpdate;
+    _tUpdate /= _nUpdate;
+    fSink = u[0][0];
+
+
+    vCostUpdate();
+
+    #if (BENCH_VARIANT == BENCH_VARIANT_NAIVE)
+        const char * _variant = "mpc_engl";
+    #elif (BENCH_VARIANT == BENCH_VARIANT_OPTIMIZED)
+        const char * _variant = "mpc_opt_engl";
+    #elif (BENCH_VARIANT == BENCH_VARIANT_LEAST_SQUARE)
+        const char * _variant = "mpc_least_square_engl";
+    #endif
+    #if defined(BENCH_HAS_TSC)
+        const char * _cycleSource = "tsc";
+    #else
+        const char * _cycleSource = "none";
+    #endif
+
+    printf("%s,%s,%d,%d,%d,%d,%d,%.1f,%.1f,%.1f,%.0f,%.4f,%.0f,%d,%s\n",
+           _variant, (FPU_PRECISION == PRECISION_SINGLE) ? "float" : "double",
+           SS_X_LEN, SS_U_LEN, SS_Z_LEN, MPC_HP_LEN, MPC_HU_LEN,
+           _tUpdate, _tReInit, _cUpdate, dFlops, (_cUpdate > 0) ? (dFlops / _cUpdate) : 0.0,
+           dElements * double(sizeof(float_prec)), int32_t(sizeof(Matrix)), _cycleSource);
+    return 0;
+}
+
+
+void SPEW_THE_ERROR(char const * str)
+{
+    fprintf(stderr, "%s\n", str);
+    exit(1);
+}
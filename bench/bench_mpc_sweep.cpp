@@ -0,0 +1,70 @@
+/**************************************************************************************************
+ * Host benchmark: run every point of the MPC benchmark sweep and merge them into one CSV.
+ *
+ *  Every (implementation, precision, X, U, Z, Hp, Hu) point is its own executable, because the
+ *  library dimensions are compile-time konfig.h macros (two configurations can't be linked into
+ *  the same binary). The list of point executables is generated by CMake (bench_mpc_points.h).
+ *
+ *      usage: bench_mpc_sweep [output.csv]         (default: stdout)
+ *
+ *  The exit code is non-zero if any point fails, so it can gate a release.
+ *
+ * See https://github.com/pronenewbits for more!
+ *************************************************************************************************/
+#include <stdio.h>
+#include <string.h>
+#include "bench_mpc_points.h"
+
+
+static bool bRunPoint(const char * _path, const char * _arg, FILE * _out)
+{
+    char _cmd[1024];
+    char _line[512];
+
+    if (snprintf(_cmd, sizeof(_cmd), "\"%s\" %s", _path, _arg) >= int(sizeof(_cmd))) {
+        return false;
+    }
+    FILE * _pipe = popen(_cmd, "r");
+    if (_pipe == NULL) {
+        return false;
+    }
+    while (fgets(_line, sizeof(_line), _pipe) != NULL) {
+        fputs(_line, _out);
+    }
+    fflush(_out);
+    return (pclose(_pipe) == 0);
+}
+
+
+int main(int argc, char ** argv)
+{
+    const int _pointLen = int(sizeof(BENCH_MPC_POINTS) / sizeof(BENCH_MPC_POINTS[0]));
+    FILE * _out = stdout;
+
+    if (argc > 1) {
+        _out = fopen(argv[1], "w");
+        if (_out == NULL) {
+            fprintf(stderr, "bench_mpc_sweep: can't open %s\n", argv[1]);
+            return 1;
+        }
+    }
+
+    int _fail = 0;
+    if (!bRunPoint(BENCH_MPC_POINTS[0], "--header", _out)) {
+        _fail++;
+    }
+    for (int _i = 0; _i < _pointLen; _i++) {
+        if (_out != stdout) {
+            fprintf(stderr, "[%d/%d] %s\n", _i+1, _pointLen, BENCH_MPC_POINTS[_i]);
+        }
+        if (!bRunPoint(BENCH_MPC_POINTS[_i], "", _out)) {
+            fprintf(stderr, "bench_mpc_sweep: %s failed\n", BENCH_MPC_POINTS[_i]);
+            _fail++;
+        }
+    }
+
+    if (_out != stdout) {
+        fclose(_out);
+    }
+    return (_fail == 0) ? 0 : 1;
+}
@@ -0,0 +1,125 @@
+/**************************************************************************************************
+ * Host tool: the Matrix operation count (MATRIX_USE_OP_COUNTING, see matrix.h) of one MPC::vReInit()
+ *  and one MPC::bUpdate() of the MPC it's linked with, at the konfig.h dimension.
+ *
+ *  Optional budgets for the bUpdate (the tool returns 1 when one of them is exceeded, so it can be
+ *  used as a regression check of an optimization):
+ *
+ *      bench_op_count_mpc_opt_engl [--max-construct N] [--max-copy N] [--max-mac N]
+ *
+ * See https://github.com/pronenewbits for more!
+ *************************************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "konfig.h"
+#include "matrix.h"
+#include "mpc.h"
+
+#if !defined(MATRIX_USE_OP_COUNTING)
+    #error("bench_op_count needs MATRIX_USE_OP_COUNTING!");
+#endif
+
+#ifndef BENCH_VARIANT_NAME
+    #define BENCH_VARIANT_NAME  "mpc"
+#endif
+
+
+static uint32_t u32Seed = 12345;
+static float_prec fRandom(void)
+{
+    /* Deterministic LCG in [-1, 1] */
+    u32Seed = (1103515245UL * u32Seed) + 12345UL;
+    return float_prec((u32Seed >> 8) & 0xFFFF) / float_prec(32767.5) - float_prec(1.0);
+}
+
+static uint64_t u64TotalMac(void)
+{
+    uint64_t _mac = 0;
+    for (int32_t _i = 0; _i < MATRIX_OP_LEN; _i++) {
+        _mac += MATRIX_OP_COUNT.op[_i].u64mac;
+    }
+    return _mac;
+}
+
+static bool bCheckBudget(const char * _name, const uint64_t _count, const uint64_t _budget)
+{
+    if (_count > _budget) {
+        printf("FAIL: %s per bUpdate = %llu > budget %llu\n", _name, (unsigned long long) _count, (unsigned long long) _budget);
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char ** argv)
+{
+    uint64_t _maxConstruct = UINT64_MAX;
+    uint64_t _maxCopy      = UINT64_MAX;
+    uint64_t _maxMac       = UINT64_MAX;
+    for (int _i = 1; _i < argc; _i++) {
+        if ((strcmp(argv[_i], "--max-construct") == 0) && (_i+1 < argc)) {
+            _maxConstruct = strtoull(argv[++_i], NULL, 10);
+        } else if ((strcmp(argv[_i], "--max-copy") == 0) && (_i+1 < argc)) {
+            _maxCopy = strtoull(argv[++_i], NULL, 10);
+        } else if ((strcmp(argv[_i], "--max-mac") == 0) && (_i+1 < argc)) {
+            _maxMac = strtoull(argv[++_i], NULL, 10);
+        } else {
+            fprintf(stderr, "usage: %s [--max-construct N] [--max-copy N] [--max-mac N]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    static Matrix A(SS_X_LEN, SS_X_LEN);
+    static Matrix B(SS_X_LEN, SS_U_LEN);
+    static Matrix C(SS_Z_LEN, SS_X_LEN);
+    static Matrix SP((MPC_HC_LEN*SS_Z_LEN), 1);
+    static Matrix x(SS_X_LEN, 1);
+    static Matrix u(SS_U_LEN, 1);
+
+    /* A stable, random plant */
+    for (int32_t _i = 0; _i < SS_X_LEN; _i++) {
+        for (int32_t _j = 0; _j < SS_X_LEN; _j++) {
+            A[_i][_j] = (_i == _j) ? float_prec(0.95) : (float_prec(0.04) * fRandom() / float_prec(SS_X_LEN));
+        }
+        for (int32_t _j = 0; _j < SS_U_LEN; _j++) {
+            B[_i][_j] = fRandom();
+        }
+    }
+    for (int32_t _i = 0; _i < SS_Z_LEN; _i++) {
+        for (int32_t _j = 0; _j < SS_X_LEN; _j++) {
+            C[_i][_j] = fRandom();
+        }
+    }
+    for (int32_t _i = 0; _i < (MPC_HC_LEN*SS_Z_LEN); _i++) {
+        SP[_i][0] = fRandom();
+    }
+    x[0][0] = float_prec(0.1);
+
+    static MPC MPC_BENCH(A, B, C, 1.0, 0.1);
+
+    printf("==== %s, %s, vReInit() ====\n", BENCH_VARIANT_NAME, (FPU_PRECISION == PRECISION_SINGLE) ? "float" : "double");
+    vMatrixOpCountReset();
+    MPC_BENCH.vReInit(A, B, C, 1.0, 0.1);
+    vMatrixOpCountReport();
+
+    printf("==== %s, %s, bUpdate() ====\n", BENCH_VARIANT_NAME, (FPU_PRECISION == PRECISION_SINGLE) ? "float" : "double");
+    vMatrixOpCountReset();
+    if (!MPC_BENCH.bUpdate(SP, x, u)) {
+        printf("FAIL: bUpdate() failed\n");
+        return 1;
+    }
+    vMatrixOpCountReport();
+
+    bool _ok = true;
+    _ok = bCheckBudget("construct", MATRIX_OP_COUNT.u64construct, _maxConstruct) && _ok;
+    _ok = bCheckBudget("copy", MATRIX_OP_COUNT.u64copy, _maxCopy) && _ok;
+    _ok = bCheckBudget("mac", u64TotalMac(), _maxMac) && _ok;
+    return _ok ? 0 : 1;
+}
+
+
+void SPEW_THE_ERROR(char const * str)
+{
+    fprintf(stderr, "%s\n", str);
+    exit(1);
+}
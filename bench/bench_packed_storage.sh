@@ -0,0 +1,40 @@
+#!/bin/sh
+# Compare the default (MATRIX_MAXIMUM_SIZE stride) and the packed (MATRIX_USE_PACKED_STORAGE) Matrix storage
+# of the three implementations on the jet example: the vReInit() & bUpdate() time of both, and the du(k)
+# difference. The layout doesn't change any operation, so the default tolerance is 0 (bit exact). It
+# exits with 1 if the difference is above the tolerance.
+#
+#   usage: bench/bench_packed_storage.sh [bench_flush_to_zero options...] (e.g. --iterations 200)
+#   env  : BENCH_HP (40), BENCH_HU (10), BENCH_FPU (PRECISION_SINGLE), BENCH_ALIGN (32, MATRIX_PACKED_ALIGN)
+set -e
+
+ROOT=$(cd "$(dirname "$0")/.." && pwd)
+CXX=${CXX:-g++}
+BENCH_HP=${BENCH_HP:-40}
+BENCH_HU=${BENCH_HU:-10}
+BENCH_FPU=${BENCH_FPU:-PRECISION_SINGLE}
+BENCH_ALIGN=${BENCH_ALIGN:-32}
+OUT=$(mktemp -d)
+trap 'rm -rf "$OUT"' EXIT
+
+# Uniform grid, every prediction step is a coincidence point
+POINTS=$(seq -s, 1 "$BENCH_HP")
+# The least square's stacked matrix is (Hp*Z + Hu*U) x Hu*U
+MAX_SIZE=$((BENCH_HP*2 + BENCH_HU*2 + 1))
+
+for VARIANT in mpc_engl mpc_opt_engl mpc_least_square_engl; do
+    for MODE in default packed; do
+        FLAGS=""
+        [ "$MODE" = "packed" ] && FLAGS="-DMATRIX_USE_PACKED_STORAGE -DMATRIX_PACKED_ALIGN=$BENCH_ALIGN"
+        "$CXX" -O2 -std=c++11 -w $FLAGS -I"$ROOT/$VARIANT" -I"$ROOT/sim" -DFPU_PRECISION="$BENCH_FPU" \
+            -DSYSTEM_IMPLEMENTATION=SYSTEM_IMPLEMENTATION_PC -DBENCH_VARIANT_NAME="\"$VARIANT\"" \
+            -DMPC_HP_LEN="$BENCH_HP" -DMPC_HU_LEN="$BENCH_HU" -DMPC_HC_LEN="$BENCH_HP" \
+            -DMPC_COINCIDENCE_POINTS="{$POINTS}" -DMPC_GRID_SEGMENT_LEN=1 -DMPC_GRID_SEGMENTS="{{$BENCH_HP,1}}" \
+            -DMATRIX_MAXIMUM_SIZE="$MAX_SIZE" \
+            "$ROOT/$VARIANT/matrix.cpp" "$ROOT/$VARIANT/mpc.cpp" "$ROOT/bench/bench_flush_to_zero.cpp" \
+            -o "$OUT/bench_$MODE"
+    done
+    "$OUT/bench_default" --tolerance 0 "$@" --write "$OUT/du_ref.txt"
+    "$OUT/bench_packed" --tolerance 0 "$@" --compare "$OUT/du_ref.txt"
+    echo
+done
@@ -0,0 +1,104 @@
+/**************************************************************************************************
+ * Host benchmark: the per-phase profiling statistic (MPC_USE_PHASE_PROFILING, see profiler.h).
+ *
+ *  Runs BENCH_UPDATE_LEN updates (and BENCH_REINIT_LEN re-initializations) of the MPC it's linked
+ *  with, then prints one CSV line per {MPC_n} phase (n is the equation label of the
+ *  implementation's mpc.cpp):
+ *
+ *      variant,precision,phase,count,min_ticks,max_ticks,mean_ticks
+ *
+ *  The ticks are MPC_PROFILE_COUNTER() ticks (TSC cycles on x86, ns on the other PCs).
+ *
+ * See https://github.com/pronenewbits for more!
+ *************************************************************************************************/
+#include <stdio.h>
+#include "konfig.h"
+#include "matrix.h"
+#include "mpc.h"
+
+#if !defined(MPC_USE_PHASE_PROFILING)
+    #error("bench_phase needs MPC_USE_PHASE_PROFILING!");
+#endif
+
+#ifndef BENCH_UPDATE_LEN
+    #define BENCH_UPDATE_LEN    (10000)
+#endif
+#ifndef BENCH_REINIT_LEN
+    #define BENCH_REINIT_LEN    (100)
+#endif
+#ifndef BENCH_VARIANT_NAME
+    #define BENCH_VARIANT_NAME  "mpc"
+#endif
+
+
+static uint32_t u32Seed = 12345;
+static float_prec fRandom(void)
+{
+    /* Deterministic LCG in [-1, 1] */
+    u32Seed = (1103515245UL * u32Seed) + 12345UL;
+    return float_prec((u32Seed >> 8) & 0xFFFF) / float_prec(32767.5) - float_prec(1.0);
+}
+
+/* Keep the result alive so the compiler can't throw the update away */
+volatile float_prec fSink;
+
+int main(void)
+{
+    static Matrix A(SS_X_LEN, SS_X_LEN);
+    static Matrix B(SS_X_LEN, SS_U_LEN);
+    static Matrix C(SS_Z_LEN, SS_X_LEN);
+    static Matrix SP((MPC_HC_LEN*SS_Z_LEN), 1);
+    static Matrix x(SS_X_LEN, 1);
+    static Matrix u(SS_U_LEN, 1);
+
+    /* A stable, random plant */
+    for (int32_t _i = 0; _i < SS_X_LEN; _i++) {
+        for (int32_t _j = 0; _j < SS_X_LEN; _j++) {
+            A[_i][_j] = (_i == _j) ? float_prec(0.95) : (float_prec(0.04) * fRandom() / float_prec(SS_X_LEN));
+        }
+        for (int32_t _j = 0; _j < SS_U_LEN; _j++) {
+            B[_i][_j] = fRandom();
+        }
+    }
+    for (int32_t _i = 0; _i < SS_Z_LEN; _i++) {
+        for (int32_t _j = 0; _j < SS_X_LEN; _j++) {
+            C[_i][_j] = fRandom();
+        }
+    }
+    for (int32_t _i = 0; _i < (MPC_HC_LEN*SS_Z_LEN); _i++) {
+        SP[_i][0] = fRandom();
+    }
+
+    static MPC MPC_BENCH(A, B, C, 1.0, 0.1);
+    MPC_BENCH.vResetPhaseStat();
+
+    for (int32_t _k = 0; _k < BENCH_REINIT_LEN; _k++) {
+        MPC_BENCH.vReInit(A, B, C, 1.0, 0.1);
+    }
+    for (int32_t _k = 0; _k < BENCH_UPDATE_LEN; _k++) {
+        x[0][0] = float_prec(_k & 0xFF) * float_prec(0.001);
+        MPC_BENCH.bUpdate(SP, x, u);
+        u.vSetToZero();
+    }
+    fSink = u[0][0];
+
+    printf("variant,precision,phase,count,min_ticks,max_ticks,mean_ticks\n");
+    for (int32_t _n = 1; _n <= MPC_PHASE_LEN; _n++) {
+        const MPC_PhaseStat &_stat = MPC_BENCH.GetPhaseStat(_n);
+        if (_stat.u32count == 0) {
+            continue;
+        }
+        printf("%s,%s,MPC_%d,%lu,%lu,%lu,%.1f\n", BENCH_VARIANT_NAME,
+               (FPU_PRECISION == PRECISION_SINGLE) ? "float" : "double", int(_n),
+               (unsigned long) _stat.u32count, (unsigned long) _stat.u32min, (unsigned long) _stat.u32max,
+               double(fProfileMean(_stat)));
+    }
+    return 0;
+}
+
+
+void SPEW_THE_ERROR(char const * str)
+{
+    fprintf(stderr, "%s\n", str);
+    exit(1);
+}
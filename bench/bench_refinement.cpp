@@ -0,0 +1,178 @@
+/**************************************************************************************************
+ * Host benchmark: the iterative refinement of the dU(k) solve (MPC_USE_ITERATIVE_REFINEMENT, see the
+ *  konfig.h of mpc_engl & mpc_least_square_engl), on the jet example of the sketch:
+ *
+ *      bench_refinement_mpc_engl [--q q] [--r r] [--samples S] [--iterations N]
+ *                                [--write file] [--compare file]
+ *
+ *  For S random (SP, x, u(k-1)) in [-1, 1] (the same sequence in every build) it calculates du(k).
+ *  --write saves them (one per line) and --compare prints the biggest & the RMS difference to the
+ *  saved ones, relative to their biggest |du(k)|: write them with the double precision build, then
+ *  compare the float builds with & without the refinement. It also prints the mean bUpdate() time
+ *  over N calls and, with the refinement, the mean refinement steps. See bench_refinement.sh.
+ *
+ * See https://github.com/pronenewbits for more!
+ *************************************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include "konfig.h"
+#include "matrix.h"
+#include "mpc.h"
+#include "closed_loop.h"
+
+#ifndef BENCH_VARIANT_NAME
+    #define BENCH_VARIANT_NAME  "mpc"
+#endif
+
+
+static uint32_t u32Seed = 12345;
+static double f64Random(void)
+{
+    /* Deterministic LCG in [-1, 1] */
+    u32Seed = (1103515245UL * u32Seed) + 12345UL;
+    return double((u32Seed >> 8) & 0xFFFF) / 32767.5 - 1.0;
+}
+
+/* Keep the result alive so the compiler can't throw the update away */
+volatile float_prec fSink;
+
+int main(int argc, char ** argv)
+{
+    double _q = 10.0;
+    double _r = 1e-4;
+    int32_t _samples = 10000;
+    int32_t _iterations = 100000;
+    const char * _write = NULL;
+    const char * _compare = NULL;
+    for (int _i = 1; _i < argc; _i++) {
+        if ((strcmp(argv[_i], "--q") == 0) && (_i+1 < argc)) {
+            _q = atof(argv[++_i]);
+        } else if ((strcmp(argv[_i], "--r") == 0) && (_i+1 < argc)) {
+            _r = atof(argv[++_i]);
+        } else if ((strcmp(argv[_i], "--samples") == 0) && (_i+1 < argc)) {
+            _samples = int32_t(atoi(argv[++_i]));
+        } else if ((strcmp(argv[_i], "--iterations") == 0) && (_i+1 < argc)) {
+            _iterations = int32_t(atoi(argv[++_i]));
+        } else if ((strcmp(argv[_i], "--write") == 0) && (_i+1 < argc)) {
+            _write = argv[++_i];
+        } else if ((strcmp(argv[_i], "--compare") == 0) && (_i+1 < argc)) {
+            _compare = argv[++_i];
+        } else {
+            fprintf(stderr, "usage: %s [--q q] [--r r] [--samples S] [--iterations N] [--write file] "
+                            "[--compare file]\n", argv[0]);
+            return 2;
+        }
+    }
+    if ((_samples < 1) || (_iterations < 1) || (_q <= 0) || (_r <= 0)) {
+        fprintf(stderr, "Need q > 0, r > 0, samples >= 1 and iterations >= 1\n");
+        return 2;
+    }
+
+    static Matrix A(SS_X_LEN, SS_X_LEN);
+    static Matrix B(SS_X_LEN, SS_U_LEN);
+    static Matrix C(SS_Z_LEN, SS_X_LEN);
+    if (!bSimJetPlant(A, B, C)) {
+        fprintf(stderr, "The jet example needs X = 4, U = 2, Z = 2\n");
+        return 2;
+    }
+    static MPC MPC_HIL(A, B, C, float_prec(_q), float_prec(_r));
+
+    static Matrix SP((MPC_HC_LEN*SS_Z_LEN), 1);
+    static Matrix x(SS_X_LEN, 1);
+    static Matrix u(SS_U_LEN, 1);
+    std::vector<double> _du(size_t(_samples) * SS_U_LEN);
+    double _refineSum = 0;
+    for (int32_t _n = 0; _n < _samples; _n++) {
+        /* float representable inputs, so the float & double builds see the same ones */
+        for (int32_t _i = 0; _i < (MPC_HC_LEN*SS_Z_LEN); _i++) {
+            SP[_i][0] = float_prec(float(f64Random()));
+        }
+        for (int32_t _i = 0; _i < SS_X_LEN; _i++) {
+            x[_i][0] = float_prec(float(f64Random()));
+        }
+        float_prec _uLast[SS_U_LEN];
+        for (int32_t _i = 0; _i < SS_U_LEN; _i++) {
+            _uLast[_i] = float_prec(float(f64Random()));
+            u[_i][0] = _uLast[_i];
+        }
+        if (!MPC_HIL.bUpdate(SP, x, u)) {
+            fprintf(stderr, "bUpdate() failed at sample %d\n", int(_n));
+            return 1;
+        }
+        for (int32_t _i = 0; _i < SS_U_LEN; _i++) {
+            _du[(size_t(_n) * SS_U_LEN) + _i] = double(u[_i][0]) - double(_uLast[_i]);
+        }
+    #if defined(MPC_USE_ITERATIVE_REFINEMENT)
+        _refineSum += double(MPC_HIL.i32GetRefineIteration());
+    #endif
+    }
+
+    printf("variant          : %s, %s, Hp %d, Hu %d, q %g, r %g%s\n", BENCH_VARIANT_NAME,
+           (FPU_PRECISION == PRECISION_SINGLE) ? "float" : "double", MPC_HP_LEN, MPC_HU_LEN, _q, _r,
+    #if defined(MPC_USE_ITERATIVE_REFINEMENT)
+           ", refined");
+    printf("refinement steps : %.2f (mean, max %d)\n", _refineSum / double(_samples), int(MPC_REFINE_MAX_ITER));
+    #else
+           "");
+    #endif
+
+    if (_write != NULL) {
+        FILE * _file = fopen(_write, "w");
+        if (_file == NULL) {
+            fprintf(stderr, "Can't write %s\n", _write);
+            return 1;
+        }
+        for (size_t _i = 0; _i < _du.size(); _i++) {
+            fprintf(_file, "%.17g\n", _du[_i]);
+        }
+        fclose(_file);
+    }
+    if (_compare != NULL) {
+        FILE * _file = fopen(_compare, "r");
+        if (_file == NULL) {
+            fprintf(stderr, "Can't read %s\n", _compare);
+            return 1;
+        }
+        double _duMax = 0;
+        double _errMax = 0;
+        double _errSquare = 0;
+        for (size_t _i = 0; _i < _du.size(); _i++) {
+            double _ref;
+            if (!bSimReadNumber(_file, _ref)) {
+                fprintf(stderr, "%s has less than %d samples\n", _compare, int(_samples));
+                fclose(_file);
+                return 1;
+            }
+            const double _err = _du[_i] - _ref;
+            _duMax = (fabs(_ref) > _duMax) ? fabs(_ref) : _duMax;
+            _errMax = (fabs(_err) > _errMax) ? fabs(_err) : _errMax;
+            _errSquare += _err * _err;
+        }
+        fclose(_file);
+        if (_duMax <= 0) {
+            _duMax = 1;
+        }
+        printf("du error (rel.)  : max %.3e rms %.3e\n", _errMax / _duMax,
+               sqrt(_errSquare / double(_du.size())) / _duMax);
+    }
+
+    SP.vSetHomogen(float_prec(0.5));
+    x.vSetHomogen(float_prec(0.1));
+    const double _t = f64SimWallSecond();
+    for (int32_t _k = 0; _k < _iterations; _k++) {
+        x[0][0] = float_prec(_k & 0xFF) * float_prec(0.001);
+        MPC_HIL.bUpdate(SP, x, u);
+        fSink = u[0][0];
+    }
+    printf("bUpdate (ns)     : %.1f\n", (f64SimWallSecond() - _t) * 1e9 / double(_iterations));
+    return 0;
+}
+
+
+void SPEW_THE_ERROR(char const * str)
+{
+    fprintf(stderr, "%s\n", str);
+    exit(1);
+}
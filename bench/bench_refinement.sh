@@ -0,0 +1,40 @@
+#!/bin/sh
+# Compare the float dU(k) solve of mpc_engl & mpc_least_square_engl, with and without
+# MPC_USE_ITERATIVE_REFINEMENT, against the double precision build, on the jet example with a long
+# horizon and a small r (an ill-conditioned H / R_L).
+#
+#   usage: bench/bench_refinement.sh [bench_refinement options...] (e.g. --r 1e-5)
+#   env  : BENCH_HP (40), BENCH_HU (10), BENCH_REFINE_MAX_ITER (2)
+set -e
+
+ROOT=$(cd "$(dirname "$0")/.." && pwd)
+CXX=${CXX:-g++}
+BENCH_HP=${BENCH_HP:-40}
+BENCH_HU=${BENCH_HU:-10}
+BENCH_REFINE_MAX_ITER=${BENCH_REFINE_MAX_ITER:-2}
+OUT=$(mktemp -d)
+trap 'rm -rf "$OUT"' EXIT
+
+# Uniform grid, every prediction step is a coincidence point
+POINTS=$(seq -s, 1 "$BENCH_HP")
+# The least square's stacked matrix is (Hp*Z + Hu*U) x Hu*U
+MAX_SIZE=$((BENCH_HP*2 + BENCH_HU*2 + 1))
+
+for VARIANT in mpc_engl mpc_least_square_engl; do
+    for MODE in double float refined; do
+        FLAGS="-DFPU_PRECISION=PRECISION_SINGLE"
+        [ "$MODE" = "double" ] && FLAGS="-DFPU_PRECISION=PRECISION_DOUBLE"
+        [ "$MODE" = "refined" ] && FLAGS="$FLAGS -DMPC_USE_ITERATIVE_REFINEMENT -DMPC_REFINE_MAX_ITER=$BENCH_REFINE_MAX_ITER"
+        "$CXX" -O2 -std=c++11 -w $FLAGS -I"$ROOT/$VARIANT" -I"$ROOT/sim" \
+            -DSYSTEM_IMPLEMENTATION=SYSTEM_IMPLEMENTATION_PC -DBENCH_VARIANT_NAME="\"$VARIANT\"" \
+            -DMPC_HP_LEN="$BENCH_HP" -DMPC_HU_LEN="$BENCH_HU" -DMPC_HC_LEN="$BENCH_HP" \
+            -DMPC_COINCIDENCE_POINTS="{$POINTS}" -DMPC_GRID_SEGMENT_LEN=1 -DMPC_GRID_SEGMENTS="{{$BENCH_HP,1}}" \
+            -DMATRIX_MAXIMUM_SIZE="$MAX_SIZE" \
+            "$ROOT/$VARIANT/matrix.cpp" "$ROOT/$VARIANT/mpc.cpp" "$ROOT/bench/bench_refinement.cpp" \
+            -o "$OUT/bench_$MODE"
+    done
+    "$OUT/bench_double" "$@" --write "$OUT/du_ref.txt"
+    "$OUT/bench_float" "$@" --compare "$OUT/du_ref.txt"
+    "$OUT/bench_refined" "$@" --compare "$OUT/du_ref.txt"
+    echo
+done
@@ -0,0 +1,161 @@
+/**************************************************************************************************
+ * Host benchmark: the vReInit() cache (MPC_REINIT_CACHE_LEN, see reinit_cache.h) of the MPC it's
+ *  linked with, at the konfig.h dimension.
+ *
+ *      bench_reinit_cache_mpc_opt_engl [--models K] [--iterations N] [--noise e] [--quantum q]
+ *
+ *  It emulates a re-identification loop that flips between K stable, random models: every iteration
+ *  re-initializes with one of them (+ a uniform noise of +-e on every element), and prints the hit &
+ *  miss count and the mean vReInit() time of both. Each hit is checked against the online constants
+ *  of the miss that filled its entry (as the snapshot payload): the tool returns 1 if they differ.
+ *
+ * See https://github.com/pronenewbits for more!
+ *************************************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <vector>
+#include "konfig.h"
+#include "matrix.h"
+#include "mpc.h"
+
+#if !defined(MPC_REINIT_CACHE_LEN)
+    #error("bench_reinit_cache needs MPC_REINIT_CACHE_LEN!");
+#endif
+
+#ifndef BENCH_VARIANT_NAME
+    #define BENCH_VARIANT_NAME  "mpc"
+#endif
+
+
+static uint32_t u32Seed = 12345;
+static float_prec fRandom(void)
+{
+    /* Deterministic LCG in [-1, 1] */
+    u32Seed = (1103515245UL * u32Seed) + 12345UL;
+    return float_prec((u32Seed >> 8) & 0xFFFF) / float_prec(32767.5) - float_prec(1.0);
+}
+
+static double f64WallSecond(void)
+{
+    struct timespec _ts;
+    clock_gettime(CLOCK_MONOTONIC, &_ts);
+    return double(_ts.tv_sec) + (double(_ts.tv_nsec) * 1e-9);
+}
+
+int main(int argc, char ** argv)
+{
+    int32_t _models = 3;
+    int32_t _iterations = 1000;
+    float_prec _noise = 0;
+    float_prec _quantum = MPC_REINIT_CACHE_QUANTUM;
+    for (int _i = 1; _i < argc; _i++) {
+        if ((strcmp(argv[_i], "--models") == 0) && (_i+1 < argc)) {
+            _models = int32_t(atoi(argv[++_i]));
+        } else if ((strcmp(argv[_i], "--iterations") == 0) && (_i+1 < argc)) {
+            _iterations = int32_t(atoi(argv[++_i]));
+        } else if ((strcmp(argv[_i], "--noise") == 0) && (_i+1 < argc)) {
+            _noise = float_prec(atof(argv[++_i]));
+        } else if ((strcmp(argv[_i], "--quantum") == 0) && (_i+1 < argc)) {
+            _quantum = float_prec(atof(argv[++_i]));
+        } else {
+            fprintf(stderr, "usage: %s [--models K] [--iterations N] [--noise e] [--quantum q]\n", argv[0]);
+            return 2;
+        }
+    }
+    if ((_models < 1) || (_iterations < 1)) {
+        fprintf(stderr, "Need models >= 1 and iterations >= 1\n");
+        return 2;
+    }
+
+    /* K stable, random models: A, B & C of each, row-major */
+    const int32_t _modelLen = (SS_X_LEN*SS_X_LEN) + (SS_X_LEN*SS_U_LEN) + (SS_Z_LEN*SS_X_LEN);
+    std::vector<float_prec> _model(size_t(_models) * _modelLen);
+    for (int32_t _m = 0; _m < _models; _m++) {
+        float_prec * _p = &_model[size_t(_m) * _modelLen];
+        for (int32_t _i = 0; _i < SS_X_LEN; _i++) {
+            for (int32_t _j = 0; _j < SS_X_LEN; _j++) {
+                *_p++ = (_i == _j) ? float_prec(0.95) : (float_prec(0.04) * fRandom() / float_prec(SS_X_LEN));
+            }
+        }
+        for (int32_t _i = 0; _i < (SS_X_LEN*SS_U_LEN) + (SS_Z_LEN*SS_X_LEN); _i++) {
+            *_p++ = fRandom();
+        }
+    }
+
+    static Matrix A(SS_X_LEN, SS_X_LEN);
+    static Matrix B(SS_X_LEN, SS_U_LEN);
+    static Matrix C(SS_Z_LEN, SS_X_LEN);
+    static MPC MPC_BENCH;
+    MPC_BENCH.vSetReInitCacheQuantum(_quantum);
+
+    /* The online constants of each model's last miss, for the check of the hits */
+    const size_t _bytes = MPC::szSnapshotBytes();
+    std::vector<uint8_t> _reference(size_t(_models) * _bytes);
+    std::vector<uint8_t> _snapshot(_bytes);
+    double _tHit = 0;
+    double _tMiss = 0;
+    int32_t _mismatch = -1;
+    for (int32_t _k = 0; (_k < _iterations) && (_mismatch < 0); _k++) {
+        const int32_t _m = _k % _models;
+        const float_prec * _p = &_model[size_t(_m) * _modelLen];
+        for (int32_t _i = 0; _i < SS_X_LEN; _i++) {
+            for (int32_t _j = 0; _j < SS_X_LEN; _j++) {
+                A[_i][_j] = *_p++ + (_noise * fRandom());
+            }
+        }
+        for (int32_t _i = 0; _i < SS_X_LEN; _i++) {
+            for (int32_t _j = 0; _j < SS_U_LEN; _j++) {
+                B[_i][_j] = *_p++ + (_noise * fRandom());
+            }
+        }
+        for (int32_t _i = 0; _i < SS_Z_LEN; _i++) {
+            for (int32_t _j = 0; _j < SS_X_LEN; _j++) {
+                C[_i][_j] = *_p++ + (_noise * fRandom());
+            }
+        }
+
+        const uint32_t _hitBefore = MPC_BENCH.u32GetReInitCacheHit();
+        const double _t = f64WallSecond();
+        MPC_BENCH.vReInit(A, B, C, 1.0, 0.1);
+        const double _dt = f64WallSecond() - _t;
+
+        uint8_t * _ref = &_reference[size_t(_m) * _bytes];
+        if (!MPC_BENCH.bSaveSnapshot(&_snapshot[0], _bytes)) {
+            fprintf(stderr, "bSaveSnapshot() failed\n");
+            return 1;
+        }
+        if (MPC_BENCH.u32GetReInitCacheHit() != _hitBefore) {
+            _tHit += _dt;
+            if (memcmp(&_snapshot[0], _ref, _bytes) != 0) {
+                _mismatch = _k;
+            }
+        } else {
+            _tMiss += _dt;
+            memcpy(_ref, &_snapshot[0], _bytes);
+        }
+    }
+
+    const uint32_t _hit  = MPC_BENCH.u32GetReInitCacheHit();
+    const uint32_t _miss = MPC_BENCH.u32GetReInitCacheMiss();
+    printf("variant          : %s (%s), %d entries\n", BENCH_VARIANT_NAME,
+           (FPU_PRECISION == PRECISION_SINGLE) ? "float" : "double", int(MPC_REINIT_CACHE_LEN));
+    printf("models           : %d, noise %g, quantum %g\n", int(_models), double(_noise), double(_quantum));
+    printf("vReInit          : %lu hit, %lu miss\n", (unsigned long) _hit, (unsigned long) _miss);
+    printf("mean time (us)   : hit %.2f, miss %.2f\n", (_hit == 0) ? 0.0 : (_tHit * 1e6 / double(_hit)),
+           (_miss == 0) ? 0.0 : (_tMiss * 1e6 / double(_miss)));
+    if (_mismatch >= 0) {
+        printf("check            : MISMATCH at iteration %d\n", int(_mismatch));
+        return 1;
+    }
+    printf("check            : every hit identical to its miss\n");
+    return 0;
+}
+
+
+void SPEW_THE_ERROR(char const * str)
+{
+    fprintf(stderr, "%s\n", str);
+    exit(1);
+}
@@ -0,0 +1,159 @@
+/**************************************************************************************************
+ * Host stack-painting harness: the real stack high-water mark of MPC::vReInit() & MPC::bUpdate() of
+ *  the implementation it's linked with, against the compile-time budget of its budget.h:
+ *
+ *      bench_stack_mpc_opt_engl
+ *      bench_stack_mpc_opt_engl_reinit_workspace
+ *      bench_stack_mpc_opt_engl_update_workspace
+ *      bench_stack_mpc_opt_engl_O0                 (the library compiled with -O0)
+ *
+ *  All of them are ctest tests (ctest -R bench_stack).
+ *
+ *  Each call runs on its own stack (ucontext), painted with a pattern beforehand; the high-water mark
+ *  is the deepest byte that doesn't hold the pattern anymore, minus the one of an empty call. It
+ *  prints the static footprint (sizeof(MPC)), the vReInit() & bUpdate() workspaces (with
+ *  MPC_USE_REINIT_WORKSPACE & MPC_USE_UPDATE_WORKSPACE), and the measured & budgeted stack of both
+ *  calls in bytes and in Matrix frames. It returns 1 if a measured stack is above its budget.
+ *
+ *  The host compiler lays the frames out differently than the target's, so it checks the count of
+ *  budget.h, not the target: the Matrix objects are the same on every target, the call level allowance
+ *  (MATRIX_STACK_CALL_BYTES) is what depends on the ABI.
+ *
+ * See https://github.com/pronenewbits for more!
+ *************************************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ucontext.h>
+#include "konfig.h"
+#include "matrix.h"
+#include "mpc.h"
+#include "budget.h"
+#include "closed_loop.h"
+
+#ifndef BENCH_VARIANT_NAME
+    #define BENCH_VARIANT_NAME  "mpc"
+#endif
+
+#define BENCH_STACK_BYTES   (64UL*1024UL*1024UL)
+#define BENCH_STACK_PAINT   (0xA5)
+
+#define BENCH_CALL_EMPTY    (0)
+#define BENCH_CALL_REINIT   (1)
+#define BENCH_CALL_UPDATE   (2)
+
+
+static ucontext_t ctxMain;
+static ucontext_t ctxCall;
+static int32_t i32Call;
+static volatile bool bCallResult;
+
+static Matrix A(SS_X_LEN, SS_X_LEN);
+static Matrix B(SS_X_LEN, SS_U_LEN);
+static Matrix C(SS_Z_LEN, SS_X_LEN);
+static Matrix SP((MPC_HC_LEN*SS_Z_LEN), 1);
+static Matrix x(SS_X_LEN, 1);
+static Matrix u(SS_U_LEN, 1);
+static MPC * pMPC;
+
+/* The result is stored after the call, so the compiler can't make it a tail call (the callee would
+ *  reuse the frame of vRunCall(), and the high-water mark wouldn't see its own frame)
+ */
+static void vRunCall(void)
+{
+    bool _result = true;
+    if (i32Call == BENCH_CALL_REINIT) {
+    #if defined(MPC_REINIT_CACHE_LEN)
+        pMPC->vClearReInitCache();      /* The miss, the full calculation */
+    #endif
+        pMPC->vReInit(A, B, C, float_prec(10.0), float_prec(0.03));
+    } else if (i32Call == BENCH_CALL_UPDATE) {
+        _result = pMPC->bUpdate(SP, x, u);
+    }
+    bCallResult = _result;
+}
+
+/* The stack bytes used by the call, i.e. above the deepest unpainted byte */
+static size_t szStackHighWater(uint8_t * _stack, const int32_t _call)
+{
+    memset(_stack, BENCH_STACK_PAINT, BENCH_STACK_BYTES);
+    getcontext(&ctxCall);
+    ctxCall.uc_stack.ss_sp = _stack;
+    ctxCall.uc_stack.ss_size = BENCH_STACK_BYTES;
+    ctxCall.uc_link = &ctxMain;
+    i32Call = _call;
+    makecontext(&ctxCall, vRunCall, 0);
+    swapcontext(&ctxMain, &ctxCall);
+
+    size_t _i = 0;
+    while ((_i < BENCH_STACK_BYTES) && (_stack[_i] == BENCH_STACK_PAINT)) {
+        _i++;
+    }
+    return BENCH_STACK_BYTES - _i;
+}
+
+int main(int argc, char ** argv)
+{
+    if (argc > 1) {
+        fprintf(stderr, "usage: %s\n", argv[0]);
+        return 2;
+    }
+    if (!bSimJetPlant(A, B, C)) {
+        fprintf(stderr, "The jet example needs X = 4, U = 2, Z = 2\n");
+        return 2;
+    }
+    static MPC MPC_HIL(A, B, C, float_prec(10.0), float_prec(0.03));
+    pMPC = &MPC_HIL;
+    SP.vSetHomogen(float_prec(0.5));
+    x.vSetHomogen(float_prec(0.1));
+    
+    /* Resolve the lazily bound library calls (sqrt, memcmp, ..) first: the dynamic linker resolves them
+     *  on the caller's stack at the first call
+     */
+    i32Call = BENCH_CALL_REINIT;
+    vRunCall();
+    i32Call = BENCH_CALL_UPDATE;
+    vRunCall();
+
+    uint8_t * _stack = (uint8_t *) malloc(BENCH_STACK_BYTES);
+    if (_stack == NULL) {
+        fprintf(stderr, "Can't allocate the %lu bytes stack\n", (unsigned long) BENCH_STACK_BYTES);
+        return 1;
+    }
+    const size_t _empty = szStackHighWater(_stack, BENCH_CALL_EMPTY);
+    const size_t _used[2] = {szStackHighWater(_stack, BENCH_CALL_REINIT) - _empty,
+                             szStackHighWater(_stack, BENCH_CALL_UPDATE) - _empty};
+    free(_stack);
+
+    const size_t _budget[2] = {MPC_STACK_REINIT_BYTES, MPC_STACK_UPDATE_BYTES};
+    const char * const _name[2] = {"vReInit", "bUpdate"};
+    printf("variant          : %s, %s, MATRIX_MAXIMUM_SIZE %d, sizeof(Matrix) %lu\n", BENCH_VARIANT_NAME,
+           (FPU_PRECISION == PRECISION_SINGLE) ? "float" : "double", int(MATRIX_MAXIMUM_SIZE),
+           (unsigned long) sizeof(Matrix));
+    printf("static (bytes)   : %lu (sizeof(MPC), %.1f Matrix)\n", (unsigned long) MPC_STATIC_BYTES,
+           double(MPC_STATIC_BYTES) / double(sizeof(Matrix)));
+#if defined(MPC_USE_REINIT_WORKSPACE)
+    printf("vReInit workspace: %lu bytes (MPC_REINIT_WORKSPACE_LEN %lu)\n", (unsigned long) MPC_REINIT_WORKSPACE_BYTES,
+           (unsigned long) MPC_REINIT_WORKSPACE_LEN);
+#endif
+#if defined(MPC_USE_UPDATE_WORKSPACE)
+    printf("bUpdate workspace: %lu bytes (MPC_UPDATE_WORKSPACE_LEN %lu)\n", (unsigned long) MPC_UPDATE_WORKSPACE_BYTES,
+           (unsigned long) MPC_UPDATE_WORKSPACE_LEN);
+#endif
+    bool _ok = true;
+    for (int32_t _i = 0; _i < 2; _i++) {
+        const bool _within = (_used[_i] <= _budget[_i]);
+        printf("%-7s (bytes)  : measured %lu (%.1f Matrix), budget %lu (%.1f Matrix)%s\n", _name[_i],
+               (unsigned long) _used[_i], double(_used[_i]) / double(sizeof(Matrix)), (unsigned long) _budget[_i],
+               double(_budget[_i]) / double(sizeof(Matrix)), _within ? "" : "  <-- ABOVE THE BUDGET");
+        _ok = _ok && _within;
+    }
+    return _ok ? 0 : 1;
+}
+
+
+void SPEW_THE_ERROR(char const * str)
+{
+    fprintf(stderr, "%s\n", str);
+    exit(1);
+}
@@ -0,0 +1,183 @@
+/**************************************************************************************************
+ * Host check of the constant-time MPC::bUpdate() (MPC_USE_CONSTANT_TIME_UPDATE, see wcet.h) of
+ *  mpc_opt_engl, at the konfig.h dimension:
+ *
+ *      bench_wcet [--iterations N] [--tolerance t] [--factor f]
+ *      bench_wcet --estimate
+ *
+ *  --estimate prints the static cycle estimate (the build prints it after linking bench_wcet).
+ *  Otherwise it times N bursts of BENCH_BURST_LEN bUpdate() calls for each class of inputs (SP, x &
+ *  u(k-1) all zero, random in [-1, 1], huge, subnormal, and not finite), in BENCH_ROUND_LEN rounds, and
+ *  prints the median & 99th percentile of the least disturbed round and the max time per call of each. The update is data independent when the medians of all
+ *  classes are within the tolerance (default 0.25) of the fastest one.
+ *
+ *  The fastest median over MPC_WCET_CYCLE is the host ns per estimated cycle, i.e. the estimate
+ *  calibrated to the host. With it the 99th percentile of every class is converted to estimated
+ *  cycles, and has to stay within the factor (default 4) of MPC_WCET_CYCLE. The max is only printed,
+ *  it's the OS preemption more than the update. It returns 1 when one of the checks fails (ctest
+ *  runs it). bench_wcet_default is the median check on the default (Matrix based) update.
+ *
+ * See https://github.com/pronenewbits for more!
+ *************************************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <vector>
+#include "konfig.h"
+#include "matrix.h"
+#include "mpc.h"
+#include "closed_loop.h"
+
+#define BENCH_CLASS_LEN     (5)
+#define BENCH_BURST_LEN     (32)
+#define BENCH_ROUND_LEN     (10)
+
+
+static uint32_t u32Seed = 12345;
+static double f64Random(void)
+{
+    /* Deterministic LCG in [-1, 1] */
+    u32Seed = (1103515245UL * u32Seed) + 12345UL;
+    return double((u32Seed >> 8) & 0xFFFF) / 32767.5 - 1.0;
+}
+
+/* The value of an input element in each class */
+static float_prec fClassValue(const int32_t _class)
+{
+    const float_prec _sign = (f64Random() < 0) ? float_prec(-1) : float_prec(1);
+    switch (_class) {
+        case 0:     return float_prec(0);
+        case 1:     return float_prec(f64Random());
+        case 2:     return _sign * float_prec((FPU_PRECISION == PRECISION_SINGLE) ? 1e30 : 1e300);
+        case 3:     return _sign * float_prec((FPU_PRECISION == PRECISION_SINGLE) ? 1e-39 : 1e-310);
+        default:    return (f64Random() < 0) ? float_prec(NAN) : (_sign * float_prec(INFINITY));
+    }
+}
+
+/* Keep the result alive so the compiler can't throw the update away */
+volatile float_prec fSink;
+
+int main(int argc, char ** argv)
+{
+    int32_t _iterations = 5000;
+    double _tolerance = 0.25;
+    double _factor = 4.0;
+    bool _estimateOnly = false;
+    for (int _i = 1; _i < argc; _i++) {
+        if ((strcmp(argv[_i], "--iterations") == 0) && (_i+1 < argc)) {
+            _iterations = int32_t(atoi(argv[++_i]));
+        } else if ((strcmp(argv[_i], "--tolerance") == 0) && (_i+1 < argc)) {
+            _tolerance = atof(argv[++_i]);
+        } else if ((strcmp(argv[_i], "--factor") == 0) && (_i+1 < argc)) {
+            _factor = atof(argv[++_i]);
+        } else if (strcmp(argv[_i], "--estimate") == 0) {
+            _estimateOnly = true;
+        } else {
+            fprintf(stderr, "usage: %s [--iterations N] [--tolerance t] [--factor f] | --estimate\n", argv[0]);
+            return 2;
+        }
+    }
+    if ((_iterations < 100) || (_tolerance <= 0) || (_factor < 1)) {
+        fprintf(stderr, "Need iterations >= 100, tolerance > 0 and factor >= 1\n");
+        return 2;
+    }
+
+#if defined(MPC_USE_CONSTANT_TIME_UPDATE)
+    printf("WCET estimate    : %lu cycles (%lu MAC x %d + %lu element x %d + %d), X %d U %d Z %d Hc %d\n",
+           (unsigned long) MPC_WCET_CYCLE, (unsigned long) MPC_WCET_MAC_LEN, int(MPC_WCET_CYCLE_MAC),
+           (unsigned long) MPC_WCET_ELEMENT_LEN, int(MPC_WCET_CYCLE_ELEMENT), int(MPC_WCET_CYCLE_CALL),
+           SS_X_LEN, SS_U_LEN, SS_Z_LEN, MPC_HC_LEN);
+#else
+    printf("WCET estimate    : none (MPC_USE_CONSTANT_TIME_UPDATE is not defined)\n");
+#endif
+    if (_estimateOnly) {
+        return 0;
+    }
+
+    static Matrix A(SS_X_LEN, SS_X_LEN);
+    static Matrix B(SS_X_LEN, SS_U_LEN);
+    static Matrix C(SS_Z_LEN, SS_X_LEN);
+    if (!bSimJetPlant(A, B, C)) {
+        fprintf(stderr, "The jet example needs X = 4, U = 2, Z = 2\n");
+        return 2;
+    }
+    static MPC MPC_HIL(A, B, C, float_prec(10.0), float_prec(0.03));
+#if defined(MPC_USE_CONSTANT_TIME_UPDATE)
+    /* Once, as the application would (see konfig.h), so bUpdate() doesn't switch the mode */
+    MatrixFlushToZero::vSetGlobal();
+#endif
+
+    static Matrix SP((MPC_HC_LEN*SS_Z_LEN), 1);
+    static Matrix x(SS_X_LEN, 1);
+    static Matrix u(SS_U_LEN, 1);
+    const char * const _className[BENCH_CLASS_LEN] = {"zero", "random", "huge", "subnormal", "not finite"};
+    double _median[BENCH_CLASS_LEN];
+    double _p99[BENCH_CLASS_LEN];
+    double _max[BENCH_CLASS_LEN];
+    std::vector<double> _ns(size_t(_iterations), 0.0);
+
+    printf("%12s %12s %12s %12s\n", "inputs", "median(ns)", "p99(ns)", "max(ns)");
+    /* The classes take turns in each round, so a change of the host clock hits all of them */
+    for (int32_t _r = 0; _r < BENCH_ROUND_LEN; _r++) {
+        for (int32_t _c = 0; _c < BENCH_CLASS_LEN; _c++) {
+            for (int32_t _k = 0; _k < _iterations; _k++) {
+                for (int32_t _i = 0; _i < (MPC_HC_LEN*SS_Z_LEN); _i++) {
+                    SP[_i][0] = fClassValue(_c);
+                }
+                for (int32_t _i = 0; _i < SS_X_LEN; _i++) {
+                    x[_i][0] = fClassValue(_c);
+                }
+                for (int32_t _i = 0; _i < SS_U_LEN; _i++) {
+                    u[_i][0] = fClassValue(_c);
+                }
+                /* A burst of calls, so the timer resolution doesn't dominate (u(k) stays in its class) */
+                const double _t = f64SimWallSecond();
+                for (int32_t _b = 0; _b < BENCH_BURST_LEN; _b++) {
+                    MPC_HIL.bUpdate(SP, x, u);
+                }
+                _ns[size_t(_k)] = (f64SimWallSecond() - _t) * 1e9 / double(BENCH_BURST_LEN);
+                fSink = u[0][0];
+            }
+            std::sort(_ns.begin(), _ns.end());
+            /* The least disturbed round: a data dependent path is in every round, the OS preemption isn't */
+            if ((_r == 0) || (_ns[_ns.size() / 2] < _median[_c])) {
+                _median[_c] = _ns[_ns.size() / 2];
+            }
+            if ((_r == 0) || (_ns[(_ns.size() * 99) / 100] < _p99[_c])) {
+                _p99[_c] = _ns[(_ns.size() * 99) / 100];
+            }
+            if ((_r == 0) || (_ns.back() > _max[_c])) {
+                _max[_c] = _ns.back();
+            }
+        }
+    }
+    for (int32_t _c = 0; _c < BENCH_CLASS_LEN; _c++) {
+        printf("%12s %12.1f %12.1f %12.1f\n", _className[_c], _median[_c], _p99[_c], _max[_c]);
+    }
+
+    const double _fastest = *std::min_element(_median, _median + BENCH_CLASS_LEN);
+    const double _slowest = *std::max_element(_median, _median + BENCH_CLASS_LEN);
+    const bool _constant = (_slowest <= (_fastest * (1.0 + _tolerance)));
+    printf("data dependence  : slowest/fastest median %.3f, %s the tolerance %g\n", _slowest / _fastest,
+           _constant ? "within" : "OUTSIDE", _tolerance);
+    bool _bounded = true;
+#if defined(MPC_USE_CONSTANT_TIME_UPDATE)
+    const double _nsPerCycle = _fastest / double(MPC_WCET_CYCLE);
+    const double _p99Cycle = *std::max_element(_p99, _p99 + BENCH_CLASS_LEN) / _nsPerCycle;
+    const double _maxCycle = *std::max_element(_max, _max + BENCH_CLASS_LEN) / _nsPerCycle;
+    _bounded = (_p99Cycle <= (_factor * double(MPC_WCET_CYCLE)));
+    printf("host calibration : %.4f ns per estimated cycle (the fastest median)\n", _nsPerCycle);
+    printf("WCET bound       : p99 %.0f cycles = %.2f x MPC_WCET_CYCLE, %s the factor %g (max %.2f x)\n",
+           _p99Cycle, _p99Cycle / double(MPC_WCET_CYCLE), _bounded ? "within" : "OUTSIDE", _factor,
+           _maxCycle / double(MPC_WCET_CYCLE));
+#endif
+    return (_constant && _bounded) ? 0 : 1;
+}
+
+
+void SPEW_THE_ERROR(char const * str)
+{
+    fprintf(stderr, "%s\n", str);
+    exit(1);
+}
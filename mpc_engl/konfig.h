@@ -12,24 +12,132 @@
 #include <math.h>
 
 
+/* NOTE: The dimensions & parameters below can be overridden from the compiler command line (e.g. 
+ *  -DMPC_HP_LEN=10), that's how the host builds compile the library for several configurations.
+ */
+
 
 /* State Space dimension */
-#define SS_X_LEN    (4)
-#define SS_Z_LEN    (2)
-#define SS_U_LEN    (2)
+#ifndef SS_X_LEN
+    #define SS_X_LEN    (4)
+#endif
+#ifndef SS_Z_LEN
+    #define SS_Z_LEN    (2)
+#endif
+#ifndef SS_U_LEN
+    #define SS_U_LEN    (2)
+#endif
 #define SS_DT_MILIS (10)                            /* 10 ms */
 #define SS_DT       float_prec(SS_DT_MILIS/1000.)   /* Sampling time */
 
 
 
 /* MPC Parameters */
-#define MPC_HP_LEN      (7)
-#define MPC_HU_LEN      (4)
+#ifndef MPC_HP_LEN
+    #define MPC_HP_LEN      (7)
+#endif
+#ifndef MPC_HU_LEN
+    #define MPC_HU_LEN      (4)
+#endif
 
+/* Coincidence points: the prediction steps (strictly increasing, 1..MPC_HP_LEN) where the tracking 
+ *  error is evaluated. CPSI, COMEGA, CTHETA, Q and SP only have rows at these steps, so the cost 
+ *  scales with MPC_HC_LEN instead of MPC_HP_LEN (e.g. Hp = 32 with {1, 2, 4, 8, 16, 32} only 
+ *  needs 6 block rows). Set it to {1, 2, .., MPC_HP_LEN} to evaluate every prediction step.
+ */
+#ifndef MPC_HC_LEN
+    #define MPC_HC_LEN              (7)
+#endif
+#ifndef MPC_COINCIDENCE_POINTS
+    #define MPC_COINCIDENCE_POINTS  {1, 2, 3, 4, 5, 6, 7}
+#endif
+
+/* Prediction time grid: MPC_GRID_SEGMENT_LEN segments of {number of prediction steps, step length in SS_DT}.
+ *  The number of prediction steps must add up to MPC_HP_LEN. The first segment usually steps with SS_DT 
+ *  and the later ones with multiples of it, e.g. a 5 second look-ahead with 10 ms SS_DT only needs 
+ *  30 prediction steps with {{10, 1}, {10, 10}, {10, 39}} instead of 500 uniform ones.
+ */
+#ifndef MPC_GRID_SEGMENT_LEN
+    #define MPC_GRID_SEGMENT_LEN    (1)
+#endif
+#ifndef MPC_GRID_SEGMENTS
+    #define MPC_GRID_SEGMENTS       {{7, 1}}
+#endif
+
+
+/* Define this to refine the solution of H * dU(k) = 0.5*G ({MPC_5a}) with iterative refinement: the residual
+ *  0.5*G - H*dU(k) is summed in double from CTHETA, Q, R & E(k) (not from the float H & G), the correction
+ *  with the same (float) H^-1, for up to MPC_REFINE_MAX_ITER iterations. It stops when max|correction| <= MPC_REFINE_TOLERANCE * max|dU(k)|.
+ *  Only useful with FPU_PRECISION = PRECISION_SINGLE (MPC::i32GetRefineIteration() gives the iterations
+ *  of the last bUpdate()).
+ */
+// #define MPC_USE_ITERATIVE_REFINEMENT
+#ifndef MPC_REFINE_MAX_ITER
+    #define MPC_REFINE_MAX_ITER     (2)
+#endif
+#ifndef MPC_REFINE_TOLERANCE
+    #define MPC_REFINE_TOLERANCE    (1e-7)
+#endif
+
+/* Define this to measure the MPC_PROFILE_COUNTER() ticks spent in each {MPC_n} phase of MPC::vReInit() &
+ *  MPC::bUpdate() (min, max & mean, read them with MPC::GetPhaseStat(n)). See profiler.h for the counter
+ *  used on each platform. When it's not defined, the profiling hooks compile to nothing.
+ */
+// #define MPC_USE_PHASE_PROFILING
+
+/* Define this to count what the Matrix class does: the constructions, the (whole buffer) copies, the
+ *  zero-fills, and the element reads, writes & multiply-adds of each matrix operation type (read them
+ *  with vMatrixOpCountReport() & clear them with vMatrixOpCountReset(), see matrix.h). For the host
+ *  analysis only, as it adds a counter update to every Matrix construction & operation.
+ */
+// #define MATRIX_USE_OP_COUNTING
+
+/* Define this to run MPC::vReInit() on one workspace of MPC_REINIT_WORKSPACE_LEN float_prec (the exact need
+ *  of the dimension above, see mpc.h) reused by all its stages, instead of the Matrix locals & temporaries,
+ *  so its stack is only a few scalars (e.g. to re-initialize from a small background task).
+ *  vReInit(.., _workspace) takes the caller's workspace, otherwise a static one shared by the instances is used.
+ */
+// #define MPC_USE_REINIT_WORKSPACE
+
+/* Define this to run MPC::bUpdate() on one workspace of MPC_UPDATE_WORKSPACE_LEN float_prec (the exact need
+ *  of the dimension above, see mpc.h) instead of the Matrix locals & temporaries, and without the DU member,
+ *  with the same du(k) (the same H^-1, see mpc.cpp). bUpdate(.., _workspace) takes the caller's workspace,
+ *  otherwise a static one shared by the instances is used, i.e. the instances updated one after another
+ *  (never concurrently, e.g. from the same task) share one peak instead of each keeping its own scratch.
+ */
+// #define MPC_USE_UPDATE_WORKSPACE
+
+/* Define these to stop the build when the worst-case stack of MPC::vReInit() or MPC::bUpdate() is above
+ *  MPC_STACK_BUDGET bytes, or sizeof(MPC) is above MPC_STATIC_BUDGET bytes (see budget.h for how they're
+ *  counted). Every Matrix is MATRIX_MAXIMUM_SIZE^2 elements, so this is what a too big MATRIX_MAXIMUM_SIZE
+ *  trips first; e.g. use the free RAM of your board minus what the rest of the sketch needs.
+ */
+// #define MPC_STACK_BUDGET         (96*1024)
+// #define MPC_STATIC_BUDGET        (128*1024)
+
+/* Define this for the flush-to-zero numerics of Matrix::Invers() & Matrix::QRDec(): the hardware FTZ/DAZ
+ *  mode is on while they run (see MatrixFlushToZero in matrix.h), and their inner loops don't round each
+ *  element below float_prec_ZERO to zero anymore (no branch, so they pipeline & vectorize). Instead, when
+ *  MATRIX_FTZ_CLEANUP is 1, one vRoundingMatrixToZero() pass cleans up the result afterward.
+ */
+// #define MATRIX_USE_FLUSH_TO_ZERO
+
+/* Define this to store each Matrix packed: the row i starts at element i*stride of one array, with the stride
+ *  the column count rounded up to MATRIX_PACKED_ALIGN bytes (and the array aligned to it), instead of the
+ *  MATRIX_MAXIMUM_SIZE stride. A small matrix then sits in consecutive cache lines (e.g. a 14x2 COMEGA is 28
+ *  consecutive floats, not 14 rows MATRIX_MAXIMUM_SIZE apart), and the constructions & copies only touch the
+ *  used rows. The array keeps the worst-case size (plus the padding), so sizeof(Matrix) doesn't shrink.
+ *  MATRIX_PACKED_ALIGN of 16, 32 or 64 pads each row for the SIMD loads; the default (sizeof(float_prec))
+ *  doesn't pad. 64 changes how gcc passes a Matrix by value (the -Wpsabi note), which is harmless here.
+ */
+// #define MATRIX_USE_PACKED_STORAGE
+// #define MATRIX_PACKED_ALIGN      (32)
 
 
 /* Change this size based on the biggest matrix you will use */
-#define MATRIX_MAXIMUM_SIZE     (28)
+#ifndef MATRIX_MAXIMUM_SIZE
+    #define MATRIX_MAXIMUM_SIZE     (28)
+#endif
 
 /* Define this to enable matrix bound checking */
 #define MATRIX_USE_BOUND_CHECKING
@@ -37,7 +145,9 @@
 /* Set this define to choose math precision of the system */
 #define PRECISION_SINGLE    1
 #define PRECISION_DOUBLE    2
-#define FPU_PRECISION       (PRECISION_SINGLE)
+#ifndef FPU_PRECISION
+    #define FPU_PRECISION       (PRECISION_SINGLE)
+#endif
 
 #if (FPU_PRECISION == PRECISION_SINGLE)
     #define float_prec          float
@@ -58,7 +168,9 @@
 #define SYSTEM_IMPLEMENTATION_EMBEDDED_NO_PRINT     2
 #define SYSTEM_IMPLEMENTATION_EMBEDDED_ARDUINO      3
 
-#define SYSTEM_IMPLEMENTATION                       (SYSTEM_IMPLEMENTATION_EMBEDDED_ARDUINO)
+#ifndef SYSTEM_IMPLEMENTATION
+    #define SYSTEM_IMPLEMENTATION                       (SYSTEM_IMPLEMENTATION_EMBEDDED_ARDUINO)
+#endif
 
 
 
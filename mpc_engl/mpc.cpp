@@ -6,17 +6,34 @@
  *          z(k)    = C*x(k)            ; z = Zx1
  *
  *
- ** Calculate prediction of z(k+1..k+Hp) constants ************************************************
+ ** Calculate prediction of z(k+T(1)..k+T(Hc)) constants ******************************************
  *
- *      Prediction of state variable of the system:
- *        z(k+1..k+Hp) = (CPSI)*x(k) + (COMEGA)*u(k-1) + (CTHETA)*dU(k..k+Hu-1)         ...{MPC_1}
+ *      The Hp prediction steps lie on a (possibly non-uniform) time grid: the first segment of
+ *      the grid steps with m(1)*dt, the next with m(2)*dt, and so on (see MPC_GRID_SEGMENTS).
+ *      t(s) is the time of the prediction step s (in dt) and T(j) = t(P(j)) is the time of
+ *      the coincidence points P(1) < .. < P(Hc) <= Hp.
+ *
+ *      Prediction of state variable of the system at the coincidence points:
+ *        z(k+T(1)..k+T(Hc)) = (CPSI)*x(k) + (COMEGA)*u(k-1) + (CTHETA)*dU(k..k+Hu-1)   ...{MPC_1}
  *
  *        Constants:
- *          CPSI   = [CA C(A^2) ... C(A^Hp)]'                                       : (Hp*N)xN
- *          COMEGA = [CB C(B+A*B) ... C*Sigma(i=0->Hp-1)A^i*B]'                     : (Hp*N)xM
+ *          CPSI   = [C(A^T(1)) C(A^T(2)) ... C(A^T(Hc))]'                          : (Hc*N)xN
+ *          COMEGA = [C*S(T(1)) C*S(T(2)) ... C*S(T(Hc))]'                          : (Hc*N)xM
+ *          CTHETA = [C*S(T(1))    C*S(T(1)-1)  ....  C*S(T(1)-Hu+1) ]
+ *                   [C*S(T(2))    C*S(T(2)-1)  ....  C*S(T(2)-Hu+1) ]
+ *                   [    .             .         .         .        ]              : (Hc*N)x(Hu*M)
+ *                   [C*S(T(Hc))   C*S(T(Hc)-1) ....  C*S(T(Hc)-Hu+1)]
+ *
+ *          S(s)   = Sigma(i=0->s-1)A^i*B  ; S(s) = 0 for s <= 0
+ *
+ *        The control moves dU(k..k+Hu-1) are still spaced dt apart.
+ *
+ *        With one grid segment of dt and P = {1, 2, .., Hp} these are the full prediction matrices:
+ *          CPSI   = [CA C(A^2) ... C(A^Hp)]'
+ *          COMEGA = [CB C(B+A*B) ... C*Sigma(i=0->Hp-1)A^i*B]'
  *          CTHETA = [         CB                0  ....           0              ]
  *                   [       C(B+A*B)           CB   .             0              ]
- *                   [           .               .    .           CB              ] : (Hp*N)x(Hu*M)
+ *                   [           .               .    .           CB              ]
  *                   [           .               .     .           .              ]
  *                   [C*Sigma(i=0->Hp-1)(A^i*B)  .  ....  C*Sigma(i=0->Hp-Hu)A^i*B]
  *
@@ -57,24 +74,189 @@
  *              u(k) = u(k-1) + du(k)                                                   ...{MPC_6}
  *
  *        Variables:
- *          SP(k) = Set Point vector at time-k              : (Hp*N) x 1
+ *          SP(k) = Set Point vector at the coincidence points: (Hc*N) x 1
  *          x(k)  = State Variables at time-k               : N x 1
  *          u(k)  = Input plant at time-k                   : M x 1
- *          Q     = Weight matrix for set-point deviation   : Hp x Hp
+ *          Q     = Weight matrix for set-point deviation   : Hc x Hc
  *          R     = Weight matrix for control signal change : Hu x Hu
  * 
  * 
  * See https://github.com/pronenewbits for more!
  *************************************************************************************************/
+#include <string.h>
 #include "mpc.h"
+#include "budget.h"
+
+
+#if defined(MPC_USE_ITERATIVE_REFINEMENT)
+/* max|v[i]| of a vector, the norm of the refinement convergence test */
+static float_prec fRefineNormMax(const float_prec * _vec, const int32_t _len)
+{
+    float_prec _max = 0;
+    for (int32_t _i = 0; _i < _len; _i++) {
+        const float_prec _abs = (_vec[_i] < 0) ? -_vec[_i] : _vec[_i];
+        _max = (_abs > _max) ? _abs : _max;
+    }
+    return _max;
+}
+#endif
+
+#if defined(MPC_USE_REINIT_WORKSPACE)
+/* The workspace of vReInit() when the caller doesn't give one, shared by all the instances */
+static float_prec f32ReInitWorkspace[MPC_REINIT_WORKSPACE_LEN];
+
+/* _dst = _add + _a*_b on the raw workspace arrays (row-major, the row stride is the column count), with
+ *  _a: X x X and _b, _add: X x _col (_add may be NULL). The product goes through _tmp (X x _col), so _dst
+ *  can be one of the operands.
+ */
+static void vWorkspaceMulAdd(float_prec * _dst, const float_prec * _add, const float_prec * _a, const float_prec * _b,
+                             const int32_t _col, float_prec * _tmp)
+{
+    for (int32_t _i = 0; _i < SS_X_LEN; _i++) {
+        for (int32_t _j = 0; _j < _col; _j++) {
+            float_prec _sum = 0;
+            for (int32_t _k = 0; _k < SS_X_LEN; _k++) {
+                _sum += _a[(_i*SS_X_LEN) + _k] * _b[(_k*_col) + _j];
+            }
+            _tmp[(_i*_col) + _j] = (_add == NULL) ? _sum : (_add[(_i*_col) + _j] + _sum);
+        }
+    }
+    memcpy(_dst, _tmp, size_t(SS_X_LEN*_col) * sizeof(float_prec));
+}
+
+/* _dst(_row:_row+Z, _col:_col+_len) = C*_b, with _b: X x _len on the workspace */
+static void vWorkspaceInsertC(Matrix &_dst, const int32_t _row, const int32_t _col, Matrix &C, const float_prec * _b,
+                              const int32_t _len)
+{
+    for (int32_t _i = 0; _i < SS_Z_LEN; _i++) {
+        const float_prec * const _cRow = C.pRowUnchecked(_i);
+        float_prec * const _dstRow = _dst.pRowUnchecked(_row + _i);
+        for (int32_t _j = 0; _j < _len; _j++) {
+            float_prec _sum = 0;
+            for (int32_t _k = 0; _k < SS_X_LEN; _k++) {
+                _sum += _cRow[_k] * _b[(_k*_len) + _j];
+            }
+            _dstRow[_col + _j] = _sum;
+        }
+    }
+}
+#endif
+
+#if defined(MPC_USE_UPDATE_WORKSPACE)
+/* The workspace of bUpdate() when the caller doesn't give one, shared by all the instances */
+static float_prec f32UpdateWorkspace[MPC_UPDATE_WORKSPACE_LEN];
+
+/* _inv = _A^-1 (_n x _n, row-major) with the Gauss-Jordan of Matrix::Invers(), step by step the same (so
+ *  bit-exact), on _temp instead of its copy of _A. Returns false if _A isn't invertible.
+ */
+static bool bWorkspaceInvers(const float_prec * _A, float_prec * _temp, float_prec * _inv, const int32_t _n)
+{
+#if defined(MATRIX_USE_FLUSH_TO_ZERO)
+    MatrixFlushToZero _ftz;
+#endif
+    for (int32_t _i = 0; _i < (_n*_n); _i++) {
+        _temp[_i] = _A[_i];
+        _inv[_i]  = ((_i / _n) == (_i % _n)) ? float_prec(1.0) : float_prec(0.0);
+    }
+    
+    /* Gauss Elimination... */
+    for (int32_t _j = 0; _j < (_n-1); _j++) {
+        for (int32_t _i = _j+1; _i < _n; _i++) {
+            if (fabs(_temp[(_j*_n) + _j]) < float_prec(float_prec_ZERO)) {
+                return false;
+            }
+            const float_prec _tempfloat = _temp[(_i*_n) + _j] / _temp[(_j*_n) + _j];
+            for (int32_t _k = 0; _k < _n; _k++) {
+                _temp[(_i*_n) + _k] -= (_temp[(_j*_n) + _k] * _tempfloat);
+                _inv[(_i*_n) + _k]  -= (_inv[(_j*_n) + _k] * _tempfloat);
+            #if !defined(MATRIX_USE_FLUSH_TO_ZERO)
+                if (fabs(_temp[(_i*_n) + _k]) < float_prec(float_prec_ZERO)) {
+                    _temp[(_i*_n) + _k] = 0.0;
+                }
+                if (fabs(_inv[(_i*_n) + _k]) < float_prec(float_prec_ZERO)) {
+                    _inv[(_i*_n) + _k] = 0.0;
+                }
+            #endif
+            }
+        }
+    }
+    for (int32_t _i = 1; _i < _n; _i++) {
+        for (int32_t _j = 0; _j < _i; _j++) {
+            _temp[(_i*_n) + _j] = 0.0;
+        }
+    }
+    
+    /* Jordan... */
+    for (int32_t _j = _n-1; _j > 0; _j--) {
+        for (int32_t _i = _j-1; _i >= 0; _i--) {
+            if (fabs(_temp[(_j*_n) + _j]) < float_prec(float_prec_ZERO)) {
+                return false;
+            }
+            const float_prec _tempfloat = _temp[(_i*_n) + _j] / _temp[(_j*_n) + _j];
+            _temp[(_i*_n) + _j] -= (_temp[(_j*_n) + _j] * _tempfloat);
+        #if defined(MATRIX_USE_FLUSH_TO_ZERO)
+            for (int32_t _k = 0; _k < _n; _k++) {
+                _inv[(_i*_n) + _k] -= (_inv[(_j*_n) + _k] * _tempfloat);
+            }
+        #else
+            if (fabs(_temp[(_i*_n) + _j]) < float_prec(float_prec_ZERO)) {
+                _temp[(_i*_n) + _j] = 0.0;
+            }
+            for (int32_t _k = (_n-1); _k >= 0; _k--) {
+                _inv[(_i*_n) + _k] -= (_inv[(_j*_n) + _k] * _tempfloat);
+                if (fabs(_inv[(_i*_n) + _k]) < float_prec(float_prec_ZERO)) {
+                    _inv[(_i*_n) + _k] = 0.0;
+                }
+            }
+        #endif
+        }
+    }
+    
+    /* Normalization */
+    for (int32_t _i = 0; _i < _n; _i++) {
+        if (fabs(_temp[(_i*_n) + _i]) < float_prec(float_prec_ZERO)) {
+            return false;
+        }
+        const float_prec _tempfloat = _temp[(_i*_n) + _i];
+        _temp[(_i*_n) + _i] = 1.0;
+        for (int32_t _j = 0; _j < _n; _j++) {
+            _inv[(_i*_n) + _j] /= _tempfloat;
+        }
+    }
+#if defined(MATRIX_USE_FLUSH_TO_ZERO) && (MATRIX_FTZ_CLEANUP)
+    for (int32_t _i = 0; _i < (_n*_n); _i++) {
+        if (fabs(_inv[_i]) < float_prec(float_prec_ZERO)) {
+            _inv[_i] = 0.0;
+        }
+    }
+#endif
+    return true;
+}
+#endif
 
 
 MPC::MPC(Matrix &A, Matrix &B, Matrix &C, float_prec _bobotQ, float_prec _bobotR)
 {
+#if defined(MPC_USE_PHASE_PROFILING)
+    vProfileCounterInit();
+    vResetPhaseStat();
+#endif
+#if defined(MPC_USE_ITERATIVE_REFINEMENT)
+    i32RefineIteration = 0;
+#endif
     vReInit(A, B, C, _bobotQ, _bobotR);
 }
 
+#if defined(MPC_USE_REINIT_WORKSPACE)
 void MPC::vReInit(Matrix &A, Matrix &B, Matrix &C, float_prec _bobotQ, float_prec _bobotR)
+{
+    vReInit(A, B, C, _bobotQ, _bobotR, f32ReInitWorkspace);
+}
+
+void MPC::vReInit(Matrix &A, Matrix &B, Matrix &C, float_prec _bobotQ, float_prec _bobotR, float_prec * _workspace)
+#else
+void MPC::vReInit(Matrix &A, Matrix &B, Matrix &C, float_prec _bobotQ, float_prec _bobotR)
+#endif
 {
     this->A = A;
     this->B = B;
@@ -82,94 +264,455 @@ void MPC::vReInit(Matrix &A, Matrix &B, Matrix &C, float_prec _bobotQ, float_pre
     Q.vSetDiag(_bobotQ);
     R.vSetDiag(_bobotR);
 
-    /*  Calculate prediction of z(k+1..k+Hp) constants
+    /*  Calculate prediction of z(k+T(1)..k+T(Hc)) constants
      *
-     *      Prediction of state variable of the system:
-     *        z(k+1..k+Hp) = (CPSI)*x(k) + (COMEGA)*u(k-1) + (CTHETA)*dU(k..k+Hu-1)         ...{MPC_1}
+     *      Prediction of state variable of the system at the coincidence points:
+     *        z(k+T(1)..k+T(Hc)) = (CPSI)*x(k) + (COMEGA)*u(k-1) + (CTHETA)*dU(k..k+Hu-1)   ...{MPC_1}
      *
      *        Constants:
-     *          CPSI   = [CA C(A^2) ... C(A^Hp)]'                                       : (Hp*N)xN
-     *          COMEGA = [CB C(B+A*B) ... C*Sigma(i=0->Hp-1)A^i*B]'                     : (Hp*N)xM
-     *          CTHETA = [         CB                0  ....           0              ]
-     *                   [       C(B+A*B)           CB   .             0              ]
-     *                   [           .               .    .           CB              ] : (Hp*N)x(Hu*M)
-     *                   [           .               .     .           .              ]
-     *                   [C*Sigma(i=0->Hp-1)(A^i*B)  .  ....  C*Sigma(i=0->Hp-Hu)A^i*B]
+     *          CPSI   = [C(A^T(1)) C(A^T(2)) ... C(A^T(Hc))]'                          : (Hc*N)xN
+     *          COMEGA = [C*S(T(1)) C*S(T(2)) ... C*S(T(Hc))]'                          : (Hc*N)xM
+     *          CTHETA = [C*S(T(1))    C*S(T(1)-1)  ....  C*S(T(1)-Hu+1) ]
+     *                   [C*S(T(2))    C*S(T(2)-1)  ....  C*S(T(2)-Hu+1) ]
+     *                   [    .             .         .         .        ]              : (Hc*N)x(Hu*M)
+     *                   [C*S(T(Hc))   C*S(T(Hc)-1) ....  C*S(T(Hc)-Hu+1)]
+     *
+     *          S(s)   = Sigma(i=0->s-1)A^i*B  ; S(s) = 0 for s <= 0
+     *
+     *  Each grid segment with step m*dt is discretized once into (A^m, S(m)), then we walk
+     *  the Hp prediction steps with it:
+     *          A^(t+m) = A^m * A^t
+     *          S(t+m)  = S(m) + A^m * S(t)
+     *
+     *  The same update walks S(t-c) of the CTHETA columns 0 < c < Hu along, once t >= c (before
+     *  that S(t-c) = 0). Inside a segment with m > 1, the first S(t+m-c) with 0 < t+m-c < m comes
+     *  from vCalculatePowerSigma() instead. Only the blocks that land on a coincidence point are
+     *  inserted (the matrices are built row-sparse: the rows of the prediction steps that are not
+     *  evaluated are never stored).
      *
+     *  With MPC_USE_REINIT_WORKSPACE the same steps run on the raw arrays of the workspace.
      */
+    MPC_PROFILE_BEGIN(1);
+#if defined(MPC_USE_REINIT_WORKSPACE)
+    vCalculatePrediction(_workspace);
+#else
+    /* Counted in MPC_STACK_REINIT_BYTES (mpc.h), change it with the Matrix objects below */
+    const int32_t _P[MPC_HC_LEN] = MPC_COINCIDENCE_POINTS;
+    const int32_t _G[MPC_GRID_SEGMENT_LEN][2] = MPC_GRID_SEGMENTS;
     Matrix _Apow(SS_X_LEN, SS_X_LEN);
-    /* CPSI     : [ C *   A  ]
-     *            [ C *  A^2 ]
-     *            [     .    ]                                                   : (Hp*N) x N
-     *            [     .    ]
-     *            [ C * A^Hp ]
-     */
-    _Apow = A;
-    for (int32_t _i = 0; _i < MPC_HP_LEN; _i++) {
-        CPSI = CPSI.InsertSubMatrix((C*_Apow), _i*SS_Z_LEN, 0);
-        _Apow = _Apow * A;
+    Matrix _Sigma(SS_X_LEN, (MPC_HU_LEN*SS_U_LEN));
+    Matrix _Aseg(SS_X_LEN, SS_X_LEN);
+    Matrix _Sseg(SS_X_LEN, SS_U_LEN);
+    Matrix _Atheta(SS_X_LEN, SS_X_LEN);
+    Matrix _Stheta(SS_X_LEN, SS_U_LEN);
+    float_prec _col[SS_X_LEN];
+    
+    int32_t _s = 0;         /* Prediction step */
+    int32_t _t = 0;         /* Time of the prediction step (in dt) */
+    int32_t _j = 0;         /* Next coincidence point */
+    _Apow.vSetIdentity();   /* A^t */
+    _Sigma.vSetToZero();    /* [S(t) S(t-1) .. S(t-Hu+1)] */
+    for (int32_t _g = 0; _g < MPC_GRID_SEGMENT_LEN; _g++) {
+        /* Discretize the segment: (A^m, S(m)) */
+        vCalculatePowerSigma(_G[_g][1], _Aseg, _Sseg);
+        
+        for (int32_t _n = 0; _n < _G[_g][0]; _n++) {
+            for (int32_t _c = 0; _c < MPC_HU_LEN; _c++) {
+                if (_t >= _c) {
+                    /* S(t+m-c) = S(m) + A^m * S(t-c), column by column */
+                    for (int32_t _k = (_c*SS_U_LEN); _k < ((_c+1)*SS_U_LEN); _k++) {
+                        for (int32_t _i = 0; _i < SS_X_LEN; _i++) {
+                            float_prec _sum = 0.0;
+                            for (int32_t _l = 0; _l < SS_X_LEN; _l++) {
+                                _sum += (_Aseg[_i][_l] * _Sigma[_l][_k]);
+                            }
+                            _col[_i] = _Sseg[_i][_k - (_c*SS_U_LEN)] + _sum;
+                        }
+                        for (int32_t _i = 0; _i < SS_X_LEN; _i++) {
+                            _Sigma[_i][_k] = _col[_i];
+                        }
+                    }
+                } else if ((_t + _G[_g][1]) > _c) {
+                    /* The first step past c inside a segment: S(t+m-c) with 0 < t+m-c < m */
+                    vCalculatePowerSigma(_t + _G[_g][1] - _c, _Atheta, _Stheta);
+                    _Sigma = _Sigma.InsertSubMatrix(_Stheta, 0, _c*SS_U_LEN);
+                }
+            }
+            _Apow = _Aseg * _Apow;
+            _t += _G[_g][1];
+            _s++;
+            
+            if ((_j >= MPC_HC_LEN) || (_P[_j] != _s)) {
+                continue;
+            }
+            i32CoincidenceTime[_j] = _t;
+            
+            /* CTHETA(j, c) = C*S(T(j)-c) ; CPSI(j) = C*A^T(j) ; COMEGA(j) = CTHETA(j, 0) = C*S(T(j)) */
+            CTHETA = CTHETA.InsertSubMatrix((C*_Sigma), _j*SS_Z_LEN, 0);
+            CPSI   = CPSI.InsertSubMatrix((C*_Apow), _j*SS_Z_LEN, 0);
+            COMEGA = COMEGA.InsertSubMatrix(CTHETA, _j*SS_Z_LEN, 0, _j*SS_Z_LEN, 0, SS_Z_LEN, SS_U_LEN);
+            _j++;
+        }
+    }
+    ASSERT((_s == MPC_HP_LEN) && (_j == MPC_HC_LEN), "The MPC_GRID_SEGMENTS or MPC_COINCIDENCE_POINTS don't match MPC_HP_LEN / MPC_HC_LEN");
+#endif
+    MPC_PROFILE_END(1);
+}
+
+#if defined(MPC_USE_PHASE_PROFILING)
+void MPC::vResetPhaseStat()
+{
+    for (int32_t _i = 0; _i < MPC_PHASE_LEN; _i++) {
+        vProfileReset(PhaseStat[_i]);
     }
+}
+#endif
+
+/*  Calculate A^n and S(n) = Sigma(i=0->n-1)A^i*B by repeated squaring, using:
+ *          A^(a+b) = A^a * A^b
+ *          S(a+b)  = S(a) + A^a * S(b)
+ */
+void MPC::vCalculatePowerSigma(int32_t _n, Matrix &_Apow, Matrix &_Sigma)
+{
+    /* Counted in MPC_STACK_POWER_SIGMA (mpc.h), change it with the Matrix objects below */
+    Matrix _Asq(SS_X_LEN, SS_X_LEN);
+    Matrix _Ssq(SS_X_LEN, SS_U_LEN);
     
-    /* COMEGA   : [          C * (B)         ]
-     *            [        C * (B+A*B)       ]
-     *            [             .            ]                                   : (Hp*N) x M
-     *            [             .            ]
-     *            [ C * Sigma(i=0->Hp-1)A^i*B]
-     */
-    Matrix _tempSigma(SS_X_LEN, SS_U_LEN);
     _Apow.vSetIdentity();
-    _tempSigma = B;
-    for (int32_t _i = 0; _i < MPC_HP_LEN; _i++) {
-        COMEGA = COMEGA.InsertSubMatrix((C*_tempSigma), _i*SS_Z_LEN, 0);
-        _Apow = _Apow * A;
-        _tempSigma = _tempSigma + (_Apow*B);
-    }
-    
-    /* CTHETA   : [          C * (B)              0         ....              0             ]
-     *            [       C * (B+A*B)           C * (B)      .                0             ]
-     *            [            .                  .           .             C * (B)         ]: (Hp*N)x(Hu*M)
-     *            [            .                  .            .              .             ]
-     *            [C * Sigma(i=0->Hp-1)A^i*B      .         ....  C * Sigma(i=0->Hp-Hu)A^i*B]
-     *
-     *          : [COMEGA   [0 COMEGA(0:(len(COMEGA)-len(B)),:)]'  ....  [0..0 COMEGA(0:(len(COMEGA)-((Hp-Hu)*len(B))),:)]']
-     */
-    for (int32_t _i = 0; _i < MPC_HU_LEN; _i++) {
-        CTHETA = CTHETA.InsertSubMatrix(COMEGA, _i*SS_Z_LEN, _i*SS_U_LEN, (MPC_HP_LEN*SS_Z_LEN)-(_i*SS_Z_LEN), SS_U_LEN);
+    _Sigma.vSetToZero();
+    _Asq = A;
+    _Ssq = B;
+    while (_n > 0) {
+        if (_n & 1) {
+            _Sigma = _Ssq + (_Asq * _Sigma);
+            _Apow  = _Asq * _Apow;
+        }
+        _n >>= 1;
+        if (_n > 0) {
+            _Ssq = _Ssq + (_Asq * _Ssq);
+            _Asq = _Asq * _Asq;
+        }
+    }
+}
+
+#if defined(MPC_USE_REINIT_WORKSPACE)
+/* vCalculatePowerSigma() on the workspace arrays: _Apow (X x X) & _Sigma (X x U), with _workspace
+ *  holding the product, A^a & S(a) (MPC_REINIT_POWER_SIGMA_LEN elements)
+ */
+void MPC::vCalculatePowerSigma(int32_t _n, float_prec * _Apow, float_prec * _Sigma, float_prec * _workspace)
+{
+    float_prec * const _tmp = _workspace;
+    float_prec * const _Asq = _tmp + (SS_X_LEN*SS_X_LEN);
+    float_prec * const _Ssq = _Asq + (SS_X_LEN*SS_X_LEN);
+    
+    for (int32_t _i = 0; _i < SS_X_LEN; _i++) {
+        for (int32_t _j = 0; _j < SS_X_LEN; _j++) {
+            _Apow[(_i*SS_X_LEN) + _j] = (_i == _j) ? float_prec(1.0) : float_prec(0.0);
+            _Asq[(_i*SS_X_LEN) + _j]  = A[_i][_j];
+        }
+        for (int32_t _j = 0; _j < SS_U_LEN; _j++) {
+            _Sigma[(_i*SS_U_LEN) + _j] = 0;
+            _Ssq[(_i*SS_U_LEN) + _j]   = B[_i][_j];
+        }
+    }
+    while (_n > 0) {
+        if (_n & 1) {
+            vWorkspaceMulAdd(_Sigma, _Ssq, _Asq, _Sigma, SS_U_LEN, _tmp);
+            vWorkspaceMulAdd(_Apow, NULL, _Asq, _Apow, SS_X_LEN, _tmp);
+        }
+        _n >>= 1;
+        if (_n > 0) {
+            vWorkspaceMulAdd(_Ssq, _Ssq, _Asq, _Ssq, SS_U_LEN, _tmp);
+            vWorkspaceMulAdd(_Asq, NULL, _Asq, _Asq, SS_X_LEN, _tmp);
+        }
+    }
+}
+
+/* {MPC_1} of vReInit() on the workspace (MPC_REINIT_PREDICTION_LEN elements), see there */
+void MPC::vCalculatePrediction(float_prec * _workspace)
+{
+    const int32_t _P[MPC_HC_LEN] = MPC_COINCIDENCE_POINTS;
+    const int32_t _G[MPC_GRID_SEGMENT_LEN][2] = MPC_GRID_SEGMENTS;
+    float_prec * const _Apow    = _workspace;
+    float_prec * const _Aseg    = _Apow   + (SS_X_LEN*SS_X_LEN);
+    float_prec * const _Atheta  = _Aseg   + (SS_X_LEN*SS_X_LEN);
+    float_prec * const _Sseg    = _Atheta + (SS_X_LEN*SS_X_LEN);
+    float_prec * const _Sigma   = _Sseg   + (SS_X_LEN*SS_U_LEN);    /* S(t-c) at _Sigma + c*X*U, 0 <= c < Hu */
+    float_prec * const _scratch = _Sigma  + (MPC_HU_LEN*SS_X_LEN*SS_U_LEN);   /* vCalculatePowerSigma(), its first X*X for the products */
+    
+    int32_t _s = 0;         /* Prediction step */
+    int32_t _t = 0;         /* Time of the prediction step (in dt) */
+    int32_t _j = 0;         /* Next coincidence point */
+    for (int32_t _i = 0; _i < SS_X_LEN; _i++) {
+        for (int32_t _k = 0; _k < SS_X_LEN; _k++) {
+            _Apow[(_i*SS_X_LEN) + _k] = (_i == _k) ? float_prec(1.0) : float_prec(0.0);
+        }
+    }
+    for (int32_t _i = 0; _i < (MPC_HU_LEN*SS_X_LEN*SS_U_LEN); _i++) {
+        _Sigma[_i] = 0;
     }
+    for (int32_t _g = 0; _g < MPC_GRID_SEGMENT_LEN; _g++) {
+        vCalculatePowerSigma(_G[_g][1], _Aseg, _Sseg, _scratch);
+        
+        for (int32_t _n = 0; _n < _G[_g][0]; _n++) {
+            for (int32_t _c = 0; _c < MPC_HU_LEN; _c++) {
+                float_prec * const _Sc = _Sigma + (_c*SS_X_LEN*SS_U_LEN);
+                if (_t >= _c) {
+                    vWorkspaceMulAdd(_Sc, _Sseg, _Aseg, _Sc, SS_U_LEN, _scratch);
+                } else if ((_t + _G[_g][1]) > _c) {
+                    vCalculatePowerSigma(_t + _G[_g][1] - _c, _Atheta, _Sc, _scratch);
+                }
+            }
+            vWorkspaceMulAdd(_Apow, NULL, _Aseg, _Apow, SS_X_LEN, _scratch);
+            _t += _G[_g][1];
+            _s++;
+            
+            if ((_j >= MPC_HC_LEN) || (_P[_j] != _s)) {
+                continue;
+            }
+            i32CoincidenceTime[_j] = _t;
+            
+            vWorkspaceInsertC(CPSI, _j*SS_Z_LEN, 0, C, _Apow, SS_X_LEN);
+            vWorkspaceInsertC(COMEGA, _j*SS_Z_LEN, 0, C, _Sigma, SS_U_LEN);
+            for (int32_t _c = 0; _c < MPC_HU_LEN; _c++) {
+                vWorkspaceInsertC(CTHETA, _j*SS_Z_LEN, _c*SS_U_LEN, C, _Sigma + (_c*SS_X_LEN*SS_U_LEN), SS_U_LEN);
+            }
+            _j++;
+        }
+    }
+    ASSERT((_s == MPC_HP_LEN) && (_j == MPC_HC_LEN), "The MPC_GRID_SEGMENTS or MPC_COINCIDENCE_POINTS don't match MPC_HP_LEN / MPC_HC_LEN");
+}
+#endif
+
+#if defined(MPC_USE_ITERATIVE_REFINEMENT)
+/* The residual 0.5*G - H*dU(k) of {MPC_5a} for the iterative refinement, summed in double from what H & G
+ *  are made of (not from H & G, they're already rounded to float_prec):
+ *
+ *      r = CTHETA'*Q*(E(k) - CTHETA*dU(k)) - R*dU(k)  ;  E(k) = SP(k) - CPSI*x(k) - COMEGA*u(k-1)
+ *
+ *  with the (diagonal) Q of vReInit(). Rounded to float_prec in _res.
+ */
+void MPC::vRefineResidual(Matrix &SP, Matrix &x, Matrix &u, const float_prec * _du, float_prec * _res)
+{
+    double _r[MPC_HU_LEN*SS_U_LEN];
+    for (int32_t _i = 0; _i < (MPC_HU_LEN*SS_U_LEN); _i++) {
+        const float_prec * const _rRow = R.pRowUnchecked(_i);
+        _r[_i] = 0.0;
+        for (int32_t _j = 0; _j < (MPC_HU_LEN*SS_U_LEN); _j++) {
+            _r[_i] -= double(_rRow[_j]) * double(_du[_j]);
+        }
+    }
+    for (int32_t _k = 0; _k < (MPC_HC_LEN*SS_Z_LEN); _k++) {
+        const float_prec * const _psi = CPSI.pRowUnchecked(_k);
+        const float_prec * const _omega = COMEGA.pRowUnchecked(_k);
+        const float_prec * const _theta = CTHETA.pRowUnchecked(_k);
+        double _e = double(SP.pRowUnchecked(_k)[0]);
+        for (int32_t _j = 0; _j < SS_X_LEN; _j++) {
+            _e -= double(_psi[_j]) * double(x.pRowUnchecked(_j)[0]);
+        }
+        for (int32_t _j = 0; _j < SS_U_LEN; _j++) {
+            _e -= double(_omega[_j]) * double(u.pRowUnchecked(_j)[0]);
+        }
+        for (int32_t _j = 0; _j < (MPC_HU_LEN*SS_U_LEN); _j++) {
+            _e -= double(_theta[_j]) * double(_du[_j]);
+        }
+        _e *= double(Q.pRowUnchecked(_k)[_k]);
+        for (int32_t _i = 0; _i < (MPC_HU_LEN*SS_U_LEN); _i++) {
+            _r[_i] += double(_theta[_i]) * _e;
+        }
+    }
+    for (int32_t _i = 0; _i < (MPC_HU_LEN*SS_U_LEN); _i++) {
+        _res[_i] = float_prec(_r[_i]);
+    }
+}
+#endif
+
+#if defined(MPC_USE_UPDATE_WORKSPACE)
+bool MPC::bUpdate(Matrix &SP, Matrix &x, Matrix &u)
+{
+    return bUpdate(SP, x, u, f32UpdateWorkspace);
 }
 
+/* bUpdate() on the raw arrays of the workspace: the same {MPC_2}..{MPC_6} in the same order (so the same
+ *  du(k) as the Matrix one), with the (diagonal) Q & R of vReInit()
+ */
+bool MPC::bUpdate(Matrix &SP, Matrix &x, Matrix &u, float_prec * _workspace)
+{
+    const int32_t _n = (MPC_HU_LEN*SS_U_LEN);
+    float_prec * const _err   = _workspace;
+    float_prec * const _G     = _err + (MPC_HC_LEN*SS_Z_LEN);
+    float_prec * const _H     = _G + _n;
+    float_prec * const _Hinv  = _H + (_n*_n);
+    float_prec * const _du    = _Hinv + (_n*_n);
+    float_prec * const _res   = _du + _n;
+    float_prec * const _corr  = _res + _n;
+    
+    /*  E(k) = SP(k) - CPSI*x(k) - COMEGA*u(k-1)                                        ...{MPC_2} */
+    MPC_PROFILE_BEGIN(2);
+    for (int32_t _i = 0; _i < (MPC_HC_LEN*SS_Z_LEN); _i++) {
+        float_prec _psi = 0;
+        float_prec _omega = 0;
+        for (int32_t _j = 0; _j < SS_X_LEN; _j++) {
+            _psi += CPSI[_i][_j] * x[_j][0];
+        }
+        for (int32_t _j = 0; _j < SS_U_LEN; _j++) {
+            _omega += COMEGA[_i][_j] * u[_j][0];
+        }
+        _err[_i] = SP[_i][0] - _psi - _omega;
+    }
+    MPC_PROFILE_END(2);
+    
+    /*  G = 2*CTHETA'*Q*E(k)                                                            ...{MPC_3} */
+    MPC_PROFILE_BEGIN(3);
+    for (int32_t _i = 0; _i < _n; _i++) {
+        float_prec _sum = 0;
+        for (int32_t _k = 0; _k < (MPC_HC_LEN*SS_Z_LEN); _k++) {
+            _sum += CTHETA[_k][_i] * Q[_k][_k] * _err[_k];
+        }
+        _G[_i] = float_prec(2.0) * _sum;
+    }
+    MPC_PROFILE_END(3);
+    
+    /*  H = CTHETA'*Q*CTHETA + R                                                        ...{MPC_4}
+     *  (both triangles: (CTHETA'*Q)*CTHETA rounds H(i,j) & H(j,i) differently)
+     */
+    MPC_PROFILE_BEGIN(4);
+    for (int32_t _i = 0; _i < _n; _i++) {
+        for (int32_t _j = 0; _j < _n; _j++) {
+            float_prec _sum = 0;
+            for (int32_t _k = 0; _k < (MPC_HC_LEN*SS_Z_LEN); _k++) {
+                _sum += CTHETA[_k][_i] * Q[_k][_k] * CTHETA[_k][_j];
+            }
+            _H[(_i*_n) + _j] = _sum + R[_i][_j];
+        }
+    }
+    MPC_PROFILE_END(4);
+    
+    /*  --> dU(k)_optimal = 1/2 * H^-1 * G                                              ...{MPC_5a} */
+    MPC_PROFILE_BEGIN(5);
+    /* H itself is the Gauss-Jordan copy, it isn't needed after */
+    if (!bWorkspaceInvers(_H, _H, _Hinv, _n)) {
+        MPC_PROFILE_END(5);
+        
+        return false;
+    }
+    for (int32_t _i = 0; _i < _n; _i++) {
+        float_prec _sum = 0;
+        for (int32_t _j = 0; _j < _n; _j++) {
+            _sum += _Hinv[(_i*_n) + _j] * _G[_j];
+        }
+        _du[_i] = _sum * float_prec(0.5);
+    }
+    #if defined(MPC_USE_ITERATIVE_REFINEMENT)
+        /*  Iterative refinement: dU(k) += H^-1 * r, with the residual r of vRefineResidual() */
+        for (i32RefineIteration = 0; i32RefineIteration < MPC_REFINE_MAX_ITER; ) {
+            vRefineResidual(SP, x, u, _du, _res);
+            for (int32_t _i = 0; _i < _n; _i++) {
+                float_prec _sum = 0;
+                for (int32_t _j = 0; _j < _n; _j++) {
+                    _sum += _Hinv[(_i*_n) + _j] * _res[_j];
+                }
+                _corr[_i] = _sum;
+            }
+            for (int32_t _i = 0; _i < _n; _i++) {
+                _du[_i] = _du[_i] + _corr[_i];
+            }
+            i32RefineIteration++;
+            if (fRefineNormMax(_corr, _n) <= (float_prec(MPC_REFINE_TOLERANCE) * fRefineNormMax(_du, _n))) {
+                break;
+            }
+        }
+    #else
+        (void) _res;
+        (void) _corr;
+    #endif
+    MPC_PROFILE_END(5);
+    
+    /*  u(k) = u(k-1) + du(k)                                                           ...{MPC_6} */
+    MPC_PROFILE_BEGIN(6);
+    for (int32_t _i = 0; _i < SS_U_LEN; _i++) {
+        u[_i][0] = u[_i][0] + _du[_i];
+    }
+    MPC_PROFILE_END(6);
+    
+    return true;
+}
+#else
 bool MPC::bUpdate(Matrix &SP, Matrix &x, Matrix &u)
 {
-    Matrix Err((MPC_HP_LEN*SS_Z_LEN), 1);
+    /* Counted in MPC_STACK_UPDATE_BYTES (mpc.h), change it with the Matrix objects below */
+    Matrix Err((MPC_HC_LEN*SS_Z_LEN), 1);
     Matrix G((MPC_HU_LEN*SS_U_LEN), 1);
     Matrix H((MPC_HU_LEN*SS_U_LEN), (MPC_HU_LEN*SS_U_LEN));
     
     /*  E(k) = SP(k) - CPSI*x(k) - COMEGA*u(k-1)                                        ...{MPC_2} */
+    MPC_PROFILE_BEGIN(2);
     Err = SP - CPSI*x - COMEGA*u;
+    MPC_PROFILE_END(2);
     
     /*  G = 2*CTHETA'*Q*E(k)                                                            ...{MPC_3} */
-    G = 2.0 * (CTHETA.Transpose()) * Q * Err;
+    MPC_PROFILE_BEGIN(3);
+    G = 2.0 * ((CTHETA.Transpose()) * Q) * Err;
+    MPC_PROFILE_END(3);
     
     /*  H = CTHETA'*Q*CTHETA + R                                                        ...{MPC_4} */
+    MPC_PROFILE_BEGIN(4);
     H = ((CTHETA.Transpose()) * Q * CTHETA) + R;
+    MPC_PROFILE_END(4);
     
     /*  --> dU(k)_optimal = 1/2 * H^-1 * G                                              ...{MPC_5a} */
+    MPC_PROFILE_BEGIN(5);
     Matrix H_inv = H.Invers();
     if (!H_inv.bMatrixIsValid()) {
         /* return false; */
         DU.vSetToZero();
+        MPC_PROFILE_END(5);
         
         return false;
     } else {
         DU = (H_inv) * G * 0.5;
+    #if defined(MPC_USE_ITERATIVE_REFINEMENT)
+        /*  Iterative refinement: dU(k) += H^-1 * r, with the residual r of vRefineResidual() */
+        float_prec _du[MPC_HU_LEN*SS_U_LEN];
+        float_prec _res[MPC_HU_LEN*SS_U_LEN];
+        float_prec _corr[MPC_HU_LEN*SS_U_LEN];
+        for (int32_t _i = 0; _i < (MPC_HU_LEN*SS_U_LEN); _i++) {
+            _du[_i] = DU[_i][0];
+        }
+        for (i32RefineIteration = 0; i32RefineIteration < MPC_REFINE_MAX_ITER; ) {
+            vRefineResidual(SP, x, u, _du, _res);
+            for (int32_t _i = 0; _i < (MPC_HU_LEN*SS_U_LEN); _i++) {
+                const float_prec * const _hRow = H_inv.pRowUnchecked(_i);
+                float_prec _sum = 0;
+                for (int32_t _j = 0; _j < (MPC_HU_LEN*SS_U_LEN); _j++) {
+                    _sum += _hRow[_j] * _res[_j];
+                }
+                _corr[_i] = _sum;
+            }
+            for (int32_t _i = 0; _i < (MPC_HU_LEN*SS_U_LEN); _i++) {
+                _du[_i] = _du[_i] + _corr[_i];
+            }
+            i32RefineIteration++;
+            if (fRefineNormMax(_corr, (MPC_HU_LEN*SS_U_LEN)) <= (float_prec(MPC_REFINE_TOLERANCE) * fRefineNormMax(_du, (MPC_HU_LEN*SS_U_LEN)))) {
+                break;
+            }
+        }
+        for (int32_t _i = 0; _i < (MPC_HU_LEN*SS_U_LEN); _i++) {
+            DU[_i][0] = _du[_i];
+        }
+    #endif
     }
+    MPC_PROFILE_END(5);
     
     /*  u(k) = u(k-1) + du(k)                                                           ...{MPC_6} */
+    MPC_PROFILE_BEGIN(6);
     Matrix DU_Out(SS_U_LEN, 1);
     for (int32_t _i = 0; _i < SS_U_LEN; _i++) {
         DU_Out[_i][0] = DU[_i][0];
     }
     u = u + DU_Out;
+    MPC_PROFILE_END(6);
     
     return true;
 }
+#endif
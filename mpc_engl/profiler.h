@@ -0,0 +1,125 @@
+/**************************************************************************************************
+ * Per-phase profiling of the MPC calculation (enabled with MPC_USE_PHASE_PROFILING in konfig.h).
+ *
+ *  The MPC code wraps each numbered equation ({MPC_n} in mpc.cpp) with:
+ *
+ *      MPC_PROFILE_BEGIN(n);
+ *          ... the {MPC_n} calculation ...
+ *      MPC_PROFILE_END(n);
+ *
+ *  which accumulates the counter ticks of the phase into MPC::PhaseStat[n-1] (number of samples,
+ *  min, max, and sum for the mean). When MPC_USE_PHASE_PROFILING is not defined, both macros are
+ *  empty and there's no PhaseStat member, so the profiling costs nothing.
+ *
+ *  The tick counter (MPC_PROFILE_COUNTER(), 32 bit, wrap-around safe for phases shorter than
+ *  2^32 ticks):
+ *      - Defined by the user before this file is included (e.g. -DMPC_PROFILE_COUNTER=myCounter).
+ *      - Cortex-M3/M4/M7 (e.g. Teensy 4.0)  : DWT CYCCNT, in CPU cycles.
+ *      - x86                                : rdtsc, in time stamp counter cycles.
+ *      - Other PC (Linux)                   : clock_gettime(CLOCK_MONOTONIC), in nanoseconds.
+ *      - Other Arduino                      : micros(), in microseconds.
+ *
+ *  Mirrored in mpc_engl, mpc_opt_engl & mpc_least_square_engl (each sketch folder needs its own copy):
+ *  edit one, then copy it over the others. The CMake configure fails when the copies differ.
+ *
+ *
+ * See https://github.com/pronenewbits for more!
+ *************************************************************************************************/
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include "konfig.h"
+
+
+#if defined(MPC_USE_PHASE_PROFILING)
+
+/* The number of profiled phases, one for each {MPC_n} label ({MPC_1}..{MPC_7}) */
+#define MPC_PHASE_LEN   (7)
+
+typedef struct {
+    uint32_t u32count;
+    uint32_t u32min;
+    uint32_t u32max;
+    uint64_t u64sum;
+} MPC_PhaseStat;
+
+
+#if defined(MPC_PROFILE_COUNTER)
+    /* User supplied counter */
+    static inline void vProfileCounterInit() {}
+
+#elif defined(__ARM_ARCH_7M__) || defined(__ARM_ARCH_7EM__)
+    /* Cortex-M DWT cycle counter (the CMSIS DWT->CYCCNT) */
+    #define PROFILE_DEMCR       (*(volatile uint32_t *) 0xE000EDFC)
+    #define PROFILE_DWT_CTRL    (*(volatile uint32_t *) 0xE0001000)
+    #define PROFILE_DWT_CYCCNT  (*(volatile uint32_t *) 0xE0001004)
+
+    static inline void vProfileCounterInit() {
+        PROFILE_DEMCR    |= (1UL << 24);        /* TRCENA       */
+        PROFILE_DWT_CTRL |= (1UL << 0);         /* CYCCNTENA    */
+    }
+    #define MPC_PROFILE_COUNTER()   (PROFILE_DWT_CYCCNT)
+
+#elif defined(__x86_64__) || defined(__i386__)
+    #include <x86intrin.h>
+
+    static inline void vProfileCounterInit() {}
+    #define MPC_PROFILE_COUNTER()   ((uint32_t) __rdtsc())
+
+#elif (SYSTEM_IMPLEMENTATION == SYSTEM_IMPLEMENTATION_PC)
+    #include <time.h>
+
+    static inline void vProfileCounterInit() {}
+    static inline uint32_t u32ProfileClockNs() {
+        struct timespec _ts;
+        clock_gettime(CLOCK_MONOTONIC, &_ts);
+        return (uint32_t) ((uint64_t(_ts.tv_sec) * 1000000000ULL) + uint64_t(_ts.tv_nsec));
+    }
+    #define MPC_PROFILE_COUNTER()   (u32ProfileClockNs())
+
+#else
+    #include <Arduino.h>
+
+    static inline void vProfileCounterInit() {}
+    #define MPC_PROFILE_COUNTER()   ((uint32_t) micros())
+
+#endif
+
+
+static inline void vProfileReset(MPC_PhaseStat &_stat)
+{
+    _stat.u32count = 0;
+    _stat.u32min   = 0xFFFFFFFFUL;
+    _stat.u32max   = 0;
+    _stat.u64sum   = 0;
+}
+
+static inline void vProfileAccumulate(MPC_PhaseStat &_stat, const uint32_t _ticks)
+{
+    _stat.u32count++;
+    _stat.u64sum += _ticks;
+    if (_ticks < _stat.u32min) {
+        _stat.u32min = _ticks;
+    }
+    if (_ticks > _stat.u32max) {
+        _stat.u32max = _ticks;
+    }
+}
+
+static inline float fProfileMean(const MPC_PhaseStat &_stat)
+{
+    return (_stat.u32count == 0) ? 0.0f : (float(_stat.u64sum) / float(_stat.u32count));
+}
+
+#define MPC_PROFILE_BEGIN(_n)   const uint32_t _u32ProfileStart##_n = MPC_PROFILE_COUNTER()
+#define MPC_PROFILE_END(_n)     vProfileAccumulate(PhaseStat[(_n)-1], uint32_t(MPC_PROFILE_COUNTER() - _u32ProfileStart##_n))
+
+#else
+
+#define MPC_PROFILE_BEGIN(_n)
+#define MPC_PROFILE_END(_n)
+
+#endif
+
+
+#endif // PROFILER_H
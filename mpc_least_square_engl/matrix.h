@@ -10,8 +10,14 @@
  *      ->  f32data[MATRIX_MAXIMUM_SIZE][MATRIX_MAXIMUM_SIZE] is the memory 
  *           representation of the matrix. We only use the first i32row-th
  *           and first i32col-th memory for the matrix data. The rest is unused.
+ *      ->  With MATRIX_USE_PACKED_STORAGE, f32data is one array and the row i
+ *           starts at f32data[i * i32stride], i32stride = i32col rounded up to
+ *           MATRIX_PACKED_ALIGN bytes.
  *      See below at "Data structure of Matrix class" at private member class
  *       definition for more information!
+ *    - matrix.h & matrix.cpp are mirrored in mpc_engl, mpc_opt_engl and
+ *       mpc_least_square_engl (each sketch folder needs its own copy): edit one,
+ *       then copy it over the others. The CMake configure fails when they differ.
  * 
  * Class Matrix Versioning:
  *    v0.7 (2020-02-23), {PNb}:
@@ -88,25 +94,220 @@
 #endif
 
 
+#if defined(MATRIX_USE_OP_COUNTING) || defined(MATRIX_USE_PACKED_STORAGE)
+    #include <string.h>
+#endif
+
+#if defined(MATRIX_USE_OP_COUNTING)
+
+    /* Instrumented build: count what the Matrix class does (see vMatrixOpCountReport() in matrix.cpp).
+     *
+     *  - Every construction also zero-initializes the whole f32data buffer (sizeof(f32data) bytes),
+     *    and every copy (pass/return by value, assignment) copies the whole buffer (only the used
+     *    rows with MATRIX_USE_PACKED_STORAGE, which doesn't zero-initialize the buffer either).
+     *  - The element reads, writes, and multiply-adds of each operation are counted from its
+     *    dimension, as coded (as if it runs to completion). The element access via operator[]
+     *    outside of the Matrix operations (e.g. in mpc.cpp) is not counted.
+     */
+    typedef enum {
+        MATRIX_OP_ADD = 0,          /* Matrix +/- Matrix, -Matrix           */
+        MATRIX_OP_SCALAR,           /* Matrix +-*\/ scalar, scalar +-* Matrix */
+        MATRIX_OP_MUL,              /* Matrix * Matrix                      */
+        MATRIX_OP_TRANSPOSE,
+        MATRIX_OP_COPY,             /* Copy()                               */
+        MATRIX_OP_INSERT,           /* InsertVector(), InsertSubMatrix()    */
+        MATRIX_OP_SET,              /* vSetDiag(), vSetIdentity(), vSetRandom() */
+        MATRIX_OP_COMPARE,          /* operator ==                          */
+        MATRIX_OP_ROUNDING,         /* RoundingMatrixToZero()               */
+        MATRIX_OP_NORM,             /* bNormVector()                        */
+        MATRIX_OP_INVERS,
+        MATRIX_OP_CHOLESKY,
+        MATRIX_OP_HOUSEHOLDER,
+        MATRIX_OP_QR,               /* QRDec() itself, the Householder transforms & multiplications inside are counted separately */
+        MATRIX_OP_BACKSUB,
+        MATRIX_OP_LEN
+    } MatrixOpType;
+
+    typedef struct {
+        uint64_t u64call;
+        uint64_t u64read;           /* Elements read        */
+        uint64_t u64write;          /* Elements written     */
+        uint64_t u64mac;            /* Multiply-adds        */
+    } MatrixOpStat;
+
+    typedef struct {
+        uint64_t u64construct;      /* Matrix(row, col[, noInitZero])                               */
+        uint64_t u64copy;           /* Copy construction & copy assignment                          */
+        uint64_t u64zeroFill;       /* vSetHomogen() calls (the constructors & vSetToZero())        */
+        uint64_t u64zeroFillElement;/* Elements written by them                                     */
+        MatrixOpStat op[MATRIX_OP_LEN];
+    } MatrixOpCounter;
+
+    extern MatrixOpCounter MATRIX_OP_COUNT;
+
+    void vMatrixOpCountReset();
+    void vMatrixOpCountReport();
+
+    static inline void vMatrixCountOp(const MatrixOpType _type, const int64_t _read, const int64_t _write, const int64_t _mac)
+    {
+        MATRIX_OP_COUNT.op[_type].u64call++;
+        MATRIX_OP_COUNT.op[_type].u64read  += uint64_t(_read);
+        MATRIX_OP_COUNT.op[_type].u64write += uint64_t(_write);
+        MATRIX_OP_COUNT.op[_type].u64mac   += uint64_t(_mac);
+    }
+
+    #define MATRIX_COUNT_OP(_type, _read, _write, _mac)     vMatrixCountOp((_type), (_read), (_write), (_mac))
+    #define MATRIX_COUNT(_field, _n)                        { MATRIX_OP_COUNT._field += uint64_t(_n); }
+#else
+    #define MATRIX_COUNT_OP(_type, _read, _write, _mac)
+    #define MATRIX_COUNT(_field, _n)
+#endif
+
+
+/* The accumulation policy of the dot products in Matrix::Multiply() */
+typedef enum {
+    MATRIX_ACC_NAIVE = 0,       /* The running sum of operator *                                        */
+    MATRIX_ACC_PAIRWISE,        /* Pairwise sum of MATRIX_PAIRWISE_BLOCK long runs, error ~ log(n)      */
+    MATRIX_ACC_KAHAN,           /* Compensated (Neumaier) sum, error ~ 1 ulp; about 4x the flops        */
+    MATRIX_ACC_DOUBLE           /* double accumulator (the same as NAIVE if float_prec is double)       */
+} MatrixAccumulation;
+
+#ifndef MATRIX_PAIRWISE_BLOCK
+    #define MATRIX_PAIRWISE_BLOCK   (8)
+#endif
+
+
+#if defined(MATRIX_USE_PACKED_STORAGE)
+    #ifndef MATRIX_PACKED_ALIGN
+        #define MATRIX_PACKED_ALIGN     (sizeof(float_prec))
+    #endif
+
+    /* The row stride (in elements) of a _col columns matrix: _col rounded up to MATRIX_PACKED_ALIGN bytes */
+    #define MATRIX_PACKED_ALIGN_LEN     (int32_t(MATRIX_PACKED_ALIGN / sizeof(float_prec)))
+    #define MATRIX_PACKED_STRIDE(_col)  ((((_col) + MATRIX_PACKED_ALIGN_LEN - 1) / MATRIX_PACKED_ALIGN_LEN) * MATRIX_PACKED_ALIGN_LEN)
+    #define MATRIX_PACKED_LEN           (MATRIX_MAXIMUM_SIZE * MATRIX_PACKED_STRIDE(MATRIX_MAXIMUM_SIZE))
+
+    static_assert(((MATRIX_PACKED_ALIGN % sizeof(float_prec)) == 0) && ((MATRIX_PACKED_ALIGN & (MATRIX_PACKED_ALIGN - 1)) == 0),
+                  "MATRIX_PACKED_ALIGN must be a power of two multiple of sizeof(float_prec)");
+#endif
+
+
+#if defined(MATRIX_USE_FLUSH_TO_ZERO)
+    #if (defined(__SSE__) || defined(_M_X64)) && !defined(__arm__) && !defined(__aarch64__)
+        #include <xmmintrin.h>
+    #endif
+
+    #ifndef MATRIX_FTZ_CLEANUP
+        #define MATRIX_FTZ_CLEANUP  (1)
+    #endif
+
+    /* Scope guard of the hardware flush-to-zero mode: the subnormal results (FTZ) & operands (DAZ)
+     *  become zero while it lives, the previous mode is restored when it goes out of scope (the status
+     *  flags raised meanwhile are kept). The control register is only written when the mode is off,
+     *  so after vSetGlobal() (once at startup) the guard is one register read.
+     *      - x86 SSE       : MXCSR FTZ (bit 15) & DAZ (bit 6).
+     *      - AArch32 VFP   : FPSCR FZ (bit 24, e.g. Cortex-M4F/M7), both results & operands.
+     *      - AArch64       : FPCR FZ (bit 24).
+     *      - Otherwise (e.g. AVR, soft float) it does nothing, the kernels just don't round per element.
+     */
+    #if (defined(__SSE__) || defined(_M_X64)) && !defined(__arm__) && !defined(__aarch64__)
+        #define MATRIX_FTZ_MODE     (0x8040UL)
+        #define MATRIX_FTZ_GET()    (uint64_t(_mm_getcsr()))
+        #define MATRIX_FTZ_SET(_v)  (_mm_setcsr((unsigned int)(_v)))
+    #elif defined(__aarch64__)
+        #define MATRIX_FTZ_MODE     (1UL << 24)
+        static inline uint64_t u64MatrixFtzGet() { uint64_t _v; __asm__ __volatile__ ("mrs %0, fpcr" : "=r" (_v)); return _v; }
+        #define MATRIX_FTZ_GET()    (u64MatrixFtzGet())
+        #define MATRIX_FTZ_SET(_v)  { const uint64_t _w = (_v); __asm__ __volatile__ ("msr fpcr, %0" : : "r" (_w)); }
+    #elif defined(__arm__) && defined(__VFP_FP__) && !defined(__SOFTFP__)
+        #define MATRIX_FTZ_MODE     (1UL << 24)
+        static inline uint64_t u64MatrixFtzGet() { uint32_t _v; __asm__ __volatile__ ("vmrs %0, fpscr" : "=r" (_v)); return _v; }
+        #define MATRIX_FTZ_GET()    (u64MatrixFtzGet())
+        #define MATRIX_FTZ_SET(_v)  { const uint32_t _w = uint32_t(_v); __asm__ __volatile__ ("vmsr fpscr, %0" : : "r" (_w)); }
+    #else
+        #define MATRIX_FTZ_MODE     (0UL)
+        #define MATRIX_FTZ_GET()    (uint64_t(0))
+        #define MATRIX_FTZ_SET(_v)  { (void)(_v); }
+    #endif
+
+    class MatrixFlushToZero
+    {
+    public:
+        MatrixFlushToZero() {
+            const uint64_t _ctrl = MATRIX_FTZ_GET();
+            bSwitched = ((_ctrl & MATRIX_FTZ_MODE) != MATRIX_FTZ_MODE);
+            if (bSwitched) {
+                MATRIX_FTZ_SET(_ctrl | MATRIX_FTZ_MODE);
+            }
+        }
+        ~MatrixFlushToZero() {
+            if (bSwitched) {
+                MATRIX_FTZ_SET(MATRIX_FTZ_GET() & ~uint64_t(MATRIX_FTZ_MODE));
+            }
+        }
+        /* Turn the mode on for good (e.g. for the constant-time update of the MPC) */
+        static void vSetGlobal() {
+            MATRIX_FTZ_SET(MATRIX_FTZ_GET() | MATRIX_FTZ_MODE);
+        }
+    private:
+        bool bSwitched;
+    };
+#endif
+
+
+/* The stack of a function, for the memory budget of the MPC (see budget.h): _matrix Matrix objects (the
+ *  named ones, the temporaries & the copies of the by-value arguments; not the returned one, the caller
+ *  holds it as its temporary), one call level of scalars, saved registers & return address, and the
+ *  deepest callee (_callee bytes). Every function keeps its own count beside its code.
+ *
+ *  MATRIX_STACK_CALL_BYTES: the biggest scalar part of a frame is 432 bytes with gcc -O0 on x86-64 (the
+ *  workspace bUpdate() of mpc_engl with the refinement & the profiling), less on a 32 bit target.
+ */
+#ifndef MATRIX_STACK_CALL_BYTES
+    #define MATRIX_STACK_CALL_BYTES     (512)
+#endif
+#define MATRIX_STACK_BYTES(_matrix, _callee)    ((size_t(_matrix) * sizeof(Matrix)) + size_t(MATRIX_STACK_CALL_BYTES) + size_t(_callee))
+
+constexpr size_t szMatrixStackMax(const size_t _a, const size_t _b)
+{
+    return (_a > _b) ? _a : _b;
+}
+
+
 class Matrix
 {
 public:
     Matrix(const int32_t _i32row, const int32_t _i32col)
     {
-        this->i32row = _i32row;
-        this->i32col = _i32col;
+        MATRIX_COUNT(u64construct, 1);
+        this->vSetShape(_i32row, _i32col);
 
         this->vSetHomogen(0.0);
     }
     Matrix(const int32_t _i32row, const int32_t _i32col, bool _noInitZero)
     {
-        this->i32row = _i32row;
-        this->i32col = _i32col;
+        MATRIX_COUNT(u64construct, 1);
+        this->vSetShape(_i32row, _i32col);
         
         if (!_noInitZero) {
             this->vSetHomogen(0.0);
         }
     }
+#if defined(MATRIX_USE_OP_COUNTING) || defined(MATRIX_USE_PACKED_STORAGE)
+    Matrix(const Matrix &_mat)
+    {
+        MATRIX_COUNT(u64copy, 1);
+        this->vSetShape(_mat.i32row, _mat.i32col);
+        memcpy(this->f32data, _mat.f32data, _mat.szDataBytes());
+    }
+    Matrix & operator = (const Matrix &_mat)
+    {
+        MATRIX_COUNT(u64copy, 1);
+        this->vSetShape(_mat.i32row, _mat.i32col);
+        memcpy(this->f32data, _mat.f32data, _mat.szDataBytes());
+        return (*this);
+    }
+#endif
     
     bool bMatrixIsValid() {
         /* Check whether the matrix is valid or not.
@@ -125,6 +326,17 @@ public:
         this->i32col = -1;
     }
 
+    /* Give the matrix its dimension back in place (e.g. after vSetMatrixInvalid()), without a
+     *  temporary Matrix. The elements are not touched. With MATRIX_USE_PACKED_STORAGE the row stride
+     *  follows the column count, so a new stride would move every row: that's an ASSERT, not a reshape.
+     */
+    void vSetDimension(const int32_t _row, const int32_t _col) {
+    #if defined(MATRIX_USE_PACKED_STORAGE)
+        ASSERT(MATRIX_PACKED_STRIDE(_col) == this->i32stride, "Matrix vSetDimension() changes the packed row stride");
+    #endif
+        this->vSetShape(_row, _col);
+    }
+
     bool bMatrixIsSquare() {
         return (this->i32row == this->i32col);
     }
@@ -159,17 +371,91 @@ public:
         #else
             #warning("Matrix bounds checking is disabled... good luck >:3");
         #endif
-        return Proxy(f32data[_row], this->i32col);      /* Parsing column index for bound checking */
+        return Proxy(this->pRowUnchecked(_row), this->i32col);      /* Parsing column index for bound checking */
+    }
+
+    /* The row without the bound checking (for the fixed trip count kernels, the caller owns the bounds).
+     *  The operations below use it too, their bounds are the dimension checks at their start.
+     */
+    float_prec * pRowUnchecked(const int32_t _row) {
+    #if defined(MATRIX_USE_PACKED_STORAGE)
+        return &f32data[_row * this->i32stride];
+    #else
+        return f32data[_row];
+    #endif
     }
+    const float_prec * pRowUnchecked(const int32_t _row) const {
+    #if defined(MATRIX_USE_PACKED_STORAGE)
+        return &f32data[_row * this->i32stride];
+    #else
+        return f32data[_row];
+    #endif
+    }
+
+    /* The transpose of a matrix without the copy (what Transpose() returns): the products
+     *  A.Transpose() * B and B * A.Transpose() read A in place. Anything else converts it to the
+     *  transposed Matrix. It refers to the matrix, so don't keep it past the expression.
+     */
+    class TransposedView {
+    public:
+        TransposedView(const Matrix &_mat) : _mat(_mat) { }
+
+        int32_t i32getRow() const { return this->_mat.i32col; }
+        int32_t i32getColumn() const { return this->_mat.i32row; }
+
+        operator Matrix() const {
+            Matrix _outp(this->_mat.i32col, this->_mat.i32row);
+            MATRIX_COUNT_OP(MATRIX_OP_TRANSPOSE, this->_mat.i32row*this->_mat.i32col, this->_mat.i32row*this->_mat.i32col, 0);
+            for (int32_t _i = 0; _i < this->_mat.i32row; _i++) {
+                const float_prec * const _row = this->_mat.pRowUnchecked(_i);
+                for (int32_t _j = 0; _j < this->_mat.i32col; _j++) {
+                    _outp.pRowUnchecked(_j)[_i] = _row[_j];
+                }
+            }
+            return _outp;
+        }
+
+        /* A' * B (or A' * x): the row k of A & B adds its outer product to _outp, so each element
+         *  is still summed over k in order, as the copied transpose times B.
+         */
+        Matrix operator * (const Matrix &_matMul) const {
+            Matrix _outp(this->_mat.i32col, _matMul.i32col);
+            if ((this->_mat.i32row != _matMul.i32row)) {
+                _outp.vSetMatrixInvalid();
+                return _outp;
+            }
+
+            MATRIX_COUNT_OP(MATRIX_OP_MUL, 3*this->_mat.i32col*_matMul.i32col*this->_mat.i32row,
+                            this->_mat.i32col*_matMul.i32col*this->_mat.i32row, this->_mat.i32col*_matMul.i32col*this->_mat.i32row);
+            for (int32_t _k = 0; _k < this->_mat.i32row; _k++) {
+                const float_prec * const _row = this->_mat.pRowUnchecked(_k);
+                const float_prec * const _mulRow = _matMul.pRowUnchecked(_k);
+                for (int32_t _i = 0; _i < this->_mat.i32col; _i++) {
+                    const float_prec _val = _row[_i];
+                    float_prec * const _outpRow = _outp.pRowUnchecked(_i);
+                    for (int32_t _j = 0; _j < _matMul.i32col; _j++) {
+                        _outpRow[_j] += (_val * _mulRow[_j]);
+                    }
+                }
+            }
+            return _outp;
+        }
+    private:
+        friend class Matrix;
+        const Matrix &_mat;
+    };
 
     bool operator == (Matrix _compare) {
         if ((this->i32row != _compare.i32row) || (this->i32col != _compare.i32getColumn())) {
             return false;
         }
 
+        MATRIX_COUNT_OP(MATRIX_OP_COMPARE, 2*this->i32row*this->i32col, 0, 0);
         for (int32_t _i = 0; _i < this->i32row; _i++) {
+            const float_prec * const _row = this->pRowUnchecked(_i);
+            const float_prec * const _compareRow = _compare.pRowUnchecked(_i);
             for (int32_t _j = 0; _j < this->i32col; _j++) {
-                if (fabs((*this)[_i][_j] - _compare[_i][_j]) > float_prec(float_prec_ZERO)) {
+                if (fabs(_row[_j] - _compareRow[_j]) > float_prec(float_prec_ZERO)) {
                     return false;
                 }
             }
@@ -184,9 +470,13 @@ public:
             return _outp;
         }
 
+        MATRIX_COUNT_OP(MATRIX_OP_ADD, 2*this->i32row*this->i32col, this->i32row*this->i32col, 0);
         for (int32_t _i = 0; _i < this->i32row; _i++) {
+            const float_prec * const _row = this->pRowUnchecked(_i);
+            const float_prec * const _opRow = _matAdd.pRowUnchecked(_i);
+            float_prec * const _outpRow = _outp.pRowUnchecked(_i);
             for (int32_t _j = 0; _j < this->i32col; _j++) {
-                _outp[_i][_j] = (*this)[_i][_j] + _matAdd[_i][_j];
+                _outpRow[_j] = _row[_j] + _opRow[_j];
             }
         }
         return _outp;
@@ -199,9 +489,13 @@ public:
             return _outp;
         }
 
+        MATRIX_COUNT_OP(MATRIX_OP_ADD, 2*this->i32row*this->i32col, this->i32row*this->i32col, 0);
         for (int32_t _i = 0; _i < this->i32row; _i++) {
+            const float_prec * const _row = this->pRowUnchecked(_i);
+            const float_prec * const _opRow = _matSub.pRowUnchecked(_i);
+            float_prec * const _outpRow = _outp.pRowUnchecked(_i);
             for (int32_t _j = 0; _j < this->i32col; _j++) {
-                _outp[_i][_j] = (*this)[_i][_j] - _matSub[_i][_j];
+                _outpRow[_j] = _row[_j] - _opRow[_j];
             }
         }
         return _outp;
@@ -209,10 +503,13 @@ public:
 
     Matrix operator - (void) {
         Matrix _outp(this->i32row, this->i32col);
+        MATRIX_COUNT_OP(MATRIX_OP_ADD, this->i32row*this->i32col, this->i32row*this->i32col, 0);
 
         for (int32_t _i = 0; _i < this->i32row; _i++) {
+            const float_prec * const _row = this->pRowUnchecked(_i);
+            float_prec * const _outpRow = _outp.pRowUnchecked(_i);
             for (int32_t _j = 0; _j < this->i32col; _j++) {
-                _outp[_i][_j] = -(*this)[_i][_j];
+                _outpRow[_j] = -_row[_j];
             }
         }
         return _outp;
@@ -225,11 +522,93 @@ public:
             return _outp;
         }
 
+        /* _outp[i][j] += a*b reads 3 elements & writes 1, on top of the _outp[i][j] = 0 */
+        MATRIX_COUNT_OP(MATRIX_OP_MUL, 3*this->i32row*_matMul.i32col*this->i32col,
+                        this->i32row*_matMul.i32col*(this->i32col+1), this->i32row*_matMul.i32col*this->i32col);
         for (int32_t _i = 0; _i < this->i32row; _i++) {
+            const float_prec * const _row = this->pRowUnchecked(_i);
+            float_prec * const _outpRow = _outp.pRowUnchecked(_i);
             for (int32_t _j = 0; _j < _matMul.i32col; _j++) {
-                _outp[_i][_j] = 0.0;
+                float_prec _sum = 0.0;
                 for (int32_t _k = 0; _k < this->i32col; _k++) {
-                    _outp[_i][_j] += ((*this)[_i][_k] * _matMul[_k][_j]);
+                    _sum += (_row[_k] * _matMul.pRowUnchecked(_k)[_j]);
+                }
+                _outpRow[_j] = _sum;
+            }
+        }
+        return _outp;
+    }
+
+    /* A * B': the dot product of the rows of A & B */
+    Matrix operator * (const TransposedView &_matMul) {
+        const Matrix &_matT = _matMul._mat;
+        Matrix _outp(this->i32row, _matT.i32row, true);
+        if ((this->i32col != _matT.i32col)) {
+            _outp.vSetMatrixInvalid();
+            return _outp;
+        }
+
+        MATRIX_COUNT_OP(MATRIX_OP_MUL, 2*this->i32row*_matT.i32row*this->i32col,
+                        this->i32row*_matT.i32row, this->i32row*_matT.i32row*this->i32col);
+        for (int32_t _i = 0; _i < this->i32row; _i++) {
+            const float_prec * const _row = this->pRowUnchecked(_i);
+            float_prec * const _outpRow = _outp.pRowUnchecked(_i);
+            for (int32_t _j = 0; _j < _matT.i32row; _j++) {
+                const float_prec * const _mulRow = _matT.pRowUnchecked(_j);
+                float_prec _sum = 0.0;
+                for (int32_t _k = 0; _k < this->i32col; _k++) {
+                    _sum += (_row[_k] * _mulRow[_k]);
+                }
+                _outpRow[_j] = _sum;
+            }
+        }
+        return _outp;
+    }
+
+    /* operator * with the accumulation policy _acc (see MatrixAccumulation), so each call site can
+     *  choose its own (and without the by-value copy of _matMul). The compensation needs IEEE arithmetic: -ffast-math may optimize it away.
+     */
+    Matrix Multiply(Matrix &_matMul, const MatrixAccumulation _acc) {
+        Matrix _outp(this->i32row, _matMul.i32col, true);
+        if ((this->i32col != _matMul.i32row)) {
+            _outp.vSetMatrixInvalid();
+            return _outp;
+        }
+
+        MATRIX_COUNT_OP(MATRIX_OP_MUL, 2*this->i32row*_matMul.i32col*this->i32col,
+                        this->i32row*_matMul.i32col, this->i32row*_matMul.i32col*this->i32col);
+        for (int32_t _i = 0; _i < this->i32row; _i++) {
+            const float_prec * const _row = this->pRowUnchecked(_i);
+            float_prec * const _outpRow = _outp.pRowUnchecked(_i);
+            for (int32_t _j = 0; _j < _matMul.i32col; _j++) {
+                if (_acc == MATRIX_ACC_NAIVE) {
+                    float_prec _sum = 0.0;
+                    for (int32_t _k = 0; _k < this->i32col; _k++) {
+                        _sum += (_row[_k] * _matMul.pRowUnchecked(_k)[_j]);
+                    }
+                    _outpRow[_j] = _sum;
+                } else if (_acc == MATRIX_ACC_PAIRWISE) {
+                    _outpRow[_j] = this->fDotPairwise(_matMul, _i, _j, 0, this->i32col);
+                } else if (_acc == MATRIX_ACC_KAHAN) {
+                    float_prec _sum = 0.0;
+                    float_prec _comp = 0.0;
+                    for (int32_t _k = 0; _k < this->i32col; _k++) {
+                        const float_prec _val = _row[_k] * _matMul.pRowUnchecked(_k)[_j];
+                        const float_prec _next = _sum + _val;
+                        if (fabs(_sum) >= fabs(_val)) {
+                            _comp += (_sum - _next) + _val;
+                        } else {
+                            _comp += (_val - _next) + _sum;
+                        }
+                        _sum = _next;
+                    }
+                    _outpRow[_j] = _sum + _comp;
+                } else {
+                    double _sum = 0.0;
+                    for (int32_t _k = 0; _k < this->i32col; _k++) {
+                        _sum += (double(_row[_k]) * double(_matMul.pRowUnchecked(_k)[_j]));
+                    }
+                    _outpRow[_j] = float_prec(_sum);
                 }
             }
         }
@@ -237,26 +616,37 @@ public:
     }
 
     void vRoundingElementToZero(const int32_t _i, const int32_t _j) {
-        if (fabs((*this)[_i][_j]) < float_prec(float_prec_ZERO)) {
-            (*this)[_i][_j] = 0.0;
+        float_prec * const _row = this->pRowUnchecked(_i);
+        if (fabs(_row[_j]) < float_prec(float_prec_ZERO)) {
+            _row[_j] = 0.0;
         }
     }
 
     Matrix RoundingMatrixToZero() {
+        this->vRoundingMatrixToZero();
+        return (*this);
+    }
+
+    /* RoundingMatrixToZero() in place, without the copy it returns */
+    void vRoundingMatrixToZero() {
+        MATRIX_COUNT_OP(MATRIX_OP_ROUNDING, this->i32row*this->i32col, 0, 0);
         for (int32_t _i = 0; _i < this->i32row; _i++) {
+            float_prec * const _row = this->pRowUnchecked(_i);
             for (int32_t _j = 0; _j < this->i32col; _j++) {
-                if (fabs((*this)[_i][_j]) < float_prec(float_prec_ZERO)) {
-                    (*this)[_i][_j] = 0.0;
+                if (fabs(_row[_j]) < float_prec(float_prec_ZERO)) {
+                    _row[_j] = 0.0;
                 }
             }
         }
-        return (*this);
     }
 
     void vSetHomogen(const float_prec _val) {
+        MATRIX_COUNT(u64zeroFill, 1);
+        MATRIX_COUNT(u64zeroFillElement, this->i32row*this->i32col);
         for (int32_t _i = 0; _i < this->i32row; _i++) {
+            float_prec * const _row = this->pRowUnchecked(_i);
             for (int32_t _j = 0; _j < this->i32col; _j++) {
-                (*this)[_i][_j] = _val;
+                _row[_j] = _val;
             }
         }
     }
@@ -266,20 +656,24 @@ public:
     }
 
     void vSetRandom(const int32_t _maxRand, const int32_t _minRand) {
+        MATRIX_COUNT_OP(MATRIX_OP_SET, 0, this->i32row*this->i32col, 0);
         for (int32_t _i = 0; _i < this->i32row; _i++) {
+            float_prec * const _row = this->pRowUnchecked(_i);
             for (int32_t _j = 0; _j < this->i32col; _j++) {
-                (*this)[_i][_j] = float_prec((rand() % (_maxRand - _minRand + 1)) + _minRand);
+                _row[_j] = float_prec((rand() % (_maxRand - _minRand + 1)) + _minRand);
             }
         }
     }
 
     void vSetDiag(const float_prec _val) {
+        MATRIX_COUNT_OP(MATRIX_OP_SET, 0, this->i32row*this->i32col, 0);
         for (int32_t _i = 0; _i < this->i32row; _i++) {
+            float_prec * const _row = this->pRowUnchecked(_i);
             for (int32_t _j = 0; _j < this->i32col; _j++) {
                 if (_i == _j) {
-                    (*this)[_i][_j] = _val;
+                    _row[_j] = _val;
                 } else {
-                    (*this)[_i][_j] = 0.0;
+                    _row[_j] = 0.0;
                 }
             }
         }
@@ -289,6 +683,9 @@ public:
         this->vSetDiag(1.0);
     }
 
+    /* InsertVector() & InsertSubMatrix() below: the Copy() of this */
+    #define MATRIX_STACK_INSERT         MATRIX_STACK_BYTES(1, MATRIX_STACK_LEAF)
+
     /* Insert vector into matrix at _posColumn position
      * Example: A = Matrix 3x3, B = Vector 3x1
      *
@@ -310,8 +707,9 @@ public:
             return _outp;
         }
         _outp = this->Copy();
+        MATRIX_COUNT_OP(MATRIX_OP_INSERT, _Vector.i32row, _Vector.i32row, 0);
         for (int32_t _i = 0; _i < _Vector.i32row; _i++) {
-            _outp[_i][_posColumn] = _Vector[_i][0];
+            _outp.pRowUnchecked(_i)[_posColumn] = _Vector.pRowUnchecked(_i)[0];
         }
         return _outp;
     }
@@ -340,9 +738,12 @@ public:
             return _outp;
         }
         _outp = this->Copy();
+        MATRIX_COUNT_OP(MATRIX_OP_INSERT, _subMatrix.i32row*_subMatrix.i32col, _subMatrix.i32row*_subMatrix.i32col, 0);
         for (int32_t _i = 0; _i < _subMatrix.i32row; _i++) {
+            const float_prec * const _subRow = _subMatrix.pRowUnchecked(_i);
+            float_prec * const _outpRow = _outp.pRowUnchecked(_i + _posRow) + _posColumn;
             for (int32_t _j = 0; _j < _subMatrix.i32col; _j++) {
-                _outp[_i + _posRow][_j + _posColumn] = _subMatrix[_i][_j];
+                _outpRow[_j] = _subRow[_j];
             }
         }
         return _outp;
@@ -372,9 +773,12 @@ public:
             return _outp;
         }
         _outp = this->Copy();
+        MATRIX_COUNT_OP(MATRIX_OP_INSERT, _lenRow*_lenColumn, _lenRow*_lenColumn, 0);
         for (int32_t _i = 0; _i < _lenRow; _i++) {
+            const float_prec * const _subRow = _subMatrix.pRowUnchecked(_i);
+            float_prec * const _outpRow = _outp.pRowUnchecked(_i + _posRow) + _posColumn;
             for (int32_t _j = 0; _j < _lenColumn; _j++) {
-                _outp[_i + _posRow][_j + _posColumn] = _subMatrix[_i][_j];
+                _outpRow[_j] = _subRow[_j];
             }
         }
         return _outp;
@@ -410,31 +814,30 @@ public:
             return _outp;
         }
         _outp = this->Copy();
+        MATRIX_COUNT_OP(MATRIX_OP_INSERT, _lenRow*_lenColumn, _lenRow*_lenColumn, 0);
         for (int32_t _i = 0; _i < _lenRow; _i++) {
+            const float_prec * const _subRow = _subMatrix.pRowUnchecked(_posRowSub + _i) + _posColumnSub;
+            float_prec * const _outpRow = _outp.pRowUnchecked(_i + _posRow) + _posColumn;
             for (int32_t _j = 0; _j < _lenColumn; _j++) {
-                _outp[_i + _posRow][_j + _posColumn] = _subMatrix[_posRowSub+_i][_posColumnSub+_j];
+                _outpRow[_j] = _subRow[_j];
             }
         }
         return _outp;
     }
     
-    /* Return the transpose of the matrix */
-    Matrix Transpose() {
-        Matrix _outp(this->i32col, this->i32row);
-        for (int32_t _i = 0; _i < this->i32row; _i++) {
-            for (int32_t _j = 0; _j < this->i32col; _j++) {
-                _outp[_j][_i] = (*this)[_i][_j];
-            }
-        }
-        return _outp;
+    /* Return the transpose of the matrix (as a TransposedView, converted to a Matrix when needed) */
+    TransposedView Transpose() {
+        return TransposedView(*this);
     }
     
     /* Normalize the vector */
     bool bNormVector() {
         float_prec _normM = 0.0;
+        MATRIX_COUNT_OP(MATRIX_OP_NORM, 3*this->i32row*this->i32col, this->i32row*this->i32col, this->i32row*this->i32col);
         for (int32_t _i = 0; _i < this->i32row; _i++) {
+            const float_prec * const _row = this->pRowUnchecked(_i);
             for (int32_t _j = 0; _j < this->i32col; _j++) {
-                _normM = _normM + ((*this)[_i][_j] * (*this)[_i][_j]);
+                _normM = _normM + (_row[_j] * _row[_j]);
             }
         }
         
@@ -447,8 +850,9 @@ public:
         }
         _normM = sqrt(_normM);
         for (int32_t _i = 0; _i < this->i32row; _i++) {
+            float_prec * const _row = this->pRowUnchecked(_i);
             for (int32_t _j = 0; _j < this->i32col; _j++) {
-                (*this)[_i][_j] /= _normM;
+                _row[_j] /= _normM;
             }
         }
         return true;
@@ -456,40 +860,76 @@ public:
     
     Matrix Copy() {
         Matrix _outp(this->i32row, this->i32col);
+        MATRIX_COUNT_OP(MATRIX_OP_COPY, this->i32row*this->i32col, this->i32row*this->i32col, 0);
         for (int32_t _i = 0; _i < this->i32row; _i++) {
+            const float_prec * const _row = this->pRowUnchecked(_i);
+            float_prec * const _outpRow = _outp.pRowUnchecked(_i);
             for (int32_t _j = 0; _j < this->i32col; _j++) {
-                _outp[_i][_j] = (*this)[_i][_j];
+                _outpRow[_j] = _row[_j];
             }
         }
         return _outp;
     }
 
+    /* The operators, Copy(), Multiply(), BackSubtitution(), .. have no Matrix of their own */
+    #define MATRIX_STACK_LEAF           MATRIX_STACK_BYTES(0, 0)
+
     /* Invers operation using Gauss-Jordan algorithm */
+    #define MATRIX_STACK_INVERS         MATRIX_STACK_BYTES(2, MATRIX_STACK_LEAF)    /* _temp & Copy() */
     Matrix Invers() {
+    #if defined(MATRIX_USE_FLUSH_TO_ZERO)
+        MatrixFlushToZero _ftz;
+    #endif
         Matrix _outp(this->i32row, this->i32col);
         Matrix _temp(this->i32row, this->i32col);
         _outp.vSetIdentity();
         _temp = this->Copy();
+        #if defined(MATRIX_USE_OP_COUNTING)
+        {
+            /* Elimination & Jordan touch every (row, pivot) pair below/above the diagonal */
+            const int64_t _n = this->i32row;
+            const int64_t _pair = _n*(_n-1)/2;
+            MATRIX_COUNT_OP(MATRIX_OP_INVERS, (_pair*(2 + 6*_n)) + (_pair*(4 + 3*_n)) + (_n + _n*_n),
+                                              (_pair*2*_n) + _pair + (_pair*(1 + _n)) + (_n + _n*_n),
+                                              (_pair*2*_n) + (_pair*(1 + _n)));
+        }
+        #endif
 
 
         /* Gauss Elimination... */
         for (int32_t _j = 0; _j < (_temp.i32row)-1; _j++) {
             for (int32_t _i = _j+1; _i < _temp.i32row; _i++) {
-                if (fabs(_temp[_j][_j]) < float_prec(float_prec_ZERO)) {
+                float_prec * const _tempRow = _temp.pRowUnchecked(_i);
+                float_prec * const _outpRow = _outp.pRowUnchecked(_i);
+                const float_prec * const _tempPivot = _temp.pRowUnchecked(_j);
+                const float_prec * const _outpPivot = _outp.pRowUnchecked(_j);
+                if (fabs(_tempPivot[_j]) < float_prec(float_prec_ZERO)) {
                     /* Matrix is non-invertible */
                     _outp.vSetMatrixInvalid();
                     return _outp;
                 }
 
-                float_prec _tempfloat = _temp[_i][_j] / _temp[_j][_j];
+                float_prec _tempfloat = _tempRow[_j] / _tempPivot[_j];
 
+            #if defined(MATRIX_USE_FLUSH_TO_ZERO)
+                /* No per element rounding: a branch-free row update (the bounds were checked above) */
                 for (int32_t _k = 0; _k < _temp.i32col; _k++) {
-                    _temp[_i][_k] -= (_temp[_j][_k] * _tempfloat);
-                    _outp[_i][_k] -= (_outp[_j][_k] * _tempfloat);
+                    _tempRow[_k] -= (_tempPivot[_k] * _tempfloat);
+                    _outpRow[_k] -= (_outpPivot[_k] * _tempfloat);
+                }
+            #else
+                for (int32_t _k = 0; _k < _temp.i32col; _k++) {
+                    _tempRow[_k] -= (_tempPivot[_k] * _tempfloat);
+                    _outpRow[_k] -= (_outpPivot[_k] * _tempfloat);
 
-                    _temp.vRoundingElementToZero(_i, _k);
-                    _outp.vRoundingElementToZero(_i, _k);
+                    if (fabs(_tempRow[_k]) < float_prec(float_prec_ZERO)) {
+                        _tempRow[_k] = 0.0;
+                    }
+                    if (fabs(_outpRow[_k]) < float_prec(float_prec_ZERO)) {
+                        _outpRow[_k] = 0.0;
+                    }
                 }
+            #endif
 
             }
         }
@@ -500,8 +940,9 @@ public:
          * bukan 0 semua, jadikan 0 --> berguna untuk dekomposisi LU
          */
         for (int32_t _i = 1; _i < _temp.i32row; _i++) {
+            float_prec * const _tempRow = _temp.pRowUnchecked(_i);
             for (int32_t _j = 0; _j < _i; _j++) {
-                _temp[_i][_j] = 0.0;
+                _tempRow[_j] = 0.0;
             }
         }
 #endif
@@ -510,39 +951,59 @@ public:
         /* Jordan... */
         for (int32_t _j = (_temp.i32row)-1; _j > 0; _j--) {
             for (int32_t _i = _j-1; _i >= 0; _i--) {
-                if (fabs(_temp[_j][_j]) < float_prec(float_prec_ZERO)) {
+                float_prec * const _tempRow = _temp.pRowUnchecked(_i);
+                float_prec * const _outpRow = _outp.pRowUnchecked(_i);
+                const float_prec * const _tempPivot = _temp.pRowUnchecked(_j);
+                const float_prec * const _outpPivot = _outp.pRowUnchecked(_j);
+                if (fabs(_tempPivot[_j]) < float_prec(float_prec_ZERO)) {
                     /* Matrix is non-invertible */
                     _outp.vSetMatrixInvalid();
                     return _outp;
                 }
 
-                float_prec _tempfloat = _temp[_i][_j] / _temp[_j][_j];
-                _temp[_i][_j] -= (_temp[_j][_j] * _tempfloat);
-                _temp.vRoundingElementToZero(_i, _j);
+                float_prec _tempfloat = _tempRow[_j] / _tempPivot[_j];
+                _tempRow[_j] -= (_tempPivot[_j] * _tempfloat);
+            #if defined(MATRIX_USE_FLUSH_TO_ZERO)
+                for (int32_t _k = 0; _k < _temp.i32row; _k++) {
+                    _outpRow[_k] -= (_outpPivot[_k] * _tempfloat);
+                }
+            #else
+                if (fabs(_tempRow[_j]) < float_prec(float_prec_ZERO)) {
+                    _tempRow[_j] = 0.0;
+                }
 
                 for (int32_t _k = (_temp.i32row - 1); _k >= 0; _k--) {
-                    _outp[_i][_k] -= (_outp[_j][_k] * _tempfloat);
-                    _outp.vRoundingElementToZero(_i, _k);
+                    _outpRow[_k] -= (_outpPivot[_k] * _tempfloat);
+                    if (fabs(_outpRow[_k]) < float_prec(float_prec_ZERO)) {
+                        _outpRow[_k] = 0.0;
+                    }
                 }
+            #endif
             }
         }
 
 
         /* Normalization */
         for (int32_t _i = 0; _i < _temp.i32row; _i++) {
-            if (fabs(_temp[_i][_i]) < float_prec(float_prec_ZERO)) {
+            float_prec * const _tempRow = _temp.pRowUnchecked(_i);
+            float_prec * const _outpRow = _outp.pRowUnchecked(_i);
+            if (fabs(_tempRow[_i]) < float_prec(float_prec_ZERO)) {
                 /* Matrix is non-invertible */
                 _outp.vSetMatrixInvalid();
                 return _outp;
             }
 
-            float_prec _tempfloat = _temp[_i][_i];
-            _temp[_i][_i] = 1.0;
+            float_prec _tempfloat = _tempRow[_i];
+            _tempRow[_i] = 1.0;
 
             for (int32_t _j = 0; _j < _temp.i32row; _j++) {
-                _outp[_i][_j] /= _tempfloat;
+                _outpRow[_j] /= _tempfloat;
             }
         }
+    #if defined(MATRIX_USE_FLUSH_TO_ZERO) && (MATRIX_FTZ_CLEANUP)
+        /* The one cleanup pass instead of the per element rounding */
+        _outp.vRoundingMatrixToZero();
+    #endif
         return _outp;
     }
 
@@ -570,12 +1031,24 @@ public:
             return _outp;
         }
         _outp.vSetHomogen(0.0);
+        #if defined(MATRIX_USE_OP_COUNTING)
+        {
+            int64_t _mac = 0;
+            for (int64_t _j = 0; _j < this->i32col; _j++) {
+                _mac += (this->i32row - _j) * _j;
+            }
+            const int64_t _pair = int64_t(this->i32row)*(this->i32row+1)/2;
+            MATRIX_COUNT_OP(MATRIX_OP_CHOLESKY, (2*_mac) + (2*_pair), _pair, _mac);
+        }
+        #endif
         for (int32_t _j = 0; _j < this->i32col; _j++) {
+            const float_prec * const _outpRowJ = _outp.pRowUnchecked(_j);
             for (int32_t _i = _j; _i < this->i32row; _i++) {
-                _tempFloat = (*this)[_i][_j];
+                float_prec * const _outpRow = _outp.pRowUnchecked(_i);
+                _tempFloat = this->pRowUnchecked(_i)[_j];
                 if (_i == _j) {
                     for (int32_t _k = 0; _k < _j; _k++) {
-                        _tempFloat = _tempFloat - (_outp[_i][_k] * _outp[_i][_k]);
+                        _tempFloat = _tempFloat - (_outpRow[_k] * _outpRow[_k]);
                     }
                     if (_tempFloat < float_prec(float_prec_ZERO)) {
                         /* Matrix is not positif definit */
@@ -586,17 +1059,17 @@ public:
                     if (fabs(_tempFloat) < float_prec(float_prec_ZERO)) {
                         _tempFloat = 0.0;
                     }
-                    _outp[_i][_i] = sqrt(_tempFloat);
+                    _outpRow[_i] = sqrt(_tempFloat);
                 } else {
                     for (int32_t _k = 0; _k < _j; _k++) {
-                        _tempFloat = _tempFloat - (_outp[_i][_k] * _outp[_j][_k]);
+                        _tempFloat = _tempFloat - (_outpRow[_k] * _outpRowJ[_k]);
                     }
-                    if (fabs(_outp[_j][_j]) < float_prec(float_prec_ZERO)) {
+                    if (fabs(_outpRowJ[_j]) < float_prec(float_prec_ZERO)) {
                         /* Matrix is not positif definit */
                         _outp.vSetMatrixInvalid();
                         return _outp;
                     }
-                    _outp[_i][_j] = _tempFloat / _outp[_j][_j];
+                    _outpRow[_j] = _tempFloat / _outpRowJ[_j];
                 }
             }
         }
@@ -606,6 +1079,7 @@ public:
     /* Do the Householder Transformation for QR Decomposition operation.
      *              out = HouseholderTransformQR(A, i, j)
      */
+    #define MATRIX_STACK_HOUSEHOLDER    MATRIX_STACK_BYTES(1, MATRIX_STACK_LEAF)    /* _vectTemp */
     Matrix HouseholderTransformQR(const int32_t _rowTransform, const int32_t _columnTransform)
     {
         float_prec _tempFloat;
@@ -620,6 +1094,9 @@ public:
             _outp.vSetMatrixInvalid();
             return _outp;
         }
+        /* The x vector, then the rank-1 update P = -2*(u1*u1')/v_len2 + I */
+        MATRIX_COUNT_OP(MATRIX_OP_HOUSEHOLDER, (this->i32row - _rowTransform) + (2*this->i32row*this->i32row),
+                        (this->i32row - _rowTransform) + (this->i32row*this->i32row), (this->i32row*this->i32row));
 
         /* Until here:
          *
@@ -627,13 +1104,13 @@ public:
          * _vLen2   = ||u||^2 - (u1^2) = x2^2 + .. + xn^2
          * _vectTemp= [0 0 0 .. x1=0 x2 x3 .. xn]'
          */
-        _x1 = (*this)[_rowTransform][_columnTransform];
+        _x1 = this->pRowUnchecked(_rowTransform)[_columnTransform];
         _xLen = _x1*_x1;
         _vLen2 = 0.0;
         for (int32_t _i = _rowTransform+1; _i < this->i32row; _i++) {
-            _vectTemp[_i][0] = (*this)[_i][_columnTransform];
+            _vectTemp.pRowUnchecked(_i)[0] = this->pRowUnchecked(_i)[_columnTransform];
 
-            _tempFloat = _vectTemp[_i][0] * _vectTemp[_i][0];
+            _tempFloat = _vectTemp.pRowUnchecked(_i)[0] * _vectTemp.pRowUnchecked(_i)[0];
             _xLen  += _tempFloat;
             _vLen2 += _tempFloat;
         }
@@ -649,27 +1126,41 @@ public:
 
         /* Solve vlen2 & tempHH */
         _vLen2 += (_u1*_u1);
-        _vectTemp[_rowTransform][0] = _u1;
+        _vectTemp.pRowUnchecked(_rowTransform)[0] = _u1;
 
         if (fabs(_vLen2) < float_prec(float_prec_ZERO)) {
             /* x vector is collinear with basis vector e, return result = I */
             _outp.vSetIdentity();
         } else {
             /* P = -2*(u1*u1')/v_len2 + I */
+        #if defined(MATRIX_USE_FLUSH_TO_ZERO)
+            /* Branch-free: the (near) zero elements of u1 are cleaned up by QRDec() */
+            const float_prec _scale = float_prec(-2.0) / _vLen2;
+            for (int32_t _i = 0; _i < this->i32row; _i++) {
+                const float_prec _ui = _vectTemp.pRowUnchecked(_i)[0] * _scale;
+                float_prec * const _outpRow = _outp.pRowUnchecked(_i);
+                for (int32_t _j = 0; _j < this->i32row; _j++) {
+                    _outpRow[_j] = _vectTemp.pRowUnchecked(_j)[0] * _ui;
+                }
+                _outpRow[_i] += float_prec(1.0);
+            }
+        #else
             /* PR TODO: We can do many optimization here */
             for (int32_t _i = 0; _i < this->i32row; _i++) {
-                _tempFloat = _vectTemp[_i][0];
+                float_prec * const _outpRow = _outp.pRowUnchecked(_i);
+                _tempFloat = _vectTemp.pRowUnchecked(_i)[0];
                 if (fabs(_tempFloat) > float_prec(float_prec_ZERO)) {
                     for (int32_t _j = 0; _j < this->i32row; _j++) {
-                        if (fabs(_vectTemp[_j][0]) > float_prec(float_prec_ZERO)) {
-                            _outp[_i][_j] = _vectTemp[_j][0];
-                            _outp[_i][_j] = _outp[_i][_j] * _tempFloat;
-                            _outp[_i][_j] = _outp[_i][_j] * (-2.0/_vLen2);
+                        if (fabs(_vectTemp.pRowUnchecked(_j)[0]) > float_prec(float_prec_ZERO)) {
+                            _outpRow[_j] = _vectTemp.pRowUnchecked(_j)[0];
+                            _outpRow[_j] = _outpRow[_j] * _tempFloat;
+                            _outpRow[_j] = _outpRow[_j] * (-2.0/_vLen2);
                         }
                     }
                 }
-                _outp[_i][_i] = _outp[_i][_i] + 1.0;
+                _outpRow[_i] = _outpRow[_i] + 1.0;
             }
+        #endif
         }
         return _outp;
     }
@@ -686,6 +1177,8 @@ public:
      *                   (QR)x = b
      *                      Rx = Q'b    --> Afterward use back-subtitution to solve x
      */
+    /* Qn, HouseholderTransformQR(), Qn*Qt & Qn*R (+ the copies of Qt & R) */
+    #define MATRIX_STACK_QRDEC          MATRIX_STACK_BYTES(6, MATRIX_STACK_HOUSEHOLDER)
     bool QRDec(Matrix &Qt, Matrix &R)
     {
         Matrix Qn(Qt.i32row, Qt.i32col);
@@ -694,6 +1187,10 @@ public:
             R.vSetMatrixInvalid();
             return false;
         }
+        MATRIX_COUNT_OP(MATRIX_OP_QR, 0, 0, 0);
+    #if defined(MATRIX_USE_FLUSH_TO_ZERO)
+        MatrixFlushToZero _ftz;
+    #endif
         R = (*this);
         Qt.vSetIdentity();
         for (int32_t _i = 0; (_i < (this->i32row - 1)) && (_i < this->i32col-1); _i++) {
@@ -706,8 +1203,8 @@ public:
             Qt = Qn * Qt;
             R  = Qn * R;
         }
-        Qt.RoundingMatrixToZero();
-        /* R.RoundingMatrixToZero(); */
+        Qt.vRoundingMatrixToZero();
+        /* R.vRoundingMatrixToZero(); */
         return true;
     }
 
@@ -758,16 +1255,20 @@ public:
             return _outp;
         }
 
+        MATRIX_COUNT_OP(MATRIX_OP_BACKSUB, (3*A.i32col*(A.i32col-1)/2) + (3*A.i32col),
+                        (A.i32col*(A.i32col-1)/2) + (2*A.i32col), (A.i32col*(A.i32col-1)/2));
         for (int32_t _i = A.i32col-1; _i >= 0; _i--) {
-            _outp[_i][0] = B[_i][0];
+            const float_prec * const _aRow = A.pRowUnchecked(_i);
+            float_prec _x = B.pRowUnchecked(_i)[0];
             for (int32_t _j = _i + 1; _j < A.i32col; _j++) {
-                _outp[_i][0] = _outp[_i][0] - A[_i][_j]*_outp[_j][0];
+                _x = _x - _aRow[_j]*_outp.pRowUnchecked(_j)[0];
             }
-            if (fabs(A[_i][_i]) < float_prec(float_prec_ZERO)) {
+            if (fabs(_aRow[_i]) < float_prec(float_prec_ZERO)) {
+                _outp.pRowUnchecked(_i)[0] = _x;
                 _outp.vSetMatrixInvalid();
                 return _outp;
             }
-            _outp[_i][0] = _outp[_i][0] / A[_i][_i];
+            _outp.pRowUnchecked(_i)[0] = _x / _aRow[_i];
         }
 
         return _outp;
@@ -839,10 +1340,53 @@ private:
      *  (like I said in the github page, I've made decision to sacrifice speed & performance to get best code readability I could get).
      * 
      * You could change the data structure of f32data if you want to make the implementation more memory efficient.
+     * 
+     * MATRIX_USE_PACKED_STORAGE does that for the access pattern instead of the size: the buffer is still the
+     *  worst case, but the rows are consecutive (i32stride apart), so a small matrix sits in a few cache lines.
      */
     int32_t i32row;
     int32_t i32col;
+#if defined(MATRIX_USE_PACKED_STORAGE)
+    /* Not zero-initialized: Matrix(row, col) sets the elements, Matrix(row, col, true) leaves them to the
+     *  caller, and the copy only moves the used rows
+     */
+    int32_t i32stride;
+    alignas(MATRIX_PACKED_ALIGN) float_prec f32data[MATRIX_PACKED_LEN];
+#else
     float_prec f32data[MATRIX_MAXIMUM_SIZE][MATRIX_MAXIMUM_SIZE] = {{0}};
+#endif
+
+    /* The bytes of f32data a copy has to move: the used rows if they're packed, otherwise all of it */
+    size_t szDataBytes() const {
+    #if defined(MATRIX_USE_PACKED_STORAGE)
+        return ((this->i32row > 0) && (this->i32stride > 0)) ? (size_t(this->i32row * this->i32stride) * sizeof(float_prec)) : 0;
+    #else
+        return sizeof(this->f32data);
+    #endif
+    }
+
+    /* The dimension (and the packed row stride) of a matrix whose elements are about to be set */
+    void vSetShape(const int32_t _row, const int32_t _col) {
+        this->i32row = _row;
+        this->i32col = _col;
+    #if defined(MATRIX_USE_PACKED_STORAGE)
+        this->i32stride = MATRIX_PACKED_STRIDE(_col);
+    #endif
+    }
+
+    /* Row _i of this matrix times column _j of _matMul, over the _len elements from _k0 (MATRIX_ACC_PAIRWISE) */
+    float_prec fDotPairwise(Matrix &_matMul, const int32_t _i, const int32_t _j, const int32_t _k0, const int32_t _len) {
+        if (_len <= MATRIX_PAIRWISE_BLOCK) {
+            float_prec _sum = 0.0;
+            for (int32_t _k = _k0; _k < (_k0 + _len); _k++) {
+                _sum += (this->pRowUnchecked(_i)[_k] * _matMul.pRowUnchecked(_k)[_j]);
+            }
+            return _sum;
+        }
+        const int32_t _half = _len / 2;
+        return this->fDotPairwise(_matMul, _i, _j, _k0, _half) +
+               this->fDotPairwise(_matMul, _i, _j, _k0 + _half, _len - _half);
+    }
 };
 
 
@@ -6,17 +6,34 @@
  *          z(k)    = C*x(k)            ; z = Zx1
  *
  *
- ** Calculate prediction of z(k+1..k+Hp) constants ************************************************
+ ** Calculate prediction of z(k+T(1)..k+T(Hc)) constants ******************************************
  *
- *      Prediction of state variable of the system:
- *        z(k+1..k+Hp) = (CPSI)*x(k) + (COMEGA)*u(k-1) + (CTHETA)*dU(k..k+Hu-1)         ...{MPC_1}
+ *      The Hp prediction steps lie on a (possibly non-uniform) time grid: the first segment of
+ *      the grid steps with m(1)*dt, the next with m(2)*dt, and so on (see MPC_GRID_SEGMENTS).
+ *      t(s) is the time of the prediction step s (in dt) and T(j) = t(P(j)) is the time of
+ *      the coincidence points P(1) < .. < P(Hc) <= Hp.
+ *
+ *      Prediction of state variable of the system at the coincidence points:
+ *        z(k+T(1)..k+T(Hc)) = (CPSI)*x(k) + (COMEGA)*u(k-1) + (CTHETA)*dU(k..k+Hu-1)   ...{MPC_1}
  *
  *        Constants:
- *          CPSI   = [CA C(A^2) ... C(A^Hp)]'                                       : (Hp*N)xN
- *          COMEGA = [CB C(B+A*B) ... C*Sigma(i=0->Hp-1)A^i*B]'                     : (Hp*N)xM
+ *          CPSI   = [C(A^T(1)) C(A^T(2)) ... C(A^T(Hc))]'                          : (Hc*N)xN
+ *          COMEGA = [C*S(T(1)) C*S(T(2)) ... C*S(T(Hc))]'                          : (Hc*N)xM
+ *          CTHETA = [C*S(T(1))    C*S(T(1)-1)  ....  C*S(T(1)-Hu+1) ]
+ *                   [C*S(T(2))    C*S(T(2)-1)  ....  C*S(T(2)-Hu+1) ]
+ *                   [    .             .         .         .        ]              : (Hc*N)x(Hu*M)
+ *                   [C*S(T(Hc))   C*S(T(Hc)-1) ....  C*S(T(Hc)-Hu+1)]
+ *
+ *          S(s)   = Sigma(i=0->s-1)A^i*B  ; S(s) = 0 for s <= 0
+ *
+ *        The control moves dU(k..k+Hu-1) are still spaced dt apart.
+ *
+ *        With one grid segment of dt and P = {1, 2, .., Hp} these are the full prediction matrices:
+ *          CPSI   = [CA C(A^2) ... C(A^Hp)]'
+ *          COMEGA = [CB C(B+A*B) ... C*Sigma(i=0->Hp-1)A^i*B]'
  *          CTHETA = [         CB                0  ....           0              ]
  *                   [       C(B+A*B)           CB   .             0              ]
- *                   [           .               .    .           CB              ] : (Hp*N)x(Hu*M)
+ *                   [           .               .    .           CB              ]
  *                   [           .               .     .           .              ]
  *                   [C*Sigma(i=0->Hp-1)(A^i*B)  .  ....  C*Sigma(i=0->Hp-Hu)A^i*B]
  *
@@ -32,10 +49,10 @@
  *          Q_L * R_L = GammaLeft                                                       ...{MPC_2}
  * 
  *        Constants:
- *          SQ    = Square root of Weight matrix for set-point deviation    : Hp x Hp
- *          SR    = Square root of Weight matrix for control signal change  : Hu x Hu
- *          Q_L   = Orthogonal matrix of QR Decomposition of GammaLeft      : (Hp*Z+Hu*M) x  (Hp*Z+Hu*M)
- *          R_L   = Upper triangular matrix of QR Decomposition of GammaLeft: (Hp*Z+Hu*M) x  (Hp*Z)
+ *          SQ    = Square root of Weight matrix for set-point deviation    : (Hc*Z) x (Hc*Z)
+ *          SR    = Square root of Weight matrix for control signal change  : (Hu*M) x (Hu*M)
+ *          Q_L   = Orthogonal matrix of QR Decomposition of GammaLeft      : (Hc*Z+Hu*M) x  (Hc*Z+Hu*M)
+ *          R_L   = Upper triangular matrix of QR Decomposition of GammaLeft: (Hc*Z+Hu*M) x  (Hc*Z)
  * 
  * 
  ** MPC update algorithm **************************************************************************
@@ -54,7 +71,7 @@
  *          u(k) = u(k-1) + du(k)                                                       ...{MPC_6}
  *
  *        Variables:
- *          SP(k) = Set Point vector at time-k              : (Hp*N) x 1
+ *          SP(k) = Set Point vector at the coincidence points: (Hc*N) x 1
  *          x(k)  = State Variables at time-k               : N x 1
  *          u(k)  = Input plant at time-k                   : M x 1
  * 
@@ -62,75 +79,267 @@
  * See https://github.com/pronenewbits for more!
  *************************************************************************************************/
 #include "mpc.h"
+#include "budget.h"
+
+
+#if defined(MPC_USE_ITERATIVE_REFINEMENT)
+/* max|v[i]| of a vector, the norm of the refinement convergence test */
+static float_prec fRefineNormMax(const float_prec * _vec, const int32_t _len)
+{
+    float_prec _max = 0;
+    for (int32_t _i = 0; _i < _len; _i++) {
+        const float_prec _abs = (_vec[_i] < 0) ? -_vec[_i] : _vec[_i];
+        _max = (_abs > _max) ? _abs : _max;
+    }
+    return _max;
+}
+
+/* R_L(1:n, 1:n)' * _x = _x in place (forward-substitution), false on a zero pivot */
+static bool bRefineForwardSubtitution(Matrix &R_L, float_prec * _x, const int32_t _n)
+{
+    for (int32_t _i = 0; _i < _n; _i++) {
+        float_prec _sum = _x[_i];
+        for (int32_t _j = 0; _j < _i; _j++) {
+            _sum -= R_L.pRowUnchecked(_j)[_i] * _x[_j];
+        }
+        const float_prec _pivot = R_L.pRowUnchecked(_i)[_i];
+        if (fabs(_pivot) < float_prec(float_prec_ZERO)) {
+            return false;
+        }
+        _x[_i] = _sum / _pivot;
+    }
+    return true;
+}
+#endif
+
+#if defined(MPC_USE_REINIT_WORKSPACE)
+/* The workspace of vReInit() when the caller doesn't give one, shared by all the instances */
+static float_prec f32ReInitWorkspace[MPC_REINIT_WORKSPACE_LEN];
+
+/* _dst = _add + _a*_b on the raw workspace arrays (row-major, the row stride is the column count), with
+ *  _a: X x X and _b, _add: X x _col (_add may be NULL). The product goes through _tmp (X x _col), so _dst
+ *  can be one of the operands.
+ */
+static void vWorkspaceMulAdd(float_prec * _dst, const float_prec * _add, const float_prec * _a, const float_prec * _b,
+                             const int32_t _col, float_prec * _tmp)
+{
+    for (int32_t _i = 0; _i < SS_X_LEN; _i++) {
+        for (int32_t _j = 0; _j < _col; _j++) {
+            float_prec _sum = 0;
+            for (int32_t _k = 0; _k < SS_X_LEN; _k++) {
+                _sum += _a[(_i*SS_X_LEN) + _k] * _b[(_k*_col) + _j];
+            }
+            _tmp[(_i*_col) + _j] = (_add == NULL) ? _sum : (_add[(_i*_col) + _j] + _sum);
+        }
+    }
+    memcpy(_dst, _tmp, size_t(SS_X_LEN*_col) * sizeof(float_prec));
+}
+
+/* _dst(_row:_row+Z, _col:_col+_len) = C*_b, with _b: X x _len on the workspace */
+static void vWorkspaceInsertC(Matrix &_dst, const int32_t _row, const int32_t _col, Matrix &C, const float_prec * _b,
+                              const int32_t _len)
+{
+    for (int32_t _i = 0; _i < SS_Z_LEN; _i++) {
+        const float_prec * const _cRow = C.pRowUnchecked(_i);
+        float_prec * const _dstRow = _dst.pRowUnchecked(_row + _i);
+        for (int32_t _j = 0; _j < _len; _j++) {
+            float_prec _sum = 0;
+            for (int32_t _k = 0; _k < SS_X_LEN; _k++) {
+                _sum += _cRow[_k] * _b[(_k*_len) + _j];
+            }
+            _dstRow[_col + _j] = _sum;
+        }
+    }
+}
+#endif
+
+#if defined(MPC_USE_UPDATE_WORKSPACE)
+/* The workspace of bUpdate() when the caller doesn't give one, shared by all the instances */
+static float_prec f32UpdateWorkspace[MPC_UPDATE_WORKSPACE_LEN];
+#endif
+
+#if defined(MPC_USE_UPDATE_WORKSPACE) || defined(MPC_USE_ITERATIVE_REFINEMENT)
+/* R_L(1:n, 1:n) * _x = _b on the raw arrays (_x may be _b), false (and _x untouched past the pivot) on a zero pivot */
+static bool bWorkspaceBackSubtitution(Matrix &R_L, const float_prec * _b, float_prec * _x, const int32_t _n)
+{
+    for (int32_t _i = _n-1; _i >= 0; _i--) {
+        const float_prec * const _rRow = R_L.pRowUnchecked(_i);
+        float_prec _sum = _b[_i];
+        for (int32_t _j = _i + 1; _j < _n; _j++) {
+            _sum -= _rRow[_j] * _x[_j];
+        }
+        if (fabs(_rRow[_i]) < float_prec(float_prec_ZERO)) {
+            return false;
+        }
+        _x[_i] = _sum / _rRow[_i];
+    }
+    return true;
+}
+#endif
 
 
 MPC::MPC(Matrix &A, Matrix &B, Matrix &C, float_prec _bobotQ, float_prec _bobotR)
 {
+#if defined(MPC_USE_PHASE_PROFILING)
+    vProfileCounterInit();
+    vResetPhaseStat();
+#endif
+#if defined(MPC_REINIT_CACHE_LEN)
+    f32ReInitCacheQuantum = MPC_REINIT_CACHE_QUANTUM;
+    vClearReInitCache();
+#endif
+#if defined(MPC_USE_ITERATIVE_REFINEMENT)
+    i32RefineIteration = 0;
+#endif
     vReInit(A, B, C, _bobotQ, _bobotR);
 }
 
+MPC::MPC()
+{
+#if defined(MPC_USE_PHASE_PROFILING)
+    vProfileCounterInit();
+    vResetPhaseStat();
+#endif
+#if defined(MPC_REINIT_CACHE_LEN)
+    f32ReInitCacheQuantum = MPC_REINIT_CACHE_QUANTUM;
+    vClearReInitCache();
+#endif
+#if defined(MPC_USE_ITERATIVE_REFINEMENT)
+    i32RefineIteration = 0;
+#endif
+    for (int32_t _j = 0; _j < MPC_HC_LEN; _j++) {
+        i32CoincidenceTime[_j] = 0;
+    }
+    /* Nothing to solve with until vReInit() or bLoadSnapshot() */
+    Qt_L.vSetMatrixInvalid();
+}
+
+#if defined(MPC_USE_REINIT_WORKSPACE)
+void MPC::vReInit(Matrix &A, Matrix &B, Matrix &C, float_prec _bobotQ, float_prec _bobotR)
+{
+    vReInit(A, B, C, _bobotQ, _bobotR, f32ReInitWorkspace);
+}
+
+void MPC::vReInit(Matrix &A, Matrix &B, Matrix &C, float_prec _bobotQ, float_prec _bobotR, float_prec * _workspace)
+#else
 void MPC::vReInit(Matrix &A, Matrix &B, Matrix &C, float_prec _bobotQ, float_prec _bobotR)
+#endif
 {
     this->A = A;
     this->B = B;
     this->C = C;
+    
+#if defined(MPC_REINIT_CACHE_LEN)
+    /* The same (quantized) model & weights as a cached vReInit(): copy its result back */
+    float_prec _key[MPC_REINIT_CACHE_KEY_LEN];
+    const uint32_t _hash = u32ReInitCacheKey(_key, A, B, C, _bobotQ, _bobotR, f32ReInitCacheQuantum);
+    int32_t _entry = i32ReInitCacheFind(ReInitCacheTag, _key, _hash);
+    u32ReInitCacheClock++;
+    if (_entry >= 0) {
+        u32ReInitCacheHit++;
+        ReInitCacheTag[_entry].u32lastUse = u32ReInitCacheClock;
+        pGetOnline(u8ReInitCacheData[_entry]);
+        return;
+    }
+    u32ReInitCacheMiss++;
+#endif
+    
     SQ.vSetDiag(sqrt(_bobotQ));
     SR.vSetDiag(sqrt(_bobotR));
     
-    /*  Calculate prediction of z(k+1..k+Hp) constants
+    /*  Calculate prediction of z(k+T(1)..k+T(Hc)) constants
      *
-     *      Prediction of state variable of the system:
-     *        z(k+1..k+Hp) = (CPSI)*x(k) + (COMEGA)*u(k-1) + (CTHETA)*dU(k..k+Hu-1)         ...{MPC_1}
+     *      Prediction of state variable of the system at the coincidence points:
+     *        z(k+T(1)..k+T(Hc)) = (CPSI)*x(k) + (COMEGA)*u(k-1) + (CTHETA)*dU(k..k+Hu-1)   ...{MPC_1}
      *
      *        Constants:
-     *          CPSI   = [CA C(A^2) ... C(A^Hp)]'                                       : (Hp*N)xN
-     *          COMEGA = [CB C(B+A*B) ... C*Sigma(i=0->Hp-1)A^i*B]'                     : (Hp*N)xM
-     *          CTHETA = [         CB                0  ....           0              ]
-     *                   [       C(B+A*B)           CB   .             0              ]
-     *                   [           .               .    .           CB              ] : (Hp*N)x(Hu*M)
-     *                   [           .               .     .           .              ]
-     *                   [C*Sigma(i=0->Hp-1)(A^i*B)  .  ....  C*Sigma(i=0->Hp-Hu)A^i*B]
+     *          CPSI   = [C(A^T(1)) C(A^T(2)) ... C(A^T(Hc))]'                          : (Hc*N)xN
+     *          COMEGA = [C*S(T(1)) C*S(T(2)) ... C*S(T(Hc))]'                          : (Hc*N)xM
+     *          CTHETA = [C*S(T(1))    C*S(T(1)-1)  ....  C*S(T(1)-Hu+1) ]
+     *                   [C*S(T(2))    C*S(T(2)-1)  ....  C*S(T(2)-Hu+1) ]
+     *                   [    .             .         .         .        ]              : (Hc*N)x(Hu*M)
+     *                   [C*S(T(Hc))   C*S(T(Hc)-1) ....  C*S(T(Hc)-Hu+1)]
+     *
+     *          S(s)   = Sigma(i=0->s-1)A^i*B  ; S(s) = 0 for s <= 0
+     *
+     *  Each grid segment with step m*dt is discretized once into (A^m, S(m)), then we walk
+     *  the Hp prediction steps with it:
+     *          A^(t+m) = A^m * A^t
+     *          S(t+m)  = S(m) + A^m * S(t)
      *
+     *  The same update walks S(t-c) of the CTHETA columns 0 < c < Hu along, once t >= c (before
+     *  that S(t-c) = 0). Inside a segment with m > 1, the first S(t+m-c) with 0 < t+m-c < m comes
+     *  from vCalculatePowerSigma() instead. Only the blocks that land on a coincidence point are
+     *  inserted (the matrices are built row-sparse: the rows of the prediction steps that are not
+     *  evaluated are never stored).
+     *
+     *  With MPC_USE_REINIT_WORKSPACE the same steps run on the raw arrays of the workspace.
      */
+    MPC_PROFILE_BEGIN(1);
+#if defined(MPC_USE_REINIT_WORKSPACE)
+    vCalculatePrediction(_workspace);
+#else
+    /* Counted in MPC_STACK_REINIT_BYTES (mpc.h), change it with the Matrix objects below */
+    const int32_t _P[MPC_HC_LEN] = MPC_COINCIDENCE_POINTS;
+    const int32_t _G[MPC_GRID_SEGMENT_LEN][2] = MPC_GRID_SEGMENTS;
     Matrix _Apow(SS_X_LEN, SS_X_LEN);
-    /* CPSI     : [ C *   A  ]
-     *            [ C *  A^2 ]
-     *            [     .    ]                                                   : (Hp*N) x N
-     *            [     .    ]
-     *            [ C * A^Hp ]
-     */
-    _Apow = A;
-    for (int32_t _i = 0; _i < MPC_HP_LEN; _i++) {
-        CPSI = CPSI.InsertSubMatrix((C*_Apow), _i*SS_Z_LEN, 0);
-        _Apow = _Apow * A;
-    }
+    Matrix _Sigma(SS_X_LEN, (MPC_HU_LEN*SS_U_LEN));
+    Matrix _Aseg(SS_X_LEN, SS_X_LEN);
+    Matrix _Sseg(SS_X_LEN, SS_U_LEN);
+    Matrix _Atheta(SS_X_LEN, SS_X_LEN);
+    Matrix _Stheta(SS_X_LEN, SS_U_LEN);
+    float_prec _col[SS_X_LEN];
     
-    /* COMEGA   : [          C * (B)         ]
-     *            [        C * (B+A*B)       ]
-     *            [             .            ]                                   : (Hp*N) x M
-     *            [             .            ]
-     *            [ C * Sigma(i=0->Hp-1)A^i*B]
-     */
-    Matrix _tempSigma(SS_X_LEN, SS_U_LEN);
-    _Apow.vSetIdentity();
-    _tempSigma = B;
-    for (int32_t _i = 0; _i < MPC_HP_LEN; _i++) {
-        COMEGA = COMEGA.InsertSubMatrix((C*_tempSigma), _i*SS_Z_LEN, 0);
-        _Apow = _Apow * A;
-        _tempSigma = _tempSigma + (_Apow*B);
-    }
-    
-    /* CTHETA   : [          C * (B)              0         ....              0             ]
-     *            [       C * (B+A*B)           C * (B)      .                0             ]
-     *            [            .                  .           .             C * (B)         ]: (Hp*N)x(Hu*M)
-     *            [            .                  .            .              .             ]
-     *            [C * Sigma(i=0->Hp-1)A^i*B      .         ....  C * Sigma(i=0->Hp-Hu)A^i*B]
-     *
-     *          : [COMEGA   [0 COMEGA(0:(len(COMEGA)-len(B)),:)]'  ....  [0..0 COMEGA(0:(len(COMEGA)-((Hp-Hu)*len(B))),:)]']
-     */
-    for (int32_t _i = 0; _i < MPC_HU_LEN; _i++) {
-        CTHETA = CTHETA.InsertSubMatrix(COMEGA, _i*SS_Z_LEN, _i*SS_U_LEN, (MPC_HP_LEN*SS_Z_LEN)-(_i*SS_Z_LEN), SS_U_LEN);
+    int32_t _s = 0;         /* Prediction step */
+    int32_t _t = 0;         /* Time of the prediction step (in dt) */
+    int32_t _j = 0;         /* Next coincidence point */
+    _Apow.vSetIdentity();   /* A^t */
+    _Sigma.vSetToZero();    /* [S(t) S(t-1) .. S(t-Hu+1)] */
+    for (int32_t _g = 0; _g < MPC_GRID_SEGMENT_LEN; _g++) {
+        /* Discretize the segment: (A^m, S(m)) */
+        vCalculatePowerSigma(_G[_g][1], _Aseg, _Sseg);
+        
+        for (int32_t _n = 0; _n < _G[_g][0]; _n++) {
+            for (int32_t _c = 0; _c < MPC_HU_LEN; _c++) {
+                if (_t >= _c) {
+                    /* S(t+m-c) = S(m) + A^m * S(t-c), column by column */
+                    for (int32_t _k = (_c*SS_U_LEN); _k < ((_c+1)*SS_U_LEN); _k++) {
+                        for (int32_t _i = 0; _i < SS_X_LEN; _i++) {
+                            float_prec _sum = 0.0;
+                            for (int32_t _l = 0; _l < SS_X_LEN; _l++) {
+                                _sum += (_Aseg[_i][_l] * _Sigma[_l][_k]);
+                            }
+                            _col[_i] = _Sseg[_i][_k - (_c*SS_U_LEN)] + _sum;
+                        }
+                        for (int32_t _i = 0; _i < SS_X_LEN; _i++) {
+                            _Sigma[_i][_k] = _col[_i];
+                        }
+                    }
+                } else if ((_t + _G[_g][1]) > _c) {
+                    /* The first step past c inside a segment: S(t+m-c) with 0 < t+m-c < m */
+                    vCalculatePowerSigma(_t + _G[_g][1] - _c, _Atheta, _Stheta);
+                    _Sigma = _Sigma.InsertSubMatrix(_Stheta, 0, _c*SS_U_LEN);
+                }
+            }
+            _Apow = _Aseg * _Apow;
+            _t += _G[_g][1];
+            _s++;
+            
+            if ((_j >= MPC_HC_LEN) || (_P[_j] != _s)) {
+                continue;
+            }
+            i32CoincidenceTime[_j] = _t;
+            
+            /* CTHETA(j, c) = C*S(T(j)-c) ; CPSI(j) = C*A^T(j) ; COMEGA(j) = CTHETA(j, 0) = C*S(T(j)) */
+            CTHETA = CTHETA.InsertSubMatrix((C*_Sigma), _j*SS_Z_LEN, 0);
+            CPSI   = CPSI.InsertSubMatrix((C*_Apow), _j*SS_Z_LEN, 0);
+            COMEGA = COMEGA.InsertSubMatrix(CTHETA, _j*SS_Z_LEN, 0, _j*SS_Z_LEN, 0, SS_Z_LEN, SS_U_LEN);
+            _j++;
+        }
     }
+    ASSERT((_s == MPC_HP_LEN) && (_j == MPC_HC_LEN), "The MPC_GRID_SEGMENTS or MPC_COINCIDENCE_POINTS don't match MPC_HP_LEN / MPC_HC_LEN");
+#endif
+    MPC_PROFILE_END(1);
     
     
     /* Calculate offline optimization constants
@@ -145,18 +354,462 @@ void MPC::vReInit(Matrix &A, Matrix &B, Matrix &C, float_prec _bobotQ, float_pre
      * 
      * NOTE: QRDec function return the transpose of Q (i.e. Q').
      */
-    Matrix GammaLeft((MPC_HP_LEN*SS_Z_LEN + MPC_HU_LEN*SS_U_LEN), MPC_HP_LEN*SS_Z_LEN);
+    MPC_PROFILE_BEGIN(2);
+#if defined(MPC_USE_REINIT_WORKSPACE)
+    /* GammaLeft is built in R_L, then each Householder reflection P = I - 2*v*v'/(v'*v) of QRDec() is
+     *  applied to R_L & Qt_L in place (without forming P), with v on the workspace
+     */
+    const int32_t _m = (MPC_HC_LEN*SS_Z_LEN + MPC_HU_LEN*SS_U_LEN);
+    float_prec * const _v = _workspace;
+    Qt_L.vSetDimension(_m, _m);
+    R_L.vSetDimension(_m, MPC_HC_LEN*SS_Z_LEN);
+    Qt_L.vSetIdentity();
+    R_L.vSetToZero();
+    const float_prec _sqrtQ = sqrt(_bobotQ);
+    const float_prec _sqrtR = sqrt(_bobotR);
+    for (int32_t _i = 0; _i < (MPC_HC_LEN*SS_Z_LEN); _i++) {
+        for (int32_t _k = 0; _k < (MPC_HU_LEN*SS_U_LEN); _k++) {
+            R_L[_i][_k] = _sqrtQ * CTHETA[_i][_k];
+        }
+    }
+    for (int32_t _i = 0; _i < (MPC_HU_LEN*SS_U_LEN); _i++) {
+        R_L[(MPC_HC_LEN*SS_Z_LEN) + _i][_i] = _sqrtR;
+    }
+    for (int32_t _i = 0; (_i < (_m - 1)) && (_i < ((MPC_HC_LEN*SS_Z_LEN) - 1)); _i++) {
+        /* v = x - sign(x1)*||x||*e1, with x = R_L(i:m, i) */
+        const float_prec _x1 = R_L[_i][_i];
+        float_prec _xLen = _x1*_x1;
+        float_prec _vLen2 = 0;
+        for (int32_t _r = _i+1; _r < _m; _r++) {
+            _v[_r] = R_L[_r][_i];
+            _xLen  += _v[_r]*_v[_r];
+            _vLen2 += _v[_r]*_v[_r];
+        }
+        _xLen = sqrt(_xLen);
+        _v[_i] = (_x1 < 0) ? (_x1 + _xLen) : (_x1 - _xLen);
+        _vLen2 += _v[_i]*_v[_i];
+        if (fabs(_vLen2) < float_prec(float_prec_ZERO)) {
+            /* x is collinear with e1, P = I */
+            continue;
+        }
+        /* R_L = P*R_L (its first i columns are already zero below the diagonal), Qt_L = P*Qt_L */
+        for (int32_t _c = _i; _c < (MPC_HC_LEN*SS_Z_LEN); _c++) {
+            float_prec _dot = 0;
+            for (int32_t _r = _i; _r < _m; _r++) {
+                _dot += _v[_r] * R_L[_r][_c];
+            }
+            _dot *= float_prec(2.0) / _vLen2;
+            for (int32_t _r = _i; _r < _m; _r++) {
+                R_L[_r][_c] -= _dot * _v[_r];
+            }
+        }
+        for (int32_t _c = 0; _c < _m; _c++) {
+            float_prec _dot = 0;
+            for (int32_t _r = _i; _r < _m; _r++) {
+                _dot += _v[_r] * Qt_L[_r][_c];
+            }
+            _dot *= float_prec(2.0) / _vLen2;
+            for (int32_t _r = _i; _r < _m; _r++) {
+                Qt_L[_r][_c] -= _dot * _v[_r];
+            }
+        }
+    }
+    Qt_L.vRoundingMatrixToZero();
+#else
+    Matrix GammaLeft((MPC_HC_LEN*SS_Z_LEN + MPC_HU_LEN*SS_U_LEN), MPC_HC_LEN*SS_Z_LEN);
     GammaLeft = GammaLeft.InsertSubMatrix((SQ * CTHETA), 0, 0);
-    GammaLeft = GammaLeft.InsertSubMatrix(SR, MPC_HP_LEN*SS_Z_LEN, 0);
+    GammaLeft = GammaLeft.InsertSubMatrix(SR, MPC_HC_LEN*SS_Z_LEN, 0);
+    /* Qt_L & R_L are invalid after a failed decomposition (or from MPC()), give them back their dimension */
+    Qt_L = Matrix((MPC_HC_LEN*SS_Z_LEN + MPC_HU_LEN*SS_U_LEN), (MPC_HC_LEN*SS_Z_LEN + MPC_HU_LEN*SS_U_LEN));
+    R_L  = Matrix((MPC_HC_LEN*SS_Z_LEN + MPC_HU_LEN*SS_U_LEN), MPC_HC_LEN*SS_Z_LEN);
     GammaLeft.QRDec(Qt_L, R_L);
+#endif
+    MPC_PROFILE_END(2);
+    
+#if defined(MPC_REINIT_CACHE_LEN)
+    if (Qt_L.bMatrixIsValid()) {
+        _entry = i32ReInitCacheVictim(ReInitCacheTag);
+        ReInitCacheTag[_entry].bValid     = true;
+        ReInitCacheTag[_entry].u32hash    = _hash;
+        ReInitCacheTag[_entry].u32lastUse = u32ReInitCacheClock;
+        memcpy(ReInitCacheTag[_entry].f32key, _key, sizeof(_key));
+        pPutOnline(u8ReInitCacheData[_entry]);
+    }
+#endif
 }
 
+/*  Snapshot payload (see snapshot.h), all row-major with the matrix dimension as the stride:
+ *      i32CoincidenceTime [Hc]     (padded to float_prec)
+ *      CPSI, COMEGA, SQ
+ *      Qt_L(1:Hu*M, 1:Hc*Z)        (bUpdate only uses these rows & columns of Qt_L and R_L)
+ *      CTHETA, SR                  (only with MPC_USE_ITERATIVE_REFINEMENT, for the residual of vRefine())
+ *      R_L(1:Hu*M, 1:Hu*M)
+ */
+MPC_SnapshotInfo MPC::SnapshotInfo()
+{
+    MPC_SnapshotInfo _info;
+    _info.u8kind = MPC_SNAPSHOT_KIND_LEAST_SQUARE;
+    _info.i32x  = SS_X_LEN;
+    _info.i32u  = SS_U_LEN;
+    _info.i32z  = SS_Z_LEN;
+    _info.i32hp = MPC_HP_LEN;
+    _info.i32hu = MPC_HU_LEN;
+    _info.i32hc = MPC_HC_LEN;
+    return _info;
+}
+
+size_t MPC::szSnapshotPayloadBytes()
+{
+    return MPC_ONLINE_BYTES;
+}
+
+size_t MPC::szSnapshotBytes()
+{
+    return MPC_SNAPSHOT_HEADER_BYTES + szSnapshotPayloadBytes();
+}
+
+/* Write (read) the online constants in the snapshot payload layout, return the end of the payload */
+uint8_t * MPC::pPutOnline(uint8_t * _p)
+{
+    memset(_p, 0, MPC_SNAPSHOT_INT_BYTES(MPC_HC_LEN));
+    pSnapshotPutInt(_p, i32CoincidenceTime, MPC_HC_LEN);
+    _p += MPC_SNAPSHOT_INT_BYTES(MPC_HC_LEN);
+    _p = pSnapshotPutBlock(_p, CPSI, (MPC_HC_LEN*SS_Z_LEN), SS_X_LEN);
+    _p = pSnapshotPutBlock(_p, COMEGA, (MPC_HC_LEN*SS_Z_LEN), SS_U_LEN);
+    _p = pSnapshotPutBlock(_p, SQ, (MPC_HC_LEN*SS_Z_LEN), (MPC_HC_LEN*SS_Z_LEN));
+    _p = pSnapshotPutBlock(_p, Qt_L, (MPC_HU_LEN*SS_U_LEN), (MPC_HC_LEN*SS_Z_LEN));
+#if defined(MPC_USE_ITERATIVE_REFINEMENT)
+    _p = pSnapshotPutBlock(_p, CTHETA, (MPC_HC_LEN*SS_Z_LEN), (MPC_HU_LEN*SS_U_LEN));
+    _p = pSnapshotPutBlock(_p, SR, (MPC_HU_LEN*SS_U_LEN), (MPC_HU_LEN*SS_U_LEN));
+#endif
+    return pSnapshotPutBlock(_p, R_L, (MPC_HU_LEN*SS_U_LEN), (MPC_HU_LEN*SS_U_LEN));
+}
+
+const uint8_t * MPC::pGetOnline(const uint8_t * _p)
+{
+    /* Restore the dimension of Qt_L & R_L (see vReInit) */
+    Qt_L = Matrix((MPC_HC_LEN*SS_Z_LEN + MPC_HU_LEN*SS_U_LEN), (MPC_HC_LEN*SS_Z_LEN + MPC_HU_LEN*SS_U_LEN));
+    R_L  = Matrix((MPC_HC_LEN*SS_Z_LEN + MPC_HU_LEN*SS_U_LEN), MPC_HC_LEN*SS_Z_LEN);
+    
+    pSnapshotGetInt(_p, i32CoincidenceTime, MPC_HC_LEN);
+    _p += MPC_SNAPSHOT_INT_BYTES(MPC_HC_LEN);
+    _p = pSnapshotGetBlock(_p, CPSI, (MPC_HC_LEN*SS_Z_LEN), SS_X_LEN);
+    _p = pSnapshotGetBlock(_p, COMEGA, (MPC_HC_LEN*SS_Z_LEN), SS_U_LEN);
+    _p = pSnapshotGetBlock(_p, SQ, (MPC_HC_LEN*SS_Z_LEN), (MPC_HC_LEN*SS_Z_LEN));
+    _p = pSnapshotGetBlock(_p, Qt_L, (MPC_HU_LEN*SS_U_LEN), (MPC_HC_LEN*SS_Z_LEN));
+#if defined(MPC_USE_ITERATIVE_REFINEMENT)
+    _p = pSnapshotGetBlock(_p, CTHETA, (MPC_HC_LEN*SS_Z_LEN), (MPC_HU_LEN*SS_U_LEN));
+    _p = pSnapshotGetBlock(_p, SR, (MPC_HU_LEN*SS_U_LEN), (MPC_HU_LEN*SS_U_LEN));
+#endif
+    return pSnapshotGetBlock(_p, R_L, (MPC_HU_LEN*SS_U_LEN), (MPC_HU_LEN*SS_U_LEN));
+}
+
+bool MPC::bSaveSnapshot(void * _buf, const size_t _bufBytes)
+{
+    if ((_buf == NULL) || (_bufBytes < szSnapshotBytes()) || !Qt_L.bMatrixIsValid()) {
+        return false;
+    }
+    pPutOnline(((uint8_t *) _buf) + MPC_SNAPSHOT_HEADER_BYTES);
+    vSnapshotWriteHeader((uint8_t *) _buf, SnapshotInfo(), uint32_t(szSnapshotPayloadBytes()));
+    return true;
+}
+
+bool MPC::bLoadSnapshot(const void * _snapshot, const size_t _bytes)
+{
+    const uint8_t * _p = pSnapshotCheck(_snapshot, _bytes, SnapshotInfo(), uint32_t(szSnapshotPayloadBytes()));
+    if (_p == NULL) {
+        return false;
+    }
+    pGetOnline(_p);
+    return true;
+}
+
+#if defined(MPC_REINIT_CACHE_LEN)
+void MPC::vSetReInitCacheQuantum(const float_prec _quantum)
+{
+    f32ReInitCacheQuantum = _quantum;
+    vClearReInitCache();
+}
+
+void MPC::vClearReInitCache()
+{
+    for (int32_t _i = 0; _i < MPC_REINIT_CACHE_LEN; _i++) {
+        ReInitCacheTag[_i].bValid = false;
+    }
+    u32ReInitCacheClock = 0;
+    u32ReInitCacheHit   = 0;
+    u32ReInitCacheMiss  = 0;
+}
+#endif
+
+#if defined(MPC_USE_PHASE_PROFILING)
+void MPC::vResetPhaseStat()
+{
+    for (int32_t _i = 0; _i < MPC_PHASE_LEN; _i++) {
+        vProfileReset(PhaseStat[_i]);
+    }
+}
+#endif
+
+/*  Calculate A^n and S(n) = Sigma(i=0->n-1)A^i*B by repeated squaring, using:
+ *          A^(a+b) = A^a * A^b
+ *          S(a+b)  = S(a) + A^a * S(b)
+ */
+void MPC::vCalculatePowerSigma(int32_t _n, Matrix &_Apow, Matrix &_Sigma)
+{
+    /* Counted in MPC_STACK_POWER_SIGMA (mpc.h), change it with the Matrix objects below */
+    Matrix _Asq(SS_X_LEN, SS_X_LEN);
+    Matrix _Ssq(SS_X_LEN, SS_U_LEN);
+    
+    _Apow.vSetIdentity();
+    _Sigma.vSetToZero();
+    _Asq = A;
+    _Ssq = B;
+    while (_n > 0) {
+        if (_n & 1) {
+            _Sigma = _Ssq + (_Asq * _Sigma);
+            _Apow  = _Asq * _Apow;
+        }
+        _n >>= 1;
+        if (_n > 0) {
+            _Ssq = _Ssq + (_Asq * _Ssq);
+            _Asq = _Asq * _Asq;
+        }
+    }
+}
+
+#if defined(MPC_USE_REINIT_WORKSPACE)
+/* vCalculatePowerSigma() on the workspace arrays: _Apow (X x X) & _Sigma (X x U), with _workspace
+ *  holding the product, A^a & S(a) (MPC_REINIT_POWER_SIGMA_LEN elements)
+ */
+void MPC::vCalculatePowerSigma(int32_t _n, float_prec * _Apow, float_prec * _Sigma, float_prec * _workspace)
+{
+    float_prec * const _tmp = _workspace;
+    float_prec * const _Asq = _tmp + (SS_X_LEN*SS_X_LEN);
+    float_prec * const _Ssq = _Asq + (SS_X_LEN*SS_X_LEN);
+    
+    for (int32_t _i = 0; _i < SS_X_LEN; _i++) {
+        for (int32_t _j = 0; _j < SS_X_LEN; _j++) {
+            _Apow[(_i*SS_X_LEN) + _j] = (_i == _j) ? float_prec(1.0) : float_prec(0.0);
+            _Asq[(_i*SS_X_LEN) + _j]  = A[_i][_j];
+        }
+        for (int32_t _j = 0; _j < SS_U_LEN; _j++) {
+            _Sigma[(_i*SS_U_LEN) + _j] = 0;
+            _Ssq[(_i*SS_U_LEN) + _j]   = B[_i][_j];
+        }
+    }
+    while (_n > 0) {
+        if (_n & 1) {
+            vWorkspaceMulAdd(_Sigma, _Ssq, _Asq, _Sigma, SS_U_LEN, _tmp);
+            vWorkspaceMulAdd(_Apow, NULL, _Asq, _Apow, SS_X_LEN, _tmp);
+        }
+        _n >>= 1;
+        if (_n > 0) {
+            vWorkspaceMulAdd(_Ssq, _Ssq, _Asq, _Ssq, SS_U_LEN, _tmp);
+            vWorkspaceMulAdd(_Asq, NULL, _Asq, _Asq, SS_X_LEN, _tmp);
+        }
+    }
+}
+
+/* {MPC_1} of vReInit() on the workspace (MPC_REINIT_PREDICTION_LEN elements), see there */
+void MPC::vCalculatePrediction(float_prec * _workspace)
+{
+    const int32_t _P[MPC_HC_LEN] = MPC_COINCIDENCE_POINTS;
+    const int32_t _G[MPC_GRID_SEGMENT_LEN][2] = MPC_GRID_SEGMENTS;
+    float_prec * const _Apow    = _workspace;
+    float_prec * const _Aseg    = _Apow   + (SS_X_LEN*SS_X_LEN);
+    float_prec * const _Atheta  = _Aseg   + (SS_X_LEN*SS_X_LEN);
+    float_prec * const _Sseg    = _Atheta + (SS_X_LEN*SS_X_LEN);
+    float_prec * const _Sigma   = _Sseg   + (SS_X_LEN*SS_U_LEN);    /* S(t-c) at _Sigma + c*X*U, 0 <= c < Hu */
+    float_prec * const _scratch = _Sigma  + (MPC_HU_LEN*SS_X_LEN*SS_U_LEN);   /* vCalculatePowerSigma(), its first X*X for the products */
+    
+    int32_t _s = 0;         /* Prediction step */
+    int32_t _t = 0;         /* Time of the prediction step (in dt) */
+    int32_t _j = 0;         /* Next coincidence point */
+    for (int32_t _i = 0; _i < SS_X_LEN; _i++) {
+        for (int32_t _k = 0; _k < SS_X_LEN; _k++) {
+            _Apow[(_i*SS_X_LEN) + _k] = (_i == _k) ? float_prec(1.0) : float_prec(0.0);
+        }
+    }
+    for (int32_t _i = 0; _i < (MPC_HU_LEN*SS_X_LEN*SS_U_LEN); _i++) {
+        _Sigma[_i] = 0;
+    }
+    for (int32_t _g = 0; _g < MPC_GRID_SEGMENT_LEN; _g++) {
+        vCalculatePowerSigma(_G[_g][1], _Aseg, _Sseg, _scratch);
+        
+        for (int32_t _n = 0; _n < _G[_g][0]; _n++) {
+            for (int32_t _c = 0; _c < MPC_HU_LEN; _c++) {
+                float_prec * const _Sc = _Sigma + (_c*SS_X_LEN*SS_U_LEN);
+                if (_t >= _c) {
+                    vWorkspaceMulAdd(_Sc, _Sseg, _Aseg, _Sc, SS_U_LEN, _scratch);
+                } else if ((_t + _G[_g][1]) > _c) {
+                    vCalculatePowerSigma(_t + _G[_g][1] - _c, _Atheta, _Sc, _scratch);
+                }
+            }
+            vWorkspaceMulAdd(_Apow, NULL, _Aseg, _Apow, SS_X_LEN, _scratch);
+            _t += _G[_g][1];
+            _s++;
+            
+            if ((_j >= MPC_HC_LEN) || (_P[_j] != _s)) {
+                continue;
+            }
+            i32CoincidenceTime[_j] = _t;
+            
+            vWorkspaceInsertC(CPSI, _j*SS_Z_LEN, 0, C, _Apow, SS_X_LEN);
+            vWorkspaceInsertC(COMEGA, _j*SS_Z_LEN, 0, C, _Sigma, SS_U_LEN);
+            for (int32_t _c = 0; _c < MPC_HU_LEN; _c++) {
+                vWorkspaceInsertC(CTHETA, _j*SS_Z_LEN, _c*SS_U_LEN, C, _Sigma + (_c*SS_X_LEN*SS_U_LEN), SS_U_LEN);
+            }
+            _j++;
+        }
+    }
+    ASSERT((_s == MPC_HP_LEN) && (_j == MPC_HC_LEN), "The MPC_GRID_SEGMENTS or MPC_COINCIDENCE_POINTS don't match MPC_HP_LEN / MPC_HC_LEN");
+}
+#endif
+
+#if defined(MPC_USE_ITERATIVE_REFINEMENT)
+/* Iterative refinement of dU(k) with the corrected semi-normal equations: the residual of the least square
+ *  problem, summed in double from what [SQ*CTHETA; SR] is made of (not from Qt_L & R_L, they're already
+ *  rounded to float_prec):
+ *
+ *      r = CTHETA'*SQ^2*(E(k) - CTHETA*dU(k)) - SR^2*dU(k)  ;  E(k) = SP(k) - CPSI*x(k) - COMEGA*u(k-1)
+ *
+ *  then R1'*R1 * corr = r with R1 = R_L(1:Hu*M, 1:Hu*M) (R1'*R1 = CTHETA'*SQ^2*CTHETA + SR^2) and
+ *  dU(k) += corr, with the (diagonal) SQ & SR of vReInit(). _res holds the residual, then the correction.
+ */
+void MPC::vRefine(Matrix &SP, Matrix &x, Matrix &u, float_prec * _du, float_prec * _res)
+{
+    const int32_t _n = (MPC_HU_LEN*SS_U_LEN);
+    double _r[MPC_HU_LEN*SS_U_LEN];
+    for (i32RefineIteration = 0; i32RefineIteration < MPC_REFINE_MAX_ITER; ) {
+        for (int32_t _i = 0; _i < _n; _i++) {
+            const double _sr = double(SR.pRowUnchecked(_i)[_i]);
+            _r[_i] = -(_sr * _sr) * double(_du[_i]);
+        }
+        for (int32_t _k = 0; _k < (MPC_HC_LEN*SS_Z_LEN); _k++) {
+            const float_prec * const _psi = CPSI.pRowUnchecked(_k);
+            const float_prec * const _omega = COMEGA.pRowUnchecked(_k);
+            const float_prec * const _theta = CTHETA.pRowUnchecked(_k);
+            const double _sq = double(SQ.pRowUnchecked(_k)[_k]);
+            double _e = double(SP.pRowUnchecked(_k)[0]);
+            for (int32_t _j = 0; _j < SS_X_LEN; _j++) {
+                _e -= double(_psi[_j]) * double(x.pRowUnchecked(_j)[0]);
+            }
+            for (int32_t _j = 0; _j < SS_U_LEN; _j++) {
+                _e -= double(_omega[_j]) * double(u.pRowUnchecked(_j)[0]);
+            }
+            for (int32_t _j = 0; _j < _n; _j++) {
+                _e -= double(_theta[_j]) * double(_du[_j]);
+            }
+            _e *= (_sq * _sq);
+            for (int32_t _i = 0; _i < _n; _i++) {
+                _r[_i] += double(_theta[_i]) * _e;
+            }
+        }
+        for (int32_t _i = 0; _i < _n; _i++) {
+            _res[_i] = float_prec(_r[_i]);
+        }
+        if (!bRefineForwardSubtitution(R_L, _res, _n) || !bWorkspaceBackSubtitution(R_L, _res, _res, _n)) {
+            break;
+        }
+        for (int32_t _i = 0; _i < _n; _i++) {
+            _du[_i] += _res[_i];
+        }
+        i32RefineIteration++;
+        if (fRefineNormMax(_res, _n) <= (float_prec(MPC_REFINE_TOLERANCE) * fRefineNormMax(_du, _n))) {
+            break;
+        }
+    }
+}
+#endif
+
+#if defined(MPC_USE_UPDATE_WORKSPACE)
+bool MPC::bUpdate(Matrix &SP, Matrix &x, Matrix &u)
+{
+    return bUpdate(SP, x, u, f32UpdateWorkspace);
+}
+
+/* bUpdate() on the raw arrays of the workspace: the same {MPC_3}..{MPC_6}, with the (diagonal) SQ of
+ *  vReInit(), and only the first (Hu*M) rows of Qt_L & R_L read in place instead of copied out. If the
+ *  back-substitution meets a zero pivot, it returns false and u(k) doesn't change.
+ */
+bool MPC::bUpdate(Matrix &SP, Matrix &x, Matrix &u, float_prec * _workspace)
+{
+    const int32_t _n = (MPC_HU_LEN*SS_U_LEN);
+    float_prec * const _err = _workspace;
+    float_prec * const _rhs = _err + (MPC_HC_LEN*SS_Z_LEN);
+    float_prec * const _du  = _rhs + _n;
+    float_prec * const _res = _du + _n;
+    
+    /*  E(k) = SP(k) - CPSI*x(k) - COMEGA*u(k-1)                                            ...{MPC_3} */
+    MPC_PROFILE_BEGIN(3);
+    for (int32_t _i = 0; _i < (MPC_HC_LEN*SS_Z_LEN); _i++) {
+        const float_prec * const _psi = CPSI.pRowUnchecked(_i);
+        const float_prec * const _omega = COMEGA.pRowUnchecked(_i);
+        float_prec _sumPsi = 0;
+        float_prec _sumOmega = 0;
+        for (int32_t _j = 0; _j < SS_X_LEN; _j++) {
+            _sumPsi += _psi[_j] * x.pRowUnchecked(_j)[0];
+        }
+        for (int32_t _j = 0; _j < SS_U_LEN; _j++) {
+            _sumOmega += _omega[_j] * u.pRowUnchecked(_j)[0];
+        }
+        _err[_i] = SP.pRowUnchecked(_i)[0] - _sumPsi - _sumOmega;
+    }
+    MPC_PROFILE_END(3);
+    
+    if (!Qt_L.bMatrixIsValid()) {
+        /* The QR Decomposition in the initialization step has failed, return false */
+        return false;
+    }
+    
+    /*  R_L * dU(k)_optimal = Qt_L * [(SQ*E(k)]                                             ...{MPC_4}
+     *                               [    0   ]
+     */
+    MPC_PROFILE_BEGIN(4);
+    for (int32_t _i = 0; _i < _n; _i++) {
+        const float_prec * const _qRow = Qt_L.pRowUnchecked(_i);
+        float_prec _sum = 0;
+        for (int32_t _k = 0; _k < (MPC_HC_LEN*SS_Z_LEN); _k++) {
+            _sum += (_qRow[_k] * SQ.pRowUnchecked(_k)[_k]) * _err[_k];
+        }
+        _rhs[_i] = _sum;
+    }
+    MPC_PROFILE_END(4);
+    
+    /*  Back-substitution                                                                   ...{MPC_5} */
+    MPC_PROFILE_BEGIN(5);
+    if (!bWorkspaceBackSubtitution(R_L, _rhs, _du, _n)) {
+        MPC_PROFILE_END(5);
+        
+        return false;
+    }
+    #if defined(MPC_USE_ITERATIVE_REFINEMENT)
+        vRefine(SP, x, u, _du, _res);
+    #else
+        (void) _res;
+    #endif
+    MPC_PROFILE_END(5);
+    
+    /*  u(k) = u(k-1) + du(k)                                                                   ...{MPC_6} */
+    MPC_PROFILE_BEGIN(6);
+    for (int32_t _i = 0; _i < SS_U_LEN; _i++) {
+        u.pRowUnchecked(_i)[0] = u.pRowUnchecked(_i)[0] + _du[_i];
+    }
+    MPC_PROFILE_END(6);
+    
+    return true;
+}
+#else
 bool MPC::bUpdate(Matrix &SP, Matrix &x, Matrix &u)
 {
-    Matrix Err((MPC_HP_LEN*SS_Z_LEN), 1);
+    /* Counted in MPC_STACK_UPDATE_BYTES (mpc.h), change it with the Matrix objects below */
+    MPC_PROFILE_BEGIN(3);
+    Matrix Err((MPC_HC_LEN*SS_Z_LEN), 1);
     
     /*  E(k) = SP(k) - CPSI*x(k) - COMEGA*u(k-1)                                            ...{MPC_3} */
     Err = SP - CPSI*x - COMEGA*u;
+    MPC_PROFILE_END(3);
     
 
     if (!Qt_L.bMatrixIsValid()) {
@@ -169,13 +822,14 @@ bool MPC::bUpdate(Matrix &SP, Matrix &x, Matrix &u)
          *          R_L * dU(k)_optimal = Qt_L * [(SQ*E(k)]                                 ...{MPC_4}
          *                                       [    0   ]
          * 
-         * NOTE: We only need the first (Hp*Z)-th columns of Qt_L to construct the 
+         * NOTE: We only need the first (Hc*Z)-th columns of Qt_L to construct the 
          *          right hand equation (encapsulated in Qt_LSQE variable).
          */
-        Matrix Q1((MPC_HP_LEN*SS_Z_LEN + MPC_HU_LEN*SS_U_LEN), MPC_HP_LEN*SS_Z_LEN);
-        Q1 = Q1.InsertSubMatrix(Qt_L, 0, 0, 0, 0, (MPC_HP_LEN*SS_Z_LEN + MPC_HU_LEN*SS_U_LEN), MPC_HP_LEN*SS_Z_LEN);
+        MPC_PROFILE_BEGIN(4);
+        Matrix Q1((MPC_HC_LEN*SS_Z_LEN + MPC_HU_LEN*SS_U_LEN), MPC_HC_LEN*SS_Z_LEN);
+        Q1 = Q1.InsertSubMatrix(Qt_L, 0, 0, 0, 0, (MPC_HC_LEN*SS_Z_LEN + MPC_HU_LEN*SS_U_LEN), MPC_HC_LEN*SS_Z_LEN);
 
-        Matrix Qt_LSQE(((MPC_HP_LEN*SS_Z_LEN + MPC_HU_LEN*SS_U_LEN)), 1);
+        Matrix Qt_LSQE(((MPC_HC_LEN*SS_Z_LEN + MPC_HU_LEN*SS_U_LEN)), 1);
         Qt_LSQE = Q1*SQ*Err;
         
         /* The linear equation is overdetermined, just need the first (Hu*M)-th row */
@@ -184,22 +838,41 @@ bool MPC::bUpdate(Matrix &SP, Matrix &x, Matrix &u)
         /* The linear equation is overdetermined, just need the first (Hu*M)-th row */
         Matrix R1(MPC_HU_LEN*SS_U_LEN, MPC_HU_LEN*SS_U_LEN);
         R1 = R1.InsertSubMatrix(R_L, 0, 0, 0, 0, MPC_HU_LEN*SS_U_LEN, MPC_HU_LEN*SS_U_LEN);
+        MPC_PROFILE_END(4);
         
         
         /*      Calculate the optimal control solution using back-subtitution:
          *          R_L * dU(k)_optimal = BackSubRight                                      ...{MPC_5}
          */
+        MPC_PROFILE_BEGIN(5);
         DU = R1.BackSubtitution(R1, BackSubRight);
+    #if defined(MPC_USE_ITERATIVE_REFINEMENT)
+        if (DU.bMatrixIsValid()) {
+            float_prec _du[MPC_HU_LEN*SS_U_LEN];
+            float_prec _res[MPC_HU_LEN*SS_U_LEN];
+            for (int32_t _i = 0; _i < (MPC_HU_LEN*SS_U_LEN); _i++) {
+                _du[_i] = DU[_i][0];
+            }
+            vRefine(SP, x, u, _du, _res);
+            for (int32_t _i = 0; _i < (MPC_HU_LEN*SS_U_LEN); _i++) {
+                DU[_i][0] = _du[_i];
+            }
+        }
+    #endif
+        MPC_PROFILE_END(5);
     }
 
     /*      Integrate the du(k) to get u(k):
      *          u(k) = u(k-1) + du(k)                                                       ...{MPC_6}
      */
+    MPC_PROFILE_BEGIN(6);
     Matrix DU_Out(SS_U_LEN, 1);
     for (int32_t _i = 0; _i < SS_U_LEN; _i++) {
         DU_Out[_i][0] = DU[_i][0];
     }
     u = u + DU_Out;
+    MPC_PROFILE_END(6);
     
     return true;
 }
+#endif
@@ -9,41 +9,218 @@
 
 #include "konfig.h"
 #include "matrix.h"
+#include "profiler.h"
+#include "snapshot.h"
+#include "reinit_cache.h"
 
 
 #if (MPC_HP_LEN < MPC_HU_LEN)
     #error("The MPC_HP_LEN must be more than or equal MPC_HU_LEN!");
 #endif
-#if (((MPC_HP_LEN*SS_Z_LEN) > MATRIX_MAXIMUM_SIZE) || ((MPC_HP_LEN*SS_X_LEN) > MATRIX_MAXIMUM_SIZE) || ((MPC_HU_LEN*SS_U_LEN) > MATRIX_MAXIMUM_SIZE) || ((MPC_HP_LEN*SS_Z_LEN + MPC_HU_LEN*SS_U_LEN) > MATRIX_MAXIMUM_SIZE))
+#if ((MPC_HC_LEN < 1) || (MPC_HC_LEN > MPC_HP_LEN))
+    #error("The MPC_HC_LEN must be between 1 and MPC_HP_LEN!");
+#endif
+
+/* MPC_COINCIDENCE_POINTS must be MPC_HC_LEN prediction steps, strictly increasing & within 1..MPC_HP_LEN */
+constexpr int32_t MPC_COINCIDENCE_POINT_LIST[] = MPC_COINCIDENCE_POINTS;
+constexpr bool bMPCCoincidencePointsValid(const int32_t _i)
+{
+    return (_i >= MPC_HC_LEN) ||
+           ((MPC_COINCIDENCE_POINT_LIST[_i] >= ((_i == 0) ? 1 : (MPC_COINCIDENCE_POINT_LIST[_i-1] + 1))) &&
+            (MPC_COINCIDENCE_POINT_LIST[_i] <= MPC_HP_LEN) && bMPCCoincidencePointsValid(_i + 1));
+}
+static_assert((sizeof(MPC_COINCIDENCE_POINT_LIST) / sizeof(MPC_COINCIDENCE_POINT_LIST[0])) == MPC_HC_LEN,
+              "The MPC_COINCIDENCE_POINTS must have MPC_HC_LEN entries!");
+static_assert(bMPCCoincidencePointsValid(0),
+              "The MPC_COINCIDENCE_POINTS must be strictly increasing and between 1 and MPC_HP_LEN!");
+#if (((MPC_HC_LEN*SS_Z_LEN) > MATRIX_MAXIMUM_SIZE) || ((MPC_HU_LEN*SS_U_LEN) > MATRIX_MAXIMUM_SIZE) || ((MPC_HC_LEN*SS_Z_LEN + MPC_HU_LEN*SS_U_LEN) > MATRIX_MAXIMUM_SIZE))
     #error("The MATRIX_MAXIMUM_SIZE is too small to do MPC calculation!");
 #endif
 
+/* The float_prec elements of the vReInit() workspace (MPC_USE_REINIT_WORKSPACE in konfig.h): the product,
+ *  A^a & S(a) of vCalculatePowerSigma(), plus A^t, A^m, A^(t-c), S(m) & S(t-c) (0 <= c < Hu) of {MPC_1}; then reused
+ *  for the Householder vector of the QR decomposition
+ */
+#define MPC_REINIT_POWER_SIGMA_LEN  ((2*SS_X_LEN*SS_X_LEN) + (SS_X_LEN*SS_U_LEN))
+#define MPC_REINIT_PREDICTION_LEN   ((3*SS_X_LEN*SS_X_LEN) + ((MPC_HU_LEN + 1)*SS_X_LEN*SS_U_LEN) + MPC_REINIT_POWER_SIGMA_LEN)
+#define MPC_REINIT_QR_LEN           (MPC_HC_LEN*SS_Z_LEN + MPC_HU_LEN*SS_U_LEN)
+#define MPC_REINIT_WORKSPACE_LEN    ((MPC_REINIT_PREDICTION_LEN > MPC_REINIT_QR_LEN) ? MPC_REINIT_PREDICTION_LEN : MPC_REINIT_QR_LEN)
+#define MPC_REINIT_WORKSPACE_BYTES  (MPC_REINIT_WORKSPACE_LEN * sizeof(float_prec))
+
+/* The float_prec elements of the bUpdate() workspace (MPC_USE_UPDATE_WORKSPACE in konfig.h): E(k), the
+ *  right hand side of {MPC_5}, dU(k) and the residual (then correction) of the iterative refinement
+ */
+#define MPC_UPDATE_WORKSPACE_LEN    ((MPC_HC_LEN*SS_Z_LEN) + (3*MPC_HU_LEN*SS_U_LEN))
+#define MPC_UPDATE_WORKSPACE_BYTES  (MPC_UPDATE_WORKSPACE_LEN * sizeof(float_prec))
+
+/* The bytes of the online constants (the snapshot payload, see bSaveSnapshot() in mpc.cpp); the iterative
+ *  refinement also needs CTHETA & SR
+ */
+#if defined(MPC_USE_ITERATIVE_REFINEMENT)
+    #define MPC_ONLINE_REFINE_LEN   ((MPC_HC_LEN*SS_Z_LEN*MPC_HU_LEN*SS_U_LEN) + (MPC_HU_LEN*SS_U_LEN*MPC_HU_LEN*SS_U_LEN))
+#else
+    #define MPC_ONLINE_REFINE_LEN   (0)
+#endif
+#define MPC_ONLINE_BYTES    (MPC_SNAPSHOT_INT_BYTES(MPC_HC_LEN) + (((MPC_HC_LEN*SS_Z_LEN*(SS_X_LEN + SS_U_LEN)) + \
+                             (MPC_HC_LEN*SS_Z_LEN*MPC_HC_LEN*SS_Z_LEN) + (MPC_HU_LEN*SS_U_LEN*MPC_HC_LEN*SS_Z_LEN) + \
+                             (MPC_HU_LEN*SS_U_LEN*MPC_HU_LEN*SS_U_LEN) + MPC_ONLINE_REFINE_LEN) * sizeof(float_prec)))
+
+/* The stack of vReInit() & bUpdate() for budget.h, from the Matrix objects & arrays of each function in
+ *  mpc.cpp (see MATRIX_STACK_BYTES in matrix.h); a product or a sum with a named Matrix operand also copies
+ *  that operand (the by-value argument). Change them with the code.
+ */
+#define MPC_STACK_GRID_BYTES        ((MPC_HC_LEN + (2*MPC_GRID_SEGMENT_LEN)) * sizeof(int32_t))    /* _P & _G */
+#if defined(MPC_REINIT_CACHE_LEN)
+    #define MPC_STACK_CACHE_KEY_BYTES   (MPC_REINIT_CACHE_KEY_LEN * sizeof(float_prec))
+#else
+    #define MPC_STACK_CACHE_KEY_BYTES   (0)
+#endif
+
+/* vCalculatePowerSigma(): _Asq & _Ssq (2), _Ssq + (_Asq*_Sigma) (3), _Asq*_Apow (2), _Ssq + (_Asq*_Ssq) (3)
+ *  & _Asq*_Asq (2)
+ */
+#define MPC_STACK_POWER_SIGMA       MATRIX_STACK_BYTES(12, MATRIX_STACK_LEAF)
+#if defined(MPC_USE_REINIT_WORKSPACE)
+    /* The workspace vReInit(A, B, C, Q, R) calls vReInit(.., _workspace) -> vCalculatePrediction() (_P & _G)
+     *  -> vCalculatePowerSigma()
+     */
+    #define MPC_STACK_REINIT_BYTES  MATRIX_STACK_BYTES(0, MATRIX_STACK_BYTES(0, MATRIX_STACK_BYTES(0, \
+                                        MATRIX_STACK_BYTES(0, MATRIX_STACK_LEAF)) + MPC_STACK_GRID_BYTES) + \
+                                        MPC_STACK_CACHE_KEY_BYTES)
+#else
+    /* vReInit(): _Apow, _Sigma, _Aseg, _Sseg, _Atheta & _Stheta (6), the _Stheta insertion (2), _Aseg*_Apow (2),
+     *  the CTHETA insertion of C*_Sigma (3), the CPSI (3) & COMEGA (2) insertions, GammaLeft (1), its SQ*CTHETA
+     *  (3) & SR (2) insertions and the new Qt_L & R_L (2); _P, _G & _col
+     */
+    #define MPC_STACK_REINIT_BYTES  (MATRIX_STACK_BYTES(26, szMatrixStackMax(szMatrixStackMax(MPC_STACK_POWER_SIGMA, \
+                                        MATRIX_STACK_QRDEC), MATRIX_STACK_INSERT)) + MPC_STACK_GRID_BYTES + (SS_X_LEN * sizeof(float_prec)) + MPC_STACK_CACHE_KEY_BYTES)
+#endif
+
+#if defined(MPC_USE_ITERATIVE_REFINEMENT)
+    /* vRefine(): the double _r, and the forward & back-substitution */
+    #define MPC_STACK_REFINE        (MATRIX_STACK_BYTES(0, MATRIX_STACK_LEAF) + ((MPC_HU_LEN*SS_U_LEN) * sizeof(double)))
+#else
+    #define MPC_STACK_REFINE        MATRIX_STACK_LEAF
+#endif
+#if defined(MPC_USE_UPDATE_WORKSPACE)
+    /* bUpdate(SP, x, u) calls bUpdate(.., _workspace), without a Matrix or an array */
+    #define MPC_STACK_UPDATE_BYTES  MATRIX_STACK_BYTES(0, MATRIX_STACK_BYTES(0, MPC_STACK_REFINE))
+#else
+    /* bUpdate(): Err, Q1, Qt_LSQE, BackSubRight, R1 & DU_Out (6), SP - CPSI*x - COMEGA*u (6), the Q1,
+     *  BackSubRight & R1 insertions (2 each), Q1*SQ*Err (4), BackSubtitution() (1) & u + DU_Out (2); the
+     *  iterative refinement adds the _du & _res arrays
+     */
+    #if defined(MPC_USE_ITERATIVE_REFINEMENT)
+        #define MPC_STACK_UPDATE_ARRAY  (2 * (MPC_HU_LEN*SS_U_LEN) * sizeof(float_prec))
+    #else
+        #define MPC_STACK_UPDATE_ARRAY  (0)
+    #endif
+    #define MPC_STACK_UPDATE_BYTES  (MATRIX_STACK_BYTES(25, szMatrixStackMax(MATRIX_STACK_INSERT, MPC_STACK_REFINE)) + \
+                                     MPC_STACK_UPDATE_ARRAY)
+#endif
+
 class MPC
 {
 public:
     MPC(Matrix &A, Matrix &B, Matrix &C, float_prec _bobotQ, float_prec _bobotR);
+    /* Without the offline calculation: call vReInit() or bLoadSnapshot() before bUpdate() */
+    MPC();
     void vReInit(Matrix &A, Matrix &B, Matrix &C, float_prec _bobotQ, float_prec _bobotR);
     bool bUpdate(Matrix &SP, Matrix &x, Matrix &u);
+    
+#if defined(MPC_USE_REINIT_WORKSPACE)
+    /* vReInit() on the caller's workspace of MPC_REINIT_WORKSPACE_LEN elements, e.g. one per task */
+    void vReInit(Matrix &A, Matrix &B, Matrix &C, float_prec _bobotQ, float_prec _bobotR, float_prec * _workspace);
+#endif
+#if defined(MPC_USE_UPDATE_WORKSPACE)
+    /* bUpdate() on the caller's workspace of MPC_UPDATE_WORKSPACE_LEN elements, the instances updated one
+     * after another can share one
+     */
+    bool bUpdate(Matrix &SP, Matrix &x, Matrix &u, float_prec * _workspace);
+#endif
+    
+    /* The online constants as a binary snapshot (see snapshot.h): bSaveSnapshot() writes
+     * szSnapshotBytes() bytes after a successful vReInit(), bLoadSnapshot() restores them without
+     * the QR decomposition
+     */
+    static size_t szSnapshotBytes();
+    bool bSaveSnapshot(void * _buf, const size_t _bufBytes);
+    bool bLoadSnapshot(const void * _snapshot, const size_t _bytes);
+    
+    /* Time of the j-th coincidence point (the j-th block of SP), in number of SS_DT */
+    int32_t i32GetCoincidenceTime(const int32_t _j) { return i32CoincidenceTime[_j]; }
+    
+#if defined(MPC_USE_ITERATIVE_REFINEMENT)
+    /* The iterative refinement steps of the last bUpdate() */
+    int32_t i32GetRefineIteration() { return i32RefineIteration; }
+#endif
+    
+#if defined(MPC_REINIT_CACHE_LEN)
+    /* The vReInit() cache (see reinit_cache.h): setting the quantum clears the cache */
+    void vSetReInitCacheQuantum(const float_prec _quantum);
+    void vClearReInitCache();
+    uint32_t u32GetReInitCacheHit() { return u32ReInitCacheHit; }
+    uint32_t u32GetReInitCacheMiss() { return u32ReInitCacheMiss; }
+#endif
+    
+#if defined(MPC_USE_PHASE_PROFILING)
+    /* The profiling statistic of the {MPC_n} phase (n = 1..MPC_PHASE_LEN), in MPC_PROFILE_COUNTER() ticks */
+    const MPC_PhaseStat & GetPhaseStat(const int32_t _n) { return PhaseStat[_n-1]; }
+    void vResetPhaseStat();
+#endif
 
 protected:
+    static size_t szSnapshotPayloadBytes();
+    static MPC_SnapshotInfo SnapshotInfo();
+    uint8_t * pPutOnline(uint8_t * _p);
+    const uint8_t * pGetOnline(const uint8_t * _p);
     void bCalculateActiveSet(void);
+    void vCalculatePowerSigma(int32_t _n, Matrix &_Apow, Matrix &_Sigma);
+#if defined(MPC_USE_REINIT_WORKSPACE)
+    void vCalculatePowerSigma(int32_t _n, float_prec * _Apow, float_prec * _Sigma, float_prec * _workspace);
+    void vCalculatePrediction(float_prec * _workspace);
+#endif
+#if defined(MPC_USE_ITERATIVE_REFINEMENT)
+    void vRefine(Matrix &SP, Matrix &x, Matrix &u, float_prec * _du, float_prec * _res);
+#endif
 
 private:
-    Matrix CPSI     {(MPC_HP_LEN*SS_Z_LEN), SS_X_LEN};
-    Matrix COMEGA   {(MPC_HP_LEN*SS_Z_LEN), SS_U_LEN};
-    Matrix CTHETA   {(MPC_HP_LEN*SS_Z_LEN), (MPC_HU_LEN*SS_U_LEN)};
+    int32_t i32CoincidenceTime[MPC_HC_LEN];
+#if defined(MPC_USE_ITERATIVE_REFINEMENT)
+    int32_t i32RefineIteration;
+#endif
+    
+#if defined(MPC_USE_PHASE_PROFILING)
+    MPC_PhaseStat PhaseStat[MPC_PHASE_LEN];
+#endif
+    
+#if defined(MPC_REINIT_CACHE_LEN)
+    /* Each entry holds the online constants (only of a successful QR decomposition) */
+    MPC_ReInitCacheTag ReInitCacheTag[MPC_REINIT_CACHE_LEN];
+    uint8_t u8ReInitCacheData[MPC_REINIT_CACHE_LEN][MPC_ONLINE_BYTES];
+    float_prec f32ReInitCacheQuantum;
+    uint32_t u32ReInitCacheClock;
+    uint32_t u32ReInitCacheHit;
+    uint32_t u32ReInitCacheMiss;
+#endif
+    
+    Matrix CPSI     {(MPC_HC_LEN*SS_Z_LEN), SS_X_LEN};
+    Matrix COMEGA   {(MPC_HC_LEN*SS_Z_LEN), SS_U_LEN};
+    Matrix CTHETA   {(MPC_HC_LEN*SS_Z_LEN), (MPC_HU_LEN*SS_U_LEN)};
 
+#if !defined(MPC_USE_UPDATE_WORKSPACE)
     Matrix DU       {(MPC_HU_LEN*SS_U_LEN), 1};
+#endif
 
     Matrix A        {SS_X_LEN, SS_X_LEN};
     Matrix B        {SS_X_LEN, SS_U_LEN};
     Matrix C        {SS_Z_LEN, SS_X_LEN};
 
-    Matrix SQ       {(MPC_HP_LEN*SS_Z_LEN), (MPC_HP_LEN*SS_Z_LEN)};
+    Matrix SQ       {(MPC_HC_LEN*SS_Z_LEN), (MPC_HC_LEN*SS_Z_LEN)};
     Matrix SR       {(MPC_HU_LEN*SS_U_LEN), (MPC_HU_LEN*SS_U_LEN)};
     
-    Matrix Qt_L     {(MPC_HP_LEN*SS_Z_LEN + MPC_HU_LEN*SS_U_LEN), (MPC_HP_LEN*SS_Z_LEN + MPC_HU_LEN*SS_U_LEN)};
-    Matrix R_L      {(MPC_HP_LEN*SS_Z_LEN + MPC_HU_LEN*SS_U_LEN), MPC_HP_LEN*SS_Z_LEN};
+    Matrix Qt_L     {(MPC_HC_LEN*SS_Z_LEN + MPC_HU_LEN*SS_U_LEN), (MPC_HC_LEN*SS_Z_LEN + MPC_HU_LEN*SS_U_LEN)};
+    Matrix R_L      {(MPC_HC_LEN*SS_Z_LEN + MPC_HU_LEN*SS_U_LEN), MPC_HC_LEN*SS_Z_LEN};
 };
 
 
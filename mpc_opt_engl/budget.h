@@ -0,0 +1,57 @@
+/**************************************************************************************************
+ * Stack & static memory budget of the MPC (see MPC_STACK_BUDGET & MPC_STATIC_BUDGET in konfig.h).
+ *
+ *  Every Matrix holds a whole MATRIX_MAXIMUM_SIZE^2 array, so the stack of MPC::vReInit() & MPC::bUpdate()
+ *  is counted from the code: each function keeps the count of its Matrix objects (the named locals, the
+ *  temporaries & the by-value argument copies of its expressions) and arrays beside it, and adds the
+ *  deepest function it calls (MATRIX_STACK_BYTES in matrix.h, MPC_STACK_REINIT_BYTES & MPC_STACK_UPDATE_BYTES
+ *  in mpc.h). It is the stack of an unoptimized build, where no two objects share a stack slot; an
+ *  optimizing compiler only shares or removes slots. MATRIX_STACK_CALL_BYTES is the allowance for the
+ *  scalars, the saved registers & the return address of one call level, set it for the target's ABI.
+ *
+ *      MPC_STACK_REINIT_BYTES  : vReInit(), see mpc.h
+ *      MPC_STACK_UPDATE_BYTES  : bUpdate(), see mpc.h
+ *      MPC_STATIC_BYTES        = sizeof(MPC)
+ *
+ *  The static workspaces of vReInit() & bUpdate() (MPC_REINIT_WORKSPACE_BYTES & MPC_UPDATE_WORKSPACE_BYTES
+ *  with MPC_USE_REINIT_WORKSPACE & MPC_USE_UPDATE_WORKSPACE) are shared by the instances, so they're not
+ *  part of MPC_STATIC_BYTES.
+ *
+ *  When the budget is exceeded the build stops at a static_assert, and the compiler prints the numbers
+ *  (in bytes) as the arguments of the MPC_BudgetCheck<need, budget> instantiation. bench/bench_stack.cpp
+ *  (a ctest) checks the counts against the real high-water mark.
+ *
+ *  Mirrored in mpc_engl, mpc_opt_engl & mpc_least_square_engl (each sketch folder needs its own copy):
+ *  edit one, then copy it over the others. The CMake configure fails when the copies differ.
+ *
+ *
+ * See https://github.com/pronenewbits for more!
+ *************************************************************************************************/
+#ifndef BUDGET_H
+#define BUDGET_H
+
+#include <stddef.h>
+#include "konfig.h"
+#include "matrix.h"
+#include "mpc.h"
+
+
+#define MPC_STATIC_BYTES        (sizeof(MPC))
+
+
+template <size_t szNeed, size_t szBudget>
+struct MPC_BudgetCheck {
+    static_assert(szNeed <= szBudget, "MPC memory budget exceeded, see the MPC_BudgetCheck<need, budget> (in bytes) instantiation");
+    static constexpr bool bOk = true;
+};
+
+#if defined(MPC_STACK_BUDGET)
+    static_assert(MPC_BudgetCheck<MPC_STACK_REINIT_BYTES, (MPC_STACK_BUDGET)>::bOk, "The stack of MPC::vReInit() is above MPC_STACK_BUDGET!");
+    static_assert(MPC_BudgetCheck<MPC_STACK_UPDATE_BYTES, (MPC_STACK_BUDGET)>::bOk, "The stack of MPC::bUpdate() is above MPC_STACK_BUDGET!");
+#endif
+#if defined(MPC_STATIC_BUDGET)
+    static_assert(MPC_BudgetCheck<MPC_STATIC_BYTES, (MPC_STATIC_BUDGET)>::bOk, "sizeof(MPC) is above MPC_STATIC_BUDGET!");
+#endif
+
+
+#endif // BUDGET_H
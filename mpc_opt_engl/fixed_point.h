@@ -0,0 +1,135 @@
+/**************************************************************************************************
+ * Fixed-point arithmetic of the MPC online path (enabled with MPC_USE_FIXED_POINT in konfig.h), for
+ *  the microcontrollers without FPU.
+ *
+ *  Every fixed-point quantity is a fixed_prec integer v with a binary exponent e (per matrix or per
+ *  signal vector), chosen so |real| < 2^e:
+ *
+ *      real = v * 2^(e - MPC_FIXED_FRAC_BITS)
+ *
+ *      MPC_FIXED_Q15 : fixed_prec = int16_t, MPC_FIXED_FRAC_BITS = 15, the products are accumulated
+ *                      exactly in 64 bit (16x16 -> 32 bit multiply, the one an M0+ has).
+ *      MPC_FIXED_Q31 : fixed_prec = int32_t, MPC_FIXED_FRAC_BITS = 31, each 32x32 -> 64 bit product
+ *                      is shifted down by 31 bit before the accumulation (so a row can't overflow).
+ *
+ *  The exponents are powers of two, so a change of format is a (rounded) shift, and every result is
+ *  saturated to the range of its destination instead of wrapping around.
+ *
+ *
+ * See https://github.com/pronenewbits for more!
+ *************************************************************************************************/
+#ifndef FIXED_POINT_H
+#define FIXED_POINT_H
+
+#include "konfig.h"
+
+
+#if defined(MPC_USE_FIXED_POINT)
+
+#if (MPC_USE_FIXED_POINT == MPC_FIXED_Q15)
+    typedef int16_t fixed_prec;
+    #define MPC_FIXED_FRAC_BITS     (15)
+    #define MPC_FIXED_PRODUCT_SHIFT (0)
+#elif (MPC_USE_FIXED_POINT == MPC_FIXED_Q31)
+    typedef int32_t fixed_prec;
+    #define MPC_FIXED_FRAC_BITS     (31)
+    #define MPC_FIXED_PRODUCT_SHIFT (31)
+#else
+    #error("MPC_USE_FIXED_POINT must be MPC_FIXED_Q15 or MPC_FIXED_Q31!");
+#endif
+
+#define MPC_FIXED_MAX   ((int64_t(1) << MPC_FIXED_FRAC_BITS) - 1)
+#define MPC_FIXED_MIN   (-(int64_t(1) << MPC_FIXED_FRAC_BITS))
+
+/* The exponents of MPC::i32GetFixedExponent(): the gain matrices, the bUpdateFixed() signals, and E(k) */
+#define MPC_FIXED_CPSI      (0)
+#define MPC_FIXED_COMEGA    (1)
+#define MPC_FIXED_XI_DU     (2)
+#define MPC_FIXED_SP        (3)
+#define MPC_FIXED_X         (4)
+#define MPC_FIXED_U         (5)
+#define MPC_FIXED_ERR       (6)
+#define MPC_FIXED_EXP_LEN   (7)
+
+
+static inline fixed_prec fxFixedSaturate(const int64_t _val)
+{
+    if (_val > MPC_FIXED_MAX) {
+        return fixed_prec(MPC_FIXED_MAX);
+    }
+    if (_val < MPC_FIXED_MIN) {
+        return fixed_prec(MPC_FIXED_MIN);
+    }
+    return fixed_prec(_val);
+}
+
+/* _val * 2^-_shift, rounded to nearest (a negative _shift is a left shift, saturated to +-2^60 so
+ *  the sum of three of them can't overflow)
+ */
+static inline int64_t i64FixedShift(const int64_t _val, const int32_t _shift)
+{
+    if (_shift > 62) {
+        return 0;
+    }
+    if (_shift > 0) {
+        return (_val + (int64_t(1) << (_shift - 1))) >> _shift;
+    }
+    if (_shift < -60) {
+        return (_val > 0) ? (int64_t(1) << 60) : ((_val < 0) ? -(int64_t(1) << 60) : 0);
+    }
+    if (_shift < 0) {
+        const int64_t _limit = int64_t(1) << (60 + _shift);
+        if (_val >= _limit) {
+            return int64_t(1) << 60;
+        }
+        if (_val <= -_limit) {
+            return -(int64_t(1) << 60);
+        }
+        return _val * (int64_t(1) << (-_shift));
+    }
+    return _val;
+}
+
+/* The product term of a dot product; the accumulator is scaled by 2^(e1 + e2 - MPC_FIXED_ACC_FRAC_BITS) */
+#define MPC_FIXED_ACC_FRAC_BITS ((2*MPC_FIXED_FRAC_BITS) - MPC_FIXED_PRODUCT_SHIFT)
+static inline int64_t i64FixedProduct(const fixed_prec _a, const fixed_prec _b)
+{
+#if (MPC_FIXED_PRODUCT_SHIFT == 0)
+    return int64_t(int32_t(_a) * int32_t(_b));
+#else
+    return (int64_t(_a) * int64_t(_b)) >> MPC_FIXED_PRODUCT_SHIFT;
+#endif
+}
+
+/* The smallest exponent e with |_max| < 2^e (host side, at vReInit) */
+static inline int32_t i32FixedExponent(const float_prec _max)
+{
+    int _e = 0;
+    if (!(_max > float_prec(0))) {
+        return 0;
+    }
+    frexp(double(_max), &_e);
+    return int32_t(_e);
+}
+
+static inline fixed_prec fxFixedFromFloat(const float_prec _val, const int32_t _exp)
+{
+    const double _scaled = ldexp(double(_val), MPC_FIXED_FRAC_BITS - _exp);
+    if (_scaled >= double(MPC_FIXED_MAX)) {
+        return fixed_prec(MPC_FIXED_MAX);
+    }
+    if (_scaled <= double(MPC_FIXED_MIN)) {
+        return fixed_prec(MPC_FIXED_MIN);
+    }
+    return fixed_prec(floor(_scaled + 0.5));
+}
+
+static inline float_prec fFixedToFloat(const fixed_prec _val, const int32_t _exp)
+{
+    return float_prec(ldexp(double(_val), _exp - MPC_FIXED_FRAC_BITS));
+}
+
+#endif
+
+
+#endif // FIXED_POINT_H
@@ -13,9 +13,12 @@ Matrix operator + (const float_prec _scalar, Matrix _mat)
 {
     Matrix _outp(_mat.i32getRow(), _mat.i32getColumn());
 
+    MATRIX_COUNT_OP(MATRIX_OP_SCALAR, _mat.i32getRow()*_mat.i32getColumn(), _mat.i32getRow()*_mat.i32getColumn(), 0);
     for (int32_t _i = 0; _i < _mat.i32getRow(); _i++) {
+        const float_prec * const _row = _mat.pRowUnchecked(_i);
+        float_prec * const _outpRow = _outp.pRowUnchecked(_i);
         for (int32_t _j = 0; _j < _mat.i32getColumn(); _j++) {
-            _outp[_i][_j] = _scalar + _mat[_i][_j];
+            _outpRow[_j] = _scalar + _row[_j];
         }
     }
     return _outp;
@@ -26,9 +29,12 @@ Matrix operator - (const float_prec _scalar, Matrix _mat)
 {
     Matrix _outp(_mat.i32getRow(), _mat.i32getColumn());
 
+    MATRIX_COUNT_OP(MATRIX_OP_SCALAR, _mat.i32getRow()*_mat.i32getColumn(), _mat.i32getRow()*_mat.i32getColumn(), 0);
     for (int32_t _i = 0; _i < _mat.i32getRow(); _i++) {
+        const float_prec * const _row = _mat.pRowUnchecked(_i);
+        float_prec * const _outpRow = _outp.pRowUnchecked(_i);
         for (int32_t _j = 0; _j < _mat.i32getColumn(); _j++) {
-            _outp[_i][_j] = _scalar - _mat[_i][_j];
+            _outpRow[_j] = _scalar - _row[_j];
         }
     }
     return _outp;
@@ -39,9 +45,12 @@ Matrix operator * (const float_prec _scalar, Matrix _mat)
 {
     Matrix _outp(_mat.i32getRow(), _mat.i32getColumn());
 
+    MATRIX_COUNT_OP(MATRIX_OP_SCALAR, _mat.i32getRow()*_mat.i32getColumn(), _mat.i32getRow()*_mat.i32getColumn(), 0);
     for (int32_t _i = 0; _i < _mat.i32getRow(); _i++) {
+        const float_prec * const _row = _mat.pRowUnchecked(_i);
+        float_prec * const _outpRow = _outp.pRowUnchecked(_i);
         for (int32_t _j = 0; _j < _mat.i32getColumn(); _j++) {
-            _outp[_i][_j] = _scalar * _mat[_i][_j];
+            _outpRow[_j] = _scalar * _row[_j];
         }
     }
     return _outp;
@@ -52,9 +61,12 @@ Matrix operator + (Matrix _mat, const float_prec _scalar)
 {
     Matrix _outp(_mat.i32getRow(), _mat.i32getColumn());
 
+    MATRIX_COUNT_OP(MATRIX_OP_SCALAR, _mat.i32getRow()*_mat.i32getColumn(), _mat.i32getRow()*_mat.i32getColumn(), 0);
     for (int32_t _i = 0; _i < _mat.i32getRow(); _i++) {
+        const float_prec * const _row = _mat.pRowUnchecked(_i);
+        float_prec * const _outpRow = _outp.pRowUnchecked(_i);
         for (int32_t _j = 0; _j < _mat.i32getColumn(); _j++) {
-            _outp[_i][_j] = _mat[_i][_j] + _scalar;
+            _outpRow[_j] = _row[_j] + _scalar;
         }
     }
     return _outp;
@@ -65,9 +77,12 @@ Matrix operator - (Matrix _mat, const float_prec _scalar)
 {
     Matrix _outp(_mat.i32getRow(), _mat.i32getColumn());
 
+    MATRIX_COUNT_OP(MATRIX_OP_SCALAR, _mat.i32getRow()*_mat.i32getColumn(), _mat.i32getRow()*_mat.i32getColumn(), 0);
     for (int32_t _i = 0; _i < _mat.i32getRow(); _i++) {
+        const float_prec * const _row = _mat.pRowUnchecked(_i);
+        float_prec * const _outpRow = _outp.pRowUnchecked(_i);
         for (int32_t _j = 0; _j < _mat.i32getColumn(); _j++) {
-            _outp[_i][_j] = _mat[_i][_j] - _scalar;
+            _outpRow[_j] = _row[_j] - _scalar;
         }
     }
     return _outp;
@@ -78,9 +93,12 @@ Matrix operator * (Matrix _mat, const float_prec _scalar)
 {
     Matrix _outp(_mat.i32getRow(), _mat.i32getColumn());
 
+    MATRIX_COUNT_OP(MATRIX_OP_SCALAR, _mat.i32getRow()*_mat.i32getColumn(), _mat.i32getRow()*_mat.i32getColumn(), 0);
     for (int32_t _i = 0; _i < _mat.i32getRow(); _i++) {
+        const float_prec * const _row = _mat.pRowUnchecked(_i);
+        float_prec * const _outpRow = _outp.pRowUnchecked(_i);
         for (int32_t _j = 0; _j < _mat.i32getColumn(); _j++) {
-            _outp[_i][_j] = _mat[_i][_j] * _scalar;
+            _outpRow[_j] = _row[_j] * _scalar;
         }
     }
     return _outp;
@@ -95,11 +113,72 @@ Matrix operator / (Matrix _mat, const float_prec _scalar)
         _outp.vSetMatrixInvalid();
         return _outp;
     }
+    MATRIX_COUNT_OP(MATRIX_OP_SCALAR, _mat.i32getRow()*_mat.i32getColumn(), _mat.i32getRow()*_mat.i32getColumn(), 0);
     for (int32_t _i = 0; _i < _mat.i32getRow(); _i++) {
+        const float_prec * const _row = _mat.pRowUnchecked(_i);
+        float_prec * const _outpRow = _outp.pRowUnchecked(_i);
         for (int32_t _j = 0; _j < _mat.i32getColumn(); _j++) {
-            _outp[_i][_j] = _mat[_i][_j] / _scalar;
+            _outpRow[_j] = _row[_j] / _scalar;
         }
     }
     return _outp;
 }
 
+
+
+#if defined(MATRIX_USE_OP_COUNTING)
+MatrixOpCounter MATRIX_OP_COUNT;
+
+void vMatrixOpCountReset()
+{
+    memset(&MATRIX_OP_COUNT, 0, sizeof(MATRIX_OP_COUNT));
+}
+
+void vMatrixOpCountReport()
+{
+    static const char * const _opName[MATRIX_OP_LEN] = {
+        "add/sub", "scalar", "mul", "transpose", "copy", "insert", "set", "compare",
+        "rounding", "norm", "invers", "cholesky", "householder", "qr", "backsub"
+    };
+    const unsigned long long _bufferBytes = (unsigned long long) (sizeof(float_prec) * MATRIX_MAXIMUM_SIZE * MATRIX_MAXIMUM_SIZE);
+
+    #if (SYSTEM_IMPLEMENTATION == SYSTEM_IMPLEMENTATION_PC)
+        cout << "construct " << MATRIX_OP_COUNT.u64construct << " (" << (MATRIX_OP_COUNT.u64construct * _bufferBytes) << " bytes zero-initialized)" << endl;
+        cout << "copy " << MATRIX_OP_COUNT.u64copy << " (" << (MATRIX_OP_COUNT.u64copy * _bufferBytes) << " bytes)" << endl;
+        cout << "zero-fill " << MATRIX_OP_COUNT.u64zeroFill << " (" << MATRIX_OP_COUNT.u64zeroFillElement << " elements)" << endl;
+        cout << "op call read write mac" << endl;
+        for (int32_t _i = 0; _i < MATRIX_OP_LEN; _i++) {
+            if (MATRIX_OP_COUNT.op[_i].u64call == 0) {
+                continue;
+            }
+            cout << _opName[_i] << " " << MATRIX_OP_COUNT.op[_i].u64call << " " << MATRIX_OP_COUNT.op[_i].u64read << " "
+                 << MATRIX_OP_COUNT.op[_i].u64write << " " << MATRIX_OP_COUNT.op[_i].u64mac << endl;
+        }
+    #elif (SYSTEM_IMPLEMENTATION == SYSTEM_IMPLEMENTATION_EMBEDDED_ARDUINO)
+        char _bufSer[100];
+        snprintf(_bufSer, sizeof(_bufSer)-1, "construct %llu (%llu bytes zero-initialized)", (unsigned long long) MATRIX_OP_COUNT.u64construct,
+                 (unsigned long long) MATRIX_OP_COUNT.u64construct * _bufferBytes);
+        Serial.println(_bufSer);
+        snprintf(_bufSer, sizeof(_bufSer)-1, "copy %llu (%llu bytes)", (unsigned long long) MATRIX_OP_COUNT.u64copy,
+                 (unsigned long long) MATRIX_OP_COUNT.u64copy * _bufferBytes);
+        Serial.println(_bufSer);
+        snprintf(_bufSer, sizeof(_bufSer)-1, "zero-fill %llu (%llu elements)", (unsigned long long) MATRIX_OP_COUNT.u64zeroFill,
+                 (unsigned long long) MATRIX_OP_COUNT.u64zeroFillElement);
+        Serial.println(_bufSer);
+        Serial.println("op call read write mac");
+        for (int32_t _i = 0; _i < MATRIX_OP_LEN; _i++) {
+            if (MATRIX_OP_COUNT.op[_i].u64call == 0) {
+                continue;
+            }
+            snprintf(_bufSer, sizeof(_bufSer)-1, "%s %llu %llu %llu %llu", _opName[_i],
+                     (unsigned long long) MATRIX_OP_COUNT.op[_i].u64call, (unsigned long long) MATRIX_OP_COUNT.op[_i].u64read,
+                     (unsigned long long) MATRIX_OP_COUNT.op[_i].u64write, (unsigned long long) MATRIX_OP_COUNT.op[_i].u64mac);
+            Serial.println(_bufSer);
+        }
+    #else
+        /* Silent function */
+        (void) _opName;
+        (void) _bufferBytes;
+    #endif
+}
+#endif
@@ -6,17 +6,34 @@
  *          z(k)    = C*x(k)            ; z = Zx1
  *
  *
- ** Calculate prediction of z(k+1..k+Hp) constants ************************************************
+ ** Calculate prediction of z(k+T(1)..k+T(Hc)) constants ******************************************
  *
- *      Prediction of state variable of the system:
- *        z(k+1..k+Hp) = (CPSI)*x(k) + (COMEGA)*u(k-1) + (CTHETA)*dU(k..k+Hu-1)         ...{MPC_1}
+ *      The Hp prediction steps lie on a (possibly non-uniform) time grid: the first segment of
+ *      the grid steps with m(1)*dt, the next with m(2)*dt, and so on (see MPC_GRID_SEGMENTS).
+ *      t(s) is the time of the prediction step s (in dt) and T(j) = t(P(j)) is the time of
+ *      the coincidence points P(1) < .. < P(Hc) <= Hp.
+ *
+ *      Prediction of state variable of the system at the coincidence points:
+ *        z(k+T(1)..k+T(Hc)) = (CPSI)*x(k) + (COMEGA)*u(k-1) + (CTHETA)*dU(k..k+Hu-1)   ...{MPC_1}
  *
  *        Constants:
- *          CPSI   = [CA C(A^2) ... C(A^Hp)]'                                       : (Hp*N)xN
- *          COMEGA = [CB C(B+A*B) ... C*Sigma(i=0->Hp-1)A^i*B]'                     : (Hp*N)xM
+ *          CPSI   = [C(A^T(1)) C(A^T(2)) ... C(A^T(Hc))]'                          : (Hc*N)xN
+ *          COMEGA = [C*S(T(1)) C*S(T(2)) ... C*S(T(Hc))]'                          : (Hc*N)xM
+ *          CTHETA = [C*S(T(1))    C*S(T(1)-1)  ....  C*S(T(1)-Hu+1) ]
+ *                   [C*S(T(2))    C*S(T(2)-1)  ....  C*S(T(2)-Hu+1) ]
+ *                   [    .             .         .         .        ]              : (Hc*N)x(Hu*M)
+ *                   [C*S(T(Hc))   C*S(T(Hc)-1) ....  C*S(T(Hc)-Hu+1)]
+ *
+ *          S(s)   = Sigma(i=0->s-1)A^i*B  ; S(s) = 0 for s <= 0
+ *
+ *        The control moves dU(k..k+Hu-1) are still spaced dt apart.
+ *
+ *        With one grid segment of dt and P = {1, 2, .., Hp} these are the full prediction matrices:
+ *          CPSI   = [CA C(A^2) ... C(A^Hp)]'
+ *          COMEGA = [CB C(B+A*B) ... C*Sigma(i=0->Hp-1)A^i*B]'
  *          CTHETA = [         CB                0  ....           0              ]
  *                   [       C(B+A*B)           CB   .             0              ]
- *                   [           .               .    .           CB              ] : (Hp*N)x(Hu*M)
+ *                   [           .               .    .           CB              ]
  *                   [           .               .     .           .              ]
  *                   [C*Sigma(i=0->Hp-1)(A^i*B)  .  ....  C*Sigma(i=0->Hp-Hu)A^i*B]
  *
@@ -31,9 +48,12 @@
  *          XI_DU   = XI_FULL(1:M, :)                                                   ...{MPC_4}
  * 
  *        Constants:
- *          Q     = Weight matrix for set-point deviation   : Hp x Hp
+ *          Q     = Weight matrix for set-point deviation   : Hc x Hc
  *          R     = Weight matrix for control signal change : Hu x Hu
  * 
+ *        Only these depend on the weights: vReTune() recalculates {MPC_2}..{MPC_4} with the
+ *        CTHETA of the last vReInit() (e.g. for a weight sweep).
+ * 
  * 
  ** MPC update algorithm **************************************************************************
  *
@@ -46,8 +66,15 @@
  *      Integrate the du(k) to get u(k):
  *              u(k) = u(k-1) + du(k)                                                   ...{MPC_7}
  *
+ *      If MPC_USE_MATRIX_FREE_PREDICTION is defined, CPSI & COMEGA are not stored. {MPC_5} & {MPC_6}
+ *      are then calculated together by rolling the free response x(t+m) = A^m*x(t) + S(m)*u(k-1)
+ *      forward and accumulating XI_DU(:, j)*(SP(j) - C*x(T(j))) at each coincidence point.
+ *
+ *      If MPC_USE_FIXED_POINT is defined, bUpdateFixed() calculates {MPC_5}..{MPC_7} in Q15/Q31 with
+ *      a fixed-point copy of CPSI, COMEGA & XI_DU (see fixed_point.h & vQuantizeFixed()).
+ *
  *        Variables:
- *          SP(k) = Set Point vector at time-k              : (Hp*N) x 1
+ *          SP(k) = Set Point vector at the coincidence points: (Hc*N) x 1
  *          x(k)  = State Variables at time-k               : N x 1
  *          u(k)  = Input plant at time-k                   : M x 1
  * 
@@ -55,88 +82,359 @@
  * See https://github.com/pronenewbits for more!
  *************************************************************************************************/
 #include "mpc.h"
+#include "budget.h"
+
+#if defined(MPC_USE_REINIT_WORKSPACE)
+/* The workspace of vReInit() when the caller doesn't give one, shared by all the instances */
+static float_prec f32ReInitWorkspace[MPC_REINIT_WORKSPACE_LEN];
+
+/* _dst = _add + _a*_b on the raw workspace arrays (row-major, the row stride is the column count), with
+ *  _a: X x X and _b, _add: X x _col (_add may be NULL). The product goes through _tmp (X x _col), so _dst
+ *  can be one of the operands.
+ */
+static void vWorkspaceMulAdd(float_prec * _dst, const float_prec * _add, const float_prec * _a, const float_prec * _b,
+                             const int32_t _col, float_prec * _tmp)
+{
+    for (int32_t _i = 0; _i < SS_X_LEN; _i++) {
+        for (int32_t _j = 0; _j < _col; _j++) {
+            float_prec _sum = 0;
+            for (int32_t _k = 0; _k < SS_X_LEN; _k++) {
+                _sum += _a[(_i*SS_X_LEN) + _k] * _b[(_k*_col) + _j];
+            }
+            _tmp[(_i*_col) + _j] = (_add == NULL) ? _sum : (_add[(_i*_col) + _j] + _sum);
+        }
+    }
+    memcpy(_dst, _tmp, size_t(SS_X_LEN*_col) * sizeof(float_prec));
+}
+
+/* _dst(_row:_row+Z, _col:_col+_len) = C*_b, with _b: X x _len on the workspace */
+static void vWorkspaceInsertC(Matrix &_dst, const int32_t _row, const int32_t _col, Matrix &C, const float_prec * _b,
+                              const int32_t _len)
+{
+    for (int32_t _i = 0; _i < SS_Z_LEN; _i++) {
+        const float_prec * const _cRow = C.pRowUnchecked(_i);
+        float_prec * const _dstRow = _dst.pRowUnchecked(_row + _i);
+        for (int32_t _j = 0; _j < _len; _j++) {
+            float_prec _sum = 0;
+            for (int32_t _k = 0; _k < SS_X_LEN; _k++) {
+                _sum += _cRow[_k] * _b[(_k*_len) + _j];
+            }
+            _dstRow[_col + _j] = _sum;
+        }
+    }
+}
+#endif
+
+#if defined(MPC_USE_UPDATE_WORKSPACE)
+/* The workspace of bUpdate() when the caller doesn't give one, shared by all the instances */
+static float_prec f32UpdateWorkspace[MPC_UPDATE_WORKSPACE_LEN];
+#endif
 
 
 MPC::MPC(Matrix &A, Matrix &B, Matrix &C, float_prec _bobotQ, float_prec _bobotR)
 {
+#if defined(MPC_USE_PHASE_PROFILING)
+    vProfileCounterInit();
+    vResetPhaseStat();
+#endif
+#if defined(MPC_USE_FIXED_POINT)
+    f32fxRange[0] = 1;
+    f32fxRange[1] = 1;
+    f32fxRange[2] = 1;
+    u32fxSaturation = 0;
+#endif
+#if defined(MPC_REINIT_CACHE_LEN)
+    f32ReInitCacheQuantum = MPC_REINIT_CACHE_QUANTUM;
+    vClearReInitCache();
+#endif
     vReInit(A, B, C, _bobotQ, _bobotR);
 }
 
+MPC::MPC()
+{
+#if defined(MPC_USE_PHASE_PROFILING)
+    vProfileCounterInit();
+    vResetPhaseStat();
+#endif
+#if defined(MPC_USE_FIXED_POINT)
+    f32fxRange[0] = 1;
+    f32fxRange[1] = 1;
+    f32fxRange[2] = 1;
+    u32fxSaturation = 0;
+#endif
+#if defined(MPC_REINIT_CACHE_LEN)
+    f32ReInitCacheQuantum = MPC_REINIT_CACHE_QUANTUM;
+    vClearReInitCache();
+#endif
+    for (int32_t _j = 0; _j < MPC_HC_LEN; _j++) {
+        i32CoincidenceTime[_j] = 0;
+    }
+#if defined(MPC_USE_FIXED_POINT)
+    vQuantizeFixed();
+#endif
+}
+
+#if defined(MPC_USE_REINIT_WORKSPACE)
 void MPC::vReInit(Matrix &A, Matrix &B, Matrix &C, float_prec _bobotQ, float_prec _bobotR)
+{
+    vReInit(A, B, C, _bobotQ, _bobotR, f32ReInitWorkspace);
+}
+
+void MPC::vReInit(Matrix &A, Matrix &B, Matrix &C, float_prec _bobotQ, float_prec _bobotR, float_prec * _workspace)
+#else
+void MPC::vReInit(Matrix &A, Matrix &B, Matrix &C, float_prec _bobotQ, float_prec _bobotR)
+#endif
 {
     this->A = A;
     this->B = B;
     this->C = C;
-    Q.vSetDiag(_bobotQ);
-    R.vSetDiag(_bobotR);
     
-    /*  Calculate prediction of z(k+1..k+Hp) constants
+#if defined(MPC_REINIT_CACHE_LEN)
+    /* The same (quantized) model & weights as a cached vReInit(): copy its result back */
+    float_prec _key[MPC_REINIT_CACHE_KEY_LEN];
+    const uint32_t _hash = u32ReInitCacheKey(_key, A, B, C, _bobotQ, _bobotR, f32ReInitCacheQuantum);
+    int32_t _entry = i32ReInitCacheFind(ReInitCacheTag, _key, _hash);
+    u32ReInitCacheClock++;
+    if (_entry >= 0) {
+        u32ReInitCacheHit++;
+        ReInitCacheTag[_entry].u32lastUse = u32ReInitCacheClock;
+        pSnapshotGetBlock(pGetOnline(u8ReInitCacheData[_entry]), CTHETA, (MPC_HC_LEN*SS_Z_LEN), (MPC_HU_LEN*SS_U_LEN));
+    #if defined(MPC_USE_FIXED_POINT)
+        vQuantizeFixed();
+    #endif
+        return;
+    }
+    u32ReInitCacheMiss++;
+#endif
+    
+    /*  Calculate prediction of z(k+T(1)..k+T(Hc)) constants
      *
-     *      Prediction of state variable of the system:
-     *        z(k+1..k+Hp) = (CPSI)*x(k) + (COMEGA)*u(k-1) + (CTHETA)*dU(k..k+Hu-1)         ...{MPC_1}
+     *      Prediction of state variable of the system at the coincidence points:
+     *        z(k+T(1)..k+T(Hc)) = (CPSI)*x(k) + (COMEGA)*u(k-1) + (CTHETA)*dU(k..k+Hu-1)   ...{MPC_1}
      *
      *        Constants:
-     *          CPSI   = [CA C(A^2) ... C(A^Hp)]'                                       : (Hp*N)xN
-     *          COMEGA = [CB C(B+A*B) ... C*Sigma(i=0->Hp-1)A^i*B]'                     : (Hp*N)xM
-     *          CTHETA = [         CB                0  ....           0              ]
-     *                   [       C(B+A*B)           CB   .             0              ]
-     *                   [           .               .    .           CB              ] : (Hp*N)x(Hu*M)
-     *                   [           .               .     .           .              ]
-     *                   [C*Sigma(i=0->Hp-1)(A^i*B)  .  ....  C*Sigma(i=0->Hp-Hu)A^i*B]
+     *          CPSI   = [C(A^T(1)) C(A^T(2)) ... C(A^T(Hc))]'                          : (Hc*N)xN
+     *          COMEGA = [C*S(T(1)) C*S(T(2)) ... C*S(T(Hc))]'                          : (Hc*N)xM
+     *          CTHETA = [C*S(T(1))    C*S(T(1)-1)  ....  C*S(T(1)-Hu+1) ]
+     *                   [C*S(T(2))    C*S(T(2)-1)  ....  C*S(T(2)-Hu+1) ]
+     *                   [    .             .         .         .        ]              : (Hc*N)x(Hu*M)
+     *                   [C*S(T(Hc))   C*S(T(Hc)-1) ....  C*S(T(Hc)-Hu+1)]
+     *
+     *          S(s)   = Sigma(i=0->s-1)A^i*B  ; S(s) = 0 for s <= 0
+     *
+     *  Each grid segment with step m*dt is discretized once into (A^m, S(m)), then we walk
+     *  the Hp prediction steps with it:
+     *          A^(t+m) = A^m * A^t
+     *          S(t+m)  = S(m) + A^m * S(t)
      *
+     *  The same update walks S(t-c) of the CTHETA columns 0 < c < Hu along, once t >= c (before
+     *  that S(t-c) = 0). Inside a segment with m > 1, the first S(t+m-c) with 0 < t+m-c < m comes
+     *  from vCalculatePowerSigma() instead. Only the blocks that land on a coincidence point are
+     *  inserted (the matrices are built row-sparse: the rows of the prediction steps that are not
+     *  evaluated are never stored).
+     *
+     *  With MPC_USE_REINIT_WORKSPACE the same steps run on the raw arrays of the workspace.
      */
+    MPC_PROFILE_BEGIN(1);
+#if defined(MPC_USE_REINIT_WORKSPACE)
+    vCalculatePrediction(_workspace);
+#else
+    /* Counted in MPC_STACK_REINIT_BYTES (mpc.h), change it with the Matrix objects below */
+    const int32_t _P[MPC_HC_LEN] = MPC_COINCIDENCE_POINTS;
+    const int32_t _G[MPC_GRID_SEGMENT_LEN][2] = MPC_GRID_SEGMENTS;
     Matrix _Apow(SS_X_LEN, SS_X_LEN);
-    /* CPSI     : [ C *   A  ]
-     *            [ C *  A^2 ]
-     *            [     .    ]                                                   : (Hp*N) x N
-     *            [     .    ]
-     *            [ C * A^Hp ]
-     */
-    _Apow = A;
-    for (int32_t _i = 0; _i < MPC_HP_LEN; _i++) {
-        CPSI = CPSI.InsertSubMatrix((C*_Apow), _i*SS_Z_LEN, 0);
-        _Apow = _Apow * A;
+    Matrix _Sigma(SS_X_LEN, (MPC_HU_LEN*SS_U_LEN));
+    Matrix _Aseg(SS_X_LEN, SS_X_LEN);
+    Matrix _Sseg(SS_X_LEN, SS_U_LEN);
+    Matrix _Atheta(SS_X_LEN, SS_X_LEN);
+    Matrix _Stheta(SS_X_LEN, SS_U_LEN);
+    float_prec _col[SS_X_LEN];
+    
+    int32_t _s = 0;         /* Prediction step */
+    int32_t _t = 0;         /* Time of the prediction step (in dt) */
+    int32_t _j = 0;         /* Next coincidence point */
+    _Apow.vSetIdentity();   /* A^t */
+    _Sigma.vSetToZero();    /* [S(t) S(t-1) .. S(t-Hu+1)] */
+    for (int32_t _g = 0; _g < MPC_GRID_SEGMENT_LEN; _g++) {
+        /* Discretize the segment: (A^m, S(m)) */
+        vCalculatePowerSigma(_G[_g][1], _Aseg, _Sseg);
+        #if defined(MPC_USE_MATRIX_FREE_PREDICTION)
+            for (int32_t _i = 0; _i < SS_X_LEN; _i++) {
+                for (int32_t _k = 0; _k < SS_X_LEN; _k++) {
+                    f32Aseg[_g][_i][_k] = _Aseg[_i][_k];
+                }
+                for (int32_t _k = 0; _k < SS_U_LEN; _k++) {
+                    f32Sseg[_g][_i][_k] = _Sseg[_i][_k];
+                }
+            }
+        #endif
+        
+        for (int32_t _n = 0; _n < _G[_g][0]; _n++) {
+            for (int32_t _c = 0; _c < MPC_HU_LEN; _c++) {
+                if (_t >= _c) {
+                    /* S(t+m-c) = S(m) + A^m * S(t-c), column by column */
+                    for (int32_t _k = (_c*SS_U_LEN); _k < ((_c+1)*SS_U_LEN); _k++) {
+                        for (int32_t _i = 0; _i < SS_X_LEN; _i++) {
+                            float_prec _sum = 0.0;
+                            for (int32_t _l = 0; _l < SS_X_LEN; _l++) {
+                                _sum += (_Aseg[_i][_l] * _Sigma[_l][_k]);
+                            }
+                            _col[_i] = _Sseg[_i][_k - (_c*SS_U_LEN)] + _sum;
+                        }
+                        for (int32_t _i = 0; _i < SS_X_LEN; _i++) {
+                            _Sigma[_i][_k] = _col[_i];
+                        }
+                    }
+                } else if ((_t + _G[_g][1]) > _c) {
+                    /* The first step past c inside a segment: S(t+m-c) with 0 < t+m-c < m */
+                    vCalculatePowerSigma(_t + _G[_g][1] - _c, _Atheta, _Stheta);
+                    _Sigma = _Sigma.InsertSubMatrix(_Stheta, 0, _c*SS_U_LEN);
+                }
+            }
+            _Apow = _Aseg * _Apow;
+            _t += _G[_g][1];
+            _s++;
+            
+            if ((_j >= MPC_HC_LEN) || (_P[_j] != _s)) {
+                continue;
+            }
+            i32CoincidenceTime[_j] = _t;
+            
+            /* CTHETA(j, c) = C*S(T(j)-c) ; CPSI(j) = C*A^T(j) ; COMEGA(j) = CTHETA(j, 0) = C*S(T(j)) */
+            CTHETA = CTHETA.InsertSubMatrix((C*_Sigma), _j*SS_Z_LEN, 0);
+            #if !defined(MPC_USE_MATRIX_FREE_PREDICTION)
+                CPSI   = CPSI.InsertSubMatrix((C*_Apow), _j*SS_Z_LEN, 0);
+                COMEGA = COMEGA.InsertSubMatrix(CTHETA, _j*SS_Z_LEN, 0, _j*SS_Z_LEN, 0, SS_Z_LEN, SS_U_LEN);
+            #endif
+            _j++;
+        }
     }
+    ASSERT((_s == MPC_HP_LEN) && (_j == MPC_HC_LEN), "The MPC_GRID_SEGMENTS or MPC_COINCIDENCE_POINTS don't match MPC_HP_LEN / MPC_HC_LEN");
+#endif
+    MPC_PROFILE_END(1);
     
-    /* COMEGA   : [          C * (B)         ]
-     *            [        C * (B+A*B)       ]
-     *            [             .            ]                                   : (Hp*N) x M
-     *            [             .            ]
-     *            [ C * Sigma(i=0->Hp-1)A^i*B]
-     */
-    Matrix _tempSigma(SS_X_LEN, SS_U_LEN);
-    _Apow.vSetIdentity();
-    _tempSigma = B;
-    for (int32_t _i = 0; _i < MPC_HP_LEN; _i++) {
-        COMEGA = COMEGA.InsertSubMatrix((C*_tempSigma), _i*SS_Z_LEN, 0);
-        _Apow = _Apow * A;
-        _tempSigma = _tempSigma + (_Apow*B);
-    }
-    
-    /* CTHETA   : [          C * (B)              0         ....              0             ]
-     *            [       C * (B+A*B)           C * (B)      .                0             ]
-     *            [            .                  .           .             C * (B)         ]: (Hp*N)x(Hu*M)
-     *            [            .                  .            .              .             ]
-     *            [C * Sigma(i=0->Hp-1)A^i*B      .         ....  C * Sigma(i=0->Hp-Hu)A^i*B]
-     *
-     *          : [COMEGA   [0 COMEGA(0:(len(COMEGA)-len(B)),:)]'  ....  [0..0 COMEGA(0:(len(COMEGA)-((Hp-Hu)*len(B))),:)]']
-     */
-    for (int32_t _i = 0; _i < MPC_HU_LEN; _i++) {
-        CTHETA = CTHETA.InsertSubMatrix(COMEGA, _i*SS_Z_LEN, _i*SS_U_LEN, (MPC_HP_LEN*SS_Z_LEN)-(_i*SS_Z_LEN), SS_U_LEN);
+#if defined(MPC_USE_REINIT_WORKSPACE)
+    vReTune(_bobotQ, _bobotR, _workspace);
+#else
+    vReTune(_bobotQ, _bobotR);
+#endif
+    
+#if defined(MPC_REINIT_CACHE_LEN)
+    _entry = i32ReInitCacheVictim(ReInitCacheTag);
+    ReInitCacheTag[_entry].bValid     = true;
+    ReInitCacheTag[_entry].u32hash    = _hash;
+    ReInitCacheTag[_entry].u32lastUse = u32ReInitCacheClock;
+    memcpy(ReInitCacheTag[_entry].f32key, _key, sizeof(_key));
+    pSnapshotPutBlock(pPutOnline(u8ReInitCacheData[_entry]), CTHETA, (MPC_HC_LEN*SS_Z_LEN), (MPC_HU_LEN*SS_U_LEN));
+#endif
+}
+
+/* Calculate the offline optimization constants (the only part of vReInit that depends on the weights) */
+#if defined(MPC_USE_REINIT_WORKSPACE)
+void MPC::vReTune(float_prec _bobotQ, float_prec _bobotR)
+{
+    vReTune(_bobotQ, _bobotR, f32ReInitWorkspace);
+}
+
+/* {MPC_2}..{MPC_4} on the workspace (MPC_REINIT_TUNE_LEN elements). H is symmetric positive definite
+ *  (R > 0), so instead of H^-1 it is factored as H = L*L' (Cholesky), and every column of
+ *  XI_FULL = H^-1 * CTHETA' * Q is solved from L*L'*xi = CTHETA(c,:)'*q. Only the first M rows
+ *  (XI_DU) of each column are kept, so {MPC_4} is part of {MPC_3} here.
+ */
+void MPC::vReTune(float_prec _bobotQ, float_prec _bobotR, float_prec * _workspace)
+{
+    const int32_t _n = (MPC_HU_LEN*SS_U_LEN);
+    float_prec * const _L  = _workspace;            /* H, then L in its lower triangle  */
+    float_prec * const _xi = _L + (_n*_n);          /* A column of XI_FULL              */
+    
+    Q.vSetDiag(_bobotQ);
+    R.vSetDiag(_bobotR);
+    
+    /*  H       = CTHETA'*Q*CTHETA + R                                                  ...{MPC_2} */
+    MPC_PROFILE_BEGIN(2);
+    for (int32_t _i = 0; _i < _n; _i++) {
+        for (int32_t _j = 0; _j <= _i; _j++) {
+            float_prec _sum = 0;
+            for (int32_t _k = 0; _k < (MPC_HC_LEN*SS_Z_LEN); _k++) {
+                _sum += CTHETA[_k][_i] * CTHETA[_k][_j];
+            }
+            _L[(_i*_n) + _j] = (_sum * _bobotQ) + ((_i == _j) ? _bobotR : float_prec(0.0));
+        }
+    }
+    MPC_PROFILE_END(2);
+    
+    /*  XI_DU   = (H^-1 * CTHETA' * Q)(1:M, :)                                          ...{MPC_3} */
+    MPC_PROFILE_BEGIN(3);
+    bool _valid = true;
+    for (int32_t _j = 0; (_j < _n) && _valid; _j++) {
+        float_prec _diag = _L[(_j*_n) + _j];
+        for (int32_t _k = 0; _k < _j; _k++) {
+            _diag -= _L[(_j*_n) + _k] * _L[(_j*_n) + _k];
+        }
+        if (_diag <= float_prec(float_prec_ZERO)) {
+            _valid = false;
+            break;
+        }
+        _L[(_j*_n) + _j] = sqrt(_diag);
+        for (int32_t _i = _j+1; _i < _n; _i++) {
+            float_prec _sum = _L[(_i*_n) + _j];
+            for (int32_t _k = 0; _k < _j; _k++) {
+                _sum -= _L[(_i*_n) + _k] * _L[(_j*_n) + _k];
+            }
+            _L[(_i*_n) + _j] = _sum / _L[(_j*_n) + _j];
+        }
+    }
+    if (!_valid) {
+        /* set XI_DU as zero to signal that the offline optimization matrix calculation has failed */
+        XI_DU.vSetToZero();
+    } else {
+        for (int32_t _c = 0; _c < (MPC_HC_LEN*SS_Z_LEN); _c++) {
+            /* L*y = CTHETA(c,:)'*q, then L'*xi = y */
+            for (int32_t _i = 0; _i < _n; _i++) {
+                float_prec _sum = CTHETA[_c][_i] * _bobotQ;
+                for (int32_t _k = 0; _k < _i; _k++) {
+                    _sum -= _L[(_i*_n) + _k] * _xi[_k];
+                }
+                _xi[_i] = _sum / _L[(_i*_n) + _i];
+            }
+            for (int32_t _i = _n-1; _i >= 0; _i--) {
+                float_prec _sum = _xi[_i];
+                for (int32_t _k = _i+1; _k < _n; _k++) {
+                    _sum -= _L[(_k*_n) + _i] * _xi[_k];
+                }
+                _xi[_i] = _sum / _L[(_i*_n) + _i];
+            }
+            for (int32_t _i = 0; _i < SS_U_LEN; _i++) {
+                XI_DU[_i][_c] = _xi[_i];
+            }
+        }
     }
+    MPC_PROFILE_END(3);
     
+#if defined(MPC_USE_FIXED_POINT)
+    vQuantizeFixed();
+#endif
+}
+#else
+void MPC::vReTune(float_prec _bobotQ, float_prec _bobotR)
+{
+    Q.vSetDiag(_bobotQ);
+    R.vSetDiag(_bobotR);
     
-    /* Calculate the offline optimization constants ---------------------------------------------- */
+    /* Counted in MPC_STACK_RETUNE (mpc.h), change it with the Matrix objects below */
     Matrix H        {(MPC_HU_LEN*SS_U_LEN), (MPC_HU_LEN*SS_U_LEN)};
     Matrix H_INV    {(MPC_HU_LEN*SS_U_LEN), (MPC_HU_LEN*SS_U_LEN)};
-    Matrix XI       {(MPC_HU_LEN*SS_U_LEN), (MPC_HP_LEN*SS_Z_LEN)};
+    Matrix XI       {(MPC_HU_LEN*SS_U_LEN), (MPC_HC_LEN*SS_Z_LEN)};
     
     /*  H       = CTHETA'*Q*CTHETA + R                                                  ...{MPC_2} */
+    MPC_PROFILE_BEGIN(2);
     H = ((CTHETA.Transpose()) * Q * CTHETA) + R;
+    MPC_PROFILE_END(2);
     
     /*  XI_FULL = 0.5*H^-1*2*CTHETA'*Q
      *          = H^-1 * CTHETA' * Q                                                    ...{MPC_3}
      */
+    MPC_PROFILE_BEGIN(3);
     H_INV = H.Invers();
     if (!H_INV.bMatrixIsValid()) {
         /* set XI as zero to signal that the offline optimization matrix calculation has failed */ 
@@ -144,28 +442,533 @@ void MPC::vReInit(Matrix &A, Matrix &B, Matrix &C, float_prec _bobotQ, float_pre
     } else {
         XI = H_INV * (CTHETA.Transpose()) * Q;
     }
+    MPC_PROFILE_END(3);
     
     /* XI_DU   = XI_FULL(1:M, :)                                                        ...{MPC_4} */
-    XI_DU = XI_DU.InsertSubMatrix(XI, 0, 0, 0, 0, SS_U_LEN, (MPC_HP_LEN*SS_Z_LEN));
+    MPC_PROFILE_BEGIN(4);
+    XI_DU = XI_DU.InsertSubMatrix(XI, 0, 0, 0, 0, SS_U_LEN, (MPC_HC_LEN*SS_Z_LEN));
+    MPC_PROFILE_END(4);
+    
+#if defined(MPC_USE_FIXED_POINT)
+    vQuantizeFixed();
+#endif
+}
+#endif
+
+/*  Snapshot payload (see snapshot.h), all row-major with the matrix dimension as the stride:
+ *      i32CoincidenceTime [Hc]     (padded to float_prec)
+ *      CPSI, COMEGA                (or the grid segments A^m, S(m) and C with MPC_USE_MATRIX_FREE_PREDICTION)
+ *      XI_DU
+ */
+MPC_SnapshotInfo MPC::SnapshotInfo()
+{
+    MPC_SnapshotInfo _info;
+#if defined(MPC_USE_MATRIX_FREE_PREDICTION)
+    _info.u8kind = MPC_SNAPSHOT_KIND_OPT_MATRIX_FREE;
+#else
+    _info.u8kind = MPC_SNAPSHOT_KIND_OPT;
+#endif
+    _info.i32x  = SS_X_LEN;
+    _info.i32u  = SS_U_LEN;
+    _info.i32z  = SS_Z_LEN;
+    _info.i32hp = MPC_HP_LEN;
+    _info.i32hu = MPC_HU_LEN;
+    _info.i32hc = MPC_HC_LEN;
+    return _info;
+}
+
+size_t MPC::szSnapshotPayloadBytes()
+{
+    return MPC_ONLINE_BYTES;
+}
+
+size_t MPC::szSnapshotBytes()
+{
+    return MPC_SNAPSHOT_HEADER_BYTES + szSnapshotPayloadBytes();
+}
+
+/* Write (read) the online constants in the snapshot payload layout, return the end of the payload */
+uint8_t * MPC::pPutOnline(uint8_t * _p)
+{
+    memset(_p, 0, MPC_SNAPSHOT_INT_BYTES(MPC_HC_LEN));
+    pSnapshotPutInt(_p, i32CoincidenceTime, MPC_HC_LEN);
+    _p += MPC_SNAPSHOT_INT_BYTES(MPC_HC_LEN);
+#if defined(MPC_USE_MATRIX_FREE_PREDICTION)
+    memcpy(_p, f32Aseg, sizeof(f32Aseg));       _p += sizeof(f32Aseg);
+    memcpy(_p, f32Sseg, sizeof(f32Sseg));       _p += sizeof(f32Sseg);
+    _p = pSnapshotPutBlock(_p, C, SS_Z_LEN, SS_X_LEN);
+#else
+    _p = pSnapshotPutBlock(_p, CPSI, (MPC_HC_LEN*SS_Z_LEN), SS_X_LEN);
+    _p = pSnapshotPutBlock(_p, COMEGA, (MPC_HC_LEN*SS_Z_LEN), SS_U_LEN);
+#endif
+    return pSnapshotPutBlock(_p, XI_DU, SS_U_LEN, (MPC_HC_LEN*SS_Z_LEN));
+}
+
+const uint8_t * MPC::pGetOnline(const uint8_t * _p)
+{
+    pSnapshotGetInt(_p, i32CoincidenceTime, MPC_HC_LEN);
+    _p += MPC_SNAPSHOT_INT_BYTES(MPC_HC_LEN);
+#if defined(MPC_USE_MATRIX_FREE_PREDICTION)
+    memcpy(f32Aseg, _p, sizeof(f32Aseg));       _p += sizeof(f32Aseg);
+    memcpy(f32Sseg, _p, sizeof(f32Sseg));       _p += sizeof(f32Sseg);
+    _p = pSnapshotGetBlock(_p, C, SS_Z_LEN, SS_X_LEN);
+#else
+    _p = pSnapshotGetBlock(_p, CPSI, (MPC_HC_LEN*SS_Z_LEN), SS_X_LEN);
+    _p = pSnapshotGetBlock(_p, COMEGA, (MPC_HC_LEN*SS_Z_LEN), SS_U_LEN);
+#endif
+    return pSnapshotGetBlock(_p, XI_DU, SS_U_LEN, (MPC_HC_LEN*SS_Z_LEN));
+}
+
+bool MPC::bSaveSnapshot(void * _buf, const size_t _bufBytes)
+{
+    if ((_buf == NULL) || (_bufBytes < szSnapshotBytes())) {
+        return false;
+    }
+    pPutOnline(((uint8_t *) _buf) + MPC_SNAPSHOT_HEADER_BYTES);
+    vSnapshotWriteHeader((uint8_t *) _buf, SnapshotInfo(), uint32_t(szSnapshotPayloadBytes()));
+    return true;
+}
+
+bool MPC::bLoadSnapshot(const void * _snapshot, const size_t _bytes)
+{
+    const uint8_t * _p = pSnapshotCheck(_snapshot, _bytes, SnapshotInfo(), uint32_t(szSnapshotPayloadBytes()));
+    if (_p == NULL) {
+        return false;
+    }
+    pGetOnline(_p);
+#if defined(MPC_USE_FIXED_POINT)
+    vQuantizeFixed();
+#endif
+    return true;
+}
+
+#if defined(MPC_REINIT_CACHE_LEN)
+void MPC::vSetReInitCacheQuantum(const float_prec _quantum)
+{
+    f32ReInitCacheQuantum = _quantum;
+    vClearReInitCache();
 }
 
+void MPC::vClearReInitCache()
+{
+    for (int32_t _i = 0; _i < MPC_REINIT_CACHE_LEN; _i++) {
+        ReInitCacheTag[_i].bValid = false;
+    }
+    u32ReInitCacheClock = 0;
+    u32ReInitCacheHit   = 0;
+    u32ReInitCacheMiss  = 0;
+}
+#endif
+
+#if defined(MPC_USE_FIXED_POINT)
+void MPC::vSetFixedRange(const float_prec _spMax, const float_prec _xMax, const float_prec _uMax)
+{
+    f32fxRange[0] = _spMax;
+    f32fxRange[1] = _xMax;
+    f32fxRange[2] = _uMax;
+    u32fxSaturation = 0;
+    vQuantizeFixed();
+}
+
+/*  Choose the fixed-point formats & convert the gains (see fixed_point.h):
+ *      - CPSI, COMEGA, XI_DU   : from their biggest element.
+ *      - SP, x, u              : from f32fxRange.
+ *      - E(k)                  : from the bound max_r(|SP| + sum_j|CPSI(r,j)|*|x| + sum_j|COMEGA(r,j)|*|u|),
+ *                                so {MPC_5} only saturates when a signal is out of its range.
+ *  The result of {MPC_6} is converted straight into the format of u for {MPC_7}.
+ */
+void MPC::vQuantizeFixed()
+{
+    float_prec _maxCPSI = 0;
+    float_prec _maxCOMEGA = 0;
+    float_prec _maxXI = 0;
+    float_prec _maxErr = 0;
+    for (int32_t _i = 0; _i < (MPC_HC_LEN*SS_Z_LEN); _i++) {
+        float_prec _bound = f32fxRange[0];
+        for (int32_t _j = 0; _j < SS_X_LEN; _j++) {
+            _maxCPSI = (fabs(CPSI[_i][_j]) > _maxCPSI) ? float_prec(fabs(CPSI[_i][_j])) : _maxCPSI;
+            _bound += float_prec(fabs(CPSI[_i][_j])) * f32fxRange[1];
+        }
+        for (int32_t _j = 0; _j < SS_U_LEN; _j++) {
+            _maxCOMEGA = (fabs(COMEGA[_i][_j]) > _maxCOMEGA) ? float_prec(fabs(COMEGA[_i][_j])) : _maxCOMEGA;
+            _bound += float_prec(fabs(COMEGA[_i][_j])) * f32fxRange[2];
+        }
+        _maxErr = (_bound > _maxErr) ? _bound : _maxErr;
+    }
+    for (int32_t _i = 0; _i < SS_U_LEN; _i++) {
+        for (int32_t _j = 0; _j < (MPC_HC_LEN*SS_Z_LEN); _j++) {
+            _maxXI = (fabs(XI_DU[_i][_j]) > _maxXI) ? float_prec(fabs(XI_DU[_i][_j])) : _maxXI;
+        }
+    }
+    i32fxExp[MPC_FIXED_CPSI]   = i32FixedExponent(_maxCPSI);
+    i32fxExp[MPC_FIXED_COMEGA] = i32FixedExponent(_maxCOMEGA);
+    i32fxExp[MPC_FIXED_XI_DU]  = i32FixedExponent(_maxXI);
+    i32fxExp[MPC_FIXED_SP]     = i32FixedExponent(f32fxRange[0]);
+    i32fxExp[MPC_FIXED_X]      = i32FixedExponent(f32fxRange[1]);
+    i32fxExp[MPC_FIXED_U]      = i32FixedExponent(f32fxRange[2]);
+    i32fxExp[MPC_FIXED_ERR]    = i32FixedExponent(_maxErr);
+    
+    for (int32_t _i = 0; _i < (MPC_HC_LEN*SS_Z_LEN); _i++) {
+        for (int32_t _j = 0; _j < SS_X_LEN; _j++) {
+            fxCPSI[_i][_j] = fxFixedFromFloat(CPSI[_i][_j], i32fxExp[MPC_FIXED_CPSI]);
+        }
+        for (int32_t _j = 0; _j < SS_U_LEN; _j++) {
+            fxCOMEGA[_i][_j] = fxFixedFromFloat(COMEGA[_i][_j], i32fxExp[MPC_FIXED_COMEGA]);
+        }
+    }
+    for (int32_t _i = 0; _i < SS_U_LEN; _i++) {
+        for (int32_t _j = 0; _j < (MPC_HC_LEN*SS_Z_LEN); _j++) {
+            fxXI_DU[_i][_j] = fxFixedFromFloat(XI_DU[_i][_j], i32fxExp[MPC_FIXED_XI_DU]);
+        }
+    }
+    
+    /* From the scale of each accumulator (2^(e1 + e2 - MPC_FIXED_ACC_FRAC_BITS)) to its destination */
+    i32fxShiftSP     = i32fxExp[MPC_FIXED_ERR] - i32fxExp[MPC_FIXED_SP];
+    i32fxShiftCPSI   = (i32fxExp[MPC_FIXED_ERR] - MPC_FIXED_FRAC_BITS) -
+                       (i32fxExp[MPC_FIXED_CPSI] + i32fxExp[MPC_FIXED_X] - MPC_FIXED_ACC_FRAC_BITS);
+    i32fxShiftCOMEGA = (i32fxExp[MPC_FIXED_ERR] - MPC_FIXED_FRAC_BITS) -
+                       (i32fxExp[MPC_FIXED_COMEGA] + i32fxExp[MPC_FIXED_U] - MPC_FIXED_ACC_FRAC_BITS);
+    i32fxShiftXI     = (i32fxExp[MPC_FIXED_U] - MPC_FIXED_FRAC_BITS) -
+                       (i32fxExp[MPC_FIXED_XI_DU] + i32fxExp[MPC_FIXED_ERR] - MPC_FIXED_ACC_FRAC_BITS);
+}
+
+bool MPC::bUpdateFixed(const fixed_prec * _SP, const fixed_prec * _x, fixed_prec * _u)
+{
+    /*  E(k) = SP(k) - CPSI*x(k) - COMEGA*u(k-1)                                        ...{MPC_5} */
+    MPC_PROFILE_BEGIN(5);
+    fixed_prec _err[(MPC_HC_LEN*SS_Z_LEN)];
+    for (int32_t _i = 0; _i < (MPC_HC_LEN*SS_Z_LEN); _i++) {
+        int64_t _accX = 0;
+        int64_t _accU = 0;
+        for (int32_t _j = 0; _j < SS_X_LEN; _j++) {
+            _accX += i64FixedProduct(fxCPSI[_i][_j], _x[_j]);
+        }
+        for (int32_t _j = 0; _j < SS_U_LEN; _j++) {
+            _accU += i64FixedProduct(fxCOMEGA[_i][_j], _u[_j]);
+        }
+        const int64_t _val = i64FixedShift(_SP[_i], i32fxShiftSP) - i64FixedShift(_accX, i32fxShiftCPSI) -
+                             i64FixedShift(_accU, i32fxShiftCOMEGA);
+        _err[_i] = fxFixedSaturate(_val);
+        u32fxSaturation += (int64_t(_err[_i]) != _val) ? 1 : 0;
+    }
+    MPC_PROFILE_END(5);
+    
+    /*  dU(k)_optimal = XI_DU * E(k)                                                    ...{MPC_6} */
+    MPC_PROFILE_BEGIN(6);
+    int64_t _du[SS_U_LEN];
+    for (int32_t _i = 0; _i < SS_U_LEN; _i++) {
+        int64_t _acc = 0;
+        for (int32_t _j = 0; _j < (MPC_HC_LEN*SS_Z_LEN); _j++) {
+            _acc += i64FixedProduct(fxXI_DU[_i][_j], _err[_j]);
+        }
+        _du[_i] = i64FixedShift(_acc, i32fxShiftXI);
+    }
+    MPC_PROFILE_END(6);
+    
+    /*  u(k) = u(k-1) + du(k)                                                           ...{MPC_7} */
+    MPC_PROFILE_BEGIN(7);
+    for (int32_t _i = 0; _i < SS_U_LEN; _i++) {
+        const int64_t _val = int64_t(_u[_i]) + _du[_i];
+        _u[_i] = fxFixedSaturate(_val);
+        u32fxSaturation += (int64_t(_u[_i]) != _val) ? 1 : 0;
+    }
+    MPC_PROFILE_END(7);
+    
+    return true;
+}
+#endif
+
+#if defined(MPC_USE_PHASE_PROFILING)
+void MPC::vResetPhaseStat()
+{
+    for (int32_t _i = 0; _i < MPC_PHASE_LEN; _i++) {
+        vProfileReset(PhaseStat[_i]);
+    }
+}
+#endif
+
+/*  Calculate A^n and S(n) = Sigma(i=0->n-1)A^i*B by repeated squaring, using:
+ *          A^(a+b) = A^a * A^b
+ *          S(a+b)  = S(a) + A^a * S(b)
+ */
+void MPC::vCalculatePowerSigma(int32_t _n, Matrix &_Apow, Matrix &_Sigma)
+{
+    /* Counted in MPC_STACK_POWER_SIGMA (mpc.h), change it with the Matrix objects below */
+    Matrix _Asq(SS_X_LEN, SS_X_LEN);
+    Matrix _Ssq(SS_X_LEN, SS_U_LEN);
+    
+    _Apow.vSetIdentity();
+    _Sigma.vSetToZero();
+    _Asq = A;
+    _Ssq = B;
+    while (_n > 0) {
+        if (_n & 1) {
+            _Sigma = _Ssq + (_Asq * _Sigma);
+            _Apow  = _Asq * _Apow;
+        }
+        _n >>= 1;
+        if (_n > 0) {
+            _Ssq = _Ssq + (_Asq * _Ssq);
+            _Asq = _Asq * _Asq;
+        }
+    }
+}
+
+#if defined(MPC_USE_REINIT_WORKSPACE)
+/* vCalculatePowerSigma() on the workspace arrays: _Apow (X x X) & _Sigma (X x U), with _workspace
+ *  holding the product, A^a & S(a) (MPC_REINIT_POWER_SIGMA_LEN elements)
+ */
+void MPC::vCalculatePowerSigma(int32_t _n, float_prec * _Apow, float_prec * _Sigma, float_prec * _workspace)
+{
+    float_prec * const _tmp = _workspace;
+    float_prec * const _Asq = _tmp + (SS_X_LEN*SS_X_LEN);
+    float_prec * const _Ssq = _Asq + (SS_X_LEN*SS_X_LEN);
+    
+    for (int32_t _i = 0; _i < SS_X_LEN; _i++) {
+        for (int32_t _j = 0; _j < SS_X_LEN; _j++) {
+            _Apow[(_i*SS_X_LEN) + _j] = (_i == _j) ? float_prec(1.0) : float_prec(0.0);
+            _Asq[(_i*SS_X_LEN) + _j]  = A[_i][_j];
+        }
+        for (int32_t _j = 0; _j < SS_U_LEN; _j++) {
+            _Sigma[(_i*SS_U_LEN) + _j] = 0;
+            _Ssq[(_i*SS_U_LEN) + _j]   = B[_i][_j];
+        }
+    }
+    while (_n > 0) {
+        if (_n & 1) {
+            vWorkspaceMulAdd(_Sigma, _Ssq, _Asq, _Sigma, SS_U_LEN, _tmp);
+            vWorkspaceMulAdd(_Apow, NULL, _Asq, _Apow, SS_X_LEN, _tmp);
+        }
+        _n >>= 1;
+        if (_n > 0) {
+            vWorkspaceMulAdd(_Ssq, _Ssq, _Asq, _Ssq, SS_U_LEN, _tmp);
+            vWorkspaceMulAdd(_Asq, NULL, _Asq, _Asq, SS_X_LEN, _tmp);
+        }
+    }
+}
+
+/* {MPC_1} of vReInit() on the workspace (MPC_REINIT_PREDICTION_LEN elements), see there */
+void MPC::vCalculatePrediction(float_prec * _workspace)
+{
+    const int32_t _P[MPC_HC_LEN] = MPC_COINCIDENCE_POINTS;
+    const int32_t _G[MPC_GRID_SEGMENT_LEN][2] = MPC_GRID_SEGMENTS;
+    float_prec * const _Apow    = _workspace;
+    float_prec * const _Aseg    = _Apow   + (SS_X_LEN*SS_X_LEN);
+    float_prec * const _Atheta  = _Aseg   + (SS_X_LEN*SS_X_LEN);
+    float_prec * const _Sseg    = _Atheta + (SS_X_LEN*SS_X_LEN);
+    float_prec * const _Sigma   = _Sseg   + (SS_X_LEN*SS_U_LEN);    /* S(t-c) at _Sigma + c*X*U, 0 <= c < Hu */
+    float_prec * const _scratch = _Sigma  + (MPC_HU_LEN*SS_X_LEN*SS_U_LEN);   /* vCalculatePowerSigma(), its first X*X for the products */
+    
+    int32_t _s = 0;         /* Prediction step */
+    int32_t _t = 0;         /* Time of the prediction step (in dt) */
+    int32_t _j = 0;         /* Next coincidence point */
+    for (int32_t _i = 0; _i < SS_X_LEN; _i++) {
+        for (int32_t _k = 0; _k < SS_X_LEN; _k++) {
+            _Apow[(_i*SS_X_LEN) + _k] = (_i == _k) ? float_prec(1.0) : float_prec(0.0);
+        }
+    }
+    for (int32_t _i = 0; _i < (MPC_HU_LEN*SS_X_LEN*SS_U_LEN); _i++) {
+        _Sigma[_i] = 0;
+    }
+    for (int32_t _g = 0; _g < MPC_GRID_SEGMENT_LEN; _g++) {
+        vCalculatePowerSigma(_G[_g][1], _Aseg, _Sseg, _scratch);
+        #if defined(MPC_USE_MATRIX_FREE_PREDICTION)
+            memcpy(f32Aseg[_g], _Aseg, sizeof(f32Aseg[_g]));
+            memcpy(f32Sseg[_g], _Sseg, sizeof(f32Sseg[_g]));
+        #endif
+        
+        for (int32_t _n = 0; _n < _G[_g][0]; _n++) {
+            for (int32_t _c = 0; _c < MPC_HU_LEN; _c++) {
+                float_prec * const _Sc = _Sigma + (_c*SS_X_LEN*SS_U_LEN);
+                if (_t >= _c) {
+                    vWorkspaceMulAdd(_Sc, _Sseg, _Aseg, _Sc, SS_U_LEN, _scratch);
+                } else if ((_t + _G[_g][1]) > _c) {
+                    vCalculatePowerSigma(_t + _G[_g][1] - _c, _Atheta, _Sc, _scratch);
+                }
+            }
+            vWorkspaceMulAdd(_Apow, NULL, _Aseg, _Apow, SS_X_LEN, _scratch);
+            _t += _G[_g][1];
+            _s++;
+            
+            if ((_j >= MPC_HC_LEN) || (_P[_j] != _s)) {
+                continue;
+            }
+            i32CoincidenceTime[_j] = _t;
+            
+            #if !defined(MPC_USE_MATRIX_FREE_PREDICTION)
+                vWorkspaceInsertC(CPSI, _j*SS_Z_LEN, 0, C, _Apow, SS_X_LEN);
+                vWorkspaceInsertC(COMEGA, _j*SS_Z_LEN, 0, C, _Sigma, SS_U_LEN);
+            #endif
+            for (int32_t _c = 0; _c < MPC_HU_LEN; _c++) {
+                vWorkspaceInsertC(CTHETA, _j*SS_Z_LEN, _c*SS_U_LEN, C, _Sigma + (_c*SS_X_LEN*SS_U_LEN), SS_U_LEN);
+            }
+            _j++;
+        }
+    }
+    ASSERT((_s == MPC_HP_LEN) && (_j == MPC_HC_LEN), "The MPC_GRID_SEGMENTS or MPC_COINCIDENCE_POINTS don't match MPC_HP_LEN / MPC_HC_LEN");
+}
+#endif
+
+#if defined(MPC_USE_UPDATE_WORKSPACE)
+bool MPC::bUpdate(Matrix &SP, Matrix &x, Matrix &u)
+{
+    return bUpdate(SP, x, u, f32UpdateWorkspace);
+}
+
+bool MPC::bUpdate(Matrix &SP, Matrix &x, Matrix &u, float_prec * _workspace)
+#else
 bool MPC::bUpdate(Matrix &SP, Matrix &x, Matrix &u)
+#endif
 {
-    Matrix Err((MPC_HP_LEN*SS_Z_LEN), 1);
+#if defined(MPC_USE_MATRIX_FREE_PREDICTION)
+    /*  E(k) = SP(k) - CPSI*x(k) - COMEGA*u(k-1)                                        ...{MPC_5}
+     *  dU(k)_optimal = XI_DU * E(k)                                                    ...{MPC_6}
+     * 
+     * Without CPSI & COMEGA: roll the free response forward over the prediction grid
+     *  (with the discretized segments of vReInit) and accumulate every coincidence 
+     *  point's error directly into dU(k):
+     *          x(t+m) = A^m*x(t) + S(m)*u(k-1)
+     *          dU(k) += XI_DU(:, j) * (SP(j) - C*x(T(j)))
+     * 
+     * Note: If XI_DU initialization is failed in vReInit(), the DU_Out is 
+     * always zero (u(k) won't change)
+     * 
+     * Note: The profiling statistic of {MPC_5} is part of {MPC_6} here.
+     */
+    MPC_PROFILE_BEGIN(6);
+    const int32_t _P[MPC_HC_LEN] = MPC_COINCIDENCE_POINTS;
+    const int32_t _G[MPC_GRID_SEGMENT_LEN][2] = MPC_GRID_SEGMENTS;
+    float_prec _xPred[SS_X_LEN];
+    float_prec _xNext[SS_X_LEN];
+    float_prec _err;
+    
+    /* Counted in MPC_STACK_UPDATE_BYTES (mpc.h), change it with the Matrix objects below */
+    Matrix DU_Out(SS_U_LEN, 1);
+    for (int32_t _i = 0; _i < SS_X_LEN; _i++) {
+        _xPred[_i] = x[_i][0];
+    }
+    int32_t _s = 0;
+    int32_t _j = 0;
+    for (int32_t _g = 0; _g < MPC_GRID_SEGMENT_LEN; _g++) {
+        for (int32_t _n = 0; _n < _G[_g][0]; _n++) {
+            for (int32_t _i = 0; _i < SS_X_LEN; _i++) {
+                _xNext[_i] = 0.0;
+                for (int32_t _k = 0; _k < SS_X_LEN; _k++) {
+                    _xNext[_i] += f32Aseg[_g][_i][_k] * _xPred[_k];
+                }
+                for (int32_t _k = 0; _k < SS_U_LEN; _k++) {
+                    _xNext[_i] += f32Sseg[_g][_i][_k] * u[_k][0];
+                }
+            }
+            for (int32_t _i = 0; _i < SS_X_LEN; _i++) {
+                _xPred[_i] = _xNext[_i];
+            }
+            _s++;
+            
+            if ((_j >= MPC_HC_LEN) || (_P[_j] != _s)) {
+                continue;
+            }
+            for (int32_t _z = 0; _z < SS_Z_LEN; _z++) {
+                _err = SP[_j*SS_Z_LEN + _z][0];
+                for (int32_t _k = 0; _k < SS_X_LEN; _k++) {
+                    _err -= C[_z][_k] * _xPred[_k];
+                }
+                for (int32_t _i = 0; _i < SS_U_LEN; _i++) {
+                    DU_Out[_i][0] += XI_DU[_i][_j*SS_Z_LEN + _z] * _err;
+                }
+            }
+            _j++;
+        }
+    }
+    MPC_PROFILE_END(6);
+#elif defined(MPC_USE_CONSTANT_TIME_UPDATE) || defined(MPC_USE_UPDATE_WORKSPACE)
+    /*  {MPC_5}..{MPC_7} with the trip counts of the compile-time dimension only: no bound check, no
+     *  Matrix temporary, no early return, and flush-to-zero (see wcet.h for the cycle estimate).
+     *  With MPC_USE_UPDATE_WORKSPACE the vectors are on the caller's workspace instead of the stack.
+     *  The sums are the ones of the Matrix update in the same order (MPC_ACC_* is not used), so with
+     *  the default MATRIX_ACC_NAIVE the du(k) is the same.
+     * 
+     * Note: If XI_DU initialization is failed in vReInit(), XI_DU is zero (u(k) won't change)
+     */
+    #if defined(MPC_USE_CONSTANT_TIME_UPDATE)
+        MatrixFlushToZero _ftz;
+    #endif
+    #if defined(MPC_USE_UPDATE_WORKSPACE)
+        float_prec * const _x   = _workspace;
+        float_prec * const _u   = _x + SS_X_LEN;
+        float_prec * const _err = _u + SS_U_LEN;
+        float_prec * const _du  = _err + (MPC_HC_LEN*SS_Z_LEN);
+    #else
+        float_prec _x[SS_X_LEN];
+        float_prec _u[SS_U_LEN];
+        float_prec _err[(MPC_HC_LEN*SS_Z_LEN)];
+        float_prec _du[SS_U_LEN];
+    #endif
+    for (int32_t _j = 0; _j < SS_X_LEN; _j++) {
+        _x[_j] = x.pRowUnchecked(_j)[0];
+    }
+    for (int32_t _j = 0; _j < SS_U_LEN; _j++) {
+        _u[_j] = u.pRowUnchecked(_j)[0];
+    }
+    
+    /*  E(k) = SP(k) - CPSI*x(k) - COMEGA*u(k-1)                                        ...{MPC_5} */
+    MPC_PROFILE_BEGIN(5);
+    for (int32_t _i = 0; _i < (MPC_HC_LEN*SS_Z_LEN); _i++) {
+        const float_prec * const _psi = CPSI.pRowUnchecked(_i);
+        const float_prec * const _omega = COMEGA.pRowUnchecked(_i);
+        float_prec _sumPsi = 0;
+        float_prec _sumOmega = 0;
+        for (int32_t _j = 0; _j < SS_X_LEN; _j++) {
+            _sumPsi += _psi[_j] * _x[_j];
+        }
+        for (int32_t _j = 0; _j < SS_U_LEN; _j++) {
+            _sumOmega += _omega[_j] * _u[_j];
+        }
+        _err[_i] = SP.pRowUnchecked(_i)[0] - _sumPsi - _sumOmega;
+    }
+    MPC_PROFILE_END(5);
+    
+    /*  dU(k)_optimal = XI_DU * E(k)                                                    ...{MPC_6} */
+    MPC_PROFILE_BEGIN(6);
+    for (int32_t _i = 0; _i < SS_U_LEN; _i++) {
+        const float_prec * const _xi = XI_DU.pRowUnchecked(_i);
+        float_prec _sum = 0;
+        for (int32_t _j = 0; _j < (MPC_HC_LEN*SS_Z_LEN); _j++) {
+            _sum += _xi[_j] * _err[_j];
+        }
+        _du[_i] = _sum;
+    }
+    MPC_PROFILE_END(6);
+#else
+    /* Counted in MPC_STACK_UPDATE_BYTES (mpc.h), change it with the Matrix objects below */
+    MPC_PROFILE_BEGIN(5);
+    Matrix Err((MPC_HC_LEN*SS_Z_LEN), 1);
     
     /*  E(k) = SP(k) - CPSI*x(k) - COMEGA*u(k-1)                                        ...{MPC_5} */
-    Err = SP - CPSI*x - COMEGA*u;
+    Err = SP - CPSI.Multiply(x, MPC_ACC_PREDICTION) - COMEGA.Multiply(u, MPC_ACC_PREDICTION);
+    MPC_PROFILE_END(5);
     
     /*  dU(k)_optimal = XI_DU * E(k)                                                    ...{MPC_6}
      * 
      * Note: If XI_DU initialization is failed in vReInit(), the DU_Out is 
      * always zero (u(k) won't change)
      */
+    MPC_PROFILE_BEGIN(6);
     Matrix DU_Out(SS_U_LEN, 1);
-    DU_Out = XI_DU * Err;
+    DU_Out = XI_DU.Multiply(Err, MPC_ACC_GAIN);
+    MPC_PROFILE_END(6);
+#endif
     
     /*  u(k) = u(k-1) + du(k)                                                           ...{MPC_7} */
+    MPC_PROFILE_BEGIN(7);
+#if defined(MPC_USE_CONSTANT_TIME_UPDATE) || defined(MPC_USE_UPDATE_WORKSPACE)
+    for (int32_t _i = 0; _i < SS_U_LEN; _i++) {
+        u.pRowUnchecked(_i)[0] = _u[_i] + _du[_i];
+    }
+#else
     u = u + DU_Out;
+#endif
+    MPC_PROFILE_END(7);
     
     return true;
 }
@@ -9,40 +9,260 @@
 
 #include "konfig.h"
 #include "matrix.h"
+#include "profiler.h"
+#include "snapshot.h"
+#include "reinit_cache.h"
+#include "fixed_point.h"
+#include "wcet.h"
 
 
 #if (MPC_HP_LEN < MPC_HU_LEN)
     #error("The MPC_HP_LEN must be more than or equal MPC_HU_LEN!");
 #endif
-#if (((MPC_HP_LEN*SS_Z_LEN) > MATRIX_MAXIMUM_SIZE) || ((MPC_HP_LEN*SS_X_LEN) > MATRIX_MAXIMUM_SIZE) || ((MPC_HU_LEN*SS_U_LEN) > MATRIX_MAXIMUM_SIZE))
+#if ((MPC_HC_LEN < 1) || (MPC_HC_LEN > MPC_HP_LEN))
+    #error("The MPC_HC_LEN must be between 1 and MPC_HP_LEN!");
+#endif
+
+/* MPC_COINCIDENCE_POINTS must be MPC_HC_LEN prediction steps, strictly increasing & within 1..MPC_HP_LEN */
+constexpr int32_t MPC_COINCIDENCE_POINT_LIST[] = MPC_COINCIDENCE_POINTS;
+constexpr bool bMPCCoincidencePointsValid(const int32_t _i)
+{
+    return (_i >= MPC_HC_LEN) ||
+           ((MPC_COINCIDENCE_POINT_LIST[_i] >= ((_i == 0) ? 1 : (MPC_COINCIDENCE_POINT_LIST[_i-1] + 1))) &&
+            (MPC_COINCIDENCE_POINT_LIST[_i] <= MPC_HP_LEN) && bMPCCoincidencePointsValid(_i + 1));
+}
+static_assert((sizeof(MPC_COINCIDENCE_POINT_LIST) / sizeof(MPC_COINCIDENCE_POINT_LIST[0])) == MPC_HC_LEN,
+              "The MPC_COINCIDENCE_POINTS must have MPC_HC_LEN entries!");
+static_assert(bMPCCoincidencePointsValid(0),
+              "The MPC_COINCIDENCE_POINTS must be strictly increasing and between 1 and MPC_HP_LEN!");
+#if defined(MPC_USE_FIXED_POINT) && defined(MPC_USE_MATRIX_FREE_PREDICTION)
+    #error("MPC_USE_FIXED_POINT needs CPSI & COMEGA, it can't be used with MPC_USE_MATRIX_FREE_PREDICTION!");
+#endif
+#if defined(MPC_USE_CONSTANT_TIME_UPDATE) && defined(MPC_USE_MATRIX_FREE_PREDICTION)
+    #error("MPC_USE_CONSTANT_TIME_UPDATE needs CPSI & COMEGA, it can't be used with MPC_USE_MATRIX_FREE_PREDICTION!");
+#endif
+#if defined(MPC_USE_UPDATE_WORKSPACE) && defined(MPC_USE_MATRIX_FREE_PREDICTION)
+    #error("MPC_USE_UPDATE_WORKSPACE needs CPSI & COMEGA, it can't be used with MPC_USE_MATRIX_FREE_PREDICTION!");
+#endif
+#if (((MPC_HC_LEN*SS_Z_LEN) > MATRIX_MAXIMUM_SIZE) || ((MPC_HU_LEN*SS_U_LEN) > MATRIX_MAXIMUM_SIZE))
     #error("The MATRIX_MAXIMUM_SIZE is too small to do MPC calculation!");
 #endif
 
+/* The float_prec elements of the vReInit() workspace (MPC_USE_REINIT_WORKSPACE in konfig.h): the product,
+ *  A^a & S(a) of vCalculatePowerSigma(), plus A^t, A^m, A^(t-c), S(m) & S(t-c) (0 <= c < Hu) of {MPC_1}; then reused
+ *  by vReTune() for H (its Cholesky factor) & one column of XI_FULL
+ */
+#define MPC_REINIT_POWER_SIGMA_LEN  ((2*SS_X_LEN*SS_X_LEN) + (SS_X_LEN*SS_U_LEN))
+#define MPC_REINIT_PREDICTION_LEN   ((3*SS_X_LEN*SS_X_LEN) + ((MPC_HU_LEN + 1)*SS_X_LEN*SS_U_LEN) + MPC_REINIT_POWER_SIGMA_LEN)
+#define MPC_REINIT_TUNE_LEN         ((MPC_HU_LEN*SS_U_LEN) * ((MPC_HU_LEN*SS_U_LEN) + 1))
+#define MPC_REINIT_WORKSPACE_LEN    ((MPC_REINIT_PREDICTION_LEN > MPC_REINIT_TUNE_LEN) ? MPC_REINIT_PREDICTION_LEN : MPC_REINIT_TUNE_LEN)
+#define MPC_REINIT_WORKSPACE_BYTES  (MPC_REINIT_WORKSPACE_LEN * sizeof(float_prec))
+
+/* The float_prec elements of the bUpdate() workspace (MPC_USE_UPDATE_WORKSPACE in konfig.h): x(k), u(k-1),
+ *  E(k) & dU(k)
+ */
+#define MPC_UPDATE_WORKSPACE_LEN    (SS_X_LEN + SS_U_LEN + (MPC_HC_LEN*SS_Z_LEN) + SS_U_LEN)
+#define MPC_UPDATE_WORKSPACE_BYTES  (MPC_UPDATE_WORKSPACE_LEN * sizeof(float_prec))
+
+/* The bytes of the online constants (the snapshot payload, see bSaveSnapshot() in mpc.cpp) */
+#if defined(MPC_USE_MATRIX_FREE_PREDICTION)
+    #define MPC_ONLINE_BYTES    (MPC_SNAPSHOT_INT_BYTES(MPC_HC_LEN) + (((SS_U_LEN*MPC_HC_LEN*SS_Z_LEN) + \
+                                 (MPC_GRID_SEGMENT_LEN*SS_X_LEN*(SS_X_LEN + SS_U_LEN)) + (SS_Z_LEN*SS_X_LEN)) * sizeof(float_prec)))
+#else
+    #define MPC_ONLINE_BYTES    (MPC_SNAPSHOT_INT_BYTES(MPC_HC_LEN) + (((SS_U_LEN*MPC_HC_LEN*SS_Z_LEN) + \
+                                 (MPC_HC_LEN*SS_Z_LEN*(SS_X_LEN + SS_U_LEN))) * sizeof(float_prec)))
+#endif
+
+/* The stack of vReInit() & bUpdate() for budget.h, from the Matrix objects & arrays of each function in
+ *  mpc.cpp (see MATRIX_STACK_BYTES in matrix.h); a product or a sum with a named Matrix operand also copies
+ *  that operand (the by-value argument). Change them with the code.
+ */
+#define MPC_STACK_GRID_BYTES        ((MPC_HC_LEN + (2*MPC_GRID_SEGMENT_LEN)) * sizeof(int32_t))    /* _P & _G */
+#if defined(MPC_REINIT_CACHE_LEN)
+    #define MPC_STACK_CACHE_KEY_BYTES   (MPC_REINIT_CACHE_KEY_LEN * sizeof(float_prec))
+#else
+    #define MPC_STACK_CACHE_KEY_BYTES   (0)
+#endif
+
+/* vCalculatePowerSigma(): _Asq & _Ssq (2), _Ssq + (_Asq*_Sigma) (3), _Asq*_Apow (2), _Ssq + (_Asq*_Ssq) (3)
+ *  & _Asq*_Asq (2)
+ */
+#define MPC_STACK_POWER_SIGMA       MATRIX_STACK_BYTES(12, MATRIX_STACK_LEAF)
+#if defined(MPC_USE_REINIT_WORKSPACE)
+    /* The workspace vReInit(A, B, C, Q, R) calls vReInit(.., _workspace) -> vCalculatePrediction() (_P & _G)
+     *  -> vCalculatePowerSigma(), or vReTune(.., _workspace); none has a Matrix
+     */
+    #define MPC_STACK_RETUNE        MATRIX_STACK_BYTES(0, MATRIX_STACK_LEAF)
+    #define MPC_STACK_PREDICTION    (MATRIX_STACK_BYTES(0, MATRIX_STACK_BYTES(0, MATRIX_STACK_LEAF)) + MPC_STACK_GRID_BYTES)
+    #define MPC_STACK_REINIT_BYTES  MATRIX_STACK_BYTES(0, MATRIX_STACK_BYTES(0, szMatrixStackMax(MPC_STACK_PREDICTION, \
+                                        MPC_STACK_RETUNE)) + MPC_STACK_CACHE_KEY_BYTES)
+#else
+    /* vReTune(): H, H_INV & XI (3), CTHETA'*Q*CTHETA + R (5), Invers() (1), H_INV*CTHETA'*Q (3) & the XI
+     *  insertion (2)
+     */
+    #define MPC_STACK_RETUNE        MATRIX_STACK_BYTES(14, szMatrixStackMax(MATRIX_STACK_INVERS, MATRIX_STACK_INSERT))
+    /* vReInit(): _Apow, _Sigma, _Aseg, _Sseg, _Atheta & _Stheta (6), the _Stheta insertion (2), _Aseg*_Apow (2),
+     *  the CTHETA insertion of C*_Sigma (3) and without the matrix-free prediction the CPSI (3) & COMEGA (2)
+     *  insertions; _P, _G & _col
+     */
+    #if defined(MPC_USE_MATRIX_FREE_PREDICTION)
+        #define MPC_STACK_REINIT_MATRIX (13)
+    #else
+        #define MPC_STACK_REINIT_MATRIX (18)
+    #endif
+    #define MPC_STACK_REINIT_BYTES  (MATRIX_STACK_BYTES(MPC_STACK_REINIT_MATRIX, szMatrixStackMax(szMatrixStackMax( \
+                                        MPC_STACK_POWER_SIGMA, MPC_STACK_RETUNE), MATRIX_STACK_INSERT)) + \
+                                     MPC_STACK_GRID_BYTES + (SS_X_LEN * sizeof(float_prec)) + MPC_STACK_CACHE_KEY_BYTES)
+#endif
+
+#if defined(MPC_USE_MATRIX_FREE_PREDICTION)
+    /* bUpdate(): DU_Out (1) & u + DU_Out (2); _P, _G, _xPred & _xNext */
+    #define MPC_STACK_UPDATE_BYTES  (MATRIX_STACK_BYTES(3, MATRIX_STACK_LEAF) + MPC_STACK_GRID_BYTES + \
+                                     (2 * SS_X_LEN * sizeof(float_prec)))
+#elif defined(MPC_USE_UPDATE_WORKSPACE)
+    /* bUpdate(SP, x, u) calls bUpdate(.., _workspace), without a Matrix or an array */
+    #define MPC_STACK_UPDATE_BYTES  MATRIX_STACK_BYTES(0, MATRIX_STACK_BYTES(0, MATRIX_STACK_LEAF))
+#elif defined(MPC_USE_CONSTANT_TIME_UPDATE)
+    /* bUpdate(): the x(k), u(k-1), E(k) & dU(k) arrays (the bUpdate() workspace) */
+    #define MPC_STACK_UPDATE_BYTES  (MATRIX_STACK_BYTES(0, MATRIX_STACK_LEAF) + MPC_UPDATE_WORKSPACE_BYTES)
+#else
+    /* bUpdate(): Err & DU_Out (2), SP - CPSI*x - COMEGA*u (4), XI_DU*Err (1) & u + DU_Out (2) */
+    #define MPC_STACK_UPDATE_BYTES  MATRIX_STACK_BYTES(9, MATRIX_STACK_LEAF)
+#endif
+
 class MPC
 {
 public:
     MPC(Matrix &A, Matrix &B, Matrix &C, float_prec _bobotQ, float_prec _bobotR);
+    /* Without the offline calculation: call vReInit() or bLoadSnapshot() before bUpdate() */
+    MPC();
     void vReInit(Matrix &A, Matrix &B, Matrix &C, float_prec _bobotQ, float_prec _bobotR);
     bool bUpdate(Matrix &SP, Matrix &x, Matrix &u);
+    
+    /* Change the weights only: recalculate {MPC_2}..{MPC_4} with the prediction matrices of the
+     * last vReInit() (CTHETA doesn't depend on the weights)
+     */
+    void vReTune(float_prec _bobotQ, float_prec _bobotR);
+    
+#if defined(MPC_USE_REINIT_WORKSPACE)
+    /* vReInit() & vReTune() on the caller's workspace of MPC_REINIT_WORKSPACE_LEN elements, e.g. one per task */
+    void vReInit(Matrix &A, Matrix &B, Matrix &C, float_prec _bobotQ, float_prec _bobotR, float_prec * _workspace);
+    void vReTune(float_prec _bobotQ, float_prec _bobotR, float_prec * _workspace);
+#endif
+#if defined(MPC_USE_UPDATE_WORKSPACE)
+    /* bUpdate() on the caller's workspace of MPC_UPDATE_WORKSPACE_LEN elements, the instances updated one
+     * after another can share one
+     */
+    bool bUpdate(Matrix &SP, Matrix &x, Matrix &u, float_prec * _workspace);
+#endif
+    
+    /* The online constants as a binary snapshot (see snapshot.h): bSaveSnapshot() writes
+     * szSnapshotBytes() bytes after vReInit(), bLoadSnapshot() restores them without the offline
+     * calculation (vReTune() needs a vReInit() first, as CTHETA is not part of the snapshot)
+     */
+    static size_t szSnapshotBytes();
+    bool bSaveSnapshot(void * _buf, const size_t _bufBytes);
+    bool bLoadSnapshot(const void * _snapshot, const size_t _bytes);
+    
+    /* Time of the j-th coincidence point (the j-th block of SP), in number of SS_DT */
+    int32_t i32GetCoincidenceTime(const int32_t _j) { return i32CoincidenceTime[_j]; }
+    
+#if defined(MPC_USE_FIXED_POINT)
+    /* The biggest |SP|, |x| & |u| the fixed-point formats must hold (1 by default). The gains are
+     * converted again with the new scaling (and after every vReInit, vReTune & bLoadSnapshot).
+     */
+    void vSetFixedRange(const float_prec _spMax, const float_prec _xMax, const float_prec _uMax);
+    /* bUpdate() in fixed-point: SP, x & u are in the MPC_FIXED_SP, MPC_FIXED_X & MPC_FIXED_U format
+     * (see fixed_point.h), u is updated in place, saturated to its range
+     */
+    bool bUpdateFixed(const fixed_prec * _SP, const fixed_prec * _x, fixed_prec * _u);
+    int32_t i32GetFixedExponent(const int32_t _n) { return i32fxExp[_n]; }
+    /* The number of saturated E(k) & u(k) elements since the last vSetFixedRange() */
+    uint32_t u32GetFixedSaturation() { return u32fxSaturation; }
+#endif
+    
+#if defined(MPC_REINIT_CACHE_LEN)
+    /* The vReInit() cache (see reinit_cache.h): setting the quantum clears the cache */
+    void vSetReInitCacheQuantum(const float_prec _quantum);
+    void vClearReInitCache();
+    uint32_t u32GetReInitCacheHit() { return u32ReInitCacheHit; }
+    uint32_t u32GetReInitCacheMiss() { return u32ReInitCacheMiss; }
+#endif
+    
+#if defined(MPC_USE_PHASE_PROFILING)
+    /* The profiling statistic of the {MPC_n} phase (n = 1..MPC_PHASE_LEN), in MPC_PROFILE_COUNTER() ticks */
+    const MPC_PhaseStat & GetPhaseStat(const int32_t _n) { return PhaseStat[_n-1]; }
+    void vResetPhaseStat();
+#endif
 
 protected:
+    static size_t szSnapshotPayloadBytes();
+    static MPC_SnapshotInfo SnapshotInfo();
+#if defined(MPC_USE_FIXED_POINT)
+    void vQuantizeFixed();
+#endif
+    uint8_t * pPutOnline(uint8_t * _p);
+    const uint8_t * pGetOnline(const uint8_t * _p);
     void bCalculateActiveSet(void);
+    void vCalculatePowerSigma(int32_t _n, Matrix &_Apow, Matrix &_Sigma);
+#if defined(MPC_USE_REINIT_WORKSPACE)
+    void vCalculatePowerSigma(int32_t _n, float_prec * _Apow, float_prec * _Sigma, float_prec * _workspace);
+    void vCalculatePrediction(float_prec * _workspace);
+#endif
 
 private:
-    Matrix CPSI     {(MPC_HP_LEN*SS_Z_LEN), SS_X_LEN};
-    Matrix COMEGA   {(MPC_HP_LEN*SS_Z_LEN), SS_U_LEN};
-    Matrix CTHETA   {(MPC_HP_LEN*SS_Z_LEN), (MPC_HU_LEN*SS_U_LEN)};
+    int32_t i32CoincidenceTime[MPC_HC_LEN];
+    
+#if defined(MPC_USE_PHASE_PROFILING)
+    MPC_PhaseStat PhaseStat[MPC_PHASE_LEN];
+#endif
+    
+#if defined(MPC_USE_FIXED_POINT)
+    /* The fixed-point copy of the gains & the shifts from each accumulator to its destination format */
+    fixed_prec fxCPSI[(MPC_HC_LEN*SS_Z_LEN)][SS_X_LEN];
+    fixed_prec fxCOMEGA[(MPC_HC_LEN*SS_Z_LEN)][SS_U_LEN];
+    fixed_prec fxXI_DU[SS_U_LEN][(MPC_HC_LEN*SS_Z_LEN)];
+    int32_t i32fxExp[MPC_FIXED_EXP_LEN];
+    int32_t i32fxShiftSP;
+    int32_t i32fxShiftCPSI;
+    int32_t i32fxShiftCOMEGA;
+    int32_t i32fxShiftXI;
+    float_prec f32fxRange[3];
+    uint32_t u32fxSaturation;
+#endif
+    
+#if defined(MPC_REINIT_CACHE_LEN)
+    /* Each entry holds the online constants + CTHETA (for vReTune) */
+    MPC_ReInitCacheTag ReInitCacheTag[MPC_REINIT_CACHE_LEN];
+    uint8_t u8ReInitCacheData[MPC_REINIT_CACHE_LEN][MPC_ONLINE_BYTES + ((MPC_HC_LEN*SS_Z_LEN)*(MPC_HU_LEN*SS_U_LEN)*sizeof(float_prec))];
+    float_prec f32ReInitCacheQuantum;
+    uint32_t u32ReInitCacheClock;
+    uint32_t u32ReInitCacheHit;
+    uint32_t u32ReInitCacheMiss;
+#endif
+    
+#if defined(MPC_USE_MATRIX_FREE_PREDICTION)
+    /* The discretized prediction grid segments (A^m, S(m)), used instead of CPSI & COMEGA */
+    float_prec f32Aseg[MPC_GRID_SEGMENT_LEN][SS_X_LEN][SS_X_LEN];
+    float_prec f32Sseg[MPC_GRID_SEGMENT_LEN][SS_X_LEN][SS_U_LEN];
+#else
+    Matrix CPSI     {(MPC_HC_LEN*SS_Z_LEN), SS_X_LEN};
+    Matrix COMEGA   {(MPC_HC_LEN*SS_Z_LEN), SS_U_LEN};
+#endif
+    Matrix CTHETA   {(MPC_HC_LEN*SS_Z_LEN), (MPC_HU_LEN*SS_U_LEN)};
 
+#if !defined(MPC_USE_UPDATE_WORKSPACE)
     Matrix DU       {(MPC_HU_LEN*SS_U_LEN), 1};
+#endif
 
     Matrix A        {SS_X_LEN, SS_X_LEN};
     Matrix B        {SS_X_LEN, SS_U_LEN};
     Matrix C        {SS_Z_LEN, SS_X_LEN};
 
-    Matrix Q        {(MPC_HP_LEN*SS_Z_LEN), (MPC_HP_LEN*SS_Z_LEN)};
+    Matrix Q        {(MPC_HC_LEN*SS_Z_LEN), (MPC_HC_LEN*SS_Z_LEN)};
     Matrix R        {(MPC_HU_LEN*SS_U_LEN), (MPC_HU_LEN*SS_U_LEN)};
     
-    Matrix XI_DU    {(SS_U_LEN), (MPC_HP_LEN*SS_Z_LEN)};
+    Matrix XI_DU    {(SS_U_LEN), (MPC_HC_LEN*SS_Z_LEN)};
 };
 
 
@@ -14,7 +14,7 @@ char bufferTxSer[100];      /* For serial printing */
 Matrix A(SS_X_LEN, SS_X_LEN);
 Matrix B(SS_X_LEN, SS_U_LEN);
 Matrix C(SS_Z_LEN, SS_X_LEN);
-Matrix SP((MPC_HP_LEN*SS_Z_LEN), 1);
+Matrix SP((MPC_HC_LEN*SS_Z_LEN), 1);
 Matrix x(SS_X_LEN, 1);
 Matrix u(SS_U_LEN, 1);
 Matrix z(SS_Z_LEN, 1);
@@ -56,31 +56,39 @@ void setup() {
 
 
 
+/* The set-point trajectory at sampling step _step (repeated every 300 steps) */
+void vGetSetPoint(int32_t _step, Matrix &SP_OUT)
+{
+    _step = _step % 300;
+    if (_step < 100) {
+        SP_OUT[0][0] = 3.14/2.;
+        SP_OUT[1][0] = 1;
+    } else if (_step < 200) {
+        SP_OUT[0][0] = 3.14/2.;
+        SP_OUT[1][0] = -3;
+    } else {
+        SP_OUT[0][0] = 3.14;
+        SP_OUT[1][0] = -3;
+    }
+}
+
+
 void loop() {
     
     if (timerMPC > SS_DT_MILIS) {
         
         /* ================================ Updating Set Point ================================= */
+        /* SP only holds the set-point at the coincidence points k+P(1)..k+P(Hc) */
         Matrix SP_NEXT(SS_Z_LEN, 1);
-        if (i32iterSP < 100-MPC_HP_LEN+1) {
-            SP_NEXT[0][0] = 3.14/2.;
-            SP_NEXT[1][0] = 1;
-        } else if (i32iterSP < 200-MPC_HP_LEN+1) {
-            SP_NEXT[0][0] = 3.14/2.;
-            SP_NEXT[1][0] = -3;
-        } else {
-            SP_NEXT[0][0] = 3.14;
-            SP_NEXT[1][0] = -3;
+        for (int32_t _i = 0; _i < MPC_HC_LEN; _i++) {
+            vGetSetPoint(i32iterSP + MPC_HIL.i32GetCoincidenceTime(_i), SP_NEXT);
+            SP = SP.InsertSubMatrix(SP_NEXT, (_i*SS_Z_LEN), 0);
         }
-        if (i32iterSP < 300-MPC_HP_LEN+1) {
+        if (i32iterSP < 300-1) {
             i32iterSP++;
         } else {
             i32iterSP = 0;
         }
-        for (int32_t _i = 0; _i < (MPC_HP_LEN-1); _i++) {
-            SP = SP.InsertSubMatrix(SP, (_i*SS_Z_LEN), 0, ((_i+1)*SS_Z_LEN), 0, SS_Z_LEN, 1);
-        }
-        SP = SP.InsertSubMatrix(SP_NEXT, ((MPC_HP_LEN-1)*SS_Z_LEN), 0, 0, 0, SS_Z_LEN, 1);
         /* -------------------------------- Updating Set Point --------------------------------- */
         
         
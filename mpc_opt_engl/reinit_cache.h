@@ -0,0 +1,114 @@
+/**************************************************************************************************
+ * Cache of the MPC::vReInit() result (enabled with MPC_REINIT_CACHE_LEN in konfig.h).
+ *
+ *  vReInit() rounds its inputs (A, B, C, weightQ & weightR) to a multiple of the quantum
+ *  (MPC_REINIT_CACHE_QUANTUM, or MPC::vSetReInitCacheQuantum()) into a key, hashes the key (FNV-1a)
+ *  and looks for it in a table of MPC_REINIT_CACHE_LEN entries:
+ *      - Hit   : the offline matrices are copied back from the entry, nothing is recalculated.
+ *      - Miss  : the full calculation, then the result is stored in an empty entry (or the least
+ *                recently used one).
+ *
+ *  The horizon (Hp, Hu, the coincidence points & the grid) is fixed at compile-time, so it's not part
+ *  of the key. With quantum 0 only identical inputs match. With quantum q, two inputs match when every
+ *  element rounds to the same multiple of q, and the first one of them gives the gains (two inputs
+ *  closer than q can still land on both sides of a rounding boundary and miss).
+ *
+ *  Mirrored in mpc_opt_engl & mpc_least_square_engl (each sketch folder needs its own copy): edit one,
+ *  then copy it over the other. The CMake configure fails when the copies differ.
+ *
+ *
+ * See https://github.com/pronenewbits for more!
+ *************************************************************************************************/
+#ifndef REINIT_CACHE_H
+#define REINIT_CACHE_H
+
+#include <string.h>
+#include "konfig.h"
+#include "matrix.h"
+
+
+#if defined(MPC_REINIT_CACHE_LEN)
+
+#if (MPC_REINIT_CACHE_LEN < 1)
+    #error("The MPC_REINIT_CACHE_LEN must be at least 1!");
+#endif
+
+/* The key: A, B, C, weightQ & weightR */
+#define MPC_REINIT_CACHE_KEY_LEN    ((SS_X_LEN*SS_X_LEN) + (SS_X_LEN*SS_U_LEN) + (SS_Z_LEN*SS_X_LEN) + 2)
+
+typedef struct {
+    bool        bValid;
+    uint32_t    u32hash;
+    uint32_t    u32lastUse;
+    float_prec  f32key[MPC_REINIT_CACHE_KEY_LEN];
+} MPC_ReInitCacheTag;
+
+
+static inline float_prec fReInitCacheQuantize(const float_prec _val, const float_prec _quantum)
+{
+    if (_quantum > float_prec(0)) {
+        /* + 0 turns -0 into +0, so they have the same bytes */
+        return float_prec(floor((_val / _quantum) + float_prec(0.5))) + float_prec(0);
+    }
+    return _val + float_prec(0);
+}
+
+/* Fill the quantized key of the vReInit() inputs, return its hash */
+static inline uint32_t u32ReInitCacheKey(float_prec * _key, Matrix &A, Matrix &B, Matrix &C,
+                                         const float_prec _bobotQ, const float_prec _bobotR, const float_prec _quantum)
+{
+    int32_t _n = 0;
+    for (int32_t _i = 0; _i < SS_X_LEN; _i++) {
+        for (int32_t _j = 0; _j < SS_X_LEN; _j++) {
+            _key[_n++] = fReInitCacheQuantize(A[_i][_j], _quantum);
+        }
+        for (int32_t _j = 0; _j < SS_U_LEN; _j++) {
+            _key[_n++] = fReInitCacheQuantize(B[_i][_j], _quantum);
+        }
+    }
+    for (int32_t _i = 0; _i < SS_Z_LEN; _i++) {
+        for (int32_t _j = 0; _j < SS_X_LEN; _j++) {
+            _key[_n++] = fReInitCacheQuantize(C[_i][_j], _quantum);
+        }
+    }
+    _key[_n++] = fReInitCacheQuantize(_bobotQ, _quantum);
+    _key[_n++] = fReInitCacheQuantize(_bobotR, _quantum);
+
+    const uint8_t * _byte = (const uint8_t *) _key;
+    uint32_t _hash = 2166136261UL;
+    for (size_t _i = 0; _i < (MPC_REINIT_CACHE_KEY_LEN * sizeof(float_prec)); _i++) {
+        _hash = (_hash ^ _byte[_i]) * 16777619UL;
+    }
+    return _hash;
+}
+
+/* The entry holding _key, or -1 */
+static inline int32_t i32ReInitCacheFind(const MPC_ReInitCacheTag * _tag, const float_prec * _key, const uint32_t _hash)
+{
+    for (int32_t _i = 0; _i < MPC_REINIT_CACHE_LEN; _i++) {
+        if (_tag[_i].bValid && (_tag[_i].u32hash == _hash) && (memcmp(_tag[_i].f32key, _key, sizeof(_tag[_i].f32key)) == 0)) {
+            return _i;
+        }
+    }
+    return -1;
+}
+
+/* The entry to store a new result in: an empty one, or the least recently used */
+static inline int32_t i32ReInitCacheVictim(const MPC_ReInitCacheTag * _tag)
+{
+    int32_t _victim = 0;
+    for (int32_t _i = 0; _i < MPC_REINIT_CACHE_LEN; _i++) {
+        if (!_tag[_i].bValid) {
+            return _i;
+        }
+        if (_tag[_i].u32lastUse < _tag[_victim].u32lastUse) {
+            _victim = _i;
+        }
+    }
+    return _victim;
+}
+
+#endif
+
+
+#endif // REINIT_CACHE_H
@@ -0,0 +1,218 @@
+/**************************************************************************************************
+ * Binary snapshot of the MPC online constants (what bUpdate needs after vReInit), so the controller
+ *  can start from a snapshot in flash or in a file without the offline calculation.
+ *
+ *  Layout (every field in the host byte order, checked with the endian tag):
+ *
+ *      offset  size
+ *        0     4       magic "MPCS"
+ *        4     2       MPC_SNAPSHOT_VERSION
+ *        6     1       sizeof(float_prec)
+ *        7     1       implementation (MPC_SNAPSHOT_KIND_*)
+ *        8     4       endian tag 0x01020304
+ *       12     4       reserved (0)
+ *       16     6*4     X, U, Z, Hp, Hu, Hc
+ *       40     4       payload bytes
+ *       44     4       CRC-32 of the payload
+ *       48     4       CRC-32 of the header bytes 0..47
+ *       52     12      zero
+ *       64     ...     payload (starts MPC_SNAPSHOT_HEADER_BYTES after an MPC_SNAPSHOT_ALIGN aligned start)
+ *
+ *  The payload is implementation specific (see bSaveSnapshot() in mpc.cpp): the matrices are stored
+ *  row-major with their own dimension as the stride (not MATRIX_MAXIMUM_SIZE), so the snapshot only
+ *  depends on the dimension & float_prec, and the same gains give the same bytes on every target
+ *  with the same byte order.
+ *
+ *  Mirrored in mpc_opt_engl, mpc_least_square_engl & mpc_runtime_engl (each sketch folder needs its
+ *  own copy): edit one, then copy it over the others. The CMake configure fails when the copies differ.
+ *
+ *
+ * See https://github.com/pronenewbits for more!
+ *************************************************************************************************/
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <string.h>
+#include "konfig.h"
+#include "matrix.h"
+
+
+#define MPC_SNAPSHOT_VERSION        (1)
+#define MPC_SNAPSHOT_HEADER_BYTES   (64)
+#define MPC_SNAPSHOT_ALIGN          (64)        /* Put the snapshot at this alignment (flash array or mmap) */
+
+#define MPC_SNAPSHOT_KIND_OPT               (1) /* mpc_opt_engl                                     */
+#define MPC_SNAPSHOT_KIND_OPT_MATRIX_FREE   (2) /* mpc_opt_engl with MPC_USE_MATRIX_FREE_PREDICTION */
+#define MPC_SNAPSHOT_KIND_LEAST_SQUARE      (3) /* mpc_least_square_engl                            */
+#define MPC_SNAPSHOT_KIND_RUNTIME           (4) /* mpc_runtime_engl                                 */
+
+typedef struct {
+    uint8_t u8kind;
+    int32_t i32x;
+    int32_t i32u;
+    int32_t i32z;
+    int32_t i32hp;
+    int32_t i32hu;
+    int32_t i32hc;
+} MPC_SnapshotInfo;
+
+
+/* CRC-32 (IEEE 802.3, reflected), bitwise so it doesn't need a table in flash */
+static inline uint32_t u32SnapshotCrc32(const uint8_t * _data, const size_t _len)
+{
+    uint32_t _crc = 0xFFFFFFFFUL;
+    for (size_t _i = 0; _i < _len; _i++) {
+        _crc ^= _data[_i];
+        for (int32_t _b = 0; _b < 8; _b++) {
+            _crc = (_crc >> 1) ^ (0xEDB88320UL & (0UL - (_crc & 1UL)));
+        }
+    }
+    return ~_crc;
+}
+
+static inline void vSnapshotPut32(uint8_t * _p, const uint32_t _val) { memcpy(_p, &_val, 4); }
+static inline uint32_t u32SnapshotGet32(const uint8_t * _p) { uint32_t _val; memcpy(&_val, _p, 4); return _val; }
+
+/* Write the header in front of a _payloadBytes long payload (already at _buf + MPC_SNAPSHOT_HEADER_BYTES) */
+static inline void vSnapshotWriteHeader(uint8_t * _buf, const MPC_SnapshotInfo &_info, const uint32_t _payloadBytes)
+{
+    const uint16_t _version = MPC_SNAPSHOT_VERSION;
+    memset(_buf, 0, MPC_SNAPSHOT_HEADER_BYTES);
+    memcpy(&_buf[0], "MPCS", 4);
+    memcpy(&_buf[4], &_version, 2);
+    _buf[6] = uint8_t(sizeof(float_prec));
+    _buf[7] = _info.u8kind;
+    vSnapshotPut32(&_buf[8],  0x01020304UL);
+    vSnapshotPut32(&_buf[16], uint32_t(_info.i32x));
+    vSnapshotPut32(&_buf[20], uint32_t(_info.i32u));
+    vSnapshotPut32(&_buf[24], uint32_t(_info.i32z));
+    vSnapshotPut32(&_buf[28], uint32_t(_info.i32hp));
+    vSnapshotPut32(&_buf[32], uint32_t(_info.i32hu));
+    vSnapshotPut32(&_buf[36], uint32_t(_info.i32hc));
+    vSnapshotPut32(&_buf[40], _payloadBytes);
+    vSnapshotPut32(&_buf[44], u32SnapshotCrc32(&_buf[MPC_SNAPSHOT_HEADER_BYTES], _payloadBytes));
+    vSnapshotPut32(&_buf[48], u32SnapshotCrc32(_buf, 48));
+}
+
+/* Check the snapshot against the expected implementation & dimension (_info) and the payload size,
+ *  return the payload or NULL if the snapshot can't be used
+ */
+static inline const uint8_t * pSnapshotCheck(const void * _snapshot, const size_t _bytes, const MPC_SnapshotInfo &_info,
+                                             const uint32_t _payloadBytes)
+{
+    const uint8_t * _buf = (const uint8_t *) _snapshot;
+    uint16_t _version;
+    if ((_buf == NULL) || (_bytes < (MPC_SNAPSHOT_HEADER_BYTES + size_t(_payloadBytes)))) {
+        return NULL;
+    }
+    memcpy(&_version, &_buf[4], 2);
+    if ((memcmp(&_buf[0], "MPCS", 4) != 0) || (_version != MPC_SNAPSHOT_VERSION) ||
+        (_buf[6] != uint8_t(sizeof(float_prec))) || (_buf[7] != _info.u8kind) ||
+        (u32SnapshotGet32(&_buf[8]) != 0x01020304UL) || (u32SnapshotGet32(&_buf[48]) != u32SnapshotCrc32(_buf, 48)))
+    {
+        return NULL;
+    }
+    if ((u32SnapshotGet32(&_buf[16]) != uint32_t(_info.i32x))  || (u32SnapshotGet32(&_buf[20]) != uint32_t(_info.i32u)) ||
+        (u32SnapshotGet32(&_buf[24]) != uint32_t(_info.i32z))  || (u32SnapshotGet32(&_buf[28]) != uint32_t(_info.i32hp)) ||
+        (u32SnapshotGet32(&_buf[32]) != uint32_t(_info.i32hu)) || (u32SnapshotGet32(&_buf[36]) != uint32_t(_info.i32hc)) ||
+        (u32SnapshotGet32(&_buf[40]) != _payloadBytes))
+    {
+        return NULL;
+    }
+    if (u32SnapshotGet32(&_buf[44]) != u32SnapshotCrc32(&_buf[MPC_SNAPSHOT_HEADER_BYTES], _payloadBytes)) {
+        return NULL;
+    }
+    return &_buf[MPC_SNAPSHOT_HEADER_BYTES];
+}
+
+/* Read the implementation & dimension of a snapshot (for the run-time dimensioned MPC), without the CRC check */
+static inline bool bSnapshotPeekInfo(const void * _snapshot, const size_t _bytes, MPC_SnapshotInfo &_info)
+{
+    const uint8_t * _buf = (const uint8_t *) _snapshot;
+    if ((_buf == NULL) || (_bytes < MPC_SNAPSHOT_HEADER_BYTES) || (memcmp(&_buf[0], "MPCS", 4) != 0)) {
+        return false;
+    }
+    _info.u8kind = _buf[7];
+    _info.i32x   = int32_t(u32SnapshotGet32(&_buf[16]));
+    _info.i32u   = int32_t(u32SnapshotGet32(&_buf[20]));
+    _info.i32z   = int32_t(u32SnapshotGet32(&_buf[24]));
+    _info.i32hp  = int32_t(u32SnapshotGet32(&_buf[28]));
+    _info.i32hu  = int32_t(u32SnapshotGet32(&_buf[32]));
+    _info.i32hc  = int32_t(u32SnapshotGet32(&_buf[36]));
+    return true;
+}
+
+/* Append the top-left _lenRow x _lenCol block of _mat to the payload (row-major, tight) */
+static inline uint8_t * pSnapshotPutBlock(uint8_t * _p, Matrix &_mat, const int32_t _lenRow, const int32_t _lenCol)
+{
+    for (int32_t _i = 0; _i < _lenRow; _i++) {
+        for (int32_t _j = 0; _j < _lenCol; _j++) {
+            const float_prec _val = _mat[_i][_j];
+            memcpy(_p, &_val, sizeof(float_prec));
+            _p += sizeof(float_prec);
+        }
+    }
+    return _p;
+}
+
+/* Read the top-left _lenRow x _lenCol block of _mat from the payload */
+static inline const uint8_t * pSnapshotGetBlock(const uint8_t * _p, Matrix &_mat, const int32_t _lenRow, const int32_t _lenCol)
+{
+    for (int32_t _i = 0; _i < _lenRow; _i++) {
+        for (int32_t _j = 0; _j < _lenCol; _j++) {
+            float_prec _val;
+            memcpy(&_val, _p, sizeof(float_prec));
+            _mat[_i][_j] = _val;
+            _p += sizeof(float_prec);
+        }
+    }
+    return _p;
+}
+
+static inline uint8_t * pSnapshotPutInt(uint8_t * _p, const int32_t * _val, const int32_t _len)
+{
+    memcpy(_p, _val, size_t(_len) * 4);
+    return _p + (size_t(_len) * 4);
+}
+
+static inline const uint8_t * pSnapshotGetInt(const uint8_t * _p, int32_t * _val, const int32_t _len)
+{
+    memcpy(_val, _p, size_t(_len) * 4);
+    return _p + (size_t(_len) * 4);
+}
+
+/* The integers are padded so the matrices after them stay float_prec aligned */
+#define MPC_SNAPSHOT_INT_BYTES(_len)    ((((size_t(_len) * 4) + sizeof(float_prec) - 1) / sizeof(float_prec)) * sizeof(float_prec))
+
+
+#if (SYSTEM_IMPLEMENTATION == SYSTEM_IMPLEMENTATION_PC) && defined(__linux__)
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <fcntl.h>
+    #include <unistd.h>
+
+    /* Map a snapshot file read-only (mmap returns a page aligned address, so MPC_SNAPSHOT_ALIGN holds) */
+    static inline const void * pSnapshotMapFile(const char * _fileName, size_t &_bytes)
+    {
+        const int _fd = open(_fileName, O_RDONLY);
+        if (_fd < 0) {
+            return NULL;
+        }
+        struct stat _st;
+        void * _map = MAP_FAILED;
+        if ((fstat(_fd, &_st) == 0) && (_st.st_size > 0)) {
+            _bytes = size_t(_st.st_size);
+            _map = mmap(NULL, _bytes, PROT_READ, MAP_PRIVATE, _fd, 0);
+        }
+        close(_fd);
+        return (_map == MAP_FAILED) ? NULL : _map;
+    }
+
+    static inline void vSnapshotUnmapFile(const void * _map, const size_t _bytes)
+    {
+        munmap((void *) _map, _bytes);
+    }
+#endif
+
+
+#endif // SNAPSHOT_H
@@ -0,0 +1,53 @@
+/**************************************************************************************************
+ * Static worst-case execution time estimate of the constant-time MPC::bUpdate() (enabled with
+ *  MPC_USE_CONSTANT_TIME_UPDATE in konfig.h).
+ *
+ *  The constant-time update has a fixed trip count for the compile-time dimension, so its cost is
+ *  a count, not a measurement:
+ *
+ *      MPC_WCET_MAC_LEN        = Hc*Z*(X + U)  + U*Hc*Z        (the {MPC_5} & {MPC_6} multiply-adds)
+ *      MPC_WCET_ELEMENT_LEN    = X + U + Hc*Z + U              (the loads, stores & loop steps of
+ *                                                               x, u(k-1), E(k) & u(k))
+ *      MPC_WCET_CYCLE          = MPC_WCET_MAC_LEN * MPC_WCET_CYCLE_MAC +
+ *                                MPC_WCET_ELEMENT_LEN * MPC_WCET_CYCLE_ELEMENT + MPC_WCET_CYCLE_CALL
+ *
+ *  The default cycle model is a Cortex-M4F in single precision from the zero wait state memory
+ *  (2 loads & a VMLA per multiply-add). Override the MPC_WCET_CYCLE_* with the numbers of your
+ *  target, and define MPC_WCET_CYCLE_BUDGET to fail the build when the estimate is above it.
+ *
+ *
+ * See https://github.com/pronenewbits for more!
+ *************************************************************************************************/
+#ifndef WCET_H
+#define WCET_H
+
+#include "konfig.h"
+
+
+#if defined(MPC_USE_CONSTANT_TIME_UPDATE)
+
+#ifndef MPC_WCET_CYCLE_MAC
+    #define MPC_WCET_CYCLE_MAC      (5)
+#endif
+#ifndef MPC_WCET_CYCLE_ELEMENT
+    #define MPC_WCET_CYCLE_ELEMENT  (6)
+#endif
+#ifndef MPC_WCET_CYCLE_CALL
+    #define MPC_WCET_CYCLE_CALL     (60)
+#endif
+
+#define MPC_WCET_MAC_LEN        ((MPC_HC_LEN*SS_Z_LEN*(SS_X_LEN + SS_U_LEN)) + (SS_U_LEN*MPC_HC_LEN*SS_Z_LEN))
+#define MPC_WCET_ELEMENT_LEN    (SS_X_LEN + SS_U_LEN + (MPC_HC_LEN*SS_Z_LEN) + SS_U_LEN)
+#define MPC_WCET_CYCLE          ((MPC_WCET_MAC_LEN * MPC_WCET_CYCLE_MAC) + \
+                                 (MPC_WCET_ELEMENT_LEN * MPC_WCET_CYCLE_ELEMENT) + MPC_WCET_CYCLE_CALL)
+
+#if defined(MPC_WCET_CYCLE_BUDGET)
+    #if (MPC_WCET_CYCLE > MPC_WCET_CYCLE_BUDGET)
+        #error("The MPC_WCET_CYCLE estimate of bUpdate() is above MPC_WCET_CYCLE_BUDGET!");
+    #endif
+#endif
+
+#endif
+
+
+#endif // WCET_H
@@ -0,0 +1,372 @@
+/**************************************************************************************************
+ * Class GainLibrary
+ *  See gain_library.h for description
+ *
+ *  The cache slots live in one array; the LRU order is a doubly linked list of slot numbers
+ *  (i32head = most recently used), and the model ID -> slot lookup is a linear probing hash table
+ *  of at least 2x the number of slots (so the probe sequence stays short). Nothing is allocated
+ *  after bOpen().
+ *
+ * See https://github.com/pronenewbits for more!
+ *************************************************************************************************/
+#include "gain_library.h"
+
+#if (SYSTEM_IMPLEMENTATION == SYSTEM_IMPLEMENTATION_PC) && defined(__linux__)
+
+#include <stdio.h>
+#include <sys/mman.h>
+
+
+#define GAIN_LIBRARY_ALIGN(_n)  ((((_n) + MPC_SNAPSHOT_ALIGN - 1) / MPC_SNAPSHOT_ALIGN) * MPC_SNAPSHOT_ALIGN)
+
+/* The splitmix64 finalizer, so consecutive model IDs spread over the hash table */
+static inline uint32_t u32GainLibraryHash(uint64_t _key)
+{
+    _key ^= _key >> 30;
+    _key *= 0xBF58476D1CE4E5B9ULL;
+    _key ^= _key >> 27;
+    _key *= 0x94D049BB133111EBULL;
+    _key ^= _key >> 31;
+    return uint32_t(_key);
+}
+
+static int iGainLibraryCompare(const void * _a, const void * _b)
+{
+    const uint64_t _idA = ((const GainLibraryIndex *) _a)->u64modelId;
+    const uint64_t _idB = ((const GainLibraryIndex *) _b)->u64modelId;
+    return (_idA < _idB) ? -1 : ((_idA > _idB) ? 1 : 0);
+}
+
+
+GainLibrary::GainLibrary()
+{
+    pMap = NULL;
+    szMapBytes = 0;
+    pIndex = NULL;
+    u32entryLen = 0;
+    pSlot = NULL;
+    pArenaPool = NULL;
+    szArenaBytes = 0;
+    i32slotLen = 0;
+    i32slotUsed = 0;
+    i32head = -1;
+    i32tail = -1;
+    pHash = NULL;
+    u32hashMask = 0;
+    u64hit = 0;
+    u64miss = 0;
+    u64evict = 0;
+}
+
+GainLibrary::~GainLibrary()
+{
+    vClose();
+}
+
+bool GainLibrary::bWrite(const char * _fileName, const uint64_t * _modelId, const void * const * _snapshot,
+                         const size_t * _bytes, const uint32_t _len)
+{
+    /* Sort the index by model ID, u64offset temporarily holds the input position */
+    GainLibraryIndex * _index = new GainLibraryIndex[(_len > 0) ? _len : 1];
+    uint32_t _workspaceBytes = 0;
+    for (uint32_t _i = 0; _i < _len; _i++) {
+        MPC_SnapshotInfo _info;
+        if (!bSnapshotPeekInfo(_snapshot[_i], _bytes[_i], _info) || (_info.u8kind != MPC_SNAPSHOT_KIND_RUNTIME)) {
+            delete [] _index;
+            return false;
+        }
+        if (MPC::snapshotWorkspaceBytes(_info.i32u) > _workspaceBytes) {
+            _workspaceBytes = uint32_t(MPC::snapshotWorkspaceBytes(_info.i32u));
+        }
+        _index[_i].u64modelId = _modelId[_i];
+        _index[_i].u64offset  = _i;
+        _index[_i].u64bytes   = _bytes[_i];
+    }
+    qsort(_index, _len, sizeof(GainLibraryIndex), iGainLibraryCompare);
+
+    uint32_t * _order = new uint32_t[(_len > 0) ? _len : 1];
+    uint64_t _offset = GAIN_LIBRARY_ALIGN(uint64_t(GAIN_LIBRARY_HEADER_BYTES) + (uint64_t(_len) * sizeof(GainLibraryIndex)));
+    bool _ok = true;
+    for (uint32_t _i = 0; _i < _len; _i++) {
+        if ((_i > 0) && (_index[_i].u64modelId == _index[_i-1].u64modelId)) {
+            _ok = false;
+        }
+        _order[_i] = uint32_t(_index[_i].u64offset);
+        _index[_i].u64offset = _offset;
+        _offset = GAIN_LIBRARY_ALIGN(_offset + _index[_i].u64bytes);
+    }
+
+    uint8_t _header[GAIN_LIBRARY_HEADER_BYTES];
+    const uint16_t _version = GAIN_LIBRARY_VERSION;
+    const uint64_t _indexOffset = GAIN_LIBRARY_HEADER_BYTES;
+    memset(_header, 0, sizeof(_header));
+    memcpy(&_header[0], "MPCL", 4);
+    memcpy(&_header[4], &_version, 2);
+    _header[6] = uint8_t(sizeof(float_prec));
+    vSnapshotPut32(&_header[8],  0x01020304UL);
+    vSnapshotPut32(&_header[12], _len);
+    vSnapshotPut32(&_header[16], _workspaceBytes);
+    vSnapshotPut32(&_header[20], u32SnapshotCrc32((const uint8_t *) _index, size_t(_len) * sizeof(GainLibraryIndex)));
+    memcpy(&_header[24], &_indexOffset, 8);
+    vSnapshotPut32(&_header[48], u32SnapshotCrc32(_header, 48));
+
+    FILE * _file = _ok ? fopen(_fileName, "wb") : NULL;
+    if (_file != NULL) {
+        static const uint8_t _pad[MPC_SNAPSHOT_ALIGN] = {0};
+        uint64_t _pos = GAIN_LIBRARY_HEADER_BYTES + (uint64_t(_len) * sizeof(GainLibraryIndex));
+        _ok = (fwrite(_header, 1, sizeof(_header), _file) == sizeof(_header)) &&
+              (fwrite(_index, sizeof(GainLibraryIndex), _len, _file) == _len);
+        for (uint32_t _i = 0; _ok && (_i < _len); _i++) {
+            _ok = (fwrite(_pad, 1, size_t(_index[_i].u64offset - _pos), _file) == size_t(_index[_i].u64offset - _pos)) &&
+                  (fwrite(_snapshot[_order[_i]], 1, _bytes[_order[_i]], _file) == _bytes[_order[_i]]);
+            _pos = _index[_i].u64offset + _index[_i].u64bytes;
+        }
+        _ok = (fclose(_file) == 0) && _ok;
+    } else {
+        _ok = false;
+    }
+    delete [] _order;
+    delete [] _index;
+    return _ok;
+}
+
+bool GainLibrary::bOpen(const char * _fileName, const int32_t _cacheLen)
+{
+    vClose();
+    if (_cacheLen <= 0) {
+        return false;
+    }
+    size_t _bytes = 0;
+    const uint8_t * _map = (const uint8_t *) pSnapshotMapFile(_fileName, _bytes);
+    if (_map == NULL) {
+        return false;
+    }
+
+    /* Only the header & the index are read here */
+    uint16_t _version = 0;
+    uint64_t _indexOffset = 0;
+    bool _ok = (_bytes >= GAIN_LIBRARY_HEADER_BYTES);
+    if (_ok) {
+        memcpy(&_version, &_map[4], 2);
+        memcpy(&_indexOffset, &_map[24], 8);
+        _ok = (memcmp(&_map[0], "MPCL", 4) == 0) && (_version == GAIN_LIBRARY_VERSION) &&
+              (_map[6] == uint8_t(sizeof(float_prec))) && (u32SnapshotGet32(&_map[8]) == 0x01020304UL) &&
+              (u32SnapshotGet32(&_map[48]) == u32SnapshotCrc32(_map, 48)) && (_indexOffset == GAIN_LIBRARY_HEADER_BYTES);
+    }
+    const uint32_t _len = _ok ? u32SnapshotGet32(&_map[12]) : 0;
+    if (_ok) {
+        const size_t _indexBytes = size_t(_len) * sizeof(GainLibraryIndex);
+        _ok = ((_bytes - GAIN_LIBRARY_HEADER_BYTES) >= _indexBytes) &&
+              (u32SnapshotGet32(&_map[20]) == u32SnapshotCrc32(&_map[GAIN_LIBRARY_HEADER_BYTES], _indexBytes));
+    }
+    const GainLibraryIndex * _index = (const GainLibraryIndex *) &_map[GAIN_LIBRARY_HEADER_BYTES];
+    for (uint32_t _i = 0; _ok && (_i < _len); _i++) {
+        _ok = (_index[_i].u64offset <= _bytes) && (_index[_i].u64bytes <= (_bytes - _index[_i].u64offset)) &&
+              ((_index[_i].u64offset % MPC_SNAPSHOT_ALIGN) == 0) &&
+              ((_i == 0) || (_index[_i].u64modelId > _index[_i-1].u64modelId));
+    }
+    if (!_ok) {
+        vSnapshotUnmapFile(_map, _bytes);
+        return false;
+    }
+    /* The controllers are used in a random order, the read-ahead would only page in the neighbours */
+    madvise((void *) _map, _bytes, MADV_RANDOM);
+
+    pMap = _map;
+    szMapBytes = _bytes;
+    pIndex = _index;
+    u32entryLen = _len;
+
+    uint32_t _hashLen = 1;
+    while (_hashLen < (2 * uint32_t(_cacheLen))) {
+        _hashLen <<= 1;
+    }
+    szArenaBytes = u32SnapshotGet32(&_map[16]);
+    i32slotLen  = _cacheLen;
+    pSlot       = new Slot[_cacheLen];
+    pArenaPool  = new uint8_t[size_t(_cacheLen) * szArenaBytes + 1];
+    pHash       = new int32_t[_hashLen];
+    u32hashMask = _hashLen - 1;
+    for (uint32_t _i = 0; _i < _hashLen; _i++) {
+        pHash[_i] = -1;
+    }
+    for (int32_t _i = 0; _i < _cacheLen; _i++) {
+        pSlot[_i].bUsed  = false;
+        pSlot[_i].pArena = &pArenaPool[size_t(_i) * szArenaBytes];
+    }
+    return true;
+}
+
+void GainLibrary::vClose()
+{
+    if (pMap != NULL) {
+        vSnapshotUnmapFile(pMap, szMapBytes);
+    }
+    delete [] pSlot;
+    delete [] pArenaPool;
+    delete [] pHash;
+    pMap = NULL;
+    szMapBytes = 0;
+    pIndex = NULL;
+    u32entryLen = 0;
+    pSlot = NULL;
+    pArenaPool = NULL;
+    szArenaBytes = 0;
+    i32slotLen = 0;
+    i32slotUsed = 0;
+    i32head = -1;
+    i32tail = -1;
+    pHash = NULL;
+    u32hashMask = 0;
+    u64hit = 0;
+    u64miss = 0;
+    u64evict = 0;
+}
+
+MPC * GainLibrary::pGet(const uint64_t _modelId)
+{
+    if (pMap == NULL) {
+        return NULL;
+    }
+    int32_t _slot = i32Find(_modelId);
+    if (_slot >= 0) {
+        u64hit++;
+        if (_slot != i32head) {
+            vUnlink(_slot);
+            vLinkFront(_slot);
+        }
+        return &pSlot[_slot].mpc;
+    }
+    u64miss++;
+
+    /* Not in the cache: look the model up in the (sorted) index */
+    uint32_t _lo = 0;
+    uint32_t _hi = u32entryLen;
+    while (_lo < _hi) {
+        const uint32_t _mid = _lo + ((_hi - _lo) / 2);
+        if (pIndex[_mid].u64modelId < _modelId) {
+            _lo = _mid + 1;
+        } else {
+            _hi = _mid;
+        }
+    }
+    if ((_lo == u32entryLen) || (pIndex[_lo].u64modelId != _modelId)) {
+        return NULL;
+    }
+
+    /* Take a free slot, or evict the least recently used one */
+    if (i32slotUsed < i32slotLen) {
+        _slot = i32slotUsed++;
+    } else {
+        _slot = i32tail;
+        vUnlink(_slot);
+        if (pSlot[_slot].bUsed) {
+            vHashRemove(_slot);
+            pSlot[_slot].bUsed = false;
+            u64evict++;
+        }
+    }
+    if (!pSlot[_slot].mpc.bLoadSnapshot(&pMap[pIndex[_lo].u64offset], size_t(pIndex[_lo].u64bytes),
+                                        pSlot[_slot].pArena, szArenaBytes))
+    {
+        /* Corrupt snapshot: the slot stays empty, at the back so it's the next one reused */
+        vLinkBack(_slot);
+        return NULL;
+    }
+    pSlot[_slot].u64modelId = _modelId;
+    pSlot[_slot].bUsed = true;
+    vHashInsert(_slot);
+    vLinkFront(_slot);
+    return &pSlot[_slot].mpc;
+}
+
+int32_t GainLibrary::i32Find(const uint64_t _modelId)
+{
+    uint32_t _i = u32GainLibraryHash(_modelId) & u32hashMask;
+    while (pHash[_i] >= 0) {
+        if (pSlot[pHash[_i]].u64modelId == _modelId) {
+            return pHash[_i];
+        }
+        _i = (_i + 1) & u32hashMask;
+    }
+    return -1;
+}
+
+void GainLibrary::vHashInsert(const int32_t _slot)
+{
+    uint32_t _i = u32GainLibraryHash(pSlot[_slot].u64modelId) & u32hashMask;
+    while (pHash[_i] >= 0) {
+        _i = (_i + 1) & u32hashMask;
+    }
+    pHash[_i] = _slot;
+}
+
+void GainLibrary::vHashRemove(const int32_t _slot)
+{
+    uint32_t _i = u32GainLibraryHash(pSlot[_slot].u64modelId) & u32hashMask;
+    while (pHash[_i] != _slot) {
+        _i = (_i + 1) & u32hashMask;
+    }
+    pHash[_i] = -1;
+
+    /* Backward shift: move up the entries after the hole that can't be reached anymore */
+    uint32_t _j = _i;
+    while (true) {
+        _j = (_j + 1) & u32hashMask;
+        if (pHash[_j] < 0) {
+            break;
+        }
+        const uint32_t _k = u32GainLibraryHash(pSlot[pHash[_j]].u64modelId) & u32hashMask;
+        const bool _reachable = (_i <= _j) ? ((_i < _k) && (_k <= _j)) : ((_i < _k) || (_k <= _j));
+        if (!_reachable) {
+            pHash[_i] = pHash[_j];
+            pHash[_j] = -1;
+            _i = _j;
+        }
+    }
+}
+
+void GainLibrary::vUnlink(const int32_t _slot)
+{
+    const int32_t _prev = pSlot[_slot].i32prev;
+    const int32_t _next = pSlot[_slot].i32next;
+    if (_prev >= 0) {
+        pSlot[_prev].i32next = _next;
+    } else {
+        i32head = _next;
+    }
+    if (_next >= 0) {
+        pSlot[_next].i32prev = _prev;
+    } else {
+        i32tail = _prev;
+    }
+}
+
+void GainLibrary::vLinkFront(const int32_t _slot)
+{
+    pSlot[_slot].i32prev = -1;
+    pSlot[_slot].i32next = i32head;
+    if (i32head >= 0) {
+        pSlot[i32head].i32prev = _slot;
+    }
+    i32head = _slot;
+    if (i32tail < 0) {
+        i32tail = _slot;
+    }
+}
+
+void GainLibrary::vLinkBack(const int32_t _slot)
+{
+    pSlot[_slot].i32prev = i32tail;
+    pSlot[_slot].i32next = -1;
+    if (i32tail >= 0) {
+        pSlot[i32tail].i32next = _slot;
+    }
+    i32tail = _slot;
+    if (i32head < 0) {
+        i32head = _slot;
+    }
+}
+
+
+#endif
@@ -0,0 +1,137 @@
+/**************************************************************************************************
+ * Gain library: many MPC configurations (one snapshot each, see snapshot.h) in one memory-mapped
+ *  file, indexed by a 64 bit model ID, with an LRU cache of the hot controllers (PC, Linux only).
+ *
+ *      GainLibrary::bWrite("fleet.mpcl", _id, _snapshot, _bytes, _len);     (offline)
+ *
+ *      static GainLibrary LIB;
+ *      LIB.bOpen("fleet.mpcl", 256);
+ *      MPC * _mpc = LIB.pGet(_modelId);
+ *      if (_mpc != NULL) {
+ *          _mpc->bUpdate(SP, x, u);
+ *      }
+ *
+ *  The file is mapped read-only and nothing is read at bOpen() except the header & the index, so
+ *  the pages of a configuration are loaded by the kernel the first time its controller is used.
+ *  The controllers are the zero copy bLoadSnapshot() of mpc_runtime_engl: an MPC object and its
+ *  dU arena per cache slot, with CPSI, COMEGA & XI_DU used in place from the mapping.
+ *
+ *  pGet() cost:
+ *      - Hit   : one hash table lookup + moving the slot to the front of the LRU list, O(1) and
+ *                independent of the number of configurations in the library.
+ *      - Miss  : binary search in the index (O(log N)), then bLoadSnapshot() into the least recently
+ *                used slot (the CRC check touches, and pages in, the whole snapshot).
+ *
+ *  The returned MPC is valid until the next pGet() (which can evict it). The unconstrained MPC
+ *  doesn't keep any state between bUpdate() calls (x & u are the caller's), so an evicted controller
+ *  is reloaded without loss. GainLibrary is not thread safe: use one per thread, the mapping itself
+ *  is shared in the page cache.
+ *
+ *  File layout (host byte order, checked with the endian tag like the snapshot):
+ *
+ *      offset  size
+ *        0     4       magic "MPCL"
+ *        4     2       GAIN_LIBRARY_VERSION
+ *        6     1       sizeof(float_prec)
+ *        7     1       reserved (0)
+ *        8     4       endian tag 0x01020304
+ *       12     4       number of configurations (N)
+ *       16     4       the biggest MPC::snapshotWorkspaceBytes() in the library
+ *       20     4       CRC-32 of the index
+ *       24     8       index offset (GAIN_LIBRARY_HEADER_BYTES)
+ *       32     16      zero
+ *       48     4       CRC-32 of the header bytes 0..47
+ *       52     12      zero
+ *       64     N*24    index, sorted by model ID: {model ID, snapshot offset, snapshot bytes} (uint64_t)
+ *      ...     ...     the snapshots, each at an MPC_SNAPSHOT_ALIGN aligned offset
+ *
+ *
+ * See https://github.com/pronenewbits for more!
+ *************************************************************************************************/
+#ifndef GAIN_LIBRARY_H
+#define GAIN_LIBRARY_H
+
+#include "konfig.h"
+#include "matrix.h"
+#include "mpc.h"
+#include "snapshot.h"
+
+#if (SYSTEM_IMPLEMENTATION == SYSTEM_IMPLEMENTATION_PC) && defined(__linux__)
+
+
+#define GAIN_LIBRARY_VERSION        (1)
+#define GAIN_LIBRARY_HEADER_BYTES   (64)
+
+typedef struct {
+    uint64_t u64modelId;
+    uint64_t u64offset;
+    uint64_t u64bytes;
+} GainLibraryIndex;
+
+
+class GainLibrary
+{
+public:
+    GainLibrary();
+    ~GainLibrary();
+
+    /* Write the library file from _len snapshots (any order, the model IDs must be unique) */
+    static bool bWrite(const char * _fileName, const uint64_t * _modelId, const void * const * _snapshot,
+                       const size_t * _bytes, const uint32_t _len);
+
+    /* Map the library & allocate _cacheLen controller slots (the only allocation) */
+    bool bOpen(const char * _fileName, const int32_t _cacheLen);
+    void vClose();
+
+    /* The controller of _modelId, or NULL if it's not in the library (or its snapshot is corrupt) */
+    MPC * pGet(const uint64_t _modelId);
+
+    uint32_t u32GetLen() { return u32entryLen; }
+    uint64_t u64GetHit() { return u64hit; }
+    uint64_t u64GetMiss() { return u64miss; }
+    uint64_t u64GetEvict() { return u64evict; }
+
+protected:
+    int32_t i32Find(const uint64_t _modelId);
+    void vHashInsert(const int32_t _slot);
+    void vHashRemove(const int32_t _slot);
+    void vUnlink(const int32_t _slot);
+    void vLinkFront(const int32_t _slot);
+    void vLinkBack(const int32_t _slot);
+
+private:
+    typedef struct {
+        uint64_t u64modelId;
+        bool     bUsed;             /* The slot holds the controller of u64modelId */
+        int32_t  i32prev;           /* LRU list, toward the most recently used  */
+        int32_t  i32next;           /* LRU list, toward the least recently used */
+        uint8_t * pArena;
+        MPC mpc;
+    } Slot;
+
+    const uint8_t * pMap;
+    size_t szMapBytes;
+    const GainLibraryIndex * pIndex;
+    uint32_t u32entryLen;
+
+    Slot * pSlot;
+    uint8_t * pArenaPool;
+    size_t szArenaBytes;
+    int32_t i32slotLen;
+    int32_t i32slotUsed;
+    int32_t i32head;                /* The most recently used slot  */
+    int32_t i32tail;                /* The least recently used slot */
+
+    /* Open addressing (linear probing) from model ID to slot, -1 = empty */
+    int32_t * pHash;
+    uint32_t u32hashMask;
+
+    uint64_t u64hit;
+    uint64_t u64miss;
+    uint64_t u64evict;
+};
+
+
+#endif
+
+#endif // GAIN_LIBRARY_H
@@ -0,0 +1,285 @@
+/************************************************************************************
+ * Matrix Class (run-time dimension, external memory)
+ *  Contain the matrix class definition and operation for the run-time dimensioned MPC.
+ *
+ *  Notes:
+ *    - Indexing start from 0, with accessing format matrix[row][column].
+ *    - Unlike the Matrix class in the other implementations, the matrix doesn't own
+ *      its memory. It's a view into a caller supplied buffer:
+ *      ->  f32data[i32row * i32col] is the memory representation of the matrix,
+ *           row-major with stride i32col (i.e. element (i,j) is f32data[i*i32col + j]).
+ *      ->  The buffer must stay alive for as long as the matrix is used.
+ *    - Because there's no memory to return a new matrix with, there's no operator
+ *      overloading (c = a*b). All operations write their result into an existing
+ *      matrix (c.bMultiply(a, b)) and return false if the dimensions don't match.
+ *
+ * See https://github.com/pronenewbits for more!
+ *************************************************************************************/
+#ifndef MATRIX_H
+#define MATRIX_H
+
+#include "konfig.h"
+
+#if (SYSTEM_IMPLEMENTATION == SYSTEM_IMPLEMENTATION_PC)
+    #include <iostream>
+    #include <iomanip>      // std::setprecision
+
+    using namespace std;
+#elif (SYSTEM_IMPLEMENTATION == SYSTEM_IMPLEMENTATION_EMBEDDED_ARDUINO)
+    #include <Wire.h>
+#endif
+
+
+class Matrix
+{
+public:
+    Matrix() {
+        this->vSetMatrixInvalid();
+    }
+    Matrix(const int32_t _i32row, const int32_t _i32col, float_prec * _f32data)
+    {
+        this->i32row = _i32row;
+        this->i32col = _i32col;
+        this->f32data = _f32data;
+    }
+
+    bool bMatrixIsValid() {
+        return ((this->f32data != NULL) && (this->i32row > 0) && (this->i32col > 0));
+    }
+
+    void vSetMatrixInvalid() {
+        this->i32row = -1;
+        this->i32col = -1;
+        this->f32data = NULL;
+    }
+
+    bool bMatrixIsSquare() {
+        return (this->i32row == this->i32col);
+    }
+
+    int32_t i32getRow() { return this->i32row; }
+    int32_t i32getColumn() { return this->i32col; }
+    float_prec * pf32getData() { return this->f32data; }
+
+    /* Ref: https://stackoverflow.com/questions/6969881/operator-overload */
+    class Proxy {
+    public:
+        Proxy(float_prec* _array, int32_t _maxColumn) : _array(_array) { this->_maxColumn = _maxColumn; }
+
+        float_prec & operator[](int32_t _column) {
+            #if (defined(MATRIX_USE_BOUND_CHECKING))
+                ASSERT((_column >= 0) && (_column < this->_maxColumn), "Matrix index out-of-bounds (at column evaluation)");
+            #else
+                #warning("Matrix bounds checking is disabled... good luck >:3");
+            #endif
+            return _array[_column];
+        }
+    private:
+        float_prec* _array;
+        int32_t _maxColumn;
+    };
+    Proxy operator[](int32_t _row) {
+        #if (defined(MATRIX_USE_BOUND_CHECKING))
+            ASSERT((_row >= 0) && (_row < this->i32row), "Matrix index out-of-bounds (at row evaluation)");
+        #else
+            #warning("Matrix bounds checking is disabled... good luck >:3");
+        #endif
+        return Proxy(&f32data[_row * this->i32col], this->i32col);      /* Parsing column index for bound checking */
+    }
+
+    /* Return the _lenRow rows starting from _posRow as a matrix (sharing the same memory) */
+    Matrix RowBlock(const int32_t _posRow, const int32_t _lenRow) {
+        if ((_posRow < 0) || ((_posRow + _lenRow) > this->i32row)) {
+            return Matrix();
+        }
+        return Matrix(_lenRow, this->i32col, &f32data[_posRow * this->i32col]);
+    }
+
+    void vSetHomogen(const float_prec _val) {
+        for (int32_t _i = 0; _i < (this->i32row * this->i32col); _i++) {
+            this->f32data[_i] = _val;
+        }
+    }
+
+    void vSetToZero() {
+        this->vSetHomogen(0.0);
+    }
+
+    void vSetDiag(const float_prec _val) {
+        this->vSetHomogen(0.0);
+        for (int32_t _i = 0; (_i < this->i32row) && (_i < this->i32col); _i++) {
+            (*this)[_i][_i] = _val;
+        }
+    }
+
+    void vSetIdentity() {
+        this->vSetDiag(1.0);
+    }
+
+    /* this = _src */
+    bool bCopy(Matrix &_src) {
+        if ((this->i32row != _src.i32row) || (this->i32col != _src.i32col)) {
+            return false;
+        }
+        for (int32_t _i = 0; _i < (this->i32row * this->i32col); _i++) {
+            this->f32data[_i] = _src.f32data[_i];
+        }
+        return true;
+    }
+
+    /* this = _matA + _matB (this can be _matA or _matB) */
+    bool bAdd(Matrix &_matA, Matrix &_matB) {
+        if ((this->i32row != _matA.i32row) || (this->i32col != _matA.i32col) ||
+            (this->i32row != _matB.i32row) || (this->i32col != _matB.i32col))
+        {
+            return false;
+        }
+        for (int32_t _i = 0; _i < (this->i32row * this->i32col); _i++) {
+            this->f32data[_i] = _matA.f32data[_i] + _matB.f32data[_i];
+        }
+        return true;
+    }
+
+    /* this = _matA * _matB (this must not be _matA or _matB) */
+    bool bMultiply(Matrix &_matA, Matrix &_matB) {
+        if ((_matA.i32col != _matB.i32row) || (this->i32row != _matA.i32row) || (this->i32col != _matB.i32col) ||
+            (this->f32data == _matA.f32data) || (this->f32data == _matB.f32data))
+        {
+            return false;
+        }
+        for (int32_t _i = 0; _i < this->i32row; _i++) {
+            for (int32_t _j = 0; _j < this->i32col; _j++) {
+                float_prec _sum = 0.0;
+                for (int32_t _k = 0; _k < _matA.i32col; _k++) {
+                    _sum += (_matA.f32data[_i*_matA.i32col + _k] * _matB.f32data[_k*_matB.i32col + _j]);
+                }
+                this->f32data[_i*this->i32col + _j] = _sum;
+            }
+        }
+        return true;
+    }
+
+    void vRoundingElementToZero(const int32_t _i, const int32_t _j) {
+        if (fabs((*this)[_i][_j]) < float_prec(float_prec_ZERO)) {
+            (*this)[_i][_j] = 0.0;
+        }
+    }
+
+    /* Invers operation using Gauss-Jordan algorithm (the same algorithm as Matrix::Invers()
+     *  in the other implementations), _outp = this^-1. _temp is a scratch matrix with the
+     *  same size as this. Return false if the matrix is non-invertible.
+     */
+    bool bInvers(Matrix &_outp, Matrix &_temp) {
+        if (!this->bMatrixIsSquare() || (_outp.i32row != this->i32row) || (_outp.i32col != this->i32col) ||
+            (_temp.i32row != this->i32row) || (_temp.i32col != this->i32col))
+        {
+            return false;
+        }
+        _outp.vSetIdentity();
+        _temp.bCopy(*this);
+
+
+        /* Gauss Elimination... */
+        for (int32_t _j = 0; _j < (_temp.i32row)-1; _j++) {
+            for (int32_t _i = _j+1; _i < _temp.i32row; _i++) {
+                if (fabs(_temp[_j][_j]) < float_prec(float_prec_ZERO)) {
+                    /* Matrix is non-invertible */
+                    return false;
+                }
+
+                float_prec _tempfloat = _temp[_i][_j] / _temp[_j][_j];
+
+                for (int32_t _k = 0; _k < _temp.i32col; _k++) {
+                    _temp[_i][_k] -= (_temp[_j][_k] * _tempfloat);
+                    _outp[_i][_k] -= (_outp[_j][_k] * _tempfloat);
+
+                    _temp.vRoundingElementToZero(_i, _k);
+                    _outp.vRoundingElementToZero(_i, _k);
+                }
+
+            }
+        }
+
+        for (int32_t _i = 1; _i < _temp.i32row; _i++) {
+            for (int32_t _j = 0; _j < _i; _j++) {
+                _temp[_i][_j] = 0.0;
+            }
+        }
+
+
+        /* Jordan... */
+        for (int32_t _j = (_temp.i32row)-1; _j > 0; _j--) {
+            for (int32_t _i = _j-1; _i >= 0; _i--) {
+                if (fabs(_temp[_j][_j]) < float_prec(float_prec_ZERO)) {
+                    /* Matrix is non-invertible */
+                    return false;
+                }
+
+                float_prec _tempfloat = _temp[_i][_j] / _temp[_j][_j];
+                _temp[_i][_j] -= (_temp[_j][_j] * _tempfloat);
+                _temp.vRoundingElementToZero(_i, _j);
+
+                for (int32_t _k = (_temp.i32row - 1); _k >= 0; _k--) {
+                    _outp[_i][_k] -= (_outp[_j][_k] * _tempfloat);
+                    _outp.vRoundingElementToZero(_i, _k);
+                }
+            }
+        }
+
+
+        /* Normalization */
+        for (int32_t _i = 0; _i < _temp.i32row; _i++) {
+            if (fabs(_temp[_i][_i]) < float_prec(float_prec_ZERO)) {
+                /* Matrix is non-invertible */
+                return false;
+            }
+
+            float_prec _tempfloat = _temp[_i][_i];
+            _temp[_i][_i] = 1.0;
+
+            for (int32_t _j = 0; _j < _temp.i32row; _j++) {
+                _outp[_i][_j] /= _tempfloat;
+            }
+        }
+        return true;
+    }
+
+#if (SYSTEM_IMPLEMENTATION == SYSTEM_IMPLEMENTATION_PC)
+    void vPrint() {
+        for (int32_t _i = 0; _i < this->i32row; _i++) {
+            cout << "[ ";
+            for (int32_t _j = 0; _j < this->i32col; _j++) {
+                cout << std::fixed << std::setprecision(3) << (*this)[_i][_j] << " ";
+            }
+            cout << "]";
+            cout << endl;
+        }
+        cout << endl;
+    }
+#elif (SYSTEM_IMPLEMENTATION == SYSTEM_IMPLEMENTATION_EMBEDDED_ARDUINO)
+    void vPrint() {
+        char _bufSer[10];
+        for (int32_t _i = 0; _i < this->i32row; _i++) {
+            Serial.print("[ ");
+            for (int32_t _j = 0; _j < this->i32col; _j++) {
+                snprintf(_bufSer, sizeof(_bufSer)-1, "%2.2f ", (*this)[_i][_j]);
+                Serial.print(_bufSer);
+            }
+            Serial.println("]");
+        }
+        Serial.println("");
+    }
+#else
+    #warning("Matrix.vPrint() function is disabled");
+
+    void vPrint() {}     /* Silent function */
+#endif
+
+private:
+    int32_t i32row;
+    int32_t i32col;
+    float_prec * f32data;
+};
+
+
+#endif // MATRIX_H
@@ -0,0 +1,326 @@
+/**************************************************************************************************
+ * Class for MPC without constraint (run-time dimension)
+ *
+ *  The plant to be controlled is a Linear Time-Invariant System:
+ *          x(k+1)  = A*x(k) + B*u(k)   ; x = Nx1, u = Mx1
+ *          z(k)    = C*x(k)            ; z = Zx1
+ *
+ *  The algorithm is the same as the optimized implementation (see mpc_opt_engl/mpc.cpp for
+ *  the full derivation):
+ *
+ ** Calculate prediction of z(k+1..k+Hp) constants ************************************************
+ *
+ *        z(k+1..k+Hp) = (CPSI)*x(k) + (COMEGA)*u(k-1) + (CTHETA)*dU(k..k+Hu-1)         ...{MPC_1}
+ *
+ ** Calculate offline optimization constants ******************************************************
+ *
+ *          H       = CTHETA'*Q*CTHETA + R                                              ...{MPC_2}
+ *          XI_FULL = H^-1 * CTHETA' * Q                                                ...{MPC_3}
+ *          XI_DU   = XI_FULL(1:M, :)                                                   ...{MPC_4}
+ *
+ ** MPC update algorithm **************************************************************************
+ *
+ *          E(k) = SP(k) - CPSI*x(k) - COMEGA*u(k-1)                                    ...{MPC_5}
+ *          dU(k)_optimal = XI_DU * E(k)                                                ...{MPC_6}
+ *          u(k) = u(k-1) + du(k)                                                       ...{MPC_7}
+ *
+ *
+ ** Memory arena **********************************************************************************
+ *
+ *  [ CPSI | COMEGA | XI_DU | scratch ]
+ *
+ *      The persistent part (CPSI, COMEGA, XI_DU) is what bUpdate needs. The scratch part is
+ *      shared between vReInit (CTHETA, H, H^-1, and the A^i & Sigma(A^i*B) temporaries) and
+ *      bUpdate (dU), it's sized for the bigger of the two.
+ *
+ *  The snapshot payload (see snapshot.h) is the persistent part as it is in the arena, so
+ *  bLoadSnapshot() points CPSI, COMEGA & XI_DU into the snapshot and the arena only holds dU.
+ *
+ *
+ * See https://github.com/pronenewbits for more!
+ *************************************************************************************************/
+#include "mpc.h"
+
+
+MPC::MPC()
+{
+    bValid = false;
+    bGainValid = false;
+    bFromSnapshot = false;
+    f32scratch = NULL;
+}
+
+size_t MPC::szPersistentLen(const int32_t _x, const int32_t _u, const int32_t _z, const int32_t _hp, const int32_t _hu)
+{
+    (void) _hu;
+    return (size_t(_hp*_z) * size_t(_x)) +     /* CPSI     */
+           (size_t(_hp*_z) * size_t(_u)) +     /* COMEGA   */
+           (size_t(_u) * size_t(_hp*_z));      /* XI_DU    */
+}
+
+size_t MPC::szScratchLen(const int32_t _x, const int32_t _u, const int32_t _z, const int32_t _hp, const int32_t _hu)
+{
+    size_t _reInit = (2 * size_t(_x) * size_t(_x)) +               /* _Apow, _Atemp        */
+                     (2 * size_t(_x) * size_t(_u)) +               /* _Sigma, _Stemp       */
+                     (size_t(_hp*_z) * size_t(_hu*_u)) +           /* CTHETA               */
+                     (3 * size_t(_hu*_u) * size_t(_hu*_u));        /* H, H_INV, _Htemp     */
+    size_t _update = size_t(_u);                                   /* dU                   */
+
+    return (_reInit > _update) ? _reInit : _update;
+}
+
+size_t MPC::workspaceBytes(const int32_t _x, const int32_t _u, const int32_t _z, const int32_t _hp, const int32_t _hu)
+{
+    if ((_x <= 0) || (_u <= 0) || (_z <= 0) || (_hu <= 0) || (_hp < _hu)) {
+        return 0;
+    }
+    /* + (sizeof(float_prec)-1) to align the start of the arena */
+    return ((szPersistentLen(_x, _u, _z, _hp, _hu) + szScratchLen(_x, _u, _z, _hp, _hu)) * sizeof(float_prec)) +
+           (sizeof(float_prec) - 1);
+}
+
+bool MPC::bInit(const int32_t _x, const int32_t _u, const int32_t _z, const int32_t _hp, const int32_t _hu,
+                void * _arena, const size_t _arenaBytes)
+{
+    bValid = false;
+    bGainValid = false;
+    bFromSnapshot = false;
+
+    size_t _needed = workspaceBytes(_x, _u, _z, _hp, _hu);
+    if ((_arena == NULL) || (_needed == 0) || (_arenaBytes < _needed)) {
+        return false;
+    }
+    i32x  = _x;
+    i32u  = _u;
+    i32z  = _z;
+    i32hp = _hp;
+    i32hu = _hu;
+
+    /* Carve the matrices from the (aligned) arena */
+    uintptr_t _addr = uintptr_t(_arena);
+    _addr = (_addr + (sizeof(float_prec) - 1)) & ~uintptr_t(sizeof(float_prec) - 1);
+    float_prec * _ptr = (float_prec *) _addr;
+
+    CPSI   = Matrix((i32hp*i32z), i32x, _ptr);          _ptr += (i32hp*i32z) * i32x;
+    COMEGA = Matrix((i32hp*i32z), i32u, _ptr);          _ptr += (i32hp*i32z) * i32u;
+    XI_DU  = Matrix(i32u, (i32hp*i32z), _ptr);          _ptr += i32u * (i32hp*i32z);
+    f32scratch = _ptr;
+
+    CPSI.vSetToZero();
+    COMEGA.vSetToZero();
+    XI_DU.vSetToZero();
+
+    bValid = true;
+    return true;
+}
+
+void MPC::vReInit(Matrix &A, Matrix &B, Matrix &C, float_prec _bobotQ, float_prec _bobotR)
+{
+    if (!bValid || bFromSnapshot) {
+        return;
+    }
+    if ((A.i32getRow() != i32x) || (A.i32getColumn() != i32x) || (B.i32getRow() != i32x) || (B.i32getColumn() != i32u) ||
+        (C.i32getRow() != i32z) || (C.i32getColumn() != i32x))
+    {
+        bGainValid = false;
+        XI_DU.vSetToZero();
+        return;
+    }
+
+    /* Carve the vReInit scratch */
+    float_prec * _ptr = f32scratch;
+    Matrix _Apow    (i32x, i32x, _ptr);                     _ptr += i32x * i32x;
+    Matrix _Atemp   (i32x, i32x, _ptr);                     _ptr += i32x * i32x;
+    Matrix _Sigma   (i32x, i32u, _ptr);                     _ptr += i32x * i32u;
+    Matrix _Stemp   (i32x, i32u, _ptr);                     _ptr += i32x * i32u;
+    Matrix CTHETA   ((i32hp*i32z), (i32hu*i32u), _ptr);     _ptr += (i32hp*i32z) * (i32hu*i32u);
+    Matrix H        ((i32hu*i32u), (i32hu*i32u), _ptr);     _ptr += (i32hu*i32u) * (i32hu*i32u);
+    Matrix H_INV    ((i32hu*i32u), (i32hu*i32u), _ptr);     _ptr += (i32hu*i32u) * (i32hu*i32u);
+    Matrix _Htemp   ((i32hu*i32u), (i32hu*i32u), _ptr);     _ptr += (i32hu*i32u) * (i32hu*i32u);
+
+    /* CPSI     : [ C *   A  ]
+     *            [ C *  A^2 ]
+     *            [     .    ]                                                   : (Hp*N) x N
+     *            [     .    ]
+     *            [ C * A^Hp ]
+     */
+    _Apow.bCopy(A);
+    for (int32_t _i = 0; _i < i32hp; _i++) {
+        Matrix _block = CPSI.RowBlock(_i*i32z, i32z);
+        _block.bMultiply(C, _Apow);
+        _Atemp.bMultiply(_Apow, A);
+        _Apow.bCopy(_Atemp);
+    }
+
+    /* COMEGA   : [          C * (B)         ]
+     *            [        C * (B+A*B)       ]
+     *            [             .            ]                                   : (Hp*N) x M
+     *            [             .            ]
+     *            [ C * Sigma(i=0->Hp-1)A^i*B]
+     */
+    _Apow.vSetIdentity();
+    _Sigma.bCopy(B);
+    for (int32_t _i = 0; _i < i32hp; _i++) {
+        Matrix _block = COMEGA.RowBlock(_i*i32z, i32z);
+        _block.bMultiply(C, _Sigma);
+        _Atemp.bMultiply(_Apow, A);
+        _Apow.bCopy(_Atemp);
+        _Stemp.bMultiply(_Apow, B);
+        _Sigma.bAdd(_Sigma, _Stemp);
+    }
+
+    /* CTHETA   : [COMEGA   [0 COMEGA(0:(len(COMEGA)-len(B)),:)]'  ....  [0..0 COMEGA(0:(len(COMEGA)-((Hp-Hu)*len(B))),:)]'] */
+    for (int32_t _i = 0; _i < (i32hp*i32z); _i++) {
+        for (int32_t _c = 0; _c < i32hu; _c++) {
+            for (int32_t _k = 0; _k < i32u; _k++) {
+                CTHETA[_i][_c*i32u + _k] = (_i >= (_c*i32z)) ? COMEGA[_i - (_c*i32z)][_k] : float_prec(0.0);
+            }
+        }
+    }
+
+
+    /* Calculate the offline optimization constants ----------------------------------------------
+     *
+     *  Q = _bobotQ*I & R = _bobotR*I, so we don't need to store them:
+     *
+     *  H       = CTHETA'*Q*CTHETA + R                                                  ...{MPC_2}
+     */
+    for (int32_t _i = 0; _i < (i32hu*i32u); _i++) {
+        for (int32_t _j = 0; _j < (i32hu*i32u); _j++) {
+            float_prec _sum = 0.0;
+            for (int32_t _k = 0; _k < (i32hp*i32z); _k++) {
+                _sum += ((CTHETA[_k][_i] * _bobotQ) * CTHETA[_k][_j]);
+            }
+            H[_i][_j] = _sum + ((_i == _j) ? _bobotR : float_prec(0.0));
+        }
+    }
+
+    /*  XI_FULL = H^-1 * CTHETA' * Q                                                    ...{MPC_3}
+     *  XI_DU   = XI_FULL(1:M, :)                                                       ...{MPC_4}
+     */
+    bGainValid = H.bInvers(H_INV, _Htemp);
+    if (!bGainValid) {
+        /* set XI_DU as zero to signal that the offline optimization matrix calculation has failed */
+        XI_DU.vSetToZero();
+        return;
+    }
+    for (int32_t _i = 0; _i < i32u; _i++) {
+        for (int32_t _j = 0; _j < (i32hp*i32z); _j++) {
+            float_prec _sum = 0.0;
+            for (int32_t _k = 0; _k < (i32hu*i32u); _k++) {
+                _sum += (H_INV[_i][_k] * CTHETA[_j][_k]);
+            }
+            XI_DU[_i][_j] = _sum * _bobotQ;
+        }
+    }
+}
+
+bool MPC::bUpdate(Matrix &SP, Matrix &x, Matrix &u)
+{
+    if (!bValid || (SP.i32getRow() != (i32hp*i32z)) || (x.i32getRow() != i32x) || (u.i32getRow() != i32u)) {
+        return false;
+    }
+
+    /*  E(k) = SP(k) - CPSI*x(k) - COMEGA*u(k-1)                                        ...{MPC_5}
+     *  dU(k)_optimal = XI_DU * E(k)                                                    ...{MPC_6}
+     *
+     *  E(k) is accumulated into dU(k) row by row, so it's never stored.
+     *
+     * Note: If XI_DU initialization is failed in vReInit(), the DU_Out is
+     * always zero (u(k) won't change)
+     */
+    Matrix DU_Out(i32u, 1, f32scratch);
+    DU_Out.vSetToZero();
+    for (int32_t _j = 0; _j < (i32hp*i32z); _j++) {
+        float_prec _cpsix = 0.0;
+        for (int32_t _k = 0; _k < i32x; _k++) {
+            _cpsix += CPSI[_j][_k] * x[_k][0];
+        }
+        float_prec _comegau = 0.0;
+        for (int32_t _k = 0; _k < i32u; _k++) {
+            _comegau += COMEGA[_j][_k] * u[_k][0];
+        }
+        float_prec _err = (SP[_j][0] - _cpsix) - _comegau;
+        for (int32_t _i = 0; _i < i32u; _i++) {
+            DU_Out[_i][0] += XI_DU[_i][_j] * _err;
+        }
+    }
+
+    /*  u(k) = u(k-1) + du(k)                                                           ...{MPC_7} */
+    u.bAdd(u, DU_Out);
+
+    return bGainValid;
+}
+
+size_t MPC::snapshotBytes(const int32_t _x, const int32_t _u, const int32_t _z, const int32_t _hp, const int32_t _hu)
+{
+    return MPC_SNAPSHOT_HEADER_BYTES + (szPersistentLen(_x, _u, _z, _hp, _hu) * sizeof(float_prec));
+}
+
+size_t MPC::snapshotWorkspaceBytes(const int32_t _u)
+{
+    return (size_t(_u) * sizeof(float_prec)) + (sizeof(float_prec) - 1);
+}
+
+bool MPC::bSaveSnapshot(void * _buf, const size_t _bufBytes)
+{
+    if (!bValid || !bGainValid || (_buf == NULL) || (_bufBytes < snapshotBytes(i32x, i32u, i32z, i32hp, i32hu))) {
+        return false;
+    }
+    MPC_SnapshotInfo _info;
+    _info.u8kind = MPC_SNAPSHOT_KIND_RUNTIME;
+    _info.i32x  = i32x;
+    _info.i32u  = i32u;
+    _info.i32z  = i32z;
+    _info.i32hp = i32hp;
+    _info.i32hu = i32hu;
+    _info.i32hc = i32hp;
+    
+    uint8_t * _p = ((uint8_t *) _buf) + MPC_SNAPSHOT_HEADER_BYTES;
+    _p = pSnapshotPutBlock(_p, CPSI, (i32hp*i32z), i32x);
+    _p = pSnapshotPutBlock(_p, COMEGA, (i32hp*i32z), i32u);
+    pSnapshotPutBlock(_p, XI_DU, i32u, (i32hp*i32z));
+    
+    vSnapshotWriteHeader((uint8_t *) _buf, _info, uint32_t(szPersistentLen(i32x, i32u, i32z, i32hp, i32hu) * sizeof(float_prec)));
+    return true;
+}
+
+bool MPC::bLoadSnapshot(const void * _snapshot, const size_t _bytes, void * _arena, const size_t _arenaBytes)
+{
+    bValid = false;
+    bGainValid = false;
+    bFromSnapshot = false;
+
+    MPC_SnapshotInfo _info;
+    if (!bSnapshotPeekInfo(_snapshot, _bytes, _info) || (_info.u8kind != MPC_SNAPSHOT_KIND_RUNTIME) ||
+        (workspaceBytes(_info.i32x, _info.i32u, _info.i32z, _info.i32hp, _info.i32hu) == 0) || (_info.i32hc != _info.i32hp) ||
+        (_arena == NULL) || (_arenaBytes < snapshotWorkspaceBytes(_info.i32u)))
+    {
+        return false;
+    }
+    const uint8_t * _payload = pSnapshotCheck(_snapshot, _bytes, _info,
+                                   uint32_t(szPersistentLen(_info.i32x, _info.i32u, _info.i32z, _info.i32hp, _info.i32hu) * sizeof(float_prec)));
+    if ((_payload == NULL) || ((uintptr_t(_payload) & (sizeof(float_prec) - 1)) != 0)) {
+        return false;
+    }
+    i32x  = _info.i32x;
+    i32u  = _info.i32u;
+    i32z  = _info.i32z;
+    i32hp = _info.i32hp;
+    i32hu = _info.i32hu;
+
+    /* bUpdate only reads these, so they can live in the read-only snapshot */
+    float_prec * _ptr = (float_prec *) _payload;
+    CPSI   = Matrix((i32hp*i32z), i32x, _ptr);          _ptr += (i32hp*i32z) * i32x;
+    COMEGA = Matrix((i32hp*i32z), i32u, _ptr);          _ptr += (i32hp*i32z) * i32u;
+    XI_DU  = Matrix(i32u, (i32hp*i32z), _ptr);
+
+    uintptr_t _addr = uintptr_t(_arena);
+    _addr = (_addr + (sizeof(float_prec) - 1)) & ~uintptr_t(sizeof(float_prec) - 1);
+    f32scratch = (float_prec *) _addr;
+
+    bValid = true;
+    bGainValid = true;
+    bFromSnapshot = true;
+    return true;
+}
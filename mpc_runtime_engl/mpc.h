@@ -0,0 +1,85 @@
+/**************************************************************************************************
+ * Class for MPC without constraint (run-time dimension).
+ *
+ *  The plant dimension (X, U, Z) and the MPC horizon (Hp, Hu) are chosen at run-time, and all
+ *  the MPC matrices are carved from one caller supplied memory arena (no malloc/new). The arena
+ *  size is given by MPC::workspaceBytes(x, u, z, hp, hu):
+ *
+ *      static uint8_t u8Arena[4096];
+ *      MPC MPC_HIL;
+ *
+ *      if (MPC::workspaceBytes(4, 2, 2, 7, 4) <= sizeof(u8Arena)) {
+ *          MPC_HIL.bInit(4, 2, 2, 7, 4, u8Arena, sizeof(u8Arena));
+ *          MPC_HIL.vReInit(A, B, C, 10.0, 0.03);
+ *      }
+ *
+ *  The algorithm is the one from the optimized implementation (mpc_opt_engl).
+ *
+ *  The online constants can be saved as a binary snapshot (see snapshot.h) and the MPC started from
+ *  it without vReInit(). The snapshot is used in place (zero copy, e.g. from flash or an mmap-ed
+ *  file), only the bUpdate scratch needs an arena:
+ *
+ *      MPC_HIL.bLoadSnapshot(SNAPSHOT, sizeof(SNAPSHOT), u8Arena, sizeof(u8Arena));
+ *
+ *
+ * See https://github.com/pronenewbits for more!
+ *************************************************************************************************/
+#ifndef MPC_H
+#define MPC_H
+
+#include <stddef.h>
+#include "konfig.h"
+#include "matrix.h"
+#include "snapshot.h"
+
+
+class MPC
+{
+public:
+    MPC();
+    bool bInit(const int32_t _x, const int32_t _u, const int32_t _z, const int32_t _hp, const int32_t _hu,
+               void * _arena, const size_t _arenaBytes);
+    void vReInit(Matrix &A, Matrix &B, Matrix &C, float_prec _bobotQ, float_prec _bobotR);
+    bool bUpdate(Matrix &SP, Matrix &x, Matrix &u);
+
+    bool bMPCIsValid() { return bValid; }
+
+    /* The arena size needed by bInit() for the given dimension */
+    static size_t workspaceBytes(const int32_t _x, const int32_t _u, const int32_t _z, const int32_t _hp, const int32_t _hu);
+
+    /* The snapshot of CPSI, COMEGA & XI_DU: bSaveSnapshot() writes snapshotBytes() bytes after a
+     * successful vReInit(). bLoadSnapshot() takes the dimension from the snapshot and uses its memory
+     * directly (it must stay alive & be float_prec aligned); the arena only holds the bUpdate
+     * scratch (snapshotWorkspaceBytes(u)). Call bInit() again before vReInit().
+     */
+    static size_t snapshotBytes(const int32_t _x, const int32_t _u, const int32_t _z, const int32_t _hp, const int32_t _hu);
+    static size_t snapshotWorkspaceBytes(const int32_t _u);
+    bool bSaveSnapshot(void * _buf, const size_t _bufBytes);
+    bool bLoadSnapshot(const void * _snapshot, const size_t _bytes, void * _arena, const size_t _arenaBytes);
+
+protected:
+    static size_t szPersistentLen(const int32_t _x, const int32_t _u, const int32_t _z, const int32_t _hp, const int32_t _hu);
+    static size_t szScratchLen(const int32_t _x, const int32_t _u, const int32_t _z, const int32_t _hp, const int32_t _hu);
+
+private:
+    int32_t i32x;
+    int32_t i32u;
+    int32_t i32z;
+    int32_t i32hp;
+    int32_t i32hu;
+    bool bValid;
+    bool bGainValid;
+    bool bFromSnapshot;     /* CPSI, COMEGA & XI_DU are in the (read-only) snapshot memory */
+
+    /* Persistent (used by bUpdate) */
+    Matrix CPSI;        /* (Hp*Z) x X       */
+    Matrix COMEGA;      /* (Hp*Z) x U       */
+    Matrix XI_DU;       /* U x (Hp*Z)       */
+
+    /* Scratch (the start of the scratch area, reused by vReInit & bUpdate) */
+    float_prec * f32scratch;
+};
+
+
+
+#endif // MPC_H
@@ -0,0 +1,187 @@
+#include <Wire.h>
+#include <elapsedMillis.h>
+#include "konfig.h"
+#include "matrix.h"
+#include "mpc.h"
+
+
+elapsedMillis timerMPC;     /* Timer for sampling time */
+uint64_t u64compuTime;      /* For benchmark */
+char bufferTxSer[100];      /* For serial printing */
+
+
+/* The controller configurations this firmware can run, chosen at run-time (e.g. read from EEPROM) */
+typedef struct {
+    int32_t i32x;
+    int32_t i32u;
+    int32_t i32z;
+    int32_t i32hp;
+    int32_t i32hu;
+} MPC_Config;
+
+const MPC_Config CONFIG_LIST[] = {
+    {4, 2, 2,  7, 4},
+    {4, 2, 2, 12, 3},
+};
+int32_t i32ConfigSelect = 0;
+
+#define SS_DT_MILIS     (10)                    /* 10 ms */
+#define MPC_ARENA_LEN   (4096)                  /* Bytes, big enough for every configuration above */
+#define PLANT_DATA_LEN  (256)                   /* Elements, for A, B, C, SP, x, u, z */
+
+uint8_t u8MPCArena[MPC_ARENA_LEN];
+float_prec f32PlantData[PLANT_DATA_LEN];
+
+
+/* Plant system */
+Matrix A;
+Matrix B;
+Matrix C;
+Matrix SP;
+Matrix x;
+Matrix u;
+Matrix z;
+Matrix xTemp;
+
+int32_t i32iterSP = 0;
+MPC MPC_HIL;
+
+void setup() {
+    /* serial to display data */
+    Serial.begin(115200);
+    while(!Serial) {}
+
+    MPC_Config _cfg = CONFIG_LIST[i32ConfigSelect];
+
+    if (MPC::workspaceBytes(_cfg.i32x, _cfg.i32u, _cfg.i32z, _cfg.i32hp, _cfg.i32hu) > sizeof(u8MPCArena)) {
+        SPEW_THE_ERROR("The MPC arena is too small for the selected configuration!");
+    }
+    MPC_HIL.bInit(_cfg.i32x, _cfg.i32u, _cfg.i32z, _cfg.i32hp, _cfg.i32hu, u8MPCArena, sizeof(u8MPCArena));
+
+    float_prec * _ptr = f32PlantData;
+    A     = Matrix(_cfg.i32x, _cfg.i32x, _ptr);                 _ptr += _cfg.i32x * _cfg.i32x;
+    B     = Matrix(_cfg.i32x, _cfg.i32u, _ptr);                 _ptr += _cfg.i32x * _cfg.i32u;
+    C     = Matrix(_cfg.i32z, _cfg.i32x, _ptr);                 _ptr += _cfg.i32z * _cfg.i32x;
+    SP    = Matrix((_cfg.i32hp*_cfg.i32z), 1, _ptr);            _ptr += _cfg.i32hp * _cfg.i32z;
+    x     = Matrix(_cfg.i32x, 1, _ptr);                         _ptr += _cfg.i32x;
+    u     = Matrix(_cfg.i32u, 1, _ptr);                         _ptr += _cfg.i32u;
+    z     = Matrix(_cfg.i32z, 1, _ptr);                         _ptr += _cfg.i32z;
+    xTemp = Matrix(_cfg.i32x, 1, _ptr);                         _ptr += _cfg.i32x;
+    if (_ptr > &f32PlantData[PLANT_DATA_LEN]) {
+        SPEW_THE_ERROR("The plant buffer is too small for the selected configuration!");
+    }
+    x.vSetToZero();
+    u.vSetToZero();
+
+    /* Ref: https://www.mathworks.com/help/control/ug/mimo-state-space-models.html#buv3tp8-1
+     *
+     * State-Space Model of Jet Transport Aircraft
+     *  This example shows how to build a MIMO model of a jet transport. Because the development of a physical model
+     *  for a jet aircraft is lengthy, only the state-space equations are presented here. See any standard text in
+     *  aviation for a more complete discussion of the physics behind aircraft flight.
+     * The jet model during cruise flight at MACH = 0.8 and H = 40,000 ft. is
+     *
+     * (The model has two inputs and two outputs. The units are radians for beta (sideslip angle) and phi (bank angle) and
+     * radians/sec for yaw (yaw rate) and roll (roll rate). The rudder and aileron deflections are in degrees.)
+     */
+    A[0][0] = -0.0558;      A[0][1] = -0.9968;      A[0][2] =  0.0802;      A[0][3] = 0.0415;
+    A[1][0] =  0.5980;      A[1][1] = -0.1150;      A[1][2] = -0.0318;      A[1][3] = 0.0000;
+    A[2][0] = -3.0500;      A[2][1] =  0.3880;      A[2][2] = -0.4650;      A[2][3] = 0.0000;
+    A[3][0] =  0.0000;      A[3][1] =  0.0805;      A[3][2] =  1.0000;      A[3][3] = 0.0000;
+
+    B[0][0] =  0.0073;      B[0][1] =  0.0000;
+    B[1][0] = -0.4750;      B[1][1] =  0.0077;
+    B[2][0] =  0.1530;      B[2][1] =  0.1430;
+    B[3][0] =  0.0000;      B[3][1] =  0.0000;
+
+    C[0][0] =  0.0000;      C[0][1] =  1.0000;      C[0][2] =  0.0000;      C[0][3] =  0.0000;
+    C[1][0] =  0.0000;      C[1][1] =  0.0000;      C[1][2] =  0.0000;      C[1][3] =  1.0000;
+
+    MPC_HIL.vReInit(A, B, C, 10.0, 0.03);
+}
+
+
+
+/* The set-point trajectory at sampling step _step (repeated every 300 steps) */
+void vGetSetPoint(int32_t _step, Matrix &SP_OUT, int32_t _row)
+{
+    _step = _step % 300;
+    if (_step < 100) {
+        SP_OUT[_row+0][0] = 3.14/2.;
+        SP_OUT[_row+1][0] = 1;
+    } else if (_step < 200) {
+        SP_OUT[_row+0][0] = 3.14/2.;
+        SP_OUT[_row+1][0] = -3;
+    } else {
+        SP_OUT[_row+0][0] = 3.14;
+        SP_OUT[_row+1][0] = -3;
+    }
+}
+
+
+void loop() {
+
+    if (timerMPC > SS_DT_MILIS) {
+
+        /* ================================ Updating Set Point ================================= */
+        for (int32_t _i = 0; _i < CONFIG_LIST[i32ConfigSelect].i32hp; _i++) {
+            vGetSetPoint(i32iterSP + _i + 1, SP, (_i*C.i32getRow()));
+        }
+        if (i32iterSP < 300-1) {
+            i32iterSP++;
+        } else {
+            i32iterSP = 0;
+        }
+        /* -------------------------------- Updating Set Point --------------------------------- */
+
+
+
+        /* ===================================== MPC Update ==================================== */
+        u64compuTime = micros();
+
+        MPC_HIL.bUpdate(SP, x, u);
+
+        u64compuTime = (micros() - u64compuTime);
+        /* ------------------------------------- MPC Update ------------------------------------ */
+
+
+
+        /* ================================= Plant Simulation ================================== */
+        xTemp.bMultiply(A, x);
+        x.bMultiply(B, u);
+        x.bAdd(x, xTemp);
+        z.bMultiply(C, x);
+        /* --------------------------------- Plant Simulation ---------------------------------- */
+
+
+
+        /* =========================== Print to serial (for plotting) ========================== */
+        #if (1)
+            /* Print: Computation time, Set-Point, z */
+            snprintf(bufferTxSer, sizeof(bufferTxSer)-1, "%.3f %.3f %.3f %.3f %.3f", ((float)u64compuTime)/1000., SP[0][0], SP[1][0], z[0][0], z[1][0]);
+        #else
+            /* Print: Computation time, Set-Point, z, u */
+            snprintf(bufferTxSer, sizeof(bufferTxSer)-1, "%.3f %.3f %.3f %.3f %.3f %.3f %.3f", ((float)u64compuTime)/1000., SP[0][0], SP[1][0], z[0][0], z[1][0], u[0][0], u[1][0]);
+        #endif
+        Serial.print(bufferTxSer);
+        Serial.print('\n');
+        /* --------------------------- Print to serial (for plotting) -------------------------- */
+
+
+        timerMPC = 0;
+    }
+}
+
+
+
+void SPEW_THE_ERROR(char const * str)
+{
+    #if (SYSTEM_IMPLEMENTATION == SYSTEM_IMPLEMENTATION_PC)
+        cout << (str) << endl;
+    #elif (SYSTEM_IMPLEMENTATION == SYSTEM_IMPLEMENTATION_EMBEDDED_ARDUINO)
+        Serial.println(str);
+    #else
+        /* Silent function */
+    #endif
+    while(1);
+}
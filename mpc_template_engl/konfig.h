@@ -0,0 +1,51 @@
+/**************************************************************************************************
+ * This file contains configuration parameters
+ * 
+ * 
+ * See https://github.com/pronenewbits for more!
+ *************************************************************************************************/
+#ifndef KONFIG_H
+#define KONFIG_H
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <math.h>
+
+
+/* NOTE: There's no plant dimension, MPC horizon, or math precision here. They're the template 
+ *  parameters of each MPC<X, U, Z, Hp, Hu, T, TOFF> instance (see mpc.h), so several controller shapes 
+ *  (and precisions) can live in the same binary.
+ */
+
+
+
+/* Define this to compensate the rounding error of the sums in MPC::bUpdate() (Neumaier summation,
+ *  about 4x the floating point operations of the plain sum). Only useful with T = float, and only
+ *  without -ffast-math (which is allowed to optimize the compensation away).
+ */
+// #define MPC_USE_COMPENSATED_UPDATE
+
+
+
+/* Define this to enable matrix bound checking */
+#define MATRIX_USE_BOUND_CHECKING
+
+
+
+/* Set this define to choose system implementation (mainly used to define how you print the matrix via the Matrix::vCetak() function) */
+#define SYSTEM_IMPLEMENTATION_PC                    1
+#define SYSTEM_IMPLEMENTATION_EMBEDDED_NO_PRINT     2
+#define SYSTEM_IMPLEMENTATION_EMBEDDED_ARDUINO      3
+
+#ifndef SYSTEM_IMPLEMENTATION
+    #define SYSTEM_IMPLEMENTATION                       (SYSTEM_IMPLEMENTATION_EMBEDDED_ARDUINO)
+#endif
+
+
+
+/* ASSERT is evaluated locally (without function call) to lower the computation cost */
+void SPEW_THE_ERROR(char const * str);
+#define ASSERT(truth, str) { if (!(truth)) SPEW_THE_ERROR(str); }
+
+
+#endif // KONFIG_H
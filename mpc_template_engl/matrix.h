@@ -0,0 +1,345 @@
+/************************************************************************************
+ * Matrix Class (compile-time dimension)
+ *  Contain the matrix class template definition and operation.
+ *
+ *  Notes:
+ *    - Indexing start from 0, with accessing format matrix[row][column].
+ *    - The matrix dimension and precision are template parameters:
+ *          Matrix<ROW, COL, T>     ; T = float or double
+ *      ->  f32data[ROW][COL] is the memory representation of the matrix, so there's
+ *           no unused memory (unlike the MATRIX_MAXIMUM_SIZE layout of the other
+ *           implementations) and every loop has a compile-time trip count.
+ *      ->  Dimension mismatch (e.g. multiplying 3x2 matrix with 3x2 matrix) is a
+ *           compile error instead of an invalid matrix.
+ *    - A matrix is still flagged invalid when a numerical operation fails (e.g. the
+ *      inverse of a singular matrix), check it with bMatrixIsValid().
+ *
+ * See https://github.com/pronenewbits for more!
+ *************************************************************************************/
+#ifndef MATRIX_H
+#define MATRIX_H
+
+#include "konfig.h"
+
+#if (SYSTEM_IMPLEMENTATION == SYSTEM_IMPLEMENTATION_PC)
+    #include <iostream>
+    #include <iomanip>      // std::setprecision
+
+    using namespace std;
+#elif (SYSTEM_IMPLEMENTATION == SYSTEM_IMPLEMENTATION_EMBEDDED_ARDUINO)
+    #include <Wire.h>
+#endif
+
+
+/* The 'zero' threshold of each precision (float_prec_ZERO in the other implementations) */
+template <typename T> struct MatrixPrecision;
+template <> struct MatrixPrecision<float> {
+    static constexpr float ZERO()       { return 1e-7f; }
+    static constexpr float ZERO_ECO()   { return 1e-5f; }   /* 'Economical' zero, for noisy calculation where 'somewhat zero' is good enough */
+};
+template <> struct MatrixPrecision<double> {
+    static constexpr double ZERO()      { return 1e-13; }
+    static constexpr double ZERO_ECO()  { return 1e-8; }    /* 'Economical' zero, for noisy calculation where 'somewhat zero' is good enough */
+};
+
+
+template <int32_t ROW, int32_t COL, typename T = float>
+class Matrix
+{
+    static_assert((ROW > 0) && (COL > 0), "The matrix dimension must be positive!");
+
+public:
+    Matrix() {
+        this->bValid = true;
+        this->vSetHomogen(0.0);
+    }
+    Matrix(bool _noInitZero) {
+        this->bValid = true;
+        if (!_noInitZero) {
+            this->vSetHomogen(0.0);
+        }
+    }
+    /* Element-wise conversion from another precision (e.g. the double offline result to float) */
+    template <typename T2>
+    explicit Matrix(Matrix<ROW, COL, T2> &_mat) {
+        this->bValid = _mat.bMatrixIsValid();
+        for (int32_t _i = 0; _i < ROW; _i++) {
+            for (int32_t _j = 0; _j < COL; _j++) {
+                this->f32data[_i][_j] = T(_mat.at(_i, _j));
+            }
+        }
+    }
+
+    bool bMatrixIsValid() { return this->bValid; }
+    void vSetMatrixInvalid() { this->bValid = false; }
+    static constexpr bool bMatrixIsSquare() { return (ROW == COL); }
+
+    static constexpr int32_t i32getRow() { return ROW; }
+    static constexpr int32_t i32getColumn() { return COL; }
+
+    /* Ref: https://stackoverflow.com/questions/6969881/operator-overload */
+    class Proxy {
+    public:
+        Proxy(T* _array) : _array(_array) { }
+
+        T & operator[](int32_t _column) {
+            #if (defined(MATRIX_USE_BOUND_CHECKING))
+                ASSERT((_column >= 0) && (_column < COL), "Matrix index out-of-bounds (at column evaluation)");
+            #else
+                #warning("Matrix bounds checking is disabled... good luck >:3");
+            #endif
+            return _array[_column];
+        }
+    private:
+        T* _array;
+    };
+    Proxy operator[](int32_t _row) {
+        #if (defined(MATRIX_USE_BOUND_CHECKING))
+            ASSERT((_row >= 0) && (_row < ROW), "Matrix index out-of-bounds (at row evaluation)");
+        #else
+            #warning("Matrix bounds checking is disabled... good luck >:3");
+        #endif
+        return Proxy(f32data[_row]);
+    }
+
+    /* Direct (unchecked) access for the kernels below */
+    T & at(int32_t _row, int32_t _column) { return f32data[_row][_column]; }
+
+    Matrix operator + (Matrix _matAdd) {
+        Matrix _outp(true);
+        for (int32_t _i = 0; _i < ROW; _i++) {
+            for (int32_t _j = 0; _j < COL; _j++) {
+                _outp.f32data[_i][_j] = this->f32data[_i][_j] + _matAdd.f32data[_i][_j];
+            }
+        }
+        return _outp;
+    }
+
+    Matrix operator - (Matrix _matSub) {
+        Matrix _outp(true);
+        for (int32_t _i = 0; _i < ROW; _i++) {
+            for (int32_t _j = 0; _j < COL; _j++) {
+                _outp.f32data[_i][_j] = this->f32data[_i][_j] - _matSub.f32data[_i][_j];
+            }
+        }
+        return _outp;
+    }
+
+    Matrix operator - (void) {
+        Matrix _outp(true);
+        for (int32_t _i = 0; _i < ROW; _i++) {
+            for (int32_t _j = 0; _j < COL; _j++) {
+                _outp.f32data[_i][_j] = -this->f32data[_i][_j];
+            }
+        }
+        return _outp;
+    }
+
+    template <int32_t COL2>
+    Matrix<ROW, COL2, T> operator * (Matrix<COL, COL2, T> _matMul) {
+        Matrix<ROW, COL2, T> _outp(true);
+        for (int32_t _i = 0; _i < ROW; _i++) {
+            for (int32_t _j = 0; _j < COL2; _j++) {
+                T _sum = 0.0;
+                for (int32_t _k = 0; _k < COL; _k++) {
+                    _sum += (this->f32data[_i][_k] * _matMul.at(_k, _j));
+                }
+                _outp.at(_i, _j) = _sum;
+            }
+        }
+        return _outp;
+    }
+
+    Matrix operator * (const T _scalar) {
+        Matrix _outp(true);
+        for (int32_t _i = 0; _i < ROW; _i++) {
+            for (int32_t _j = 0; _j < COL; _j++) {
+                _outp.f32data[_i][_j] = this->f32data[_i][_j] * _scalar;
+            }
+        }
+        return _outp;
+    }
+
+    void vSetHomogen(const T _val) {
+        for (int32_t _i = 0; _i < ROW; _i++) {
+            for (int32_t _j = 0; _j < COL; _j++) {
+                this->f32data[_i][_j] = _val;
+            }
+        }
+    }
+
+    void vSetToZero() {
+        this->vSetHomogen(0.0);
+    }
+
+    void vSetDiag(const T _val) {
+        for (int32_t _i = 0; _i < ROW; _i++) {
+            for (int32_t _j = 0; _j < COL; _j++) {
+                this->f32data[_i][_j] = (_i == _j) ? _val : T(0.0);
+            }
+        }
+    }
+
+    void vSetIdentity() {
+        this->vSetDiag(1.0);
+    }
+
+    /* Insert the _lenRow x _lenColumn submatrix, start from _posRowSub & _posColumnSub submatrix;
+     *  into matrix at the matrix's _posRow and _posColumn position (see InsertSubMatrix in the other
+     *  implementations). Unlike those, the matrix is modified in place.
+     */
+    template <int32_t ROW2, int32_t COL2>
+    bool bInsertSubMatrix(Matrix<ROW2, COL2, T> &_subMatrix, const int32_t _posRow, const int32_t _posColumn,
+                          const int32_t _posRowSub, const int32_t _posColumnSub,
+                          const int32_t _lenRow, const int32_t _lenColumn)
+    {
+        if (((_lenRow+_posRow) > ROW) || ((_lenColumn+_posColumn) > COL) ||
+            ((_posRowSub+_lenRow) > ROW2) || ((_posColumnSub+_lenColumn) > COL2))
+        {
+            return false;
+        }
+        for (int32_t _i = 0; _i < _lenRow; _i++) {
+            for (int32_t _j = 0; _j < _lenColumn; _j++) {
+                this->f32data[_i + _posRow][_j + _posColumn] = _subMatrix.at(_posRowSub+_i, _posColumnSub+_j);
+            }
+        }
+        return true;
+    }
+
+    template <int32_t ROW2, int32_t COL2>
+    bool bInsertSubMatrix(Matrix<ROW2, COL2, T> &_subMatrix, const int32_t _posRow, const int32_t _posColumn) {
+        return this->bInsertSubMatrix(_subMatrix, _posRow, _posColumn, 0, 0, ROW2, COL2);
+    }
+
+    /* Return the transpose of the matrix */
+    Matrix<COL, ROW, T> Transpose() {
+        Matrix<COL, ROW, T> _outp(true);
+        for (int32_t _i = 0; _i < ROW; _i++) {
+            for (int32_t _j = 0; _j < COL; _j++) {
+                _outp.at(_j, _i) = this->f32data[_i][_j];
+            }
+        }
+        return _outp;
+    }
+
+    void vRoundingElementToZero(const int32_t _i, const int32_t _j) {
+        if (fabs(this->f32data[_i][_j]) < MatrixPrecision<T>::ZERO()) {
+            this->f32data[_i][_j] = 0.0;
+        }
+    }
+
+    /* Invers operation using Gauss-Jordan algorithm */
+    Matrix Invers() {
+        static_assert(ROW == COL, "Only square matrix can be inverted!");
+
+        Matrix _outp(true);
+        Matrix _temp(*this);
+        _outp.vSetIdentity();
+
+
+        /* Gauss Elimination... */
+        for (int32_t _j = 0; _j < ROW-1; _j++) {
+            for (int32_t _i = _j+1; _i < ROW; _i++) {
+                if (fabs(_temp.f32data[_j][_j]) < MatrixPrecision<T>::ZERO()) {
+                    /* Matrix is non-invertible */
+                    _outp.vSetMatrixInvalid();
+                    return _outp;
+                }
+
+                T _tempfloat = _temp.f32data[_i][_j] / _temp.f32data[_j][_j];
+
+                for (int32_t _k = 0; _k < COL; _k++) {
+                    _temp.f32data[_i][_k] -= (_temp.f32data[_j][_k] * _tempfloat);
+                    _outp.f32data[_i][_k] -= (_outp.f32data[_j][_k] * _tempfloat);
+
+                    _temp.vRoundingElementToZero(_i, _k);
+                    _outp.vRoundingElementToZero(_i, _k);
+                }
+
+            }
+        }
+
+        for (int32_t _i = 1; _i < ROW; _i++) {
+            for (int32_t _j = 0; _j < _i; _j++) {
+                _temp.f32data[_i][_j] = 0.0;
+            }
+        }
+
+
+        /* Jordan... */
+        for (int32_t _j = ROW-1; _j > 0; _j--) {
+            for (int32_t _i = _j-1; _i >= 0; _i--) {
+                if (fabs(_temp.f32data[_j][_j]) < MatrixPrecision<T>::ZERO()) {
+                    /* Matrix is non-invertible */
+                    _outp.vSetMatrixInvalid();
+                    return _outp;
+                }
+
+                T _tempfloat = _temp.f32data[_i][_j] / _temp.f32data[_j][_j];
+                _temp.f32data[_i][_j] -= (_temp.f32data[_j][_j] * _tempfloat);
+                _temp.vRoundingElementToZero(_i, _j);
+
+                for (int32_t _k = ROW-1; _k >= 0; _k--) {
+                    _outp.f32data[_i][_k] -= (_outp.f32data[_j][_k] * _tempfloat);
+                    _outp.vRoundingElementToZero(_i, _k);
+                }
+            }
+        }
+
+
+        /* Normalization */
+        for (int32_t _i = 0; _i < ROW; _i++) {
+            if (fabs(_temp.f32data[_i][_i]) < MatrixPrecision<T>::ZERO()) {
+                /* Matrix is non-invertible */
+                _outp.vSetMatrixInvalid();
+                return _outp;
+            }
+
+            T _tempfloat = _temp.f32data[_i][_i];
+            _temp.f32data[_i][_i] = 1.0;
+
+            for (int32_t _j = 0; _j < ROW; _j++) {
+                _outp.f32data[_i][_j] /= _tempfloat;
+            }
+        }
+        return _outp;
+    }
+
+#if (SYSTEM_IMPLEMENTATION == SYSTEM_IMPLEMENTATION_PC)
+    void vPrint() {
+        for (int32_t _i = 0; _i < ROW; _i++) {
+            cout << "[ ";
+            for (int32_t _j = 0; _j < COL; _j++) {
+                cout << std::fixed << std::setprecision(3) << this->f32data[_i][_j] << " ";
+            }
+            cout << "]";
+            cout << endl;
+        }
+        cout << endl;
+    }
+#elif (SYSTEM_IMPLEMENTATION == SYSTEM_IMPLEMENTATION_EMBEDDED_ARDUINO)
+    void vPrint() {
+        char _bufSer[10];
+        for (int32_t _i = 0; _i < ROW; _i++) {
+            Serial.print("[ ");
+            for (int32_t _j = 0; _j < COL; _j++) {
+                snprintf(_bufSer, sizeof(_bufSer)-1, "%2.2f ", double(this->f32data[_i][_j]));
+                Serial.print(_bufSer);
+            }
+            Serial.println("]");
+        }
+        Serial.println("");
+    }
+#else
+    #warning("Matrix.vPrint() function is disabled");
+
+    void vPrint() {}     /* Silent function */
+#endif
+
+private:
+    bool bValid;
+    T f32data[ROW][COL];
+};
+
+
+#endif // MATRIX_H
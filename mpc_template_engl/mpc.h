@@ -0,0 +1,224 @@
+/**************************************************************************************************
+ * Class template for MPC without constraint (compile-time dimension).
+ *
+ *      MPC<X, U, Z, Hp, Hu, T, TOFF>   ; T, TOFF = float or double (TOFF = double by default)
+ *
+ *  The plant dimension (X, U, Z), the MPC horizon (Hp, Hu), and the math precision are template
+ *  parameters instead of konfig.h macros, so several controllers can live in the same binary:
+ *
+ *      MPC<4, 2, 2,  7, 4, float>  MPC_INNER(A1, B1, C1, 10.0, 0.03);
+ *      MPC<6, 3, 3, 20, 5, double> MPC_OUTER(A2, B2, C2, 1.0, 0.1);
+ *
+ *  Every matrix has its exact size and every loop has a compile-time trip count.
+ *
+ *  The precision is mixed: vReInit() ({MPC_1}..{MPC_4}, incl. the Gauss-Jordan inverse of H) runs in
+ *  TOFF, then CPSI, COMEGA & XI_DU are rounded to T for bUpdate() ({MPC_5}..{MPC_7}). So a float
+ *  controller gets the gains of the double calculation (only rounded once) at the float update cost.
+ *  MPC<.., float, float> is the all-float version (e.g. when the double emulation is too slow even
+ *  for the offline part). With MPC_USE_COMPENSATED_UPDATE (konfig.h) the sums of bUpdate() are
+ *  compensated (Neumaier), so the error of a long Hp*Z sum in float doesn't grow with its length.
+ *
+ *  The plant to be controlled is a Linear Time-Invariant System:
+ *          x(k+1)  = A*x(k) + B*u(k)   ; x = Nx1, u = Mx1
+ *          z(k)    = C*x(k)            ; z = Zx1
+ *
+ *  The algorithm is the same as the optimized implementation (see mpc_opt_engl/mpc.cpp for
+ *  the full derivation):
+ *
+ ** Calculate prediction of z(k+1..k+Hp) constants ************************************************
+ *
+ *        z(k+1..k+Hp) = (CPSI)*x(k) + (COMEGA)*u(k-1) + (CTHETA)*dU(k..k+Hu-1)         ...{MPC_1}
+ *
+ ** Calculate offline optimization constants ******************************************************
+ *
+ *          H       = CTHETA'*Q*CTHETA + R                                              ...{MPC_2}
+ *          XI_FULL = H^-1 * CTHETA' * Q                                                ...{MPC_3}
+ *          XI_DU   = XI_FULL(1:M, :)                                                   ...{MPC_4}
+ *
+ ** MPC update algorithm **************************************************************************
+ *
+ *          E(k) = SP(k) - CPSI*x(k) - COMEGA*u(k-1)                                    ...{MPC_5}
+ *          dU(k)_optimal = XI_DU * E(k)                                                ...{MPC_6}
+ *          u(k) = u(k-1) + du(k)                                                       ...{MPC_7}
+ *
+ *
+ * See https://github.com/pronenewbits for more!
+ *************************************************************************************************/
+#ifndef MPC_H
+#define MPC_H
+
+#include "konfig.h"
+#include "matrix.h"
+
+
+template <int32_t X, int32_t U, int32_t Z, int32_t HP, int32_t HU, typename T = float, typename TOFF = double>
+class MPC
+{
+    static_assert(HP >= HU, "The Hp must be more than or equal Hu!");
+    static_assert(HU > 0, "The Hu must be positive!");
+
+public:
+    /* The plant matrices can be in T or in TOFF (TM) */
+    template <typename TM>
+    MPC(Matrix<X, X, TM> &A, Matrix<X, U, TM> &B, Matrix<Z, X, TM> &C, TOFF _bobotQ, TOFF _bobotR)
+    {
+        bGainValid = false;
+        vReInit(A, B, C, _bobotQ, _bobotR);
+    }
+
+    template <typename TM>
+    void vReInit(Matrix<X, X, TM> &A_in, Matrix<X, U, TM> &B_in, Matrix<Z, X, TM> &C_in, TOFF _bobotQ, TOFF _bobotR)
+    {
+        Matrix<X, X, TOFF> A(A_in);
+        Matrix<X, U, TOFF> B(B_in);
+        Matrix<Z, X, TOFF> C(C_in);
+        Matrix<(HP*Z), X, TOFF> CPSI_OFF;
+        Matrix<(HP*Z), U, TOFF> COMEGA_OFF;
+
+        /* CPSI     : [ C *   A  ]
+         *            [ C *  A^2 ]
+         *            [     .    ]                                                   : (Hp*N) x N
+         *            [     .    ]
+         *            [ C * A^Hp ]
+         */
+        Matrix<X, X, TOFF> _Apow(A);
+        for (int32_t _i = 0; _i < HP; _i++) {
+            Matrix<Z, X, TOFF> _block = C*_Apow;
+            CPSI_OFF.bInsertSubMatrix(_block, _i*Z, 0);
+            _Apow = _Apow * A;
+        }
+
+        /* COMEGA   : [          C * (B)         ]
+         *            [        C * (B+A*B)       ]
+         *            [             .            ]                                   : (Hp*N) x M
+         *            [             .            ]
+         *            [ C * Sigma(i=0->Hp-1)A^i*B]
+         */
+        Matrix<X, U, TOFF> _tempSigma(B);
+        _Apow.vSetIdentity();
+        for (int32_t _i = 0; _i < HP; _i++) {
+            Matrix<Z, U, TOFF> _block = C*_tempSigma;
+            COMEGA_OFF.bInsertSubMatrix(_block, _i*Z, 0);
+            _Apow = _Apow * A;
+            _tempSigma = _tempSigma + (_Apow*B);
+        }
+
+        /* CTHETA   : [COMEGA   [0 COMEGA(0:(len(COMEGA)-len(B)),:)]'  ....  [0..0 COMEGA(0:(len(COMEGA)-((Hp-Hu)*len(B))),:)]'] */
+        Matrix<(HP*Z), (HU*U), TOFF> CTHETA;
+        for (int32_t _i = 0; _i < HU; _i++) {
+            CTHETA.bInsertSubMatrix(COMEGA_OFF, _i*Z, _i*U, 0, 0, (HP*Z)-(_i*Z), U);
+        }
+        CPSI   = Matrix<(HP*Z), X, T>(CPSI_OFF);
+        COMEGA = Matrix<(HP*Z), U, T>(COMEGA_OFF);
+
+
+        /* Calculate the offline optimization constants ----------------------------------------------
+         *
+         *  Q = _bobotQ*I & R = _bobotR*I, so we don't need to store them:
+         *
+         *  H       = CTHETA'*Q*CTHETA + R                                                  ...{MPC_2}
+         */
+        Matrix<(HU*U), (HU*U), TOFF> H(true);
+        for (int32_t _i = 0; _i < (HU*U); _i++) {
+            for (int32_t _j = 0; _j < (HU*U); _j++) {
+                TOFF _sum = 0.0;
+                for (int32_t _k = 0; _k < (HP*Z); _k++) {
+                    _sum += ((CTHETA.at(_k, _i) * _bobotQ) * CTHETA.at(_k, _j));
+                }
+                H.at(_i, _j) = _sum + ((_i == _j) ? _bobotR : TOFF(0.0));
+            }
+        }
+
+        /*  XI_FULL = H^-1 * CTHETA' * Q                                                    ...{MPC_3}
+         *  XI_DU   = XI_FULL(1:M, :)                                                       ...{MPC_4}
+         *
+         *  Rounded to T only here, at the end.
+         */
+        Matrix<(HU*U), (HU*U), TOFF> H_INV = H.Invers();
+        bGainValid = H_INV.bMatrixIsValid();
+        if (!bGainValid) {
+            /* set XI_DU as zero to signal that the offline optimization matrix calculation has failed */
+            XI_DU.vSetToZero();
+            return;
+        }
+        for (int32_t _i = 0; _i < U; _i++) {
+            for (int32_t _j = 0; _j < (HP*Z); _j++) {
+                TOFF _sum = 0.0;
+                for (int32_t _k = 0; _k < (HU*U); _k++) {
+                    _sum += (H_INV.at(_i, _k) * CTHETA.at(_j, _k));
+                }
+                XI_DU.at(_i, _j) = T(_sum * _bobotQ);
+            }
+        }
+    }
+
+    bool bUpdate(Matrix<(HP*Z), 1, T> &SP, Matrix<X, 1, T> &x, Matrix<U, 1, T> &u)
+    {
+    #if defined(MPC_USE_COMPENSATED_UPDATE)
+        /*  E(k) = SP(k) - CPSI*x(k) - COMEGA*u(k-1)                                        ...{MPC_5} */
+        Matrix<(HP*Z), 1, T> Err(true);
+        for (int32_t _i = 0; _i < (HP*Z); _i++) {
+            T _sum = SP.at(_i, 0);
+            T _comp = 0.0;
+            for (int32_t _j = 0; _j < X; _j++) {
+                vCompensatedAdd(_sum, _comp, -(CPSI.at(_i, _j) * x.at(_j, 0)));
+            }
+            for (int32_t _j = 0; _j < U; _j++) {
+                vCompensatedAdd(_sum, _comp, -(COMEGA.at(_i, _j) * u.at(_j, 0)));
+            }
+            Err.at(_i, 0) = _sum + _comp;
+        }
+
+        /*  dU(k)_optimal = XI_DU * E(k)                                                    ...{MPC_6} */
+        Matrix<U, 1, T> DU_Out(true);
+        for (int32_t _i = 0; _i < U; _i++) {
+            T _sum = 0.0;
+            T _comp = 0.0;
+            for (int32_t _j = 0; _j < (HP*Z); _j++) {
+                vCompensatedAdd(_sum, _comp, XI_DU.at(_i, _j) * Err.at(_j, 0));
+            }
+            DU_Out.at(_i, 0) = _sum + _comp;
+        }
+    #else
+        /*  E(k) = SP(k) - CPSI*x(k) - COMEGA*u(k-1)                                        ...{MPC_5} */
+        Matrix<(HP*Z), 1, T> Err = SP - CPSI*x - COMEGA*u;
+
+        /*  dU(k)_optimal = XI_DU * E(k)                                                    ...{MPC_6}
+         *
+         * Note: If XI_DU initialization is failed in vReInit(), the DU_Out is
+         * always zero (u(k) won't change)
+         */
+        Matrix<U, 1, T> DU_Out = XI_DU * Err;
+    #endif
+
+        /*  u(k) = u(k-1) + du(k)                                                           ...{MPC_7} */
+        u = u + DU_Out;
+
+        return bGainValid;
+    }
+
+    bool bGainIsValid() { return bGainValid; }
+
+private:
+#if defined(MPC_USE_COMPENSATED_UPDATE)
+    /* Neumaier's variant of the Kahan summation: _comp collects the low bits _sum lost */
+    static void vCompensatedAdd(T &_sum, T &_comp, const T _val) {
+        const T _next = _sum + _val;
+        if (fabs(_sum) >= fabs(_val)) {
+            _comp += (_sum - _next) + _val;
+        } else {
+            _comp += (_val - _next) + _sum;
+        }
+        _sum = _next;
+    }
+#endif
+
+    bool bGainValid;
+    Matrix<(HP*Z), X, T>    CPSI;
+    Matrix<(HP*Z), U, T>    COMEGA;
+    Matrix<U, (HP*Z), T>    XI_DU;
+};
+
+
+
+#endif // MPC_H
@@ -0,0 +1,178 @@
+#include <Wire.h>
+#include <elapsedMillis.h>
+#include "konfig.h"
+#include "matrix.h"
+#include "mpc.h"
+
+
+elapsedMillis timerMPC;     /* Timer for sampling time */
+uint64_t u64compuTime[2];   /* For benchmark */
+char bufferTxSer[100];      /* For serial printing */
+
+#define SS_DT_MILIS     (10)                    /* 10 ms */
+
+
+/* Two controllers with different shape & precision, living side by side on two copies of the plant:
+ *  - MPC_SHORT : Hp = 7,  Hu = 4, single precision update (the gains are still calculated in double)
+ *  - MPC_LONG  : Hp = 20, Hu = 5, double precision
+ */
+#define SHORT_HP_LEN    (7)
+#define SHORT_HU_LEN    (4)
+#define LONG_HP_LEN     (20)
+#define LONG_HU_LEN     (5)
+
+
+/* Plant system */
+Matrix<4, 4> A;
+Matrix<4, 2> B;
+Matrix<2, 4> C;
+Matrix<(SHORT_HP_LEN*2), 1> SP;
+Matrix<4, 1> x;
+Matrix<2, 1> u;
+Matrix<2, 1> z;
+
+Matrix<4, 4, double> A_d;
+Matrix<4, 2, double> B_d;
+Matrix<2, 4, double> C_d;
+Matrix<(LONG_HP_LEN*2), 1, double> SP_d;
+Matrix<4, 1, double> x_d;
+Matrix<2, 1, double> u_d;
+Matrix<2, 1, double> z_d;
+
+int32_t i32iterSP = 0;
+MPC<4, 2, 2, SHORT_HP_LEN, SHORT_HU_LEN, float> MPC_SHORT(A, B, C, 1, 0.001);
+MPC<4, 2, 2, LONG_HP_LEN, LONG_HU_LEN, double> MPC_LONG(A_d, B_d, C_d, 1, 0.001);
+
+void setup() {
+    /* serial to display data */
+    Serial.begin(115200);
+    while(!Serial) {}
+
+    /* Ref: https://www.mathworks.com/help/control/ug/mimo-state-space-models.html#buv3tp8-1
+     *
+     * State-Space Model of Jet Transport Aircraft
+     *  This example shows how to build a MIMO model of a jet transport. Because the development of a physical model
+     *  for a jet aircraft is lengthy, only the state-space equations are presented here. See any standard text in
+     *  aviation for a more complete discussion of the physics behind aircraft flight.
+     * The jet model during cruise flight at MACH = 0.8 and H = 40,000 ft. is
+     *
+     * (The model has two inputs and two outputs. The units are radians for beta (sideslip angle) and phi (bank angle) and
+     * radians/sec for yaw (yaw rate) and roll (roll rate). The rudder and aileron deflections are in degrees.)
+     */
+    A[0][0] = -0.0558;      A[0][1] = -0.9968;      A[0][2] =  0.0802;      A[0][3] = 0.0415;
+    A[1][0] =  0.5980;      A[1][1] = -0.1150;      A[1][2] = -0.0318;      A[1][3] = 0.0000;
+    A[2][0] = -3.0500;      A[2][1] =  0.3880;      A[2][2] = -0.4650;      A[2][3] = 0.0000;
+    A[3][0] =  0.0000;      A[3][1] =  0.0805;      A[3][2] =  1.0000;      A[3][3] = 0.0000;
+
+    B[0][0] =  0.0073;      B[0][1] =  0.0000;
+    B[1][0] = -0.4750;      B[1][1] =  0.0077;
+    B[2][0] =  0.1530;      B[2][1] =  0.1430;
+    B[3][0] =  0.0000;      B[3][1] =  0.0000;
+
+    C[0][0] =  0.0000;      C[0][1] =  1.0000;      C[0][2] =  0.0000;      C[0][3] =  0.0000;
+    C[1][0] =  0.0000;      C[1][1] =  0.0000;      C[1][2] =  0.0000;      C[1][3] =  1.0000;
+
+    /* The double precision copy of the plant */
+    for (int32_t _i = 0; _i < 4; _i++) {
+        for (int32_t _j = 0; _j < 4; _j++) {
+            A_d[_i][_j] = A[_i][_j];
+        }
+        for (int32_t _j = 0; _j < 2; _j++) {
+            B_d[_i][_j] = B[_i][_j];
+            C_d[_j][_i] = C[_j][_i];
+        }
+    }
+
+    MPC_SHORT.vReInit(A, B, C, 10.0, 0.03);
+    MPC_LONG.vReInit(A_d, B_d, C_d, 10.0, 0.03);
+}
+
+
+
+/* The set-point trajectory at sampling step _step (repeated every 300 steps) */
+template <int32_t ROW, typename T>
+void vGetSetPoint(int32_t _step, Matrix<ROW, 1, T> &SP_OUT, int32_t _row)
+{
+    _step = _step % 300;
+    if (_step < 100) {
+        SP_OUT[_row+0][0] = 3.14/2.;
+        SP_OUT[_row+1][0] = 1;
+    } else if (_step < 200) {
+        SP_OUT[_row+0][0] = 3.14/2.;
+        SP_OUT[_row+1][0] = -3;
+    } else {
+        SP_OUT[_row+0][0] = 3.14;
+        SP_OUT[_row+1][0] = -3;
+    }
+}
+
+
+void loop() {
+
+    if (timerMPC > SS_DT_MILIS) {
+
+        /* ================================ Updating Set Point ================================= */
+        for (int32_t _i = 0; _i < SHORT_HP_LEN; _i++) {
+            vGetSetPoint(i32iterSP + _i + 1, SP, (_i*2));
+        }
+        for (int32_t _i = 0; _i < LONG_HP_LEN; _i++) {
+            vGetSetPoint(i32iterSP + _i + 1, SP_d, (_i*2));
+        }
+        if (i32iterSP < 300-1) {
+            i32iterSP++;
+        } else {
+            i32iterSP = 0;
+        }
+        /* -------------------------------- Updating Set Point --------------------------------- */
+
+
+
+        /* ===================================== MPC Update ==================================== */
+        u64compuTime[0] = micros();
+        MPC_SHORT.bUpdate(SP, x, u);
+        u64compuTime[0] = (micros() - u64compuTime[0]);
+
+        u64compuTime[1] = micros();
+        MPC_LONG.bUpdate(SP_d, x_d, u_d);
+        u64compuTime[1] = (micros() - u64compuTime[1]);
+        /* ------------------------------------- MPC Update ------------------------------------ */
+
+
+
+        /* ================================= Plant Simulation ================================== */
+        x = A*x + B*u;
+        z = C*x;
+
+        x_d = A_d*x_d + B_d*u_d;
+        z_d = C_d*x_d;
+        /* --------------------------------- Plant Simulation ---------------------------------- */
+
+
+
+        /* =========================== Print to serial (for plotting) ========================== */
+        /* Print: Computation time (both controllers), Set-Point, z (single precision), z (double precision) */
+        snprintf(bufferTxSer, sizeof(bufferTxSer)-1, "%.3f %.3f %.3f %.3f %.3f %.3f %.3f %.3f",
+                 ((float)u64compuTime[0])/1000., ((float)u64compuTime[1])/1000., SP[0][0], SP[1][0],
+                 z[0][0], z[1][0], z_d[0][0], z_d[1][0]);
+        Serial.print(bufferTxSer);
+        Serial.print('\n');
+        /* --------------------------- Print to serial (for plotting) -------------------------- */
+
+
+        timerMPC = 0;
+    }
+}
+
+
+
+void SPEW_THE_ERROR(char const * str)
+{
+    #if (SYSTEM_IMPLEMENTATION == SYSTEM_IMPLEMENTATION_PC)
+        cout << (str) << endl;
+    #elif (SYSTEM_IMPLEMENTATION == SYSTEM_IMPLEMENTATION_EMBEDDED_ARDUINO)
+        Serial.println(str);
+    #else
+        /* Silent function */
+    #endif
+    while(1);
+}
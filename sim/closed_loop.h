@@ -0,0 +1,383 @@
+/**************************************************************************************************
+ * Host closed-loop simulation of the MPC (the loop of the *.ino sketch, without the wall-clock
+ *  cadence & the serial printing).
+ *
+ *  At every step k:
+ *      SP  = the set-point schedule at the coincidence points k+P(1)..k+P(Hc)
+ *      u   = MPC::bUpdate(SP, x, u)
+ *      x   = A*x + B*u;    z = C*x         (the plant, it can be different from the MPC model)
+ *
+ *  The plant step is done in place with plain loops (no Matrix temporary), so the loop cost is the
+ *  MPC update itself. It's header only: include it after the konfig.h/matrix.h/mpc.h of the MPC
+ *  implementation you link with.
+ *
+ *  The set-point schedule text file: one segment per line, "<length in steps> <sp_1> .. <sp_Z>",
+ *  repeated after the last segment ('#' starts a comment).
+ *  The plant text file: the elements of A (X*X), B (X*U), and C (Z*X), row-major, whitespace
+ *  separated ('#' starts a comment).
+ *
+ *  The binary trace: a SimTraceHeader, then one record per step of float_prec values
+ *  {SP(k) [Z], z(k+1) [Z], u(k) [U]} in the host byte order.
+ *
+ * See https://github.com/pronenewbits for more!
+ *************************************************************************************************/
+#ifndef CLOSED_LOOP_H
+#define CLOSED_LOOP_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <vector>
+#include "konfig.h"
+#include "matrix.h"
+#include "mpc.h"
+
+
+#define SIM_TRACE_VERSION       (1)
+#define SIM_TRACE_RECORD_LEN    (SS_Z_LEN + SS_Z_LEN + SS_U_LEN)
+#define SIM_TRACE_BLOCK_LEN     (4096)      /* Records buffered before one fwrite */
+
+typedef struct {
+    char     magic[8];          /* "MPCTRACE"                                           */
+    uint32_t u32version;        /* SIM_TRACE_VERSION                                    */
+    uint32_t u32floatSize;      /* sizeof(float_prec)                                   */
+    uint32_t u32xLen;
+    uint32_t u32uLen;
+    uint32_t u32zLen;
+    uint32_t u32reserved;
+    uint64_t u64steps;          /* Number of records (written when the trace is closed) */
+} SimTraceHeader;
+
+
+/* Monotonic wall-clock time, in seconds */
+static inline double f64SimWallSecond(void)
+{
+    struct timespec _ts;
+    clock_gettime(CLOCK_MONOTONIC, &_ts);
+    return double(_ts.tv_sec) + (double(_ts.tv_nsec) * 1e-9);
+}
+
+
+/* Read the next number from a text file, skipping the whitespaces & '#' comments */
+static inline bool bSimReadNumber(FILE * _file, double &_val)
+{
+    while (true) {
+        int _c = fgetc(_file);
+        if (_c == EOF) {
+            return false;
+        }
+        if (_c == '#') {
+            while ((_c != '\n') && (_c != EOF)) {
+                _c = fgetc(_file);
+            }
+            continue;
+        }
+        if ((_c == ' ') || (_c == '\t') || (_c == '\r') || (_c == '\n') || (_c == ',')) {
+            continue;
+        }
+        ungetc(_c, _file);
+        return (fscanf(_file, "%lf", &_val) == 1);
+    }
+}
+
+
+/* The jet transport aircraft of the *.ino sketch (MACH = 0.8, H = 40,000 ft), needs X=4, U=2, Z=2 */
+static inline bool bSimJetPlant(Matrix &A, Matrix &B, Matrix &C)
+{
+    if ((SS_X_LEN != 4) || (SS_U_LEN != 2) || (SS_Z_LEN != 2)) {
+        return false;
+    }
+    A.vSetToZero();
+    B.vSetToZero();
+    C.vSetToZero();
+
+    A[0][0] = -0.0558;      A[0][1] = -0.9968;      A[0][2] =  0.0802;      A[0][3] = 0.0415;
+    A[1][0] =  0.5980;      A[1][1] = -0.1150;      A[1][2] = -0.0318;      A[1][3] = 0.0000;
+    A[2][0] = -3.0500;      A[2][1] =  0.3880;      A[2][2] = -0.4650;      A[2][3] = 0.0000;
+    A[3][0] =  0.0000;      A[3][1] =  0.0805;      A[3][2] =  1.0000;      A[3][3] = 0.0000;
+    
+    B[0][0] =  0.0073;      B[0][1] =  0.0000;
+    B[1][0] = -0.4750;      B[1][1] =  0.0077;
+    B[2][0] =  0.1530;      B[2][1] =  0.1430;
+    B[3][0] =  0.0000;      B[3][1] =  0.0000;
+    
+    C[0][0] =  0.0000;      C[0][1] =  1.0000;      C[0][2] =  0.0000;      C[0][3] =  0.0000;
+    C[1][0] =  0.0000;      C[1][1] =  0.0000;      C[1][2] =  0.0000;      C[1][3] =  1.0000;
+    return true;
+}
+
+
+/* Load A, B, C from the plant text file */
+static inline bool bSimLoadPlant(const char * _fileName, Matrix &A, Matrix &B, Matrix &C)
+{
+    FILE * _file = fopen(_fileName, "r");
+    if (_file == NULL) {
+        return false;
+    }
+    Matrix * const _mat[3] = {&A, &B, &C};
+    bool _ok = true;
+    for (int32_t _m = 0; (_m < 3) && _ok; _m++) {
+        for (int32_t _i = 0; (_i < _mat[_m]->i32getRow()) && _ok; _i++) {
+            for (int32_t _j = 0; (_j < _mat[_m]->i32getColumn()) && _ok; _j++) {
+                double _val;
+                _ok = bSimReadNumber(_file, _val);
+                (*_mat[_m])[_i][_j] = float_prec(_val);
+            }
+        }
+    }
+    fclose(_file);
+    return _ok;
+}
+
+
+/* The (periodic) set-point schedule, expanded to one SS_Z_LEN vector per step of the period */
+class SimSchedule
+{
+public:
+    SimSchedule() { vSetJetSchedule(); }
+
+    /* The set-point trajectory of the *.ino sketch (period of 300 steps) */
+    void vSetJetSchedule() {
+        const float_prec _segment[3][3] = {
+            {100, float_prec(3.14/2.),  1},
+            {100, float_prec(3.14/2.), -3},
+            {100, float_prec(3.14),    -3}
+        };
+        f32table.clear();
+        for (int32_t _s = 0; _s < 3; _s++) {
+            for (int32_t _k = 0; _k < int32_t(_segment[_s][0]); _k++) {
+                for (int32_t _i = 0; _i < SS_Z_LEN; _i++) {
+                    f32table.push_back((_i < 2) ? _segment[_s][1+_i] : float_prec(0));
+                }
+            }
+        }
+        i32period = 300;
+    }
+
+    bool bLoad(const char * _fileName) {
+        FILE * _file = fopen(_fileName, "r");
+        if (_file == NULL) {
+            return false;
+        }
+        std::vector<float_prec> _table;
+        double _len;
+        while (bSimReadNumber(_file, _len)) {
+            float_prec _sp[SS_Z_LEN];
+            for (int32_t _i = 0; _i < SS_Z_LEN; _i++) {
+                double _val;
+                if (!bSimReadNumber(_file, _val)) {
+                    fclose(_file);
+                    return false;
+                }
+                _sp[_i] = float_prec(_val);
+            }
+            for (int32_t _k = 0; _k < int32_t(_len); _k++) {
+                _table.insert(_table.end(), _sp, _sp + SS_Z_LEN);
+            }
+        }
+        fclose(_file);
+        if (_table.empty()) {
+            return false;
+        }
+        f32table.swap(_table);
+        i32period = int32_t(f32table.size() / SS_Z_LEN);
+        return true;
+    }
+
+    /* The set-point at step _k (SS_Z_LEN elements) */
+    const float_prec * pGet(const int64_t _k) const { return &f32table[size_t(_k % i32period) * SS_Z_LEN]; }
+
+private:
+    std::vector<float_prec> f32table;
+    int32_t i32period;
+};
+
+
+/* Buffered binary trace writer */
+class SimTrace
+{
+public:
+    SimTrace() : file(NULL), u32fill(0), u64steps(0) {}
+    ~SimTrace() { bClose(); }
+
+    bool bOpen(const char * _fileName) {
+        file = fopen(_fileName, "wb");
+        if (file == NULL) {
+            return false;
+        }
+        SimTraceHeader _header;
+        memset(&_header, 0, sizeof(_header));
+        memcpy(_header.magic, "MPCTRACE", 8);
+        _header.u32version   = SIM_TRACE_VERSION;
+        _header.u32floatSize = sizeof(float_prec);
+        _header.u32xLen      = SS_X_LEN;
+        _header.u32uLen      = SS_U_LEN;
+        _header.u32zLen      = SS_Z_LEN;
+        return (fwrite(&_header, sizeof(_header), 1, file) == 1);
+    }
+
+    /* The record slot of the next step (call vCommit() after filling it) */
+    float_prec * pNext() { return f32block[u32fill]; }
+
+    void vCommit() {
+        u32fill++;
+        u64steps++;
+        if (u32fill == SIM_TRACE_BLOCK_LEN) {
+            vFlush();
+        }
+    }
+
+    bool bIsOpen() const { return (file != NULL); }
+
+    bool bClose() {
+        if (file == NULL) {
+            return true;
+        }
+        vFlush();
+        /* Patch the number of records in the header */
+        bool _ok = (fseek(file, long(offsetof(SimTraceHeader, u64steps)), SEEK_SET) == 0);
+        _ok = _ok && (fwrite(&u64steps, sizeof(u64steps), 1, file) == 1);
+        _ok = (fclose(file) == 0) && _ok;
+        file = NULL;
+        return _ok;
+    }
+
+private:
+    void vFlush() {
+        if (u32fill > 0) {
+            fwrite(f32block, sizeof(f32block[0]), u32fill, file);
+            u32fill = 0;
+        }
+    }
+
+    FILE * file;
+    uint32_t u32fill;
+    uint64_t u64steps;
+    float_prec f32block[SIM_TRACE_BLOCK_LEN][SIM_TRACE_RECORD_LEN];
+};
+
+
+/* The closed loop: the MPC (built from its own model) driving the plant A, B, C */
+class SimClosedLoop
+{
+public:
+    SimClosedLoop(MPC &_mpc, Matrix &_A, Matrix &_B, Matrix &_C, const SimSchedule &_schedule) :
+        mpc(_mpc), A(_A), B(_B), C(_C), schedule(_schedule) { vReset(); }
+
+    void vReset() {
+        x.vSetToZero();
+        u.vSetToZero();
+        z.vSetToZero();
+        i64step = 0;
+        u64updateFail = 0;
+        f64sumSquareDu = 0;
+        for (int32_t _i = 0; _i < SS_Z_LEN; _i++) {
+            f64sumSquareErr[_i] = 0;
+            f64maxAbsErr[_i] = 0;
+        }
+    }
+
+    /* One sampling time; the record (SP, z, u) is written to _trace when it's not NULL */
+    void vStep(float_prec * _trace) {
+        /* SP only holds the set-point at the coincidence points k+P(1)..k+P(Hc) */
+        for (int32_t _j = 0; _j < MPC_HC_LEN; _j++) {
+            const float_prec * _sp = schedule.pGet(i64step + mpc.i32GetCoincidenceTime(_j));
+            for (int32_t _i = 0; _i < SS_Z_LEN; _i++) {
+                SP[(_j*SS_Z_LEN) + _i][0] = _sp[_i];
+            }
+        }
+
+        float_prec _uLast[SS_U_LEN];
+        for (int32_t _i = 0; _i < SS_U_LEN; _i++) {
+            _uLast[_i] = u[_i][0];
+        }
+        if (!mpc.bUpdate(SP, x, u)) {
+            u64updateFail++;
+        }
+        for (int32_t _i = 0; _i < SS_U_LEN; _i++) {
+            const double _du = double(u[_i][0]) - double(_uLast[_i]);
+            f64sumSquareDu += _du * _du;
+        }
+
+        /* x = A*x + B*u;  z = C*x */
+        float_prec _xNext[SS_X_LEN];
+        for (int32_t _i = 0; _i < SS_X_LEN; _i++) {
+            float_prec _sum = 0;
+            for (int32_t _j = 0; _j < SS_X_LEN; _j++) {
+                _sum += A[_i][_j] * x[_j][0];
+            }
+            for (int32_t _j = 0; _j < SS_U_LEN; _j++) {
+                _sum += B[_i][_j] * u[_j][0];
+            }
+            _xNext[_i] = _sum;
+        }
+        for (int32_t _i = 0; _i < SS_X_LEN; _i++) {
+            x[_i][0] = _xNext[_i];
+        }
+
+        /* The tracking error against the set-point of this step */
+        const float_prec * _spNow = schedule.pGet(i64step);
+        for (int32_t _i = 0; _i < SS_Z_LEN; _i++) {
+            float_prec _sum = 0;
+            for (int32_t _j = 0; _j < SS_X_LEN; _j++) {
+                _sum += C[_i][_j] * x[_j][0];
+            }
+            z[_i][0] = _sum;
+
+            const double _err = double(_sum) - double(_spNow[_i]);
+            f64sumSquareErr[_i] += _err * _err;
+            if (fabs(_err) > f64maxAbsErr[_i]) {
+                f64maxAbsErr[_i] = fabs(_err);
+            }
+        }
+
+        if (_trace != NULL) {
+            for (int32_t _i = 0; _i < SS_Z_LEN; _i++) {
+                _trace[_i]            = _spNow[_i];
+                _trace[SS_Z_LEN + _i] = z[_i][0];
+            }
+            for (int32_t _i = 0; _i < SS_U_LEN; _i++) {
+                _trace[(2*SS_Z_LEN) + _i] = u[_i][0];
+            }
+        }
+        i64step++;
+    }
+
+    int64_t i64GetStep() const { return i64step; }
+    uint64_t u64GetUpdateFail() const { return u64updateFail; }
+    double f64GetRmsErr(const int32_t _i) const { return (i64step > 0) ? sqrt(f64sumSquareErr[_i] / double(i64step)) : 0; }
+    double f64GetMaxAbsErr(const int32_t _i) const { return f64maxAbsErr[_i]; }
+    /* RMS of the control move du(k) = u(k) - u(k-1), over all inputs */
+    double f64GetRmsDu() const { return (i64step > 0) ? sqrt(f64sumSquareDu / double(i64step * SS_U_LEN)) : 0; }
+    bool bIsFinite() {
+        for (int32_t _i = 0; _i < SS_X_LEN; _i++) {
+            if (!isfinite(double(x[_i][0]))) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+private:
+    MPC &mpc;
+    Matrix &A;
+    Matrix &B;
+    Matrix &C;
+    const SimSchedule &schedule;
+
+    Matrix SP   {(MPC_HC_LEN*SS_Z_LEN), 1};
+    Matrix x    {SS_X_LEN, 1};
+    Matrix u    {SS_U_LEN, 1};
+    Matrix z    {SS_Z_LEN, 1};
+
+    int64_t i64step;
+    uint64_t u64updateFail;
+    double f64sumSquareDu;
+    double f64sumSquareErr[SS_Z_LEN];
+    double f64maxAbsErr[SS_Z_LEN];
+};
+
+
+#endif // CLOSED_LOOP_H
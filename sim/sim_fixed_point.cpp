@@ -0,0 +1,284 @@
+/**************************************************************************************************
+ * Host check of the fixed-point online path (MPC_USE_FIXED_POINT, see fixed_point.h) of the
+ *  optimized implementation, against its float bUpdate():
+ *
+ *      sim_fixed_point_q15 [--steps N] [--samples S] [--margin m] [--max-error e]
+ *                          [--plant file] [--schedule file]
+ *
+ *  1. Calibration: a float closed-loop run (see closed_loop.h) records the biggest |SP|, |x| & |u|;
+ *     times the margin, they are the ranges of MPC::vSetFixedRange().
+ *  2. Worst case: S random (SP, x, u(k-1)) inside the ranges, the u(k) of bUpdate() (from the same
+ *     quantized inputs) against the one of bUpdateFixed(). The samples where the float u(k) leaves
+ *     its range are skipped (the fixed-point one saturates there by design).
+ *  3. Closed loop: the float & the fixed-point MPC each drive their own copy of the plant for N
+ *     steps; the biggest u & z deviation between them, and the RMS tracking error of both.
+ *
+ *  The error of step 2 is also printed relative to the u range. With --max-error the tool returns 1
+ *  when that relative error is bigger than e.
+ *
+ * See https://github.com/pronenewbits for more!
+ *************************************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "closed_loop.h"
+
+#if !defined(MPC_USE_FIXED_POINT)
+    #error("sim_fixed_point needs MPC_USE_FIXED_POINT!");
+#endif
+
+#ifndef SIM_VARIANT_NAME
+    #define SIM_VARIANT_NAME    "mpc"
+#endif
+
+
+static uint32_t u32Seed = 12345;
+static float_prec fRandom(void)
+{
+    /* Deterministic LCG in [-1, 1] */
+    u32Seed = (1103515245UL * u32Seed) + 12345UL;
+    return float_prec((u32Seed >> 8) & 0xFFFF) / float_prec(32767.5) - float_prec(1.0);
+}
+
+/* x = A*x + B*u */
+static void vPlantStep(Matrix &A, Matrix &B, float_prec * _x, const float_prec * _u)
+{
+    float_prec _xNext[SS_X_LEN];
+    for (int32_t _i = 0; _i < SS_X_LEN; _i++) {
+        float_prec _sum = 0;
+        for (int32_t _j = 0; _j < SS_X_LEN; _j++) {
+            _sum += A[_i][_j] * _x[_j];
+        }
+        for (int32_t _j = 0; _j < SS_U_LEN; _j++) {
+            _sum += B[_i][_j] * _u[_j];
+        }
+        _xNext[_i] = _sum;
+    }
+    memcpy(_x, _xNext, sizeof(_xNext));
+}
+
+static float_prec fOutput(Matrix &C, const float_prec * _x, const int32_t _i)
+{
+    float_prec _sum = 0;
+    for (int32_t _j = 0; _j < SS_X_LEN; _j++) {
+        _sum += C[_i][_j] * _x[_j];
+    }
+    return _sum;
+}
+
+static void vUsage(const char * _name)
+{
+    fprintf(stderr, "usage: %s [--steps N] [--samples S] [--margin m] [--max-error e] [--plant file] [--schedule file]\n",
+            _name);
+}
+
+int main(int argc, char ** argv)
+{
+    int64_t _steps = 3000;
+    int32_t _samples = 100000;
+    double _margin = 1.5;
+    double _maxError = -1;
+    const char * _plantFile = NULL;
+    const char * _scheduleFile = NULL;
+    for (int _i = 1; _i < argc; _i++) {
+        if ((strcmp(argv[_i], "--steps") == 0) && (_i+1 < argc)) {
+            _steps = strtoll(argv[++_i], NULL, 10);
+        } else if ((strcmp(argv[_i], "--samples") == 0) && (_i+1 < argc)) {
+            _samples = int32_t(atoi(argv[++_i]));
+        } else if ((strcmp(argv[_i], "--margin") == 0) && (_i+1 < argc)) {
+            _margin = atof(argv[++_i]);
+        } else if ((strcmp(argv[_i], "--max-error") == 0) && (_i+1 < argc)) {
+            _maxError = atof(argv[++_i]);
+        } else if ((strcmp(argv[_i], "--plant") == 0) && (_i+1 < argc)) {
+            _plantFile = argv[++_i];
+        } else if ((strcmp(argv[_i], "--schedule") == 0) && (_i+1 < argc)) {
+            _scheduleFile = argv[++_i];
+        } else {
+            vUsage(argv[0]);
+            return 2;
+        }
+    }
+    if ((_steps < 1) || (_samples < 1) || (_margin < 1)) {
+        fprintf(stderr, "Need steps >= 1, samples >= 1 and margin >= 1\n");
+        return 2;
+    }
+
+    static Matrix A(SS_X_LEN, SS_X_LEN);
+    static Matrix B(SS_X_LEN, SS_U_LEN);
+    static Matrix C(SS_Z_LEN, SS_X_LEN);
+    if (_plantFile != NULL) {
+        if (!bSimLoadPlant(_plantFile, A, B, C)) {
+            fprintf(stderr, "Can't read the plant file '%s' (A, B, C of %dx%d, %dx%d, %dx%d)\n", _plantFile,
+                    SS_X_LEN, SS_X_LEN, SS_X_LEN, SS_U_LEN, SS_Z_LEN, SS_X_LEN);
+            return 2;
+        }
+    } else if (!bSimJetPlant(A, B, C)) {
+        fprintf(stderr, "The jet example needs X=4, U=2, Z=2; use --plant for this dimension\n");
+        return 2;
+    }
+
+    static SimSchedule SCHEDULE;
+    if ((_scheduleFile != NULL) && !SCHEDULE.bLoad(_scheduleFile)) {
+        fprintf(stderr, "Can't read the set-point schedule file '%s'\n", _scheduleFile);
+        return 2;
+    }
+
+    static MPC MPC_SIM(A, B, C, float_prec(10.0), float_prec(0.03));
+    static Matrix SP((MPC_HC_LEN*SS_Z_LEN), 1);
+    static Matrix x(SS_X_LEN, 1);
+    static Matrix u(SS_U_LEN, 1);
+
+
+    /* 1. Calibration ------------------------------------------------------------------------- */
+    float_prec _range[3] = {0, 0, 0};
+    float_prec _xf[SS_X_LEN] = {0};
+    float_prec _uf[SS_U_LEN] = {0};
+    for (int64_t _k = 0; _k < _steps; _k++) {
+        for (int32_t _j = 0; _j < MPC_HC_LEN; _j++) {
+            const float_prec * _sp = SCHEDULE.pGet(_k + MPC_SIM.i32GetCoincidenceTime(_j));
+            for (int32_t _i = 0; _i < SS_Z_LEN; _i++) {
+                SP[(_j*SS_Z_LEN) + _i][0] = _sp[_i];
+                _range[0] = (fabs(_sp[_i]) > _range[0]) ? float_prec(fabs(_sp[_i])) : _range[0];
+            }
+        }
+        for (int32_t _i = 0; _i < SS_X_LEN; _i++) {
+            x[_i][0] = _xf[_i];
+            _range[1] = (fabs(_xf[_i]) > _range[1]) ? float_prec(fabs(_xf[_i])) : _range[1];
+        }
+        for (int32_t _i = 0; _i < SS_U_LEN; _i++) {
+            u[_i][0] = _uf[_i];
+        }
+        MPC_SIM.bUpdate(SP, x, u);
+        for (int32_t _i = 0; _i < SS_U_LEN; _i++) {
+            _uf[_i] = u[_i][0];
+            _range[2] = (fabs(_uf[_i]) > _range[2]) ? float_prec(fabs(_uf[_i])) : _range[2];
+        }
+        vPlantStep(A, B, _xf, _uf);
+    }
+    for (int32_t _i = 0; _i < 3; _i++) {
+        _range[_i] = (_range[_i] > float_prec(0)) ? float_prec(_range[_i] * _margin) : float_prec(1);
+    }
+    MPC_SIM.vSetFixedRange(_range[0], _range[1], _range[2]);
+
+    const int32_t _eSP = MPC_SIM.i32GetFixedExponent(MPC_FIXED_SP);
+    const int32_t _eX  = MPC_SIM.i32GetFixedExponent(MPC_FIXED_X);
+    const int32_t _eU  = MPC_SIM.i32GetFixedExponent(MPC_FIXED_U);
+
+    printf("variant          : %s (%s)\n", SIM_VARIANT_NAME, (MPC_USE_FIXED_POINT == MPC_FIXED_Q15) ? "Q15" : "Q31");
+    printf("range            : |SP| %g, |x| %g, |u| %g (margin %g)\n", double(_range[0]), double(_range[1]), double(_range[2]),
+           _margin);
+    printf("exponent         : CPSI %d, COMEGA %d, XI_DU %d, SP %d, x %d, u %d, E %d\n",
+           int(MPC_SIM.i32GetFixedExponent(MPC_FIXED_CPSI)), int(MPC_SIM.i32GetFixedExponent(MPC_FIXED_COMEGA)),
+           int(MPC_SIM.i32GetFixedExponent(MPC_FIXED_XI_DU)), int(_eSP), int(_eX), int(_eU),
+           int(MPC_SIM.i32GetFixedExponent(MPC_FIXED_ERR)));
+
+
+    /* 2. Worst case over the ranges ---------------------------------------------------------- */
+    fixed_prec _fxSP[(MPC_HC_LEN*SS_Z_LEN)];
+    fixed_prec _fxX[SS_X_LEN];
+    fixed_prec _fxU[SS_U_LEN];
+    double _worst = 0;
+    int32_t _skipped = 0;
+    for (int32_t _n = 0; _n < _samples; _n++) {
+        for (int32_t _i = 0; _i < (MPC_HC_LEN*SS_Z_LEN); _i++) {
+            _fxSP[_i] = fxFixedFromFloat(_range[0] * fRandom(), _eSP);
+            SP[_i][0] = fFixedToFloat(_fxSP[_i], _eSP);
+        }
+        for (int32_t _i = 0; _i < SS_X_LEN; _i++) {
+            _fxX[_i] = fxFixedFromFloat(_range[1] * fRandom(), _eX);
+            x[_i][0] = fFixedToFloat(_fxX[_i], _eX);
+        }
+        for (int32_t _i = 0; _i < SS_U_LEN; _i++) {
+            _fxU[_i] = fxFixedFromFloat(_range[2] * fRandom(), _eU);
+            u[_i][0] = fFixedToFloat(_fxU[_i], _eU);
+        }
+        const uint32_t _saturation = MPC_SIM.u32GetFixedSaturation();
+        MPC_SIM.bUpdate(SP, x, u);
+        MPC_SIM.bUpdateFixed(_fxSP, _fxX, _fxU);
+
+        bool _inRange = true;
+        for (int32_t _i = 0; _i < SS_U_LEN; _i++) {
+            _inRange = _inRange && (fabs(u[_i][0]) < _range[2]);
+        }
+        if (!_inRange) {
+            _skipped++;
+            continue;
+        }
+        if (MPC_SIM.u32GetFixedSaturation() != _saturation) {
+            /* Every input is in its range and so is the float result: nothing should saturate */
+            printf("worst case       : unexpected saturation at sample %d\n", int(_n));
+            return 1;
+        }
+        for (int32_t _i = 0; _i < SS_U_LEN; _i++) {
+            const double _err = fabs(double(u[_i][0]) - double(fFixedToFloat(_fxU[_i], _eU)));
+            _worst = (_err > _worst) ? _err : _worst;
+        }
+    }
+    printf("worst case       : max |u error| %.3e (%.3e of the u range), %d of %d samples out of range\n",
+           _worst, _worst / double(_range[2]), int(_skipped), int(_samples));
+
+
+    /* 3. Float & fixed-point closed loops, side by side --------------------------------------- */
+    MPC_SIM.vSetFixedRange(_range[0], _range[1], _range[2]);
+    float_prec _xq[SS_X_LEN] = {0};
+    float_prec _uq[SS_U_LEN] = {0};
+    memset(_xf, 0, sizeof(_xf));
+    memset(_uf, 0, sizeof(_uf));
+    memset(_fxU, 0, sizeof(_fxU));
+    double _maxDevU = 0;
+    double _maxDevZ = 0;
+    double _sumSquareErrF = 0;
+    double _sumSquareErrQ = 0;
+    for (int64_t _k = 0; _k < _steps; _k++) {
+        for (int32_t _j = 0; _j < MPC_HC_LEN; _j++) {
+            const float_prec * _sp = SCHEDULE.pGet(_k + MPC_SIM.i32GetCoincidenceTime(_j));
+            for (int32_t _i = 0; _i < SS_Z_LEN; _i++) {
+                SP[(_j*SS_Z_LEN) + _i][0] = _sp[_i];
+                _fxSP[(_j*SS_Z_LEN) + _i] = fxFixedFromFloat(_sp[_i], _eSP);
+            }
+        }
+        for (int32_t _i = 0; _i < SS_X_LEN; _i++) {
+            x[_i][0] = _xf[_i];
+            _fxX[_i] = fxFixedFromFloat(_xq[_i], _eX);
+        }
+        for (int32_t _i = 0; _i < SS_U_LEN; _i++) {
+            u[_i][0] = _uf[_i];
+        }
+        MPC_SIM.bUpdate(SP, x, u);
+        MPC_SIM.bUpdateFixed(_fxSP, _fxX, _fxU);
+        for (int32_t _i = 0; _i < SS_U_LEN; _i++) {
+            _uf[_i] = u[_i][0];
+            _uq[_i] = fFixedToFloat(_fxU[_i], _eU);
+            _maxDevU = (fabs(double(_uf[_i]) - double(_uq[_i])) > _maxDevU) ? fabs(double(_uf[_i]) - double(_uq[_i])) : _maxDevU;
+        }
+        vPlantStep(A, B, _xf, _uf);
+        vPlantStep(A, B, _xq, _uq);
+
+        const float_prec * _spNow = SCHEDULE.pGet(_k);
+        for (int32_t _i = 0; _i < SS_Z_LEN; _i++) {
+            const double _zf = double(fOutput(C, _xf, _i));
+            const double _zq = double(fOutput(C, _xq, _i));
+            _maxDevZ = (fabs(_zf - _zq) > _maxDevZ) ? fabs(_zf - _zq) : _maxDevZ;
+            _sumSquareErrF += (_zf - double(_spNow[_i])) * (_zf - double(_spNow[_i]));
+            _sumSquareErrQ += (_zq - double(_spNow[_i])) * (_zq - double(_spNow[_i]));
+        }
+    }
+    printf("closed loop      : %lld steps, max |u float - u fixed| %.3e, max |z float - z fixed| %.3e\n",
+           (long long) _steps, _maxDevU, _maxDevZ);
+    printf("rms tracking err : float %.6f, fixed %.6f\n", sqrt(_sumSquareErrF / double(_steps * SS_Z_LEN)),
+           sqrt(_sumSquareErrQ / double(_steps * SS_Z_LEN)));
+    printf("saturation       : %lu\n", (unsigned long) MPC_SIM.u32GetFixedSaturation());
+
+    if ((_maxError >= 0) && ((_worst / double(_range[2])) > _maxError)) {
+        printf("budget           : FAIL, %.3e > %.3e\n", _worst / double(_range[2]), _maxError);
+        return 1;
+    }
+    return 0;
+}
+
+
+void SPEW_THE_ERROR(char const * str)
+{
+    fprintf(stderr, "%s\n", str);
+    exit(1);
+}
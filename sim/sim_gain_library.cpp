@@ -0,0 +1,283 @@
+/**************************************************************************************************
+ * Host gain library tool for the run-time dimensioned MPC (mpc_runtime_engl, see gain_library.h):
+ *
+ *      sim_gain_library [--models N] [--cache K] [--hot H] [--requests R] [--file name]
+ *
+ *  It makes N plant configurations (the jet example with a per-model perturbation of A & B, and
+ *  Hp of 7, 10 or 12), runs vReInit() for each and writes their snapshots as one library file. Then
+ *  it opens the library with K cache slots and serves R requests (pGet() + bUpdate()); 95% of them
+ *  go to H hot models, the rest to any model. It prints the hit rate and the request latency after
+ *  the warm-up (the first K requests), which should not change with N as long as H <= K.
+ *
+ *  Every model's update is also checked against its vReInit() controller: the tool returns 1 if
+ *  they're not bit-identical.
+ *
+ * See https://github.com/pronenewbits for more!
+ *************************************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <vector>
+#include <algorithm>
+#include "konfig.h"
+#include "matrix.h"
+#include "mpc.h"
+#include "gain_library.h"
+
+#define SIM_X_LEN       (4)
+#define SIM_U_LEN       (2)
+#define SIM_Z_LEN       (2)
+#define SIM_HP_MAX      (12)
+#define SIM_HU_LEN      (4)
+#define SIM_ARENA_LEN   (16384)
+
+
+static double f64WallSecond(void)
+{
+    struct timespec _ts;
+    clock_gettime(CLOCK_MONOTONIC, &_ts);
+    return double(_ts.tv_sec) + (double(_ts.tv_nsec) * 1e-9);
+}
+
+/* xorshift64*, for the perturbation & the request stream */
+static uint64_t u64Random(uint64_t &_state)
+{
+    _state ^= _state >> 12;
+    _state ^= _state << 25;
+    _state ^= _state >> 27;
+    return _state * 0x2545F4914F6CDD1DULL;
+}
+
+/* A sparse, unordered model ID for the n-th configuration */
+static uint64_t u64ModelId(const uint32_t _n)
+{
+    return (uint64_t(_n) * 0x9E3779B97F4A7C15ULL) ^ 0x5A17ULL;
+}
+
+static int32_t i32ModelHp(const uint32_t _n)
+{
+    static const int32_t _hp[3] = {7, 10, 12};
+    return _hp[_n % 3];
+}
+
+/* The n-th configuration: the jet example with A & B perturbed by up to +-5% */
+static void vModelPlant(const uint32_t _n, float_prec * _a, float_prec * _b)
+{
+    static const float_prec f32A[SIM_X_LEN*SIM_X_LEN] = {
+        -0.0558, -0.9968,  0.0802, 0.0415,
+         0.5980, -0.1150, -0.0318, 0.0000,
+        -3.0500,  0.3880, -0.4650, 0.0000,
+         0.0000,  0.0805,  1.0000, 0.0000
+    };
+    static const float_prec f32B[SIM_X_LEN*SIM_U_LEN] = {
+         0.0073, 0.0000,
+        -0.4750, 0.0077,
+         0.1530, 0.1430,
+         0.0000, 0.0000
+    };
+    uint64_t _state = u64ModelId(_n) | 1;
+    for (int32_t _i = 0; _i < (SIM_X_LEN*SIM_X_LEN); _i++) {
+        _a[_i] = f32A[_i] * float_prec(1.0 + 0.1 * ((double(u64Random(_state) >> 11) / 9007199254740992.0) - 0.5));
+    }
+    for (int32_t _i = 0; _i < (SIM_X_LEN*SIM_U_LEN); _i++) {
+        _b[_i] = f32B[_i] * float_prec(1.0 + 0.1 * ((double(u64Random(_state) >> 11) / 9007199254740992.0) - 0.5));
+    }
+}
+
+/* One request: the set-point & state of the fleet member, the answer is u */
+static void vRequestInput(const uint64_t _k, const int32_t _hp, Matrix &SP, Matrix &x)
+{
+    for (int32_t _i = 0; _i < _hp; _i++) {
+        SP[_i*SIM_Z_LEN + 0][0] = (((_k + _i) % 300) < 200) ? float_prec(3.14/2.) : float_prec(3.14);
+        SP[_i*SIM_Z_LEN + 1][0] = (((_k + _i) % 300) < 100) ? float_prec(1) : float_prec(-3);
+    }
+    for (int32_t _i = 0; _i < SIM_X_LEN; _i++) {
+        x[_i][0] = float_prec(0.01) * float_prec(int32_t((_k + _i) % 64) - 32);
+    }
+}
+
+int main(int argc, char ** argv)
+{
+    const char * _fileName = "mpc_fleet.mpcl";
+    uint32_t _models = 4096;
+    int32_t _cache = 256;
+    uint32_t _hot = 200;
+    uint64_t _requests = 1000000;
+    for (int _i = 1; _i < argc; _i++) {
+        if ((strcmp(argv[_i], "--models") == 0) && (_i+1 < argc)) {
+            _models = uint32_t(strtoul(argv[++_i], NULL, 10));
+        } else if ((strcmp(argv[_i], "--cache") == 0) && (_i+1 < argc)) {
+            _cache = int32_t(strtol(argv[++_i], NULL, 10));
+        } else if ((strcmp(argv[_i], "--hot") == 0) && (_i+1 < argc)) {
+            _hot = uint32_t(strtoul(argv[++_i], NULL, 10));
+        } else if ((strcmp(argv[_i], "--requests") == 0) && (_i+1 < argc)) {
+            _requests = strtoull(argv[++_i], NULL, 10);
+        } else if ((strcmp(argv[_i], "--file") == 0) && (_i+1 < argc)) {
+            _fileName = argv[++_i];
+        } else {
+            fprintf(stderr, "usage: %s [--models N] [--cache K] [--hot H] [--requests R] [--file name]\n", argv[0]);
+            return 2;
+        }
+    }
+    if ((_models == 0) || (_cache <= 0) || (_hot == 0) || (_hot > _models)) {
+        fprintf(stderr, "Need models > 0, cache > 0 and 0 < hot <= models\n");
+        return 2;
+    }
+
+    /* Offline: vReInit() every configuration and collect the snapshots */
+    static uint8_t u8Arena[SIM_ARENA_LEN];
+    float_prec f32A[SIM_X_LEN*SIM_X_LEN];
+    float_prec f32B[SIM_X_LEN*SIM_U_LEN];
+    float_prec f32C[SIM_Z_LEN*SIM_X_LEN] = {
+         0.0000, 1.0000, 0.0000, 0.0000,
+         0.0000, 0.0000, 0.0000, 1.0000
+    };
+    Matrix A(SIM_X_LEN, SIM_X_LEN, f32A);
+    Matrix B(SIM_X_LEN, SIM_U_LEN, f32B);
+    Matrix C(SIM_Z_LEN, SIM_X_LEN, f32C);
+
+    std::vector<std::vector<uint8_t> > _snapshot(_models);
+    std::vector<const void *> _snapshotPtr(_models);
+    std::vector<size_t> _snapshotBytes(_models);
+    std::vector<uint64_t> _modelId(_models);
+    MPC _mpc;
+    double _t = f64WallSecond();
+    for (uint32_t _n = 0; _n < _models; _n++) {
+        const int32_t _hp = i32ModelHp(_n);
+        vModelPlant(_n, f32A, f32B);
+        if (!_mpc.bInit(SIM_X_LEN, SIM_U_LEN, SIM_Z_LEN, _hp, SIM_HU_LEN, u8Arena, sizeof(u8Arena))) {
+            fprintf(stderr, "bInit() failed\n");
+            return 1;
+        }
+        _mpc.vReInit(A, B, C, 10.0, 0.03);
+        _snapshot[_n].resize(MPC::snapshotBytes(SIM_X_LEN, SIM_U_LEN, SIM_Z_LEN, _hp, SIM_HU_LEN));
+        if (!_mpc.bSaveSnapshot(&_snapshot[_n][0], _snapshot[_n].size())) {
+            fprintf(stderr, "bSaveSnapshot() failed for model %lu\n", (unsigned long) _n);
+            return 1;
+        }
+        _snapshotPtr[_n]   = &_snapshot[_n][0];
+        _snapshotBytes[_n] = _snapshot[_n].size();
+        _modelId[_n]       = u64ModelId(_n);
+    }
+    const double _tReInit = f64WallSecond() - _t;
+    if (!GainLibrary::bWrite(_fileName, &_modelId[0], &_snapshotPtr[0], &_snapshotBytes[0], _models)) {
+        fprintf(stderr, "Can't write '%s'\n", _fileName);
+        return 2;
+    }
+
+    static GainLibrary LIB;
+    _t = f64WallSecond();
+    if (!LIB.bOpen(_fileName, _cache)) {
+        fprintf(stderr, "Can't open '%s'\n", _fileName);
+        return 2;
+    }
+    const double _tOpen = f64WallSecond() - _t;
+
+    float_prec f32Io[2][(SIM_HP_MAX*SIM_Z_LEN) + SIM_X_LEN + SIM_U_LEN];
+    memset(f32Io, 0, sizeof(f32Io));
+
+    /* Check every model against its vReInit() controller (this also pages in the whole library) */
+    int64_t _mismatch = -1;
+    for (uint32_t _n = 0; (_n < _models) && (_mismatch < 0); _n++) {
+        const int32_t _hp = i32ModelHp(_n);
+        Matrix SP0((_hp*SIM_Z_LEN), 1, &f32Io[0][0]);
+        Matrix x0(SIM_X_LEN, 1, &f32Io[0][(SIM_HP_MAX*SIM_Z_LEN)]);
+        Matrix u0(SIM_U_LEN, 1, &f32Io[0][(SIM_HP_MAX*SIM_Z_LEN) + SIM_X_LEN]);
+        Matrix SP1((_hp*SIM_Z_LEN), 1, &f32Io[1][0]);
+        Matrix x1(SIM_X_LEN, 1, &f32Io[1][(SIM_HP_MAX*SIM_Z_LEN)]);
+        Matrix u1(SIM_U_LEN, 1, &f32Io[1][(SIM_HP_MAX*SIM_Z_LEN) + SIM_X_LEN]);
+
+        vModelPlant(_n, f32A, f32B);
+        _mpc.bInit(SIM_X_LEN, SIM_U_LEN, SIM_Z_LEN, _hp, SIM_HU_LEN, u8Arena, sizeof(u8Arena));
+        _mpc.vReInit(A, B, C, 10.0, 0.03);
+        MPC * _lib = LIB.pGet(u64ModelId(_n));
+        vRequestInput(_n, _hp, SP0, x0);
+        vRequestInput(_n, _hp, SP1, x1);
+        if ((_lib == NULL) || !_mpc.bUpdate(SP0, x0, u0) || !_lib->bUpdate(SP1, x1, u1) ||
+            (memcmp(f32Io[0], f32Io[1], sizeof(f32Io[0])) != 0))
+        {
+            _mismatch = _n;
+        }
+    }
+    if (_mismatch >= 0) {
+        printf("check            : MISMATCH at model %lld\n", (long long) _mismatch);
+        return 1;
+    }
+    if (LIB.pGet(u64ModelId(_models) + 1) != NULL) {
+        printf("check            : unknown model ID was found\n");
+        return 1;
+    }
+
+    /* The request stream: the hot models are spread over the whole library */
+    std::vector<uint32_t> _hotModel(_hot);
+    uint64_t _state = 0x1234567ULL;
+    for (uint32_t _i = 0; _i < _hot; _i++) {
+        _hotModel[_i] = uint32_t(u64Random(_state) % _models);
+    }
+    LIB.vClose();
+    if (!LIB.bOpen(_fileName, _cache)) {
+        fprintf(stderr, "Can't open '%s'\n", _fileName);
+        return 2;
+    }
+    std::vector<float> _latency;
+    _latency.reserve(size_t(_requests));
+    uint64_t _warmMiss = 0;
+    volatile float_prec _sink = 0;
+    const double _tRun = f64WallSecond();
+    for (uint64_t _k = 0; _k < _requests; _k++) {
+        const uint64_t _r = u64Random(_state);
+        const uint32_t _n = ((_r % 100) < 95) ? _hotModel[(_r >> 8) % _hot] : uint32_t((_r >> 8) % _models);
+        const int32_t _hp = i32ModelHp(_n);
+        Matrix SP((_hp*SIM_Z_LEN), 1, &f32Io[0][0]);
+        Matrix x(SIM_X_LEN, 1, &f32Io[0][(SIM_HP_MAX*SIM_Z_LEN)]);
+        Matrix u(SIM_U_LEN, 1, &f32Io[0][(SIM_HP_MAX*SIM_Z_LEN) + SIM_X_LEN]);
+        vRequestInput(_k, _hp, SP, x);
+
+        const uint64_t _missBefore = LIB.u64GetMiss();
+        const double _t0 = f64WallSecond();
+        MPC * _lib = LIB.pGet(u64ModelId(_n));
+        _lib->bUpdate(SP, x, u);
+        const double _t1 = f64WallSecond();
+        _sink = u[0][0];
+        if (_k == uint64_t(_cache)) {
+            _warmMiss = _missBefore;
+        }
+        if ((_k >= uint64_t(_cache)) && (LIB.u64GetMiss() == _missBefore)) {
+            _latency.push_back(float(_t1 - _t0));
+        }
+    }
+    const double _tTotal = f64WallSecond() - _tRun;
+    (void) _sink;
+
+    std::sort(_latency.begin(), _latency.end());
+    double _mean = 0;
+    for (size_t _i = 0; _i < _latency.size(); _i++) {
+        _mean += _latency[_i];
+    }
+    _mean = _latency.empty() ? 0 : (_mean / double(_latency.size()));
+    const uint64_t _lookups = LIB.u64GetHit() + LIB.u64GetMiss();
+
+    printf("variant          : mpc_runtime_engl (%s)\n", (FPU_PRECISION == PRECISION_SINGLE) ? "float" : "double");
+    printf("library          : %s, %lu models, all vReInit() in %.1f ms\n", _fileName, (unsigned long) LIB.u32GetLen(), _tReInit * 1e3);
+    printf("bOpen            : %.1f us, %ld cache slots\n", _tOpen * 1e6, (long) _cache);
+    printf("check            : %lu models bit-identical to vReInit()\n", (unsigned long) _models);
+    printf("requests         : %llu (%.0f /s), %lu hot models\n", (unsigned long long) _requests, double(_requests) / _tTotal,
+           (unsigned long) _hot);
+    printf("cache            : hit %.2f%%, %llu miss (%llu in the warm-up), %llu evict\n",
+           (_lookups == 0) ? 0.0 : (100.0 * double(LIB.u64GetHit()) / double(_lookups)),
+           (unsigned long long) LIB.u64GetMiss(), (unsigned long long) _warmMiss, (unsigned long long) LIB.u64GetEvict());
+    if (!_latency.empty()) {
+        printf("hit latency (ns) : mean %.0f, p50 %.0f, p99 %.0f, max %.0f\n", _mean * 1e9,
+               double(_latency[_latency.size() / 2]) * 1e9, double(_latency[(_latency.size() * 99) / 100]) * 1e9,
+               double(_latency.back()) * 1e9);
+    }
+    return 0;
+}
+
+
+void SPEW_THE_ERROR(char const * str)
+{
+    fprintf(stderr, "%s\n", str);
+    exit(1);
+}
@@ -0,0 +1,118 @@
+/**************************************************************************************************
+ * Host closed-loop simulator (see closed_loop.h), by default the jet transport example of the
+ *  *.ino sketch, running as fast as the MPC update allows:
+ *
+ *      sim_mpc_opt_engl [--steps N] [--plant file] [--schedule file] [--q Q] [--r R] [--trace file]
+ *
+ *  It prints the number of steps per second and the tracking error (RMS & max of each output), that
+ *  can be compared between two versions of the controller. The MPC model is the same as the plant.
+ *
+ * See https://github.com/pronenewbits for more!
+ *************************************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "closed_loop.h"
+
+#ifndef SIM_VARIANT_NAME
+    #define SIM_VARIANT_NAME    "mpc"
+#endif
+
+
+static void vUsage(const char * _name)
+{
+    fprintf(stderr, "usage: %s [--steps N] [--plant file] [--schedule file] [--q Q] [--r R] [--trace file]\n", _name);
+}
+
+int main(int argc, char ** argv)
+{
+    int64_t _steps = 1000000;
+    const char * _plantFile = NULL;
+    const char * _scheduleFile = NULL;
+    const char * _traceFile = NULL;
+    double _bobotQ = 10.0;
+    double _bobotR = 0.03;
+    for (int _i = 1; _i < argc; _i++) {
+        if ((strcmp(argv[_i], "--steps") == 0) && (_i+1 < argc)) {
+            _steps = strtoll(argv[++_i], NULL, 10);
+        } else if ((strcmp(argv[_i], "--plant") == 0) && (_i+1 < argc)) {
+            _plantFile = argv[++_i];
+        } else if ((strcmp(argv[_i], "--schedule") == 0) && (_i+1 < argc)) {
+            _scheduleFile = argv[++_i];
+        } else if ((strcmp(argv[_i], "--q") == 0) && (_i+1 < argc)) {
+            _bobotQ = atof(argv[++_i]);
+        } else if ((strcmp(argv[_i], "--r") == 0) && (_i+1 < argc)) {
+            _bobotR = atof(argv[++_i]);
+        } else if ((strcmp(argv[_i], "--trace") == 0) && (_i+1 < argc)) {
+            _traceFile = argv[++_i];
+        } else {
+            vUsage(argv[0]);
+            return 2;
+        }
+    }
+
+    static Matrix A(SS_X_LEN, SS_X_LEN);
+    static Matrix B(SS_X_LEN, SS_U_LEN);
+    static Matrix C(SS_Z_LEN, SS_X_LEN);
+    if (_plantFile != NULL) {
+        if (!bSimLoadPlant(_plantFile, A, B, C)) {
+            fprintf(stderr, "Can't read the plant file '%s' (A, B, C of %dx%d, %dx%d, %dx%d)\n", _plantFile,
+                    SS_X_LEN, SS_X_LEN, SS_X_LEN, SS_U_LEN, SS_Z_LEN, SS_X_LEN);
+            return 2;
+        }
+    } else if (!bSimJetPlant(A, B, C)) {
+        fprintf(stderr, "The jet example needs X=4, U=2, Z=2; use --plant for this dimension\n");
+        return 2;
+    }
+
+    static SimSchedule SCHEDULE;
+    if ((_scheduleFile != NULL) && !SCHEDULE.bLoad(_scheduleFile)) {
+        fprintf(stderr, "Can't read the set-point schedule file '%s'\n", _scheduleFile);
+        return 2;
+    }
+
+    static SimTrace TRACE;
+    if ((_traceFile != NULL) && !TRACE.bOpen(_traceFile)) {
+        fprintf(stderr, "Can't open the trace file '%s'\n", _traceFile);
+        return 2;
+    }
+
+    static MPC MPC_SIM(A, B, C, float_prec(_bobotQ), float_prec(_bobotR));
+    static SimClosedLoop LOOP(MPC_SIM, A, B, C, SCHEDULE);
+
+    const double _tStart = f64SimWallSecond();
+    if (TRACE.bIsOpen()) {
+        for (int64_t _k = 0; _k < _steps; _k++) {
+            LOOP.vStep(TRACE.pNext());
+            TRACE.vCommit();
+        }
+    } else {
+        for (int64_t _k = 0; _k < _steps; _k++) {
+            LOOP.vStep(NULL);
+        }
+    }
+    const double _tElapsed = f64SimWallSecond() - _tStart;
+
+    if (!TRACE.bClose()) {
+        fprintf(stderr, "Can't write the trace file '%s'\n", _traceFile);
+        return 2;
+    }
+
+    printf("variant          : %s (%s)\n", SIM_VARIANT_NAME, (FPU_PRECISION == PRECISION_SINGLE) ? "float" : "double");
+    printf("steps            : %lld\n", (long long) _steps);
+    printf("wall time        : %.3f s\n", _tElapsed);
+    printf("steps/second     : %.0f\n", (_tElapsed > 0) ? (double(_steps) / _tElapsed) : 0.0);
+    printf("ns/step          : %.1f\n", (_steps > 0) ? (_tElapsed * 1e9 / double(_steps)) : 0.0);
+    printf("update fail      : %llu\n", (unsigned long long) LOOP.u64GetUpdateFail());
+    for (int32_t _i = 0; _i < SS_Z_LEN; _i++) {
+        printf("z[%d] error       : rms %.6e, max %.6e\n", int(_i), LOOP.f64GetRmsErr(_i), LOOP.f64GetMaxAbsErr(_i));
+    }
+    return ((LOOP.u64GetUpdateFail() == 0) && LOOP.bIsFinite()) ? 0 : 1;
+}
+
+
+void SPEW_THE_ERROR(char const * str)
+{
+    fprintf(stderr, "%s\n", str);
+    exit(1);
+}
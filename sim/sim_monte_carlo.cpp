@@ -0,0 +1,364 @@
+/**************************************************************************************************
+ * Host Monte Carlo robustness check (see closed_loop.h): the MPC is built from the nominal A, B, C,
+ *  and every trial runs the closed loop against a perturbed copy of the plant:
+ *
+ *      A_p[i][j] = A[i][j] * (1 + sigmaA*N(0,1)),  B_p[i][j] = B[i][j] * (1 + sigmaB*N(0,1))
+ *
+ *  (relative perturbation, so the structural zeros of the model stay zero).
+ *
+ *      sim_monte_carlo_mpc_opt_engl [--trials N] [--steps N] [--threads T] [--seed S]
+ *                                   [--sigma-a s] [--sigma-b s] [--diverge e]
+ *                                   [--plant file] [--schedule file] [--q Q] [--r R]
+ *
+ *  The trials are split in contiguous blocks over the threads. Trial n draws its perturbation from
+ *  its own random stream (seeded from (seed, n)), so a trial is the same whatever thread runs it.
+ *  Each thread keeps streaming statistics (Welford mean/variance, min, max) of the per-trial RMS
+ *  tracking error, no trajectory is stored; the threads' statistics are merged in thread order at
+ *  the end. A trial diverges when its state isn't finite or its RMS error is above --diverge.
+ *
+ * See https://github.com/pronenewbits for more!
+ *************************************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <thread>
+#include <vector>
+#include "closed_loop.h"
+
+#ifndef SIM_VARIANT_NAME
+    #define SIM_VARIANT_NAME    "mpc"
+#endif
+
+
+/* splitmix64, used to seed the per-trial stream */
+static inline uint64_t u64SplitMix(uint64_t &_state)
+{
+    uint64_t _z = (_state += 0x9E3779B97F4A7C15ULL);
+    _z = (_z ^ (_z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    _z = (_z ^ (_z >> 27)) * 0x94D049BB133111EBULL;
+    return _z ^ (_z >> 31);
+}
+
+/* xoshiro256** random stream with a N(0,1) (Box-Muller) */
+class McRandom
+{
+public:
+    McRandom(const uint64_t _seed, const uint64_t _stream) {
+        uint64_t _sm = _seed ^ (0xD1B54A32D192ED03ULL * (_stream + 1));
+        for (int32_t _i = 0; _i < 4; _i++) {
+            u64s[_i] = u64SplitMix(_sm);
+        }
+        bHaveSpare = false;
+    }
+
+    uint64_t u64Next() {
+        const uint64_t _result = u64Rotl(u64s[1] * 5, 7) * 9;
+        const uint64_t _t = u64s[1] << 17;
+        u64s[2] ^= u64s[0];
+        u64s[3] ^= u64s[1];
+        u64s[1] ^= u64s[2];
+        u64s[0] ^= u64s[3];
+        u64s[2] ^= _t;
+        u64s[3] = u64Rotl(u64s[3], 45);
+        return _result;
+    }
+
+    /* Uniform in (0, 1] */
+    double f64Uniform() { return (double(u64Next() >> 11) + 1.0) * (1.0 / 9007199254740992.0); }
+
+    double f64Gaussian() {
+        if (bHaveSpare) {
+            bHaveSpare = false;
+            return f64spare;
+        }
+        const double _r  = sqrt(-2.0 * log(f64Uniform()));
+        const double _th = 6.283185307179586 * f64Uniform();
+        f64spare = _r * sin(_th);
+        bHaveSpare = true;
+        return _r * cos(_th);
+    }
+
+private:
+    static inline uint64_t u64Rotl(const uint64_t _x, const int _k) { return (_x << _k) | (_x >> (64 - _k)); }
+
+    uint64_t u64s[4];
+    double f64spare;
+    bool bHaveSpare;
+};
+
+
+/* Streaming statistic (Welford), mergeable (Chan et al.) */
+typedef struct {
+    uint64_t u64n;
+    double f64mean;
+    double f64m2;
+    double f64min;
+    double f64max;
+} McStat;
+
+static void vMcStatReset(McStat &_stat)
+{
+    _stat.u64n = 0;
+    _stat.f64mean = 0;
+    _stat.f64m2 = 0;
+    _stat.f64min = INFINITY;
+    _stat.f64max = -INFINITY;
+}
+
+static void vMcStatAdd(McStat &_stat, const double _val)
+{
+    _stat.u64n++;
+    const double _delta = _val - _stat.f64mean;
+    _stat.f64mean += _delta / double(_stat.u64n);
+    _stat.f64m2   += _delta * (_val - _stat.f64mean);
+    if (_val < _stat.f64min) {
+        _stat.f64min = _val;
+    }
+    if (_val > _stat.f64max) {
+        _stat.f64max = _val;
+    }
+}
+
+static void vMcStatMerge(McStat &_stat, const McStat &_other)
+{
+    if (_other.u64n == 0) {
+        return;
+    }
+    const double _n  = double(_stat.u64n + _other.u64n);
+    const double _delta = _other.f64mean - _stat.f64mean;
+    _stat.f64mean += _delta * double(_other.u64n) / _n;
+    _stat.f64m2   += _other.f64m2 + (_delta * _delta * double(_stat.u64n) * double(_other.u64n) / _n);
+    _stat.u64n    += _other.u64n;
+    if (_other.f64min < _stat.f64min) {
+        _stat.f64min = _other.f64min;
+    }
+    if (_other.f64max > _stat.f64max) {
+        _stat.f64max = _other.f64max;
+    }
+}
+
+static double f64McStatStd(const McStat &_stat)
+{
+    return (_stat.u64n > 1) ? sqrt(_stat.f64m2 / double(_stat.u64n - 1)) : 0;
+}
+
+
+typedef struct {
+    McStat rmsErr[SS_Z_LEN];        /* Per-trial RMS tracking error of each output (converged trials) */
+    McStat maxErr[SS_Z_LEN];        /* Per-trial max |tracking error| of each output (converged trials) */
+    uint64_t u64diverged;
+    uint64_t u64updateFail;         /* Trials with at least one failed bUpdate */
+} McResult;
+
+typedef struct {
+    int64_t i64trialBegin;
+    int64_t i64trialEnd;
+    int64_t i64steps;
+    uint64_t u64seed;
+    double f64sigmaA;
+    double f64sigmaB;
+    double f64diverge;
+    float_prec fBobotQ;
+    float_prec fBobotR;
+    const Matrix * A;               /* Nominal model */
+    const Matrix * B;
+    const Matrix * C;
+    const SimSchedule * schedule;
+} McJob;
+
+
+static void vMcWorker(const McJob _job, McResult * _result)
+{
+    /* The Matrix objects are MATRIX_MAXIMUM_SIZE^2 each, keep them off the thread stack */
+    Matrix * A  = new Matrix(*_job.A);
+    Matrix * B  = new Matrix(*_job.B);
+    Matrix * C  = new Matrix(*_job.C);
+    Matrix * Ap = new Matrix(*_job.A);
+    Matrix * Bp = new Matrix(*_job.B);
+    MPC * mpc = new MPC(*A, *B, *C, _job.fBobotQ, _job.fBobotR);
+    SimClosedLoop * loop = new SimClosedLoop(*mpc, *Ap, *Bp, *C, *_job.schedule);
+
+    for (int32_t _i = 0; _i < SS_Z_LEN; _i++) {
+        vMcStatReset(_result->rmsErr[_i]);
+        vMcStatReset(_result->maxErr[_i]);
+    }
+    _result->u64diverged = 0;
+    _result->u64updateFail = 0;
+
+    for (int64_t _n = _job.i64trialBegin; _n < _job.i64trialEnd; _n++) {
+        McRandom _rng(_job.u64seed, uint64_t(_n));
+        for (int32_t _i = 0; _i < SS_X_LEN; _i++) {
+            for (int32_t _j = 0; _j < SS_X_LEN; _j++) {
+                (*Ap)[_i][_j] = (*A)[_i][_j] * float_prec(1.0 + (_job.f64sigmaA * _rng.f64Gaussian()));
+            }
+            for (int32_t _j = 0; _j < SS_U_LEN; _j++) {
+                (*Bp)[_i][_j] = (*B)[_i][_j] * float_prec(1.0 + (_job.f64sigmaB * _rng.f64Gaussian()));
+            }
+        }
+
+        loop->vReset();
+        for (int64_t _k = 0; _k < _job.i64steps; _k++) {
+            loop->vStep(NULL);
+        }
+
+        if (loop->u64GetUpdateFail() > 0) {
+            _result->u64updateFail++;
+        }
+        bool _diverged = !loop->bIsFinite();
+        for (int32_t _i = 0; (_i < SS_Z_LEN) && !_diverged; _i++) {
+            _diverged = !(loop->f64GetRmsErr(_i) <= _job.f64diverge);
+        }
+        if (_diverged) {
+            _result->u64diverged++;
+            continue;
+        }
+        for (int32_t _i = 0; _i < SS_Z_LEN; _i++) {
+            vMcStatAdd(_result->rmsErr[_i], loop->f64GetRmsErr(_i));
+            vMcStatAdd(_result->maxErr[_i], loop->f64GetMaxAbsErr(_i));
+        }
+    }
+
+    delete loop;
+    delete mpc;
+    delete Bp;
+    delete Ap;
+    delete C;
+    delete B;
+    delete A;
+}
+
+
+static void vUsage(const char * _name)
+{
+    fprintf(stderr, "usage: %s [--trials N] [--steps N] [--threads T] [--seed S] [--sigma-a s] [--sigma-b s]\n"
+                    "       [--diverge e] [--plant file] [--schedule file] [--q Q] [--r R]\n", _name);
+}
+
+int main(int argc, char ** argv)
+{
+    int64_t _trials = 1000;
+    int64_t _steps = 3000;
+    int32_t _threads = int32_t(std::thread::hardware_concurrency());
+    uint64_t _seed = 1;
+    double _sigmaA = 0.05;
+    double _sigmaB = 0.05;
+    double _diverge = 1e3;
+    const char * _plantFile = NULL;
+    const char * _scheduleFile = NULL;
+    double _bobotQ = 10.0;
+    double _bobotR = 0.03;
+    for (int _i = 1; _i < argc; _i++) {
+        if ((strcmp(argv[_i], "--trials") == 0) && (_i+1 < argc)) {
+            _trials = strtoll(argv[++_i], NULL, 10);
+        } else if ((strcmp(argv[_i], "--steps") == 0) && (_i+1 < argc)) {
+            _steps = strtoll(argv[++_i], NULL, 10);
+        } else if ((strcmp(argv[_i], "--threads") == 0) && (_i+1 < argc)) {
+            _threads = int32_t(atoi(argv[++_i]));
+        } else if ((strcmp(argv[_i], "--seed") == 0) && (_i+1 < argc)) {
+            _seed = strtoull(argv[++_i], NULL, 10);
+        } else if ((strcmp(argv[_i], "--sigma-a") == 0) && (_i+1 < argc)) {
+            _sigmaA = atof(argv[++_i]);
+        } else if ((strcmp(argv[_i], "--sigma-b") == 0) && (_i+1 < argc)) {
+            _sigmaB = atof(argv[++_i]);
+        } else if ((strcmp(argv[_i], "--diverge") == 0) && (_i+1 < argc)) {
+            _diverge = atof(argv[++_i]);
+        } else if ((strcmp(argv[_i], "--plant") == 0) && (_i+1 < argc)) {
+            _plantFile = argv[++_i];
+        } else if ((strcmp(argv[_i], "--schedule") == 0) && (_i+1 < argc)) {
+            _scheduleFile = argv[++_i];
+        } else if ((strcmp(argv[_i], "--q") == 0) && (_i+1 < argc)) {
+            _bobotQ = atof(argv[++_i]);
+        } else if ((strcmp(argv[_i], "--r") == 0) && (_i+1 < argc)) {
+            _bobotR = atof(argv[++_i]);
+        } else {
+            vUsage(argv[0]);
+            return 2;
+        }
+    }
+    if (_threads < 1) {
+        _threads = 1;
+    }
+    if (_trials < _threads) {
+        _threads = int32_t((_trials > 0) ? _trials : 1);
+    }
+
+    static Matrix A(SS_X_LEN, SS_X_LEN);
+    static Matrix B(SS_X_LEN, SS_U_LEN);
+    static Matrix C(SS_Z_LEN, SS_X_LEN);
+    if (_plantFile != NULL) {
+        if (!bSimLoadPlant(_plantFile, A, B, C)) {
+            fprintf(stderr, "Can't read the plant file '%s' (A, B, C of %dx%d, %dx%d, %dx%d)\n", _plantFile,
+                    SS_X_LEN, SS_X_LEN, SS_X_LEN, SS_U_LEN, SS_Z_LEN, SS_X_LEN);
+            return 2;
+        }
+    } else if (!bSimJetPlant(A, B, C)) {
+        fprintf(stderr, "The jet example needs X=4, U=2, Z=2; use --plant for this dimension\n");
+        return 2;
+    }
+
+    static SimSchedule SCHEDULE;
+    if ((_scheduleFile != NULL) && !SCHEDULE.bLoad(_scheduleFile)) {
+        fprintf(stderr, "Can't read the set-point schedule file '%s'\n", _scheduleFile);
+        return 2;
+    }
+
+    std::vector<McResult> _result;
+    _result.resize(size_t(_threads));
+    std::vector<std::thread> _worker;
+    const double _tStart = f64SimWallSecond();
+    for (int32_t _t = 0; _t < _threads; _t++) {
+        McJob _job;
+        _job.i64trialBegin = (_trials * _t) / _threads;
+        _job.i64trialEnd   = (_trials * (_t+1)) / _threads;
+        _job.i64steps      = _steps;
+        _job.u64seed       = _seed;
+        _job.f64sigmaA     = _sigmaA;
+        _job.f64sigmaB     = _sigmaB;
+        _job.f64diverge    = _diverge;
+        _job.fBobotQ       = float_prec(_bobotQ);
+        _job.fBobotR       = float_prec(_bobotR);
+        _job.A             = &A;
+        _job.B             = &B;
+        _job.C             = &C;
+        _job.schedule      = &SCHEDULE;
+        _worker.push_back(std::thread(vMcWorker, _job, &_result[size_t(_t)]));
+    }
+    for (size_t _t = 0; _t < _worker.size(); _t++) {
+        _worker[_t].join();
+    }
+    const double _tElapsed = f64SimWallSecond() - _tStart;
+
+    McResult _total = _result[0];
+    for (int32_t _t = 1; _t < _threads; _t++) {
+        for (int32_t _i = 0; _i < SS_Z_LEN; _i++) {
+            vMcStatMerge(_total.rmsErr[_i], _result[size_t(_t)].rmsErr[_i]);
+            vMcStatMerge(_total.maxErr[_i], _result[size_t(_t)].maxErr[_i]);
+        }
+        _total.u64diverged   += _result[size_t(_t)].u64diverged;
+        _total.u64updateFail += _result[size_t(_t)].u64updateFail;
+    }
+
+    printf("variant          : %s (%s)\n", SIM_VARIANT_NAME, (FPU_PRECISION == PRECISION_SINGLE) ? "float" : "double");
+    printf("trials           : %lld x %lld steps, sigma A %g, sigma B %g, seed %llu\n", (long long) _trials,
+           (long long) _steps, _sigmaA, _sigmaB, (unsigned long long) _seed);
+    printf("threads          : %d\n", int(_threads));
+    printf("wall time        : %.3f s\n", _tElapsed);
+    printf("trials/second    : %.1f\n", (_tElapsed > 0) ? (double(_trials) / _tElapsed) : 0.0);
+    printf("steps/second     : %.0f\n", (_tElapsed > 0) ? (double(_trials) * double(_steps) / _tElapsed) : 0.0);
+    printf("diverged         : %llu\n", (unsigned long long) _total.u64diverged);
+    printf("update fail      : %llu\n", (unsigned long long) _total.u64updateFail);
+    for (int32_t _i = 0; _i < SS_Z_LEN; _i++) {
+        printf("z[%d] rms error   : mean %.6e, std %.6e, min %.6e, max %.6e\n", int(_i), _total.rmsErr[_i].f64mean,
+               f64McStatStd(_total.rmsErr[_i]), _total.rmsErr[_i].f64min, _total.rmsErr[_i].f64max);
+        printf("z[%d] max error   : mean %.6e, std %.6e, min %.6e, max %.6e\n", int(_i), _total.maxErr[_i].f64mean,
+               f64McStatStd(_total.maxErr[_i]), _total.maxErr[_i].f64min, _total.maxErr[_i].f64max);
+    }
+    return ((_total.u64diverged == 0) && (_total.u64updateFail == 0)) ? 0 : 1;
+}
+
+
+void SPEW_THE_ERROR(char const * str)
+{
+    fprintf(stderr, "%s\n", str);
+    exit(1);
+}
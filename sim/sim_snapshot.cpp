@@ -0,0 +1,163 @@
+/**************************************************************************************************
+ * Host snapshot tool (see snapshot.h), for the fixed dimension implementations:
+ *
+ *      sim_snapshot_mpc_opt_engl [--out file] [--c-array file] [--steps N] [--q Q] [--r R] [--plant file]
+ *
+ *  It initializes the MPC with vReInit(), writes its snapshot to a file (and optionally as a C array
+ *  to put in flash), then starts a second MPC from the file (mmap-ed on Linux) with bLoadSnapshot()
+ *  and runs both in the closed loop. It returns 1 if the two trajectories are not bit-identical.
+ *
+ * See https://github.com/pronenewbits for more!
+ *************************************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include "closed_loop.h"
+
+#ifndef SIM_VARIANT_NAME
+    #define SIM_VARIANT_NAME    "mpc"
+#endif
+
+
+static bool bWriteCArray(const char * _fileName, const uint8_t * _buf, const size_t _len)
+{
+    FILE * _file = fopen(_fileName, "w");
+    if (_file == NULL) {
+        return false;
+    }
+    fprintf(_file, "/* MPC snapshot (%s, %s), generated by sim_snapshot, see snapshot.h */\n", SIM_VARIANT_NAME,
+            (FPU_PRECISION == PRECISION_SINGLE) ? "float" : "double");
+    fprintf(_file, "alignas(%d) static const uint8_t MPC_SNAPSHOT[%lu] = {", MPC_SNAPSHOT_ALIGN, (unsigned long) _len);
+    for (size_t _i = 0; _i < _len; _i++) {
+        fprintf(_file, "%s0x%02X,", ((_i % 16) == 0) ? "\n    " : " ", _buf[_i]);
+    }
+    fprintf(_file, "\n};\n");
+    return (fclose(_file) == 0);
+}
+
+static void vUsage(const char * _name)
+{
+    fprintf(stderr, "usage: %s [--out file] [--c-array file] [--steps N] [--q Q] [--r R] [--plant file]\n", _name);
+}
+
+int main(int argc, char ** argv)
+{
+    const char * _outFile = "mpc.snap";
+    const char * _cArrayFile = NULL;
+    const char * _plantFile = NULL;
+    int64_t _steps = 30000;
+    double _bobotQ = 10.0;
+    double _bobotR = 0.03;
+    for (int _i = 1; _i < argc; _i++) {
+        if ((strcmp(argv[_i], "--out") == 0) && (_i+1 < argc)) {
+            _outFile = argv[++_i];
+        } else if ((strcmp(argv[_i], "--c-array") == 0) && (_i+1 < argc)) {
+            _cArrayFile = argv[++_i];
+        } else if ((strcmp(argv[_i], "--steps") == 0) && (_i+1 < argc)) {
+            _steps = strtoll(argv[++_i], NULL, 10);
+        } else if ((strcmp(argv[_i], "--q") == 0) && (_i+1 < argc)) {
+            _bobotQ = atof(argv[++_i]);
+        } else if ((strcmp(argv[_i], "--r") == 0) && (_i+1 < argc)) {
+            _bobotR = atof(argv[++_i]);
+        } else if ((strcmp(argv[_i], "--plant") == 0) && (_i+1 < argc)) {
+            _plantFile = argv[++_i];
+        } else {
+            vUsage(argv[0]);
+            return 2;
+        }
+    }
+
+    static Matrix A(SS_X_LEN, SS_X_LEN);
+    static Matrix B(SS_X_LEN, SS_U_LEN);
+    static Matrix C(SS_Z_LEN, SS_X_LEN);
+    if (_plantFile != NULL) {
+        if (!bSimLoadPlant(_plantFile, A, B, C)) {
+            fprintf(stderr, "Can't read the plant file '%s'\n", _plantFile);
+            return 2;
+        }
+    } else if (!bSimJetPlant(A, B, C)) {
+        fprintf(stderr, "The jet example needs X=4, U=2, Z=2; use --plant for this dimension\n");
+        return 2;
+    }
+
+    /* The reference: vReInit() */
+    static MPC MPC_REF;
+    double _t = f64SimWallSecond();
+    MPC_REF.vReInit(A, B, C, float_prec(_bobotQ), float_prec(_bobotR));
+    const double _tReInit = f64SimWallSecond() - _t;
+
+    std::vector<uint8_t> _buf(MPC::szSnapshotBytes());
+    if (!MPC_REF.bSaveSnapshot(&_buf[0], _buf.size())) {
+        fprintf(stderr, "bSaveSnapshot() failed (did vReInit() fail?)\n");
+        return 1;
+    }
+    FILE * _file = fopen(_outFile, "wb");
+    if ((_file == NULL) || (fwrite(&_buf[0], 1, _buf.size(), _file) != _buf.size()) || (fclose(_file) != 0)) {
+        fprintf(stderr, "Can't write '%s'\n", _outFile);
+        return 2;
+    }
+    if ((_cArrayFile != NULL) && !bWriteCArray(_cArrayFile, &_buf[0], _buf.size())) {
+        fprintf(stderr, "Can't write '%s'\n", _cArrayFile);
+        return 2;
+    }
+
+    /* The boot: bLoadSnapshot() from the file */
+    size_t _bytes = 0;
+#if defined(__linux__)
+    const void * _snapshot = pSnapshotMapFile(_outFile, _bytes);
+#else
+    std::vector<uint8_t> _fileBuf(_buf);
+    const void * _snapshot = &_fileBuf[0];
+    _bytes = _fileBuf.size();
+#endif
+    if (_snapshot == NULL) {
+        fprintf(stderr, "Can't map '%s'\n", _outFile);
+        return 2;
+    }
+    static MPC MPC_BOOT;
+    _t = f64SimWallSecond();
+    const bool _loaded = MPC_BOOT.bLoadSnapshot(_snapshot, _bytes);
+    const double _tLoad = f64SimWallSecond() - _t;
+#if defined(__linux__)
+    vSnapshotUnmapFile(_snapshot, _bytes);
+#endif
+    if (!_loaded) {
+        fprintf(stderr, "bLoadSnapshot() failed\n");
+        return 1;
+    }
+
+    /* Both in the closed loop, compare the records (SP, z, u) bit by bit */
+    static SimSchedule SCHEDULE;
+    static SimClosedLoop LOOP_REF(MPC_REF, A, B, C, SCHEDULE);
+    static SimClosedLoop LOOP_BOOT(MPC_BOOT, A, B, C, SCHEDULE);
+    float_prec _recRef[SIM_TRACE_RECORD_LEN];
+    float_prec _recBoot[SIM_TRACE_RECORD_LEN];
+    int64_t _mismatch = -1;
+    for (int64_t _k = 0; (_k < _steps) && (_mismatch < 0); _k++) {
+        LOOP_REF.vStep(_recRef);
+        LOOP_BOOT.vStep(_recBoot);
+        if (memcmp(_recRef, _recBoot, sizeof(_recRef)) != 0) {
+            _mismatch = _k;
+        }
+    }
+
+    printf("variant          : %s (%s)\n", SIM_VARIANT_NAME, (FPU_PRECISION == PRECISION_SINGLE) ? "float" : "double");
+    printf("snapshot         : %s, %lu bytes (CRC-32 0x%08lX)\n", _outFile, (unsigned long) _buf.size(),
+           (unsigned long) u32SnapshotGet32(&_buf[44]));
+    printf("vReInit          : %.1f us\n", _tReInit * 1e6);
+    printf("bLoadSnapshot    : %.1f us\n", _tLoad * 1e6);
+    if (_mismatch >= 0) {
+        printf("closed loop      : MISMATCH at step %lld\n", (long long) _mismatch);
+        return 1;
+    }
+    printf("closed loop      : %lld steps bit-identical\n", (long long) _steps);
+    return 0;
+}
+
+
+void SPEW_THE_ERROR(char const * str)
+{
+    fprintf(stderr, "%s\n", str);
+    exit(1);
+}
@@ -0,0 +1,173 @@
+/**************************************************************************************************
+ * Host snapshot tool for the run-time dimensioned MPC (mpc_runtime_engl, see snapshot.h):
+ *
+ *      sim_snapshot_runtime [--out file] [--steps N]
+ *
+ *  It initializes the jet example MPC with vReInit() in an arena, writes its snapshot to a file,
+ *  mmap-s the file (Linux) and starts a second MPC from it with bLoadSnapshot(): CPSI, COMEGA &
+ *  XI_DU are used in place from the mapping, the arena only holds dU. Then both run in the closed
+ *  loop and the tool returns 1 if the two trajectories are not bit-identical.
+ *
+ * See https://github.com/pronenewbits for more!
+ *************************************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <vector>
+#include "konfig.h"
+#include "matrix.h"
+#include "mpc.h"
+
+#define SIM_X_LEN   (4)
+#define SIM_U_LEN   (2)
+#define SIM_Z_LEN   (2)
+#define SIM_HP_LEN  (7)
+#define SIM_HU_LEN  (4)
+
+
+static double f64WallSecond(void)
+{
+    struct timespec _ts;
+    clock_gettime(CLOCK_MONOTONIC, &_ts);
+    return double(_ts.tv_sec) + (double(_ts.tv_nsec) * 1e-9);
+}
+
+/* The closed loop of the jet example: x = A*x + B*u (the set-point trajectory of the *.ino sketch) */
+static void vStep(MPC &_mpc, Matrix &A, Matrix &B, Matrix &SP, Matrix &x, Matrix &u, const int64_t _k)
+{
+    for (int32_t _i = 0; _i < SIM_HP_LEN; _i++) {
+        const int64_t _s = (_k + _i + 1) % 300;
+        SP[_i*SIM_Z_LEN + 0][0] = (_s < 200) ? float_prec(3.14/2.) : float_prec(3.14);
+        SP[_i*SIM_Z_LEN + 1][0] = (_s < 100) ? float_prec(1) : float_prec(-3);
+    }
+    _mpc.bUpdate(SP, x, u);
+
+    float_prec _xNext[SIM_X_LEN];
+    for (int32_t _i = 0; _i < SIM_X_LEN; _i++) {
+        _xNext[_i] = 0;
+        for (int32_t _j = 0; _j < SIM_X_LEN; _j++) {
+            _xNext[_i] += A[_i][_j] * x[_j][0];
+        }
+        for (int32_t _j = 0; _j < SIM_U_LEN; _j++) {
+            _xNext[_i] += B[_i][_j] * u[_j][0];
+        }
+    }
+    for (int32_t _i = 0; _i < SIM_X_LEN; _i++) {
+        x[_i][0] = _xNext[_i];
+    }
+}
+
+int main(int argc, char ** argv)
+{
+    const char * _outFile = "mpc_runtime.snap";
+    int64_t _steps = 30000;
+    for (int _i = 1; _i < argc; _i++) {
+        if ((strcmp(argv[_i], "--out") == 0) && (_i+1 < argc)) {
+            _outFile = argv[++_i];
+        } else if ((strcmp(argv[_i], "--steps") == 0) && (_i+1 < argc)) {
+            _steps = strtoll(argv[++_i], NULL, 10);
+        } else {
+            fprintf(stderr, "usage: %s [--out file] [--steps N]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    static float_prec f32A[SIM_X_LEN*SIM_X_LEN] = {
+        -0.0558, -0.9968,  0.0802, 0.0415,
+         0.5980, -0.1150, -0.0318, 0.0000,
+        -3.0500,  0.3880, -0.4650, 0.0000,
+         0.0000,  0.0805,  1.0000, 0.0000
+    };
+    static float_prec f32B[SIM_X_LEN*SIM_U_LEN] = {
+         0.0073, 0.0000,
+        -0.4750, 0.0077,
+         0.1530, 0.1430,
+         0.0000, 0.0000
+    };
+    static float_prec f32C[SIM_Z_LEN*SIM_X_LEN] = {
+         0.0000, 1.0000, 0.0000, 0.0000,
+         0.0000, 0.0000, 0.0000, 1.0000
+    };
+    Matrix A(SIM_X_LEN, SIM_X_LEN, f32A);
+    Matrix B(SIM_X_LEN, SIM_U_LEN, f32B);
+    Matrix C(SIM_Z_LEN, SIM_X_LEN, f32C);
+
+    /* The reference: bInit() + vReInit() */
+    static uint8_t u8ArenaRef[8192];
+    static MPC MPC_REF;
+    double _t = f64WallSecond();
+    if (!MPC_REF.bInit(SIM_X_LEN, SIM_U_LEN, SIM_Z_LEN, SIM_HP_LEN, SIM_HU_LEN, u8ArenaRef, sizeof(u8ArenaRef))) {
+        fprintf(stderr, "bInit() failed\n");
+        return 1;
+    }
+    MPC_REF.vReInit(A, B, C, 10.0, 0.03);
+    const double _tReInit = f64WallSecond() - _t;
+
+    std::vector<uint8_t> _buf(MPC::snapshotBytes(SIM_X_LEN, SIM_U_LEN, SIM_Z_LEN, SIM_HP_LEN, SIM_HU_LEN));
+    if (!MPC_REF.bSaveSnapshot(&_buf[0], _buf.size())) {
+        fprintf(stderr, "bSaveSnapshot() failed\n");
+        return 1;
+    }
+    FILE * _file = fopen(_outFile, "wb");
+    if ((_file == NULL) || (fwrite(&_buf[0], 1, _buf.size(), _file) != _buf.size()) || (fclose(_file) != 0)) {
+        fprintf(stderr, "Can't write '%s'\n", _outFile);
+        return 2;
+    }
+
+    /* The boot: zero copy from the mapped file */
+    size_t _bytes = 0;
+    const void * _snapshot = pSnapshotMapFile(_outFile, _bytes);
+    if (_snapshot == NULL) {
+        fprintf(stderr, "Can't map '%s'\n", _outFile);
+        return 2;
+    }
+    static uint8_t u8ArenaBoot[64];
+    static MPC MPC_BOOT;
+    _t = f64WallSecond();
+    if (!MPC_BOOT.bLoadSnapshot(_snapshot, _bytes, u8ArenaBoot, sizeof(u8ArenaBoot))) {
+        fprintf(stderr, "bLoadSnapshot() failed\n");
+        return 1;
+    }
+    const double _tLoad = f64WallSecond() - _t;
+
+    /* Both in the closed loop */
+    float_prec f32State[2][(SIM_HP_LEN*SIM_Z_LEN) + SIM_X_LEN + SIM_U_LEN];
+    memset(f32State, 0, sizeof(f32State));
+    Matrix SP_REF((SIM_HP_LEN*SIM_Z_LEN), 1, &f32State[0][0]);
+    Matrix x_REF(SIM_X_LEN, 1, &f32State[0][(SIM_HP_LEN*SIM_Z_LEN)]);
+    Matrix u_REF(SIM_U_LEN, 1, &f32State[0][(SIM_HP_LEN*SIM_Z_LEN) + SIM_X_LEN]);
+    Matrix SP_BOOT((SIM_HP_LEN*SIM_Z_LEN), 1, &f32State[1][0]);
+    Matrix x_BOOT(SIM_X_LEN, 1, &f32State[1][(SIM_HP_LEN*SIM_Z_LEN)]);
+    Matrix u_BOOT(SIM_U_LEN, 1, &f32State[1][(SIM_HP_LEN*SIM_Z_LEN) + SIM_X_LEN]);
+    int64_t _mismatch = -1;
+    for (int64_t _k = 0; (_k < _steps) && (_mismatch < 0); _k++) {
+        vStep(MPC_REF, A, B, SP_REF, x_REF, u_REF, _k);
+        vStep(MPC_BOOT, A, B, SP_BOOT, x_BOOT, u_BOOT, _k);
+        if (memcmp(f32State[0], f32State[1], sizeof(f32State[0])) != 0) {
+            _mismatch = _k;
+        }
+    }
+    vSnapshotUnmapFile(_snapshot, _bytes);
+
+    printf("variant          : mpc_runtime_engl (%s)\n", (FPU_PRECISION == PRECISION_SINGLE) ? "float" : "double");
+    printf("snapshot         : %s, %lu bytes (CRC-32 0x%08lX)\n", _outFile, (unsigned long) _buf.size(),
+           (unsigned long) u32SnapshotGet32(&_buf[44]));
+    printf("bInit + vReInit  : %.1f us (arena %lu bytes)\n", _tReInit * 1e6,
+           (unsigned long) MPC::workspaceBytes(SIM_X_LEN, SIM_U_LEN, SIM_Z_LEN, SIM_HP_LEN, SIM_HU_LEN));
+    printf("bLoadSnapshot    : %.1f us (arena %lu bytes, zero copy)\n", _tLoad * 1e6,
+           (unsigned long) MPC::snapshotWorkspaceBytes(SIM_U_LEN));
+    if (_mismatch >= 0) {
+        printf("closed loop      : MISMATCH at step %lld\n", (long long) _mismatch);
+        return 1;
+    }
+    printf("closed loop      : %lld steps bit-identical\n", (long long) _steps);
+    return 0;
+}
+
+
+void SPEW_THE_ERROR(char const * str)
+{
+    fprintf(stderr, "%s\n", str);
+    exit(1);
+}
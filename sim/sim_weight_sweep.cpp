@@ -0,0 +1,247 @@
+/**************************************************************************************************
+ * Host Q/R weight sweep (see closed_loop.h), for the optimized implementation (mpc_opt_engl):
+ *
+ *      sim_weight_sweep [--q-min q] [--q-max q] [--q-len n] [--r-min r] [--r-max r] [--r-len n]
+ *                       [--steps N] [--threads T] [--du-weight w] [--out file]
+ *                       [--plant file] [--schedule file]
+ *
+ *  The weight-independent prediction matrices ({MPC_1}) are calculated once with MPC::vReInit().
+ *  Every thread works on its own copy of that MPC and only calls MPC::vReTune(q, r) ({MPC_2}..
+ *  {MPC_4}) for each grid point, then runs the closed-loop scenario. The grid is log-spaced in
+ *  both weights, and the points are interleaved over the threads.
+ *
+ *  The cost-surface table (CSV, one line per grid point, in grid order):
+ *
+ *      q,r,rms_err,max_err,rms_du,cost,diverged
+ *
+ *  with rms_err the RMS tracking error over all outputs, max_err the biggest |tracking error|,
+ *  rms_du the RMS control move over all inputs, and cost = rms_err^2 + du_weight*rms_du^2.
+ *
+ * See https://github.com/pronenewbits for more!
+ *************************************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <thread>
+#include <vector>
+#include "closed_loop.h"
+
+
+typedef struct {
+    double f64q;
+    double f64r;
+    double f64rmsErr;
+    double f64maxErr;
+    double f64rmsDu;
+    double f64cost;
+    bool bDiverged;
+} SweepPoint;
+
+typedef struct {
+    int32_t i32thread;
+    int32_t i32threadLen;
+    int64_t i64steps;
+    double f64duWeight;
+    MPC * mpcNominal;               /* After vReInit() with the nominal model */
+    const Matrix * A;
+    const Matrix * B;
+    const Matrix * C;
+    const SimSchedule * schedule;
+    std::vector<SweepPoint> * point;
+} SweepJob;
+
+
+static void vSweepWorker(const SweepJob _job)
+{
+    /* Share the offline prediction work: copy the MPC, don't vReInit() it */
+    MPC * mpc = new MPC(*_job.mpcNominal);
+    Matrix * A = new Matrix(*_job.A);
+    Matrix * B = new Matrix(*_job.B);
+    Matrix * C = new Matrix(*_job.C);
+    SimClosedLoop * loop = new SimClosedLoop(*mpc, *A, *B, *C, *_job.schedule);
+
+    for (size_t _n = size_t(_job.i32thread); _n < _job.point->size(); _n += size_t(_job.i32threadLen)) {
+        SweepPoint &_point = (*_job.point)[_n];
+
+        mpc->vReTune(float_prec(_point.f64q), float_prec(_point.f64r));
+        loop->vReset();
+        for (int64_t _k = 0; _k < _job.i64steps; _k++) {
+            loop->vStep(NULL);
+        }
+
+        double _mse = 0;
+        _point.f64maxErr = 0;
+        for (int32_t _i = 0; _i < SS_Z_LEN; _i++) {
+            _mse += loop->f64GetRmsErr(_i) * loop->f64GetRmsErr(_i);
+            if (loop->f64GetMaxAbsErr(_i) > _point.f64maxErr) {
+                _point.f64maxErr = loop->f64GetMaxAbsErr(_i);
+            }
+        }
+        _mse /= double(SS_Z_LEN);
+        _point.f64rmsErr = sqrt(_mse);
+        _point.f64rmsDu  = loop->f64GetRmsDu();
+        _point.f64cost   = _mse + (_job.f64duWeight * _point.f64rmsDu * _point.f64rmsDu);
+        _point.bDiverged = !loop->bIsFinite() || !isfinite(_point.f64cost) || (loop->u64GetUpdateFail() > 0);
+    }
+
+    delete loop;
+    delete C;
+    delete B;
+    delete A;
+    delete mpc;
+}
+
+
+static double f64LogSpace(const double _min, const double _max, const int32_t _len, const int32_t _i)
+{
+    if (_len < 2) {
+        return _min;
+    }
+    return _min * pow(_max / _min, double(_i) / double(_len - 1));
+}
+
+static void vUsage(const char * _name)
+{
+    fprintf(stderr, "usage: %s [--q-min q] [--q-max q] [--q-len n] [--r-min r] [--r-max r] [--r-len n]\n"
+                    "       [--steps N] [--threads T] [--du-weight w] [--out file] [--plant file] [--schedule file]\n", _name);
+}
+
+int main(int argc, char ** argv)
+{
+    double _qMin = 0.1;
+    double _qMax = 100.0;
+    int32_t _qLen = 100;
+    double _rMin = 0.001;
+    double _rMax = 1.0;
+    int32_t _rLen = 100;
+    int64_t _steps = 600;
+    int32_t _threads = int32_t(std::thread::hardware_concurrency());
+    double _duWeight = 0.1;
+    const char * _outFile = NULL;
+    const char * _plantFile = NULL;
+    const char * _scheduleFile = NULL;
+    for (int _i = 1; _i < argc; _i++) {
+        if ((strcmp(argv[_i], "--q-min") == 0) && (_i+1 < argc)) {
+            _qMin = atof(argv[++_i]);
+        } else if ((strcmp(argv[_i], "--q-max") == 0) && (_i+1 < argc)) {
+            _qMax = atof(argv[++_i]);
+        } else if ((strcmp(argv[_i], "--q-len") == 0) && (_i+1 < argc)) {
+            _qLen = int32_t(atoi(argv[++_i]));
+        } else if ((strcmp(argv[_i], "--r-min") == 0) && (_i+1 < argc)) {
+            _rMin = atof(argv[++_i]);
+        } else if ((strcmp(argv[_i], "--r-max") == 0) && (_i+1 < argc)) {
+            _rMax = atof(argv[++_i]);
+        } else if ((strcmp(argv[_i], "--r-len") == 0) && (_i+1 < argc)) {
+            _rLen = int32_t(atoi(argv[++_i]));
+        } else if ((strcmp(argv[_i], "--steps") == 0) && (_i+1 < argc)) {
+            _steps = strtoll(argv[++_i], NULL, 10);
+        } else if ((strcmp(argv[_i], "--threads") == 0) && (_i+1 < argc)) {
+            _threads = int32_t(atoi(argv[++_i]));
+        } else if ((strcmp(argv[_i], "--du-weight") == 0) && (_i+1 < argc)) {
+            _duWeight = atof(argv[++_i]);
+        } else if ((strcmp(argv[_i], "--out") == 0) && (_i+1 < argc)) {
+            _outFile = argv[++_i];
+        } else if ((strcmp(argv[_i], "--plant") == 0) && (_i+1 < argc)) {
+            _plantFile = argv[++_i];
+        } else if ((strcmp(argv[_i], "--schedule") == 0) && (_i+1 < argc)) {
+            _scheduleFile = argv[++_i];
+        } else {
+            vUsage(argv[0]);
+            return 2;
+        }
+    }
+    if ((_qLen < 1) || (_rLen < 1) || (_qMin <= 0) || (_qMax <= 0) || (_rMin <= 0) || (_rMax <= 0)) {
+        fprintf(stderr, "The weight grid must be positive and non-empty\n");
+        return 2;
+    }
+    if (_threads < 1) {
+        _threads = 1;
+    }
+
+    static Matrix A(SS_X_LEN, SS_X_LEN);
+    static Matrix B(SS_X_LEN, SS_U_LEN);
+    static Matrix C(SS_Z_LEN, SS_X_LEN);
+    if (_plantFile != NULL) {
+        if (!bSimLoadPlant(_plantFile, A, B, C)) {
+            fprintf(stderr, "Can't read the plant file '%s' (A, B, C of %dx%d, %dx%d, %dx%d)\n", _plantFile,
+                    SS_X_LEN, SS_X_LEN, SS_X_LEN, SS_U_LEN, SS_Z_LEN, SS_X_LEN);
+            return 2;
+        }
+    } else if (!bSimJetPlant(A, B, C)) {
+        fprintf(stderr, "The jet example needs X=4, U=2, Z=2; use --plant for this dimension\n");
+        return 2;
+    }
+
+    static SimSchedule SCHEDULE;
+    if ((_scheduleFile != NULL) && !SCHEDULE.bLoad(_scheduleFile)) {
+        fprintf(stderr, "Can't read the set-point schedule file '%s'\n", _scheduleFile);
+        return 2;
+    }
+
+    FILE * _out = stdout;
+    if ((_outFile != NULL) && ((_out = fopen(_outFile, "w")) == NULL)) {
+        fprintf(stderr, "Can't open '%s'\n", _outFile);
+        return 2;
+    }
+
+    std::vector<SweepPoint> _point;
+    _point.resize(size_t(_qLen) * size_t(_rLen));
+    for (int32_t _i = 0; _i < _qLen; _i++) {
+        for (int32_t _j = 0; _j < _rLen; _j++) {
+            SweepPoint &_p = _point[(size_t(_i) * size_t(_rLen)) + size_t(_j)];
+            _p.f64q = f64LogSpace(_qMin, _qMax, _qLen, _i);
+            _p.f64r = f64LogSpace(_rMin, _rMax, _rLen, _j);
+        }
+    }
+
+    const double _tStart = f64SimWallSecond();
+
+    /* The weight-independent part, once ({MPC_1}) */
+    static MPC MPC_NOMINAL(A, B, C, float_prec(_point[0].f64q), float_prec(_point[0].f64r));
+
+    std::vector<std::thread> _worker;
+    for (int32_t _t = 0; _t < _threads; _t++) {
+        SweepJob _job;
+        _job.i32thread    = _t;
+        _job.i32threadLen = _threads;
+        _job.i64steps     = _steps;
+        _job.f64duWeight  = _duWeight;
+        _job.mpcNominal   = &MPC_NOMINAL;
+        _job.A            = &A;
+        _job.B            = &B;
+        _job.C            = &C;
+        _job.schedule     = &SCHEDULE;
+        _job.point        = &_point;
+        _worker.push_back(std::thread(vSweepWorker, _job));
+    }
+    for (size_t _t = 0; _t < _worker.size(); _t++) {
+        _worker[_t].join();
+    }
+    const double _tElapsed = f64SimWallSecond() - _tStart;
+
+    uint64_t _diverged = 0;
+    fprintf(_out, "q,r,rms_err,max_err,rms_du,cost,diverged\n");
+    for (size_t _n = 0; _n < _point.size(); _n++) {
+        const SweepPoint &_p = _point[_n];
+        fprintf(_out, "%.6g,%.6g,%.6e,%.6e,%.6e,%.6e,%d\n", _p.f64q, _p.f64r, _p.f64rmsErr, _p.f64maxErr,
+                _p.f64rmsDu, _p.f64cost, _p.bDiverged ? 1 : 0);
+        if (_p.bDiverged) {
+            _diverged++;
+        }
+    }
+    if (_out != stdout) {
+        fclose(_out);
+    }
+
+    fprintf(stderr, "%lu points x %lld steps, %d threads: %.3f s (%.0f points/s), %llu diverged\n",
+            (unsigned long) _point.size(), (long long) _steps, int(_threads), _tElapsed,
+            (_tElapsed > 0) ? (double(_point.size()) / _tElapsed) : 0.0, (unsigned long long) _diverged);
+    return 0;
+}
+
+
+void SPEW_THE_ERROR(char const * str)
+{
+    fprintf(stderr, "%s\n", str);
+    exit(1);
+}